@@ -0,0 +1,286 @@
+#include "hwpch.h"
+#include "AdapterSelector.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+    bool operator==( const LUID& a, const LUID& b )
+    {
+        return a.LowPart == b.LowPart && a.HighPart == b.HighPart;
+    }
+
+    // The user-mode driver version, read without creating a device.
+    uint64_t GetDriverVersion( IDXGIAdapter1* pAdapter )
+    {
+        LARGE_INTEGER version = {};
+        if (FAILED( pAdapter->CheckInterfaceSupport( __uuidof( IDXGIDevice ), &version ) ))
+        {
+            return 0;
+        }
+        return static_cast<uint64_t>( version.QuadPart );
+    }
+}
+
+AdapterSelector::AdapterSelector()
+    : m_capabilities(), m_dirty( false )
+{
+}
+
+void AdapterSelector::LoadCache( const std::wstring& path )
+{
+    std::ifstream file( path, std::ios::binary );
+    if (!file)
+    {
+        return;
+    }
+
+    uint32_t header[3] = {};
+    file.read( reinterpret_cast<char*>( header ), sizeof( header ) );
+    if (!file || header[0] != FileMagic || header[1] != FileVersion || header[2] != sizeof( GpuCapabilities ))
+    {
+        return;
+    }
+
+    GpuCapabilities capabilities;
+    while (file.read( reinterpret_cast<char*>( &capabilities ), sizeof( capabilities ) ))
+    {
+        m_cache.push_back( capabilities );
+    }
+}
+
+void AdapterSelector::SaveCache( const std::wstring& path )
+{
+    // Drop the adapters that are gone, or that came back under a new LUID after a reboot.
+    if (!m_enumeratedLuids.empty())
+    {
+        const auto stale = std::remove_if( m_cache.begin(), m_cache.end(), [this]( const GpuCapabilities& capabilities )
+        {
+            return std::none_of( m_enumeratedLuids.begin(), m_enumeratedLuids.end(), [&capabilities]( const LUID& luid ) { return luid == capabilities.adapterLuid; } );
+        } );
+        if (stale != m_cache.end())
+        {
+            m_cache.erase( stale, m_cache.end() );
+            m_dirty = true;
+        }
+    }
+
+    if (!m_dirty)
+    {
+        return;
+    }
+
+    std::ofstream file( path, std::ios::binary | std::ios::trunc );
+    const uint32_t header[3] = { FileMagic, FileVersion, sizeof( GpuCapabilities ) };
+    file.write( reinterpret_cast<const char*>( header ), sizeof( header ) );
+    file.write( reinterpret_cast<const char*>( m_cache.data() ), m_cache.size() * sizeof( GpuCapabilities ) );
+    m_dirty = false;
+}
+
+Microsoft::WRL::ComPtr<ID3D12Device> AdapterSelector::CreateDevice(
+    IDXGIFactory4* pFactory,
+    AdapterPolicy policy,
+    LUID explicitLuid,
+    D3D_FEATURE_LEVEL minFeatureLevel )
+{
+    EnumerateLuids( pFactory );
+
+    ComPtr<IDXGIAdapter1> adapter;
+    ComPtr<ID3D12Device> device;
+
+    if (policy == AdapterPolicy::Warp)
+    {
+        ThrowIfFailed( pFactory->EnumWarpAdapter( IID_PPV_ARGS( &adapter ) ) );
+        device = TryAdapter( adapter.Get(), minFeatureLevel );
+    }
+    else if (policy == AdapterPolicy::ExplicitLuid)
+    {
+        ThrowIfFailed( pFactory->EnumAdapterByLuid( explicitLuid, IID_PPV_ARGS( &adapter ) ) );
+        device = TryAdapter( adapter.Get(), minFeatureLevel );
+    }
+    else
+    {
+        ComPtr<IDXGIFactory6> factory6;
+        const bool hasPreference = SUCCEEDED( pFactory->QueryInterface( IID_PPV_ARGS( &factory6 ) ) );
+        const DXGI_GPU_PREFERENCE preference = policy == AdapterPolicy::HighPerformance ? DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE : DXGI_GPU_PREFERENCE_MINIMUM_POWER;
+
+        for (UINT adapterIndex = 0; !device; ++adapterIndex)
+        {
+            const HRESULT hr = hasPreference
+                ? factory6->EnumAdapterByGpuPreference( adapterIndex, preference, IID_PPV_ARGS( &adapter ) )
+                : pFactory->EnumAdapters1( adapterIndex, &adapter );
+            if (hr == DXGI_ERROR_NOT_FOUND)
+            {
+                break;
+            }
+
+            DXGI_ADAPTER_DESC1 desc;
+            adapter->GetDesc1( &desc );
+            if (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
+            {
+                // Don't select the Basic Render Driver adapter; use AdapterPolicy::Warp instead.
+                continue;
+            }
+
+            device = TryAdapter( adapter.Get(), minFeatureLevel );
+        }
+    }
+
+    if (!device)
+    {
+        ThrowIfFailed( DXGI_ERROR_UNSUPPORTED );
+    }
+
+    return device;
+}
+
+Microsoft::WRL::ComPtr<ID3D12Device> AdapterSelector::TryAdapter( IDXGIAdapter1* pAdapter, D3D_FEATURE_LEVEL minFeatureLevel )
+{
+    DXGI_ADAPTER_DESC1 desc;
+    pAdapter->GetDesc1( &desc );
+    const uint64_t driverVersion = GetDriverVersion( pAdapter );
+
+    // A cached result rules the adapter out without touching it.
+    const GpuCapabilities* pCached = FindCached( desc.AdapterLuid, driverVersion );
+    if (pCached && ( !pCached->supported || pCached->maxFeatureLevel < minFeatureLevel ))
+    {
+        return nullptr;
+    }
+
+    ComPtr<ID3D12Device> device;
+    if (FAILED( D3D12CreateDevice( pAdapter, minFeatureLevel, IID_PPV_ARGS( &device ) ) ))
+    {
+        if (!pCached)
+        {
+            GpuCapabilities unsupported = {};
+            unsupported.adapterLuid = desc.AdapterLuid;
+            unsupported.driverVersion = driverVersion;
+            Store( unsupported );
+        }
+        return nullptr;
+    }
+
+    if (pCached)
+    {
+        m_capabilities = *pCached;
+    }
+    else
+    {
+        m_capabilities = Probe( device.Get(), desc, driverVersion );
+        Store( m_capabilities );
+    }
+
+    return device;
+}
+
+GpuCapabilities AdapterSelector::Probe( ID3D12Device* pDevice, const DXGI_ADAPTER_DESC1& desc, uint64_t driverVersion )
+{
+    GpuCapabilities capabilities = {};
+    capabilities.adapterLuid = desc.AdapterLuid;
+    capabilities.driverVersion = driverVersion;
+    wcsncpy_s( capabilities.description, desc.Description, _TRUNCATE );
+    capabilities.vendorId = desc.VendorId;
+    capabilities.deviceId = desc.DeviceId;
+    capabilities.dedicatedVideoMemory = desc.DedicatedVideoMemory;
+    capabilities.isSoftware = ( desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE ) != 0;
+    capabilities.supported = true;
+
+    static const D3D_FEATURE_LEVEL featureLevels[] =
+    {
+        D3D_FEATURE_LEVEL_12_1, D3D_FEATURE_LEVEL_12_0, D3D_FEATURE_LEVEL_11_1, D3D_FEATURE_LEVEL_11_0
+    };
+    D3D12_FEATURE_DATA_FEATURE_LEVELS featureLevelData = { _countof( featureLevels ), featureLevels, D3D_FEATURE_LEVEL_11_0 };
+    if (SUCCEEDED( pDevice->CheckFeatureSupport( D3D12_FEATURE_FEATURE_LEVELS, &featureLevelData, sizeof( featureLevelData ) ) ))
+    {
+        capabilities.maxFeatureLevel = featureLevelData.MaxSupportedFeatureLevel;
+    }
+    else
+    {
+        capabilities.maxFeatureLevel = D3D_FEATURE_LEVEL_11_0;
+    }
+
+    // This is the highest version the sample supports. If CheckFeatureSupport succeeds, the HighestVersion returned will not be greater than this.
+    D3D12_FEATURE_DATA_ROOT_SIGNATURE rootSignatureData = { D3D_ROOT_SIGNATURE_VERSION_1_1 };
+    if (FAILED( pDevice->CheckFeatureSupport( D3D12_FEATURE_ROOT_SIGNATURE, &rootSignatureData, sizeof( rootSignatureData ) ) ))
+    {
+        rootSignatureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+    }
+    capabilities.rootSignatureVersion = rootSignatureData.HighestVersion;
+
+    // Runtimes that do not know the requested shader model fail the query, so step down.
+    static const D3D_SHADER_MODEL shaderModels[] =
+    {
+        D3D_SHADER_MODEL_6_5, D3D_SHADER_MODEL_6_4, D3D_SHADER_MODEL_6_3, D3D_SHADER_MODEL_6_2, D3D_SHADER_MODEL_6_1, D3D_SHADER_MODEL_6_0
+    };
+    capabilities.shaderModel = D3D_SHADER_MODEL_5_1;
+    for (D3D_SHADER_MODEL shaderModel : shaderModels)
+    {
+        D3D12_FEATURE_DATA_SHADER_MODEL shaderModelData = { shaderModel };
+        if (SUCCEEDED( pDevice->CheckFeatureSupport( D3D12_FEATURE_SHADER_MODEL, &shaderModelData, sizeof( shaderModelData ) ) ))
+        {
+            capabilities.shaderModel = shaderModelData.HighestShaderModel;
+            break;
+        }
+    }
+
+    // Optional feature blocks stay zeroed if the runtime predates them.
+    pDevice->CheckFeatureSupport( D3D12_FEATURE_D3D12_OPTIONS, &capabilities.options, sizeof( capabilities.options ) );
+    pDevice->CheckFeatureSupport( D3D12_FEATURE_D3D12_OPTIONS1, &capabilities.options1, sizeof( capabilities.options1 ) );
+    pDevice->CheckFeatureSupport( D3D12_FEATURE_D3D12_OPTIONS3, &capabilities.options3, sizeof( capabilities.options3 ) );
+    pDevice->CheckFeatureSupport( D3D12_FEATURE_D3D12_OPTIONS5, &capabilities.options5, sizeof( capabilities.options5 ) );
+    capabilities.resourceBindingTier = capabilities.options.ResourceBindingTier;
+
+    return capabilities;
+}
+
+const GpuCapabilities* AdapterSelector::FindCached( const LUID& luid, uint64_t driverVersion ) const
+{
+    for (const GpuCapabilities& capabilities : m_cache)
+    {
+        if (capabilities.adapterLuid == luid && capabilities.driverVersion == driverVersion)
+        {
+            return &capabilities;
+        }
+    }
+    return nullptr;
+}
+
+// Every adapter present, WARP included, whichever one ends up being used.
+void AdapterSelector::EnumerateLuids( IDXGIFactory4* pFactory )
+{
+    m_enumeratedLuids.clear();
+
+    ComPtr<IDXGIAdapter1> adapter;
+    for (UINT adapterIndex = 0; pFactory->EnumAdapters1( adapterIndex, &adapter ) != DXGI_ERROR_NOT_FOUND; ++adapterIndex)
+    {
+        DXGI_ADAPTER_DESC1 desc;
+        adapter->GetDesc1( &desc );
+        m_enumeratedLuids.push_back( desc.AdapterLuid );
+    }
+
+    ComPtr<IDXGIAdapter> warpAdapter;
+    if (SUCCEEDED( pFactory->EnumWarpAdapter( IID_PPV_ARGS( &warpAdapter ) ) ))
+    {
+        DXGI_ADAPTER_DESC desc;
+        warpAdapter->GetDesc( &desc );
+        m_enumeratedLuids.push_back( desc.AdapterLuid );
+    }
+}
+
+// An adapter keeps one entry: a driver update replaces the stale one.
+void AdapterSelector::Store( const GpuCapabilities& capabilities )
+{
+    for (GpuCapabilities& cached : m_cache)
+    {
+        if (cached.adapterLuid == capabilities.adapterLuid)
+        {
+            cached = capabilities;
+            m_dirty = true;
+            return;
+        }
+    }
+
+    m_cache.push_back( capabilities );
+    m_dirty = true;
+}
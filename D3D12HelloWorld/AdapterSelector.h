@@ -0,0 +1,57 @@
+#pragma once
+
+#include "GpuCapabilities.h"
+#include "Helpers.h"
+
+#include <dxgi1_6.h>
+#include <vector>
+
+enum class AdapterPolicy
+{
+    HighPerformance,
+    MinimumPower,
+    ExplicitLuid,
+    Warp
+};
+
+// Picks an adapter by policy and creates the device on it. Adapter capabilities are
+// cached on disk keyed by adapter LUID and driver version, so a known adapter is neither
+// probed nor test-created again; an unknown one is probed with the device that is going
+// to be used anyway, rather than a throwaway one. LUIDs are assigned at boot, so entries
+// for adapters that no longer enumerate are dropped when the cache is saved.
+class AdapterSelector
+{
+public:
+    AdapterSelector();
+
+    void LoadCache( const std::wstring& path );
+    // Call after CreateDevice(), which records the adapters present.
+    void SaveCache( const std::wstring& path );
+
+    // Throws if no adapter satisfies the policy and minimum feature level.
+    Microsoft::WRL::ComPtr<ID3D12Device> CreateDevice(
+        IDXGIFactory4* pFactory,
+        AdapterPolicy policy,
+        LUID explicitLuid = {},
+        D3D_FEATURE_LEVEL minFeatureLevel = D3D_FEATURE_LEVEL_11_0 );
+
+    const GpuCapabilities& GetCapabilities() const { return m_capabilities; }
+
+private:
+    static GpuCapabilities Probe( ID3D12Device* pDevice, const DXGI_ADAPTER_DESC1& desc, uint64_t driverVersion );
+
+    const GpuCapabilities* FindCached( const LUID& luid, uint64_t driverVersion ) const;
+    void Store( const GpuCapabilities& capabilities );
+    void EnumerateLuids( IDXGIFactory4* pFactory );
+
+    // Creates the device on pAdapter if it is (or may be) suitable; probes on a cache miss.
+    Microsoft::WRL::ComPtr<ID3D12Device> TryAdapter( IDXGIAdapter1* pAdapter, D3D_FEATURE_LEVEL minFeatureLevel );
+
+    static const uint32_t FileMagic = 0x50434748; // 'HGCP'
+    static const uint32_t FileVersion = 1;
+
+    std::vector<GpuCapabilities> m_cache;
+    std::vector<LUID> m_enumeratedLuids;
+    GpuCapabilities m_capabilities;
+    bool m_dirty;
+};
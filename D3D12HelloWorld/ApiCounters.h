@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Helpers.h"
+
+// Per-frame counts of the API calls that drive CPU and driver cost. Filled in by
+// CountingCommandList while recording, and at the call sites of device and queue
+// operations (descriptor writes, uploads, submissions).
+struct ApiCounters
+{
+    uint64_t draws;
+    uint64_t dispatches;
+    uint64_t indirectExecutes;
+    uint64_t bundlesExecuted;
+    uint64_t barrierBatches;    // ResourceBarrier calls
+    uint64_t barriers;          // barriers across all batches
+    uint64_t maxBarrierBatch;
+    uint64_t pipelineStateBinds;
+    uint64_t rootSignatureBinds;
+    uint64_t descriptorWrites;  // views created and descriptors copied
+    uint64_t bytesUploaded;
+    uint64_t commandListsSubmitted;
+
+    void Reset() { *this = ApiCounters(); }
+
+    // Adds the calls recorded in a bundle each time it is executed.
+    void Accumulate( const ApiCounters& other )
+    {
+        draws += other.draws;
+        dispatches += other.dispatches;
+        indirectExecutes += other.indirectExecutes;
+        bundlesExecuted += other.bundlesExecuted;
+        barrierBatches += other.barrierBatches;
+        barriers += other.barriers;
+        maxBarrierBatch = other.maxBarrierBatch > maxBarrierBatch ? other.maxBarrierBatch : maxBarrierBatch;
+        pipelineStateBinds += other.pipelineStateBinds;
+        rootSignatureBinds += other.rootSignatureBinds;
+        descriptorWrites += other.descriptorWrites;
+        bytesUploaded += other.bytesUploaded;
+        commandListsSubmitted += other.commandListsSubmitted;
+    }
+};
+
+// Records into a command list and counts the calls that ApiCounters tracks. Calls that
+// are not counted go through Get().
+class CountingCommandList
+{
+public:
+    CountingCommandList( ID3D12GraphicsCommandList* pCommandList, ApiCounters& counters )
+        : m_pCommandList( pCommandList ), m_counters( counters )
+    {
+    }
+
+    ID3D12GraphicsCommandList* Get() const { return m_pCommandList; }
+
+    void SetPipelineState( ID3D12PipelineState* pPipelineState )
+    {
+        m_counters.pipelineStateBinds++;
+        m_pCommandList->SetPipelineState( pPipelineState );
+    }
+
+    void SetGraphicsRootSignature( ID3D12RootSignature* pRootSignature )
+    {
+        m_counters.rootSignatureBinds++;
+        m_pCommandList->SetGraphicsRootSignature( pRootSignature );
+    }
+
+    void SetComputeRootSignature( ID3D12RootSignature* pRootSignature )
+    {
+        m_counters.rootSignatureBinds++;
+        m_pCommandList->SetComputeRootSignature( pRootSignature );
+    }
+
+    void ResourceBarrier( UINT numBarriers, const D3D12_RESOURCE_BARRIER* pBarriers )
+    {
+        m_counters.barrierBatches++;
+        m_counters.barriers += numBarriers;
+        m_counters.maxBarrierBatch = numBarriers > m_counters.maxBarrierBatch ? numBarriers : m_counters.maxBarrierBatch;
+        m_pCommandList->ResourceBarrier( numBarriers, pBarriers );
+    }
+
+    void DrawInstanced( UINT vertexCountPerInstance, UINT instanceCount, UINT startVertexLocation, UINT startInstanceLocation )
+    {
+        m_counters.draws++;
+        m_pCommandList->DrawInstanced( vertexCountPerInstance, instanceCount, startVertexLocation, startInstanceLocation );
+    }
+
+    void DrawIndexedInstanced( UINT indexCountPerInstance, UINT instanceCount, UINT startIndexLocation, INT baseVertexLocation, UINT startInstanceLocation )
+    {
+        m_counters.draws++;
+        m_pCommandList->DrawIndexedInstanced( indexCountPerInstance, instanceCount, startIndexLocation, baseVertexLocation, startInstanceLocation );
+    }
+
+    void Dispatch( UINT threadGroupCountX, UINT threadGroupCountY, UINT threadGroupCountZ )
+    {
+        m_counters.dispatches++;
+        m_pCommandList->Dispatch( threadGroupCountX, threadGroupCountY, threadGroupCountZ );
+    }
+
+    void ExecuteIndirect( ID3D12CommandSignature* pCommandSignature, UINT maxCommandCount, ID3D12Resource* pArgumentBuffer, UINT64 argumentBufferOffset, ID3D12Resource* pCountBuffer, UINT64 countBufferOffset )
+    {
+        m_counters.indirectExecutes++;
+        m_pCommandList->ExecuteIndirect( pCommandSignature, maxCommandCount, pArgumentBuffer, argumentBufferOffset, pCountBuffer, countBufferOffset );
+    }
+
+    // bundleCounters holds what was counted while the bundle was recorded.
+    void ExecuteBundle( ID3D12GraphicsCommandList* pBundle, const ApiCounters& bundleCounters )
+    {
+        m_counters.bundlesExecuted++;
+        m_counters.Accumulate( bundleCounters );
+        m_pCommandList->ExecuteBundle( pBundle );
+    }
+
+private:
+    ID3D12GraphicsCommandList* m_pCommandList;
+    ApiCounters& m_counters;
+};
@@ -1,58 +1,981 @@
 #include "hwpch.h"
 #include "App.h"
+#include "PipelineStateStream.h"
+#include "SimulatedPresentQueue.h"
+#include "SwapChainPresentQueue.h"
+#include "TransformHierarchy.h"
 
-App::App( uint32_t width, uint32_t height, std::wstring name )
-    : m_width(width), m_height(height), m_title( name ),
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+namespace
+{
+    // Fixed-function state of the scene and upscale pipelines. Its part of the PSO cache key
+    // is folded at compile time; only the shaders are hashed when a pipeline is created.
+    constexpr auto SceneFixedState = MakePipelineStateStream(
+        PsoPrimitiveTopology( D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE ),
+        PsoRasterizer( DefaultRasterizerDesc ),
+        PsoBlend( DefaultBlendDesc ),
+        PsoDepthStencil( DepthStencilDisabledDesc ),
+        PsoSampleMask( UINT_MAX ),
+        PsoRenderTargetFormats( D3D12_RT_FORMAT_ARRAY{ { DXGI_FORMAT_R8G8B8A8_UNORM }, 1 } ),
+        PsoSampleDesc( DXGI_SAMPLE_DESC{ 1, 0 } ) );
+
+    constexpr uint64_t SceneFixedStateHash = SceneFixedState.ConstantHash();
+
+    const float ClearColor[] = { 0.16f, 0.16f, 0.16f, 1.0f };
+
+    // Bounding radius of the triangle around its origin: its corners are within
+    // sqrt( 0.125 ) of it.
+    const float TriangleBoundingRadius = 0.36f;
+    const uint32_t TriangleIndexCount = 3;
+
+    // The triangle's positions as occluder geometry, matching the vertex buffer.
+    const float TrianglePositions[] = { 0.0f, 0.25f, 0.0f, 0.25f, -0.25f, 0.0f, -0.25f, -0.25f, 0.0f };
+    const uint16_t TriangleIndices[TriangleIndexCount] = { 0, 1, 2 };
+
+    // Depth of the instance grid, and of the occluders drawn in front of it with
+    // --occlusion-culling.
+    const float GridDepth = 0.5f;
+    const float OccluderDepth = 0.25f;
+    const uint32_t OccluderCount = 3;
+    const uint32_t OcclusionBufferWidth = 256;
+    const uint32_t OcclusionBufferHeight = 128;
+
+    // Threads per group of the culling pass (numthreads in Cull.hlsl).
+    const uint32_t CullGroupSize = 64;
+
+    // Frames between checks of the culling pass's output against the CPU reference.
+    const uint64_t CullCheckInterval = 120;
+
+    // The indirect buffers between the culling pass and ExecuteIndirect: also a copy
+    // source, so that they can be read back for a check in the same state.
+    const D3D12_RESOURCE_STATES IndirectArgumentState = D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT | D3D12_RESOURCE_STATE_COPY_SOURCE;
+
+    CD3DX12_ROOT_PARAMETER1 RootConstants( UINT num32BitValues, UINT shaderRegister, D3D12_SHADER_VISIBILITY visibility )
+    {
+        CD3DX12_ROOT_PARAMETER1 parameter;
+        parameter.InitAsConstants( num32BitValues, shaderRegister, 0, visibility );
+        return parameter;
+    }
+
+    CD3DX12_ROOT_PARAMETER1 RootShaderResourceView( UINT shaderRegister, D3D12_SHADER_VISIBILITY visibility )
+    {
+        CD3DX12_ROOT_PARAMETER1 parameter;
+        parameter.InitAsShaderResourceView( shaderRegister, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE, visibility );
+        return parameter;
+    }
+
+    CD3DX12_ROOT_PARAMETER1 RootUnorderedAccessView( UINT shaderRegister, D3D12_SHADER_VISIBILITY visibility )
+    {
+        CD3DX12_ROOT_PARAMETER1 parameter;
+        parameter.InitAsUnorderedAccessView( shaderRegister, 0, D3D12_ROOT_DESCRIPTOR_FLAG_NONE, visibility );
+        return parameter;
+    }
+
+    // range must outlive the parameter.
+    CD3DX12_ROOT_PARAMETER1 DescriptorTable( const D3D12_DESCRIPTOR_RANGE1& range, D3D12_SHADER_VISIBILITY visibility )
+    {
+        CD3DX12_ROOT_PARAMETER1 parameter;
+        parameter.InitAsDescriptorTable( 1, &range, visibility );
+        return parameter;
+    }
+
+    double ElapsedMs( App::FrameClock::time_point start, App::FrameClock::time_point end )
+    {
+        return std::chrono::duration<double, std::milli>( end - start ).count();
+    }
+
+    App::FrameClock::time_point QpcToFrameClock( int64_t qpc )
+    {
+        LARGE_INTEGER frequency;
+        LARGE_INTEGER now;
+        QueryPerformanceFrequency( &frequency );
+        QueryPerformanceCounter( &now );
+        const App::FrameClock::time_point frameClockNow = App::FrameClock::now();
+        const double ageSeconds = static_cast<double>( now.QuadPart - qpc ) / static_cast<double>( frequency.QuadPart );
+        return frameClockNow - std::chrono::duration_cast<App::FrameClock::duration>( std::chrono::duration<double>( ageSeconds ) );
+    }
+}
+
+App::App( const RuntimeConfig& config, std::wstring name )
+    : m_width( config.width ), m_height( config.height ), m_title( name ),
     m_FrameIndex( 0 ),
-    m_Viewport( 0.0f, 0.0f, static_cast<float>( width ), static_cast<float>( height ) ),
-    m_ScissorRect( 0, 0, static_cast<LONG>( width ), static_cast<LONG>( height ) ),
+    m_Viewport( 0.0f, 0.0f, static_cast<float>( config.width ), static_cast<float>( config.height ) ),
+    m_ScissorRect( 0, 0, static_cast<LONG>( config.width ), static_cast<LONG>( config.height ) ),
+    m_swapChainFlags( 0 ),
+    m_presentMode( config.presentMode ),
+    m_pSimulatedDisplay( nullptr ),
+    m_minimized( false ),
+    m_occluded( false ),
+    m_throttleIntervalMs( 0 ),
+    m_resizePending( false ),
+    m_pendingWidth( 0 ),
+    m_pendingHeight( 0 ),
     m_rtvDescriptorSize( 0 ),
-    m_useWarpDevice(false)
+    m_RootSignature( nullptr ),
+    m_rootSignatureHash( 0 ),
+    m_renderScale( 1.0 ),
+    m_frameScales{},
+    m_scaledGpuFenceValue( 0 ),
+    m_UpscaleRootSignature( nullptr ),
+    m_upscaleRootSignatureHash( 0 ),
+    m_CullRootSignature( nullptr ),
+    m_cullRootSignatureHash( 0 ),
+    m_cullCheckFenceValue( 0 ),
+    m_cullCheckConstants{},
+    m_cullChecks( 0 ),
+    m_cullCheckMismatches( 0 ),
+    m_vertexShader( 0 ),
+    m_pixelShader( 0 ),
+    m_pixelShaderPermutation( 0 ),
+    m_grayscaleMask( 0 ),
+    m_requestedPixelPermutation( 0 ),
+    m_permutationBuildPending( false ),
+    m_permutationBuildPermutation( 0 ),
+    m_ShaderHotReload( m_ShaderLibrary ),
+    m_mainPipelineId( 0 ),
+    m_upscaleVertexShader( 0 ),
+    m_upscalePixelShader( 0 ),
+    m_upscalePipelineId( 0 ),
+    m_cullShader( 0 ),
+    m_firstFramePresented( false ),
+    m_framesRendered( 0 ),
+    m_frameTimings{},
+    m_frameCounters(),
+    m_bundleCounters(),
+    m_pGpuTrack( Trace::CreateTrack( "GPU direct queue" ) ),
+    m_tracedGpuFenceValue( 0 ),
+    m_simulationFrame( 0 ),
+    m_boundsAspectRatio( 0.0f ),
+    m_stopSimulation( false ),
+    m_FenceValues{},
+    m_config( config ),
+    m_capabilities(),
+    m_Jobs( config.workerThreads, config.pinWorkers )
 {
     WCHAR assetsPath[512];
     GetAssetsPath( assetsPath, _countof( assetsPath ) );
     m_assetsPath = assetsPath;
 
-    m_aspectRatio = static_cast<float>( width ) / static_cast<float>( height );
+    m_aspectRatio.store( static_cast<float>( config.width ) / static_cast<float>( config.height ) );
+
+    if (config.framePacing || config.maxFps != 0)
+    {
+        m_FramePacer.reset( new FramePacer() );
+        m_FramePacer->SetTargetFps( config.maxFps );
+    }
+
+    if (config.gpuBudgetMs > 0.0)
+    {
+        ResolutionScaleController::Settings settings;
+        settings.budgetMs = config.gpuBudgetMs;
+        settings.minScale = config.minRenderScale;
+        m_ResolutionScale.reset( new ResolutionScaleController( settings ) );
+    }
+
+    // The GPU culling pass appends its draws in no particular order, so the occluders
+    // would not reliably be drawn last.
+    if (config.occlusionCulling && !config.gpuCulling)
+    {
+        m_OcclusionBuffer.reset( new OcclusionBuffer( OcclusionBufferWidth, OcclusionBufferHeight ) );
+    }
 }
 
+// Startup runs as a task graph. Work that does not need the device (reading caches,
+// loading shaders, serializing the root signature) overlaps LoadPipeline(); the device-
+// dependent steps join once the device exists, and only the resources the first frame
+// needs are waited on before the main loop starts.
 void App::OnInit()
 {
-    LoadPipeline();
+    Trace::SetThreadName( "Main" );
+
+    m_StartupGraph.reset( new TaskGraph( m_Jobs ) );
+    TaskGraph& graph = *m_StartupGraph;
+
+    struct StartupShaders
+    {
+        Microsoft::WRL::ComPtr<ID3DBlob> vertexShader;
+        Microsoft::WRL::ComPtr<ID3DBlob> pixelShader;
+        Microsoft::WRL::ComPtr<ID3DBlob> upscaleVertexShader;
+        Microsoft::WRL::ComPtr<ID3DBlob> upscalePixelShader;
+        Microsoft::WRL::ComPtr<ID3DBlob> cullShader;
+    } shaders;
+
+    const TaskGraph::TaskId device = graph.AddExternal( "LoadPipeline" );
+
+    const TaskGraph::TaskId readCaches = graph.Add( "ReadCaches", [this]
+    {
+        m_RootSignatureCache.Load( GetAssetFullPath( L"RootSignatures.cache" ) );
+        m_PipelineLibrary.Read( GetAssetFullPath( L"Pipelines.cache" ) );
+    } );
+
+    const TaskGraph::TaskId serializeRootSignature = graph.Add( "SerializeRootSignature", [this]
+    {
+        // Speculatively serialize at the highest version; CreateRootSignature() falls back
+        // to 1.0 if the device turns out not to support 1.1.
+        m_RootSignatureCache.Serialize( GetRootSignatureDesc(), D3D_ROOT_SIGNATURE_VERSION_1_1 );
+        if (m_ResolutionScale)
+        {
+            m_RootSignatureCache.Serialize( GetUpscaleRootSignatureDesc(), D3D_ROOT_SIGNATURE_VERSION_1_1 );
+        }
+        if (m_config.gpuCulling)
+        {
+            m_RootSignatureCache.Serialize( GetCullRootSignatureDesc(), D3D_ROOT_SIGNATURE_VERSION_1_1 );
+        }
+    }, { readCaches } );
+
+    const TaskGraph::TaskId loadShaders = graph.Add( "LoadShaders", [this, &shaders]
+    {
+        m_ShaderLibrary.Start( m_Jobs, GetShaderSourceDirectory(), GetAssetFullPath( L"ShaderCache\\" ) );
+        m_vertexShader = m_ShaderLibrary.DeclareShader( L"Shaders.hlsl", "VSMain", "vs_5_0", {} );
+        m_pixelShader = m_ShaderLibrary.DeclareShader( L"Shaders.hlsl", "PSMain", "ps_5_0", { "GRAYSCALE" } );
+        m_grayscaleMask = m_ShaderLibrary.GetKeywordMask( m_pixelShader, "GRAYSCALE" );
+        m_pixelShaderPermutation = m_config.grayscale ? m_grayscaleMask : 0;
+        m_requestedPixelPermutation = m_pixelShaderPermutation;
+
+        // The variants the first frame needs come from the disk cache when possible.
+        shaders.vertexShader = m_ShaderLibrary.GetVariant( m_vertexShader, 0 );
+        shaders.pixelShader = m_ShaderLibrary.GetVariant( m_pixelShader, m_pixelShaderPermutation );
+
+        if (m_ResolutionScale)
+        {
+            m_upscaleVertexShader = m_ShaderLibrary.DeclareShader( L"Upscale.hlsl", "VSMain", "vs_5_0", {} );
+            m_upscalePixelShader = m_ShaderLibrary.DeclareShader( L"Upscale.hlsl", "PSMain", "ps_5_0", {} );
+            shaders.upscaleVertexShader = m_ShaderLibrary.GetVariant( m_upscaleVertexShader, 0 );
+            shaders.upscalePixelShader = m_ShaderLibrary.GetVariant( m_upscalePixelShader, 0 );
+        }
+
+        if (m_config.gpuCulling)
+        {
+            m_cullShader = m_ShaderLibrary.DeclareShader( L"Cull.hlsl", "CSMain", "cs_5_0", {} );
+            shaders.cullShader = m_ShaderLibrary.GetVariant( m_cullShader, 0 );
+        }
+    } );
+
+    const TaskGraph::TaskId rootSignature = graph.Add( "CreateRootSignature", [this] { CreateRootSignature(); }, { device, serializeRootSignature } );
+
+    const TaskGraph::TaskId pipelineLibrary = graph.Add( "OpenPipelineLibrary", [this] { m_PipelineLibrary.Open( m_Device.Get() ); }, { device, readCaches } );
+
+    const TaskGraph::TaskId pipelineState = graph.Add( "CreatePipelineState", [this, &shaders]
+    {
+        m_PipelineState = CreatePipelineState( shaders.vertexShader.Get(), shaders.pixelShader.Get() );
+        if (m_ResolutionScale)
+        {
+            m_UpscalePipelineState = CreateUpscalePipelineState( shaders.upscaleVertexShader.Get(), shaders.upscalePixelShader.Get() );
+        }
+        if (m_config.gpuCulling)
+        {
+            m_CullPipelineState = CreateCullPipelineState( shaders.cullShader.Get() );
+        }
+    }, { rootSignature, loadShaders, pipelineLibrary } );
+
+    const TaskGraph::TaskId vertexBuffer = graph.Add( "CreateVertexBuffer", [this] { CreateVertexBuffer(); }, { device } );
+
+    // Not needed by the first frame; these may still be running when the main loop starts.
+    graph.Add( "SaveRootSignatureCache", [this] { m_RootSignatureCache.Save( GetAssetFullPath( L"RootSignatures.cache" ) ); }, { rootSignature } );
+    graph.Add( "PrewarmShaderVariants", [this] { m_ShaderLibrary.PrewarmFromManifest( GetAssetFullPath( L"ShaderVariants.manifest" ) ); }, { loadShaders } );
+
+    graph.Start();
+
+    // The swap chain must be created on the window thread.
+    graph.BeginExternal( device );
+    try
+    {
+        LoadPipeline();
+    }
+    catch (...)
+    {
+        // Let the in-flight tasks finish before the locals they reference go away.
+        graph.CompleteExternal( device, std::current_exception() );
+        m_StartupGraph.reset();
+        throw;
+    }
+    graph.CompleteExternal( device );
+
+    graph.Wait( pipelineState );
+    graph.Wait( vertexBuffer );
     LoadAssets();
+
+    // Runs with a fixed frame count are benchmarks: measure every frame after the warmup.
+    if (m_config.frameCount != 0)
+    {
+        m_FrameStats.reset( new FrameStats( { "cpuFrameMs", "waitMs", "presentMs", "gpuFrameMs", "gpuClearMs", "gpuSceneMs", "gpuUpscaleMs", "renderScale", "uploadMs", "recordMs", "cullMs", "visibleInstances", "gpuCullMs", "occlusionMs" }, m_config.warmupFrames ) );
+        m_FrameStats->Reserve( m_config.frameCount );
+        m_FrameStats->SetTag( "adapter", ToUtf8( m_capabilities.description ) );
+        m_FrameStats->SetTag( "resolution", std::to_string( m_width ) + "x" + std::to_string( m_height ) );
+        m_FrameStats->SetTag( "instances", std::to_string( m_config.instanceCount ) );
+        m_FrameStats->SetTag( "drawMode", m_config.gpuCulling ? "indirect" : m_config.separateDraws ? "separate" : "instanced" );
+        m_FrameStats->SetTag( "occlusionCulling", m_OcclusionBuffer ? "on" : "off" );
+        m_FrameStats->SetTag( "framesInFlight", std::to_string( m_config.framesInFlight ) );
+        m_FrameStats->SetTag( "presentMode", PresentModeName( m_presentMode ) );
+        m_FrameStats->SetTag( "maxFps", m_config.maxFps != 0 ? std::to_string( m_config.maxFps ) : "off" );
+        m_FrameStats->SetTag( "framePacing", m_FramePacer ? "on" : "off" );
+        m_FrameStats->SetTag( "gpuBudgetMs", m_ResolutionScale ? std::to_string( m_config.gpuBudgetMs ) : "off" );
+        m_FrameStats->SetTag( "frameLatency", m_config.frameLatency != 0 ? std::to_string( m_config.frameLatency ) : "off" );
+        m_FrameStats->SetTag( "warmupFrames", std::to_string( m_config.warmupFrames ) );
+    }
+
+    StartSimulation();
 }
 
 
-// Update frame-based values.
+// Simulation stage: fills the next frame packet while the render thread records the
+// previous one. Runs on the simulation thread (see StartSimulation()).
 void App::OnUpdate()
 {
+    HW_TRACE_SCOPE( "OnUpdate" );
+
+    // Low-latency mode: start the frame only once the display can take it, rather than
+    // building it early and blocking in Present().
+    if (!WaitForPresentQueue())
+    {
+        return;
+    }
+
+    // Then hold it back until just in time for its present slot, so that it starts from
+    // the latest input.
+    if (m_FramePacer)
+    {
+        HW_TRACE_SCOPE( "FramePacing" );
+        m_FramePacer->WaitForFrameStart();
+    }
+
+    FramePacket* pPacket;
+    {
+        HW_TRACE_SCOPE( "WaitForFramePacketSlot" );
+        pPacket = m_FramePackets.BeginWrite();
+    }
+    if (!pPacket)
+    {
+        return;
+    }
+
+    pPacket->startTime = FrameClock::now();
+    Simulate( *pPacket );
+    m_FramePackets.EndWrite();
+}
+
+// Advance the scene by a fixed step, so that benchmark runs see the same frames.
+void App::Simulate( FramePacket& packet )
+{
+    using namespace DirectX;
+
+    const double timeStep = 1.0 / 60.0;
+    packet.frameNumber = m_simulationFrame++;
+    packet.simulationTime = packet.frameNumber * timeStep;
+
+    // The camera corrects for the aspect ratio and, with more than one instance, slowly
+    // zooms in on the grid and back out, so that culling has something to reject.
+    const float aspectRatio = m_aspectRatio.load( std::memory_order_relaxed );
+    const uint32_t count = m_config.instanceCount;
+    const float zoom = count > 1 ? static_cast<float>( 1.5 - 0.5 * std::cos( packet.simulationTime * 0.25 ) ) : 1.0f;
+    const XMMATRIX viewProjection = XMMatrixScaling( zoom, zoom * aspectRatio, 1.0f );
+    XMStoreFloat4x4( &packet.viewProjection, XMMatrixTranspose( viewProjection ) );
+    {
+        XMFLOAT4X4 matrix;
+        XMStoreFloat4x4( &matrix, viewProjection );
+        packet.frustum = Frustum::FromViewProjection( matrix.m );
+    }
+
+    // Instances fill a square grid over the view, each spinning with its own phase and
+    // tinted by its cell; a single instance is the original triangle in the centre.
+    const uint32_t side = static_cast<uint32_t>( std::ceil( std::sqrt( static_cast<double>( count ) ) ) );
+    const float cell = 2.0f / side;
+    const float scale = 1.0f / side;
+    const float angle = static_cast<float>( packet.simulationTime * XM_PIDIV2 );
+
+    if (m_config.gpuCulling)
+    {
+        // The GPU culls from the instances themselves: all of them go to the render stage.
+        if (m_visibleInstances.size() != count)
+        {
+            m_visibleInstances.resize( count );
+            std::iota( m_visibleInstances.begin(), m_visibleInstances.end(), 0u );
+        }
+        packet.cullMs = 0.0;
+    }
+    else
+    {
+        // The bounds only change with the grid. Each sphere covers its triangle at any angle.
+        if (m_instanceBounds.count != count || m_boundsAspectRatio != aspectRatio)
+        {
+            m_instanceBounds.Resize( count );
+            m_boundsAspectRatio = aspectRatio;
+            SphereBounds* pBounds = &m_instanceBounds;
+            m_Jobs.ParallelFor( count, [=]( uint32_t begin, uint32_t end )
+            {
+                for (uint32_t i = begin; i < end; i++)
+                {
+                    const float x = -1.0f + cell * ( i % side + 0.5f );
+                    const float y = ( 1.0f - cell * ( i / side + 0.5f ) ) / aspectRatio;
+                    pBounds->Set( i, x, y, GridDepth, TriangleBoundingRadius * scale );
+                }
+            }, 16384 );
+        }
+
+        const FrameClock::time_point cullStart = FrameClock::now();
+        {
+            HW_TRACE_SCOPE( "FrustumCulling" );
+            CullSpheres( m_Jobs, packet.frustum, m_instanceBounds, m_visibleInstances );
+        }
+        packet.cullMs = ElapsedMs( cullStart, FrameClock::now() );
+    }
+
+    // Large dark triangles drifting over the grid, drawn after it so they cover it.
+    FramePacket::Instance occluders[OccluderCount];
+    const uint32_t occluderCount = m_OcclusionBuffer ? OccluderCount : 0;
+    for (uint32_t k = 0; k < occluderCount; k++)
+    {
+        const float x = 0.55f * std::sin( static_cast<float>( packet.simulationTime ) * 0.35f + 2.1f * k );
+        const float y = 0.35f * std::cos( static_cast<float>( packet.simulationTime ) * 0.27f + 1.3f * k ) / aspectRatio;
+        occluders[k].worldRows[0] = XMFLOAT4( 1.6f, 0.0f, 0.0f, x );
+        occluders[k].worldRows[1] = XMFLOAT4( 0.0f, 1.6f, 0.0f, y );
+        occluders[k].worldRows[2] = XMFLOAT4( 0.0f, 0.0f, 1.0f, OccluderDepth );
+        occluders[k].color = XMFLOAT4( 0.35f, 0.35f, 0.4f, 1.0f );
+    }
+
+    packet.occlusionMs = 0.0;
+    if (m_OcclusionBuffer)
+    {
+        HW_TRACE_SCOPE( "OcclusionCulling" );
+        const FrameClock::time_point occlusionStart = FrameClock::now();
+
+        m_OcclusionBuffer->Clear();
+        for (const FramePacket::Instance& occluder : occluders)
+        {
+            // The instance rows are the transposed world matrix.
+            const XMMATRIX world = XMMatrixTranspose( XMMATRIX( XMLoadFloat4( &occluder.worldRows[0] ), XMLoadFloat4( &occluder.worldRows[1] ), XMLoadFloat4( &occluder.worldRows[2] ), g_XMIdentityR3 ) );
+            XMFLOAT4X4 objectToClip;
+            XMStoreFloat4x4( &objectToClip, XMMatrixMultiply( world, viewProjection ) );
+            m_OcclusionBuffer->AddOccluder( objectToClip.m, TrianglePositions, 3, TriangleIndices, 1 );
+        }
+        m_OcclusionBuffer->Rasterize( m_Jobs );
+
+        XMFLOAT4X4 matrix;
+        XMStoreFloat4x4( &matrix, viewProjection );
+        m_frustumVisible.swap( m_visibleInstances );
+        m_OcclusionBuffer->CullSpheres( m_Jobs, matrix.m, m_instanceBounds, m_frustumVisible, m_visibleInstances );
+        packet.occlusionMs = ElapsedMs( occlusionStart, FrameClock::now() );
+    }
+
+    // Only the visible instances go to the render stage.
+    const uint32_t visibleCount = static_cast<uint32_t>( m_visibleInstances.size() );
+    packet.instances.resize( visibleCount );
+    FramePacket::Instance* pInstances = packet.instances.data();
+    const uint32_t* pVisible = m_visibleInstances.data();
+    m_Jobs.ParallelFor( visibleCount, [=]( uint32_t begin, uint32_t end )
+    {
+        for (uint32_t v = begin; v < end; v++)
+        {
+            const uint32_t i = pVisible[v];
+            const uint32_t column = i % side;
+            const uint32_t row = i / side;
+            const float x = -1.0f + cell * ( column + 0.5f );
+            const float y = ( 1.0f - cell * ( row + 0.5f ) ) / aspectRatio;
+
+            float sinAngle;
+            float cosAngle;
+            XMScalarSinCos( &sinAngle, &cosAngle, angle + 0.1f * ( i % 64 ) );
+
+            FramePacket::Instance& instance = pInstances[v];
+            instance.worldRows[0] = XMFLOAT4( cosAngle * scale, -sinAngle * scale, 0.0f, x );
+            instance.worldRows[1] = XMFLOAT4( sinAngle * scale, cosAngle * scale, 0.0f, y );
+            instance.worldRows[2] = XMFLOAT4( 0.0f, 0.0f, 1.0f, GridDepth );
+            instance.color = XMFLOAT4( 1.0f - 0.5f * column / side, 1.0f - 0.5f * row / side, 1.0f, 1.0f );
+        }
+    }, 4096 );
+
+    packet.instances.insert( packet.instances.end(), occluders, occluders + occluderCount );
+}
+
+// Returns false if the display took no frame within a short wait. The frame is then
+// skipped rather than started anyway: every admission must be matched by exactly one
+// Present(), or the queue would let more frames through than the latency allows. The
+// simulation loop calls OnUpdate() again, so shutdown is never held up by a display that
+// stopped taking frames.
+bool App::WaitForPresentQueue()
+{
+    if (!m_PresentQueue)
+    {
+        return true;
+    }
+
+    HW_TRACE_SCOPE( "WaitForPresentQueue" );
+    return m_PresentQueue->WaitForFrame( 100 );
+}
+
+// Feeds the pacing model: how long the frame took to reach Present(), its GPU time, and
+// where the display's vblanks fall (only relevant with vsync).
+void App::ReportFramePacing( FrameClock::time_point frameStart, FrameClock::time_point presentTime )
+{
+    if (!m_FramePacer)
+    {
+        return;
+    }
+
+    // GPU timings trail by the frames in flight; the latest is the best estimate.
+    m_FramePacer->ReportFrame( frameStart, presentTime, m_GpuProfiler.GetScopeMilliseconds( "Frame" ) );
+
+    if (m_presentMode != PresentMode::Vsync)
+    {
+        return;
+    }
+
+    if (m_SwapChain)
+    {
+        // Fails until the swap chain has presented a few frames; the grid is set up later.
+        DXGI_FRAME_STATISTICS statistics;
+        if (SUCCEEDED( m_SwapChain->GetFrameStatistics( &statistics ) ) && statistics.SyncQPCTime.QuadPart != 0)
+        {
+            m_FramePacer->ReportVblank( QpcToFrameClock( statistics.SyncQPCTime.QuadPart ), statistics.SyncRefreshCount );
+        }
+    }
+    else if (m_pSimulatedDisplay)
+    {
+        SimulatedPresentQueue::Clock::time_point vblankTime;
+        uint64_t vblankCount;
+        m_pSimulatedDisplay->GetLastVblank( vblankTime, vblankCount );
+        m_FramePacer->ReportVblank( vblankTime, vblankCount );
+    }
+}
+
+// Minimized or hidden windows suspend rendering; they come back through a resize or by
+// being shown again. An occluded window (e.g. covered by a full-screen app) instead polls
+// with test presents, which check visibility without presenting anything.
+uint32_t App::UpdateThrottling()
+{
+    const uint32_t SuspendedPollMs = 250;
+    const uint32_t OccludedPollMs = 100;
+
+    if (m_config.headless)
+    {
+        return 0;
+    }
+
+    if (m_minimized || !IsWindowVisible( Window::GetHwnd() ))
+    {
+        return SuspendedPollMs;
+    }
+
+    if (m_occluded)
+    {
+        HW_TRACE_SCOPE( "PresentTest" );
+        m_occluded = m_SwapChain->Present( 0, DXGI_PRESENT_TEST ) == DXGI_STATUS_OCCLUDED;
+        if (m_occluded)
+        {
+            return OccludedPollMs;
+        }
+    }
+    return 0;
+}
+
+// Must be called on the render thread, which presents.
+void App::SetFrameLatency( uint32_t frames )
+{
+    if (m_PresentQueue && frames >= 1 && frames <= RuntimeConfig::MaxFrameLatency)
+    {
+        m_PresentQueue->SetMaximumFrameLatency( frames );
+    }
+}
+
+void App::StartSimulation()
+{
+    m_simulationThread = std::thread( [this]
+    {
+        Trace::SetThreadName( "Simulation" );
+        try
+        {
+            while (!m_stopSimulation.load( std::memory_order_acquire ))
+            {
+                OnUpdate();
+            }
+        }
+        catch (...)
+        {
+            m_simulationError = std::current_exception();
+        }
+
+        // Releases the render thread if it is waiting for a packet.
+        m_FramePackets.Close();
+    } );
+}
+
+void App::StopSimulation()
+{
+    if (m_simulationThread.joinable())
+    {
+        m_stopSimulation.store( true, std::memory_order_release );
+        m_FramePackets.Close();
+        m_simulationThread.join();
+    }
 }
 
 // Render the scene.
 void App::OnRender()
 {
-    // Record all the commands we need to render the scene into the command list.
-    PopulateCommandList();
+    if (m_framesRendered == 0)
+    {
+        m_lastFrameEnd = FrameClock::now();
+    }
+
+    ApplyPendingResize();
+
+    // Skip the frame entirely while it could not be seen. The simulation thread stalls
+    // on the frame packets in the meantime.
+    const bool wasThrottled = m_throttleIntervalMs != 0;
+    m_throttleIntervalMs = UpdateThrottling();
+    if (m_throttleIntervalMs != 0)
+    {
+        return;
+    }
+    if (wasThrottled)
+    {
+        // Do not count the time spent throttled as a frame.
+        m_lastFrameEnd = FrameClock::now();
+    }
+
+    // Swap in any pipelines rebuilt since the last frame.
+    ApplyShaderReloads();
+    ApplyPixelShaderPermutation();
+
+    const FramePacket* pPacket;
+    {
+        HW_TRACE_SCOPE( "WaitForFramePacket" );
+        pPacket = m_FramePackets.BeginRead();
+    }
+    if (!pPacket)
+    {
+        // The simulation stopped; the error, if any, ends the render thread.
+        if (m_simulationError)
+        {
+            std::rethrow_exception( m_simulationError );
+        }
+        return;
+    }
+
+    // Record all the commands we need to render the scene into the command list. The
+    // packet is released as soon as it is recorded, so the next simulation step can start.
+    PopulateCommandList( *pPacket );
+    const FrameClock::time_point frameStart = pPacket->startTime;
+    m_FramePackets.EndRead();
 
     // Execute the command list.
-    ID3D12CommandList* ppCommandLists[] = { m_CommandList.Get() };
-    m_CommandQueue->ExecuteCommandLists( _countof( ppCommandLists ), ppCommandLists );
+    {
+        HW_TRACE_SCOPE( "ExecuteCommandLists" );
+        ID3D12CommandList* ppCommandLists[] = { m_CommandList.Get() };
+        m_CommandQueue->ExecuteCommandLists( _countof( ppCommandLists ), ppCommandLists );
+        m_frameCounters.commandListsSubmitted += _countof( ppCommandLists );
+    }
+
+    // Present the frame. Headless runs have no swap chain; the frame ends at the fence.
+    if (!m_config.headless)
+    {
+        const uint32_t syncInterval = m_presentMode == PresentMode::Vsync ? 1 : 0;
+        const uint32_t presentFlags = m_presentMode == PresentMode::Tearing ? DXGI_PRESENT_ALLOW_TEARING : 0;
+        HW_TRACE_SCOPE( "Present" );
+        const FrameClock::time_point presentStart = FrameClock::now();
+        const HRESULT hr = m_SwapChain->Present( syncInterval, presentFlags );
+        ThrowIfFailed( hr );
+        m_occluded = hr == DXGI_STATUS_OCCLUDED;
+        m_frameTimings[FrameMetricPresent] = ElapsedMs( presentStart, FrameClock::now() );
+    }
+    else if (m_pSimulatedDisplay)
+    {
+        m_pSimulatedDisplay->Present();
+    }
+    ReportFramePacing( frameStart, FrameClock::now() );
+    m_framesRendered++;
+
+    if (!m_firstFramePresented)
+    {
+        m_firstFramePresented = true;
+        ReportStartupTiming();
+    }
 
-    // Present the frame.
-    ThrowIfFailed( m_SwapChain->Present( 1, 0 ) );
+    UpdateOverlay();
+    TraceGpuScopes();
 
     MoveToNextFrame();
+
+    UpdateRenderScale();
+    RecordFrameTimings();
+
+    m_SharedCounters.Publish( m_framesRendered, m_frameCounters, m_GpuProfiler.GetLatestTimings() );
+    m_frameCounters.Reset();
 }
 
 void App::OnDestroy()
 {
+    StopSimulation();
+    m_Jobs.Wait( m_permutationBuild );
+    m_ShaderHotReload.Stop();
+    m_StartupGraph.reset();
+    m_ShaderLibrary.Stop();
+    m_ShaderLibrary.SaveManifest( GetAssetFullPath( L"ShaderVariants.manifest" ) );
+    m_PipelineLibrary.Save( GetAssetFullPath( L"Pipelines.cache" ) );
+    WriteFrameStats();
+    if (!m_config.tracePath.empty())
+    {
+        WriteTrace( m_config.tracePath );
+    }
+
     // Ensure that the GPU is no longer referencing resources that are about to be
     // cleaned up by the destructor.
     WaitForGpu();
+    m_DeferredReleases.ReleaseAll();
 
     CloseHandle(m_FenceEvent);
 }
 
+// The CPU frame time is measured end to end on the render thread, so it includes waiting
+// for the frame packet as well as recording, Present() and the wait in MoveToNextFrame().
+void App::RecordFrameTimings()
+{
+    const FrameClock::time_point frameEnd = FrameClock::now();
+    m_frameTimings[FrameMetricCpuFrame] = ElapsedMs( m_lastFrameEnd, frameEnd );
+    m_lastFrameEnd = frameEnd;
+
+    // GPU results trail the CPU by the frames in flight; each frame records the latest.
+    m_frameTimings[FrameMetricGpuFrame] = m_GpuProfiler.GetScopeMilliseconds( "Frame" );
+    m_frameTimings[FrameMetricGpuClear] = m_GpuProfiler.GetScopeMilliseconds( "Clear" );
+    m_frameTimings[FrameMetricGpuScene] = m_GpuProfiler.GetScopeMilliseconds( "Scene" );
+    m_frameTimings[FrameMetricGpuUpscale] = m_GpuProfiler.GetScopeMilliseconds( "Upscale" );
+    m_frameTimings[FrameMetricGpuCull] = m_GpuProfiler.GetScopeMilliseconds( "Cull" );
+    m_frameTimings[FrameMetricRenderScale] = m_renderScale;
+
+    if (m_FrameStats)
+    {
+        m_FrameStats->AddFrame( m_frameTimings );
+    }
+}
+
+// Show the latest GPU pass timings in the window title, a few times a second.
+void App::UpdateOverlay()
+{
+    const FrameClock::time_point now = FrameClock::now();
+    if (m_config.headless || ElapsedMs( m_lastOverlayUpdate, now ) < 500.0)
+    {
+        return;
+    }
+    m_lastOverlayUpdate = now;
+
+    std::wstring title = m_title;
+    for (const GpuProfiler::ScopeTiming& timing : m_GpuProfiler.GetLatestTimings())
+    {
+        wchar_t text[64];
+        if (timing.depth == 0)
+        {
+            swprintf_s( text, L" - GPU %.3f ms", timing.milliseconds );
+            title += text;
+        }
+        else if (timing.depth == 1)
+        {
+            swprintf_s( text, L" | %hs %.3f", timing.name, timing.milliseconds );
+            title += text;
+        }
+    }
+    if (m_PresentQueue)
+    {
+        title += L" | Latency " + std::to_wstring( m_PresentQueue->GetMaximumFrameLatency() );
+    }
+    if (m_FramePacer)
+    {
+        wchar_t text[64];
+        swprintf_s( text, L" | Predicted %.2f ms", m_FramePacer->GetPredictedFrameMs() );
+        title += text;
+    }
+    if (m_ResolutionScale)
+    {
+        wchar_t text[64];
+        swprintf_s( text, L" | Scale %.2f", m_renderScale );
+        title += text;
+    }
+
+    Window::SetTitle( title );
+}
+
+// Put the GPU scopes read back since the last frame on the trace's GPU track, aligned
+// with the CPU scopes.
+void App::TraceGpuScopes()
+{
+#if HW_TRACING_ENABLED
+    if (m_GpuProfiler.GetLatestFenceValue() == m_tracedGpuFenceValue)
+    {
+        return;
+    }
+    m_tracedGpuFenceValue = m_GpuProfiler.GetLatestFenceValue();
+
+    for (const GpuProfiler::ScopeTiming& timing : m_GpuProfiler.GetLatestTimings())
+    {
+        Trace::Record( m_pGpuTrack, timing.name, m_GpuProfiler.ToCpuNanoseconds( timing.beginTimestamp ), m_GpuProfiler.ToCpuNanoseconds( timing.endTimestamp ) );
+    }
+#endif
+}
+
+void App::WriteTrace( const std::wstring& path )
+{
+    std::ofstream file( path, std::ios::trunc );
+    Trace::WriteChromeTrace( file );
+}
+
+// Only records the size: a drag sends a burst of these, and the swap chain is resized
+// once per frame to the latest one.
+void App::OnSizeChanged( uint32_t width, uint32_t height, bool minimized )
+{
+    m_minimized = minimized;
+    if (!minimized)
+    {
+        m_resizePending = true;
+        m_pendingWidth = width;
+        m_pendingHeight = height;
+    }
+}
+
+// Resizes the back buffers to the last reported client size. Only the frames still
+// using the old back buffers are waited on; nothing new is signaled, and the pipelines,
+// bundles and descriptor heap are kept (the RTVs are rewritten in their slots).
+void App::ApplyPendingResize()
+{
+    if (!m_resizePending)
+    {
+        return;
+    }
+    m_resizePending = false;
+
+    const uint32_t width = m_pendingWidth;
+    const uint32_t height = m_pendingHeight;
+    if (m_config.headless || width == 0 || height == 0 || ( width == m_width && height == m_height ))
+    {
+        return;
+    }
+
+    HW_TRACE_SCOPE( "ResizeSwapChain" );
+
+    // The last frame submitted is the newest one that can reference a back buffer.
+    const uint64_t lastSubmitted = m_FenceValues[m_FrameIndex] - 1;
+    if (m_Fence->GetCompletedValue() < lastSubmitted)
+    {
+        ThrowIfFailed( m_Fence->SetEventOnCompletion( lastSubmitted, m_FenceEvent ) );
+        WaitForSingleObjectEx( m_FenceEvent, INFINITE, false );
+    }
+    m_DeferredReleases.ReleaseCompleted( m_Fence->GetCompletedValue() );
+
+    // ResizeBuffers() fails while any reference to a back buffer is held.
+    for (uint32_t n = 0; n < m_config.framesInFlight; n++)
+    {
+        m_RenderTargets[n].Reset();
+    }
+    ThrowIfFailed( m_SwapChain->ResizeBuffers( m_config.framesInFlight, width, height, DXGI_FORMAT_UNKNOWN, m_swapChainFlags ) );
+
+    m_width = width;
+    m_height = height;
+    CreateRenderTargets();
+
+    // The current buffer restarts at the swap chain's choice. Every allocator is idle, so
+    // every frame slot may be reused right away.
+    m_FrameIndex = m_SwapChain->GetCurrentBackBufferIndex();
+    for (uint32_t n = 0; n < m_config.framesInFlight; n++)
+    {
+        m_FenceValues[n] = lastSubmitted;
+    }
+    m_FenceValues[m_FrameIndex] = lastSubmitted + 1;
+
+    m_Viewport = CD3DX12_VIEWPORT( 0.0f, 0.0f, static_cast<float>( width ), static_cast<float>( height ) );
+    m_ScissorRect = CD3DX12_RECT( 0, 0, static_cast<LONG>( width ), static_cast<LONG>( height ) );
+
+    // The simulation picks this up from its next step; the packet in flight still uses
+    // the old ratio for one frame.
+    m_aspectRatio.store( static_cast<float>( width ) / static_cast<float>( height ), std::memory_order_relaxed );
+}
+
+// F11 dumps the trace of the last few thousand scopes per thread.
+void App::OnKeyDown( uint8_t key )
+{
+    if (key == VK_F11)
+    {
+        WriteTrace( m_config.tracePath.empty() ? GetAssetFullPath( L"Trace.json" ) : m_config.tracePath );
+    }
+    else if (key == 'G')
+    {
+        // Picked up by ApplyPixelShaderPermutation() once the variant is ready.
+        m_requestedPixelPermutation ^= m_grayscaleMask;
+    }
+    else if (m_PresentQueue && ( key == VK_PRIOR || key == VK_NEXT ))
+    {
+        // Page Up / Page Down: more or fewer frames queued for display.
+        const uint32_t latency = m_PresentQueue->GetMaximumFrameLatency();
+        SetFrameLatency( key == VK_PRIOR ? latency + 1 : latency - 1 );
+    }
+}
+
+// Written as CSV if the stats path ends in .csv, otherwise as JSON.
+void App::WriteFrameStats()
+{
+    if (!m_FrameStats)
+    {
+        return;
+    }
+
+    if (m_config.gpuCulling)
+    {
+        m_FrameStats->SetTag( "gpuCullingChecks", std::to_string( m_cullChecks ) );
+        m_FrameStats->SetTag( "gpuCullingMismatches", std::to_string( m_cullCheckMismatches ) );
+    }
+
+    const std::wstring path = m_config.statsPath.empty() ? GetAssetFullPath( L"FrameStats.json" ) : m_config.statsPath;
+    std::ofstream file( path, std::ios::trunc );
+    if (path.size() >= 4 && _wcsicmp( path.c_str() + path.size() - 4, L".csv" ) == 0)
+    {
+        m_FrameStats->WriteCsv( file );
+    }
+    else
+    {
+        m_FrameStats->WriteJson( file );
+    }
+}
+
+bool App::IsRunComplete() const
+{
+    return m_config.frameCount != 0 && m_framesRendered >= uint64_t( m_config.warmupFrames ) + m_config.frameCount;
+}
+
+// Compile the variants listed in the manifest into the shader cache, without a device.
+uint32_t App::PrecompileShaders()
+{
+    return ShaderLibrary::PrecompileManifest( m_Jobs, m_config.precompileManifest, GetShaderSourceDirectory(), GetAssetFullPath( L"ShaderCache\\" ) );
+}
+
+// Time the frustum and occlusion culling versions on generated volumes and write the
+// report next to the executable, without a device.
+bool App::BenchmarkCulling()
+{
+    bool resultsMatch = false;
+    bool depthMatches = false;
+    const std::string report =
+        ::BenchmarkCulling( m_Jobs, m_config.cullingBenchmarkCount, resultsMatch ) +
+        BenchmarkOcclusion( m_Jobs, m_config.cullingBenchmarkCount, depthMatches );
+    resultsMatch = resultsMatch && depthMatches;
+    OutputDebugStringA( report.c_str() );
+
+    std::ofstream file( GetAssetFullPath( L"CullingBenchmark.txt" ), std::ios::trunc );
+    file << report;
+    return resultsMatch && file.good();
+}
+
+// Time world-matrix updates of a generated transform hierarchy and write the report next
+// to the executable, without a device.
+bool App::BenchmarkTransforms()
+{
+    const std::string report = ::BenchmarkTransforms( m_Jobs, m_config.transformBenchmarkCount );
+    OutputDebugStringA( report.c_str() );
+
+    std::ofstream file( GetAssetFullPath( L"TransformBenchmark.txt" ), std::ios::trunc );
+    file << report;
+    return file.good();
+}
+
 void App::LoadPipeline()
 {
     uint32_t dxgiFactoryFlags = 0;
@@ -75,28 +998,13 @@ void App::LoadPipeline()
     Microsoft::WRL::ComPtr<IDXGIFactory4> factory;
     ThrowIfFailed( CreateDXGIFactory2( dxgiFactoryFlags, IID_PPV_ARGS( &factory ) ) );
 
-    if (m_useWarpDevice)
-    {
-        Microsoft::WRL::ComPtr<IDXGIAdapter> warpAdapter;
-        ThrowIfFailed( factory->EnumWarpAdapter( IID_PPV_ARGS( &warpAdapter ) ) );
-
-        ThrowIfFailed( D3D12CreateDevice(
-            warpAdapter.Get(),
-            D3D_FEATURE_LEVEL_11_0,
-            IID_PPV_ARGS( &m_Device )
-        ) );
-    }
-    else
-    {
-        Microsoft::WRL::ComPtr<IDXGIAdapter1> hardwareAdapter;
-        GetHardwareAdapter( factory.Get(), &hardwareAdapter );
-
-        ThrowIfFailed( D3D12CreateDevice(
-            hardwareAdapter.Get(),
-            D3D_FEATURE_LEVEL_11_0,
-            IID_PPV_ARGS( &m_Device )
-        ) );
-    }
+    // Adapter capabilities are probed once per adapter and driver version and reused
+    // on later runs.
+    AdapterSelector adapterSelector;
+    adapterSelector.LoadCache( GetAssetFullPath( L"AdapterCapabilities.cache" ) );
+    m_Device = adapterSelector.CreateDevice( factory.Get(), m_config.adapterPolicy, m_config.adapterLuid );
+    m_capabilities = adapterSelector.GetCapabilities();
+    adapterSelector.SaveCache( GetAssetFullPath( L"AdapterCapabilities.cache" ) );
 
     // Describe and create the command queue.
     D3D12_COMMAND_QUEUE_DESC queueDesc = {};
@@ -105,183 +1013,310 @@ void App::LoadPipeline()
 
     ThrowIfFailed( m_Device->CreateCommandQueue( &queueDesc, IID_PPV_ARGS( &m_CommandQueue ) ) );
 
-    // Describe and create the swap chain.
-    DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
-    swapChainDesc.BufferCount = FrameCount;
-    swapChainDesc.Width = m_width;
-    swapChainDesc.Height = m_height;
-    swapChainDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-    swapChainDesc.SampleDesc.Count = 1;
-
-    Microsoft::WRL::ComPtr<IDXGISwapChain1> swapChain;
-    ThrowIfFailed( factory->CreateSwapChainForHwnd(
-        m_CommandQueue.Get(), // Swap chain needs the queue so that it can force a flush on it.
-        Window::GetHwnd(),
-        &swapChainDesc,
-        nullptr,
-        nullptr,
-        &swapChain
-    ) );
+    // Headless runs have no swap chain; see the frame resources below.
+    if (m_config.frameLatency != 0)
+    {
+        m_swapChainFlags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+    }
 
-    // This sample does not support fullscreen transition.
-    ThrowIfFailed( factory->MakeWindowAssociation( Window::GetHwnd(), DXGI_MWA_NO_ALT_ENTER ) );
+    // Tearing needs support from both the OS (DXGI 1.5) and the display driver; without
+    // it, the closest mode is an immediate present that waits for the next vblank.
+    if (m_presentMode == PresentMode::Tearing)
+    {
+        BOOL allowTearing = FALSE;
+        Microsoft::WRL::ComPtr<IDXGIFactory5> factory5;
+        if (SUCCEEDED( factory.As( &factory5 ) ))
+        {
+            if (FAILED( factory5->CheckFeatureSupport( DXGI_FEATURE_PRESENT_ALLOW_TEARING, &allowTearing, sizeof( allowTearing ) ) ))
+            {
+                allowTearing = FALSE;
+            }
+        }
 
-    ThrowIfFailed( swapChain.As( &m_SwapChain ) );
-    m_FrameIndex = m_SwapChain->GetCurrentBackBufferIndex();
+        if (allowTearing)
+        {
+            m_swapChainFlags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+        }
+        else
+        {
+            OutputDebugStringA( "Tearing is not supported; presenting immediately instead.\n" );
+            m_presentMode = PresentMode::Immediate;
+        }
+    }
+    if (!m_config.headless)
+    {
+        // Describe and create the swap chain.
+        DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
+        swapChainDesc.BufferCount = m_config.framesInFlight;
+        swapChainDesc.Width = m_width;
+        swapChainDesc.Height = m_height;
+        swapChainDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+        swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+        swapChainDesc.SampleDesc.Count = 1;
+        swapChainDesc.Flags = m_swapChainFlags;
+
+        Microsoft::WRL::ComPtr<IDXGISwapChain1> swapChain;
+        ThrowIfFailed( factory->CreateSwapChainForHwnd(
+            m_CommandQueue.Get(), // Swap chain needs the queue so that it can force a flush on it.
+            Window::GetHwnd(),
+            &swapChainDesc,
+            nullptr,
+            nullptr,
+            &swapChain
+        ) );
+
+        // This sample does not support fullscreen transition.
+        ThrowIfFailed( factory->MakeWindowAssociation( Window::GetHwnd(), DXGI_MWA_NO_ALT_ENTER ) );
+
+        ThrowIfFailed( swapChain.As( &m_SwapChain ) );
+        m_FrameIndex = m_SwapChain->GetCurrentBackBufferIndex();
+
+        if (m_config.frameLatency != 0)
+        {
+            m_PresentQueue.reset( new SwapChainPresentQueue( m_SwapChain.Get(), m_config.frameLatency ) );
+        }
+    }
+    else if (m_config.frameLatency != 0)
+    {
+        m_pSimulatedDisplay = new SimulatedPresentQueue( 60.0, m_config.frameLatency );
+        m_PresentQueue.reset( m_pSimulatedDisplay );
+    }
 
     // Create descriptor heaps.
     {
-        // Describe and create a render target view (RTV) descriptor heap.
+        // Describe and create a render target view (RTV) descriptor heap. The scene target,
+        // if any, goes after the frames' RTVs.
         D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-        rtvHeapDesc.NumDescriptors = FrameCount;
+        rtvHeapDesc.NumDescriptors = m_config.framesInFlight + ( m_ResolutionScale ? 1 : 0 );
         rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
         rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
         ThrowIfFailed( m_Device->CreateDescriptorHeap( &rtvHeapDesc, IID_PPV_ARGS( &m_rtvHeap ) ) );
 
         m_rtvDescriptorSize = m_Device->GetDescriptorHandleIncrementSize( D3D12_DESCRIPTOR_HEAP_TYPE_RTV );
+
+        // The upscale pass reads the scene target through a shader-visible SRV.
+        if (m_ResolutionScale)
+        {
+            D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
+            srvHeapDesc.NumDescriptors = 1;
+            srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+            srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+            ThrowIfFailed( m_Device->CreateDescriptorHeap( &srvHeapDesc, IID_PPV_ARGS( &m_srvHeap ) ) );
+        }
     }
 
     // Create frame resources.
+    CreateRenderTargets();
+    for (uint32_t n = 0; n < m_config.framesInFlight; n++)
     {
-        CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle( m_rtvHeap->GetCPUDescriptorHandleForHeapStart() );
+        ThrowIfFailed( m_Device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS( &m_CommandAllocators[n] ) ) );
+    }
+}
 
-        // Create a RTV for each frame.
-        for (uint32_t n = 0; n < FrameCount; n++)
+// One render target per frame, with its RTV in the frame's slot of the heap, plus the
+// scene target for dynamic resolution. Called again after a resize, overwriting the views
+// in place.
+void App::CreateRenderTargets()
+{
+    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle( m_rtvHeap->GetCPUDescriptorHandleForHeapStart() );
+    for (uint32_t n = 0; n < m_config.framesInFlight; n++)
+    {
+        if (m_config.headless)
+        {
+            // Render into textures that are never shown in place of back buffers.
+            const CD3DX12_CLEAR_VALUE clearValue( DXGI_FORMAT_R8G8B8A8_UNORM, ClearColor );
+            ThrowIfFailed( m_Device->CreateCommittedResource(
+                &CD3DX12_HEAP_PROPERTIES( D3D12_HEAP_TYPE_DEFAULT ),
+                D3D12_HEAP_FLAG_NONE,
+                &CD3DX12_RESOURCE_DESC::Tex2D( DXGI_FORMAT_R8G8B8A8_UNORM, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET ),
+                D3D12_RESOURCE_STATE_PRESENT,
+                &clearValue,
+                IID_PPV_ARGS( &m_RenderTargets[n] )
+            ) );
+        }
+        else
         {
             ThrowIfFailed( m_SwapChain->GetBuffer( n, IID_PPV_ARGS( &m_RenderTargets[n] ) ) );
-            m_Device->CreateRenderTargetView( m_RenderTargets[n].Get(), nullptr, rtvHandle );
-            rtvHandle.Offset( 1, m_rtvDescriptorSize );
-
-            ThrowIfFailed( m_Device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS( &m_CommandAllocators[n] ) ) );
         }
+        m_Device->CreateRenderTargetView( m_RenderTargets[n].Get(), nullptr, rtvHandle );
+        m_frameCounters.descriptorWrites++;
+        rtvHandle.Offset( 1, m_rtvDescriptorSize );
     }
 
-    ThrowIfFailed( m_Device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS( &m_BundleAllocator ) ) );
+    if (m_ResolutionScale)
+    {
+        // As large as the output: the largest scale is 1. Smaller scales use its top-left
+        // corner, so the scale can change every frame without reallocating.
+        const CD3DX12_CLEAR_VALUE clearValue( DXGI_FORMAT_R8G8B8A8_UNORM, ClearColor );
+        ThrowIfFailed( m_Device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES( D3D12_HEAP_TYPE_DEFAULT ),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Tex2D( DXGI_FORMAT_R8G8B8A8_UNORM, m_width, m_height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET ),
+            D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+            &clearValue,
+            IID_PPV_ARGS( &m_SceneTarget )
+        ) );
+        m_Device->CreateRenderTargetView( m_SceneTarget.Get(), nullptr, rtvHandle );
+        m_Device->CreateShaderResourceView( m_SceneTarget.Get(), nullptr, m_srvHeap->GetCPUDescriptorHandleForHeapStart() );
+        m_frameCounters.descriptorWrites += 2;
+    }
 }
 
 
-// Load the sample assets.
-void App::LoadAssets()
+// The root signature of the scene pipeline. Holds no pointers, so it can be rebuilt on
+// any thread.
+CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC App::GetRootSignatureDesc()
 {
-    // Create the root signature.
+    // b0: the frame's view-projection matrix, as root constants. t0: the frame's instances,
+    // a root SRV into the upload ring. b1: the draw's first instance, a root constant that
+    // indirect commands set per draw.
+    static const CD3DX12_ROOT_PARAMETER1 rootParameters[] =
     {
-        D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
+        RootConstants( sizeof( FramePacket::viewProjection ) / 4, 0, D3D12_SHADER_VISIBILITY_VERTEX ),
+        RootShaderResourceView( 0, D3D12_SHADER_VISIBILITY_VERTEX ),
+        RootConstants( 1, 1, D3D12_SHADER_VISIBILITY_VERTEX )
+    };
+
+    CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+    rootSignatureDesc.Init_1_1( _countof( rootParameters ), rootParameters, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT );
+    return rootSignatureDesc;
+}
 
-        // This is the highest version the sample supports. If CheckFeatureSupport succeeds, the HighestVersion returned will not be greater than this.
-        featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+// The root signature of the upscale pass.
+CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC App::GetUpscaleRootSignatureDesc()
+{
+    // b0: UV scale and clamp; t0: the scene target, bilinearly filtered through s0.
+    static const CD3DX12_DESCRIPTOR_RANGE1 sceneRange( D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC_WHILE_SET_AT_EXECUTE );
+    static const CD3DX12_ROOT_PARAMETER1 rootParameters[] =
+    {
+        RootConstants( 4, 0, D3D12_SHADER_VISIBILITY_PIXEL ),
+        DescriptorTable( sceneRange, D3D12_SHADER_VISIBILITY_PIXEL )
+    };
+    static const CD3DX12_STATIC_SAMPLER_DESC linearSampler( 0, D3D12_FILTER_MIN_MAG_LINEAR_MIP_POINT,
+        D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP, D3D12_TEXTURE_ADDRESS_MODE_CLAMP,
+        0.0f, 1, D3D12_COMPARISON_FUNC_ALWAYS, D3D12_STATIC_BORDER_COLOR_OPAQUE_BLACK, 0.0f, 0.0f, D3D12_SHADER_VISIBILITY_PIXEL );
+
+    CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+    rootSignatureDesc.Init_1_1( _countof( rootParameters ), rootParameters, 1, &linearSampler, D3D12_ROOT_SIGNATURE_FLAG_NONE );
+    return rootSignatureDesc;
+}
 
-        if (FAILED( m_Device->CheckFeatureSupport( D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof( featureData ) ) ))
-        {
-            featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
-        }
+// The root signature of the culling pass.
+CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC App::GetCullRootSignatureDesc()
+{
+    // b0: frustum planes and counts; t0: the frame's instances; u0: the commands written;
+    // u1: their count.
+    static const CD3DX12_ROOT_PARAMETER1 rootParameters[] =
+    {
+        RootConstants( sizeof( IndirectCullConstants ) / 4, 0, D3D12_SHADER_VISIBILITY_ALL ),
+        RootShaderResourceView( 0, D3D12_SHADER_VISIBILITY_ALL ),
+        RootUnorderedAccessView( 0, D3D12_SHADER_VISIBILITY_ALL ),
+        RootUnorderedAccessView( 1, D3D12_SHADER_VISIBILITY_ALL )
+    };
+
+    CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+    rootSignatureDesc.Init_1_1( _countof( rootParameters ), rootParameters, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_NONE );
+    return rootSignatureDesc;
+}
 
-        CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
-        rootSignatureDesc.Init_1_1( 0, nullptr, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT );
+// Create the root signatures.
+void App::CreateRootSignature()
+{
+    // Serialized blobs persist across runs; only descriptions not seen before are serialized.
+    const CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc = GetRootSignatureDesc();
+    m_RootSignature = m_RootSignatureCache.GetOrCreate( m_Device.Get(), rootSignatureDesc, m_capabilities.rootSignatureVersion );
+    m_rootSignatureHash = HashRootSignatureDesc( rootSignatureDesc, m_capabilities.rootSignatureVersion );
 
-        Microsoft::WRL::ComPtr<ID3DBlob> signature;
-        Microsoft::WRL::ComPtr<ID3DBlob> error;
-        ThrowIfFailed( D3DX12SerializeVersionedRootSignature( &rootSignatureDesc, featureData.HighestVersion, &signature, &error ) );
-        ThrowIfFailed( m_Device->CreateRootSignature( 0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS( &m_RootSignature ) ) );
+    if (m_ResolutionScale)
+    {
+        const CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC upscaleDesc = GetUpscaleRootSignatureDesc();
+        m_UpscaleRootSignature = m_RootSignatureCache.GetOrCreate( m_Device.Get(), upscaleDesc, m_capabilities.rootSignatureVersion );
+        m_upscaleRootSignatureHash = HashRootSignatureDesc( upscaleDesc, m_capabilities.rootSignatureVersion );
     }
 
-    // Create the pipeline state, which includes compiling and loading shaders.
+    if (m_config.gpuCulling)
     {
-        Microsoft::WRL::ComPtr<ID3DBlob> vertexShader;
-        Microsoft::WRL::ComPtr<ID3DBlob> pixelShader;
-
-#if defined(_DEBUG)
-        // Enable better shader debugging with the graphics debugging tools.
-        uint32_t compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#else
-        uint32_t compileFlags = 0;
-#endif
-
-        ThrowIfFailed( D3DCompileFromFile( GetAssetFullPath( L"Shaders.hlsl" ).c_str(), nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, nullptr ) );
-        ThrowIfFailed( D3DCompileFromFile( GetAssetFullPath( L"Shaders.hlsl" ).c_str(), nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, nullptr ) );
-
-        // Define the vertex input layout.
-        D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
-        {
-            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-            { "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-        };
-
-        // Describe and create the graphics pipeline state object (PSO).
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-        psoDesc.InputLayout = { inputElementDescs, _countof( inputElementDescs ) };
-        psoDesc.pRootSignature = m_RootSignature.Get();
-        psoDesc.VS = CD3DX12_SHADER_BYTECODE( vertexShader.Get() );
-        psoDesc.PS = CD3DX12_SHADER_BYTECODE( pixelShader.Get() );
-        psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC( D3D12_DEFAULT );
-        psoDesc.BlendState = CD3DX12_BLEND_DESC( D3D12_DEFAULT );
-        psoDesc.DepthStencilState.DepthEnable = false;
-        psoDesc.DepthStencilState.StencilEnable = false;
-        psoDesc.SampleMask = UINT_MAX;
-        psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-        psoDesc.NumRenderTargets = 1;
-        psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-        psoDesc.SampleDesc.Count = 1;
-        ThrowIfFailed( m_Device->CreateGraphicsPipelineState( &psoDesc, IID_PPV_ARGS( &m_PipelineState ) ) );
+        const CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC cullDesc = GetCullRootSignatureDesc();
+        m_CullRootSignature = m_RootSignatureCache.GetOrCreate( m_Device.Get(), cullDesc, m_capabilities.rootSignatureVersion );
+        m_cullRootSignatureHash = HashRootSignatureDesc( cullDesc, m_capabilities.rootSignatureVersion );
     }
+}
 
-    // Create the command list.
-    ThrowIfFailed( m_Device->CreateCommandList( 0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_CommandAllocators[m_FrameIndex].Get(), m_PipelineState.Get(), IID_PPV_ARGS( &m_CommandList ) ) );
-
-    // Create the vertex buffer.
+// Create the vertex buffer, and the index buffer that indirect draws need.
+void App::CreateVertexBuffer()
+{
+    Vertex triangleVertices[] =
     {
-        Vertex triangleVertices[] =
-        {
-            { { 0.0f, 0.25f * m_aspectRatio, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
-            { { 0.25f, -0.25f * m_aspectRatio, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
-            { { -0.25f, -0.25f * m_aspectRatio, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } }
-        };
+        { { 0.0f, 0.25f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+        { { 0.25f, -0.25f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+        { { -0.25f, -0.25f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } }
+    };
+
+    const uint32_t vertexBufferSize = sizeof( triangleVertices );
+
+    // Note: using upload heaps to transfer static data like vert buffers is not 
+    // recommended. Every time the GPU needs it, the upload heap will be marshalled 
+    // over. Please read up on Default Heap usage. An upload heap is used here for 
+    // code simplicity and because there are very few verts to actually transfer.
+    ThrowIfFailed( m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES( D3D12_HEAP_TYPE_UPLOAD ),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer( vertexBufferSize ),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS( &m_VertexBuffer ) 
+    ) );
 
-        const uint32_t vertexBufferSize = sizeof( triangleVertices );
+    // Copy the triangle data to the vertex buffer. 
+    uint8_t* pVertexDataBegin;
+    CD3DX12_RANGE readRange( 0, 0 ); // We do not intend to read from this resource on the CPU.
+    ThrowIfFailed( m_VertexBuffer->Map( 0, &readRange, reinterpret_cast<void**>( &pVertexDataBegin ) ) );
+    memcpy( pVertexDataBegin, triangleVertices, sizeof( triangleVertices ) );
+    m_VertexBuffer->Unmap( 0, nullptr );
+    m_frameCounters.bytesUploaded += sizeof( triangleVertices );
+
+    // Initialize the vertex buffer view.
+    m_VertexBufferView.BufferLocation = m_VertexBuffer->GetGPUVirtualAddress();
+    m_VertexBufferView.StrideInBytes = sizeof( Vertex );
+    m_VertexBufferView.SizeInBytes = vertexBufferSize;
+
+    ThrowIfFailed( m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES( D3D12_HEAP_TYPE_UPLOAD ),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer( sizeof( TriangleIndices ) ),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS( &m_IndexBuffer )
+    ) );
 
-        // Note: using upload heaps to transfer static data like vert buffers is not 
-        // recommended. Every time the GPU needs it, the upload heap will be marshalled 
-        // over. Please read up on Default Heap usage. An upload heap is used here for 
-        // code simplicity and because there are very few verts to actually transfer.
-        ThrowIfFailed( m_Device->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES( D3D12_HEAP_TYPE_UPLOAD ),
-            D3D12_HEAP_FLAG_NONE,
-            &CD3DX12_RESOURCE_DESC::Buffer( vertexBufferSize ),
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS( &m_VertexBuffer ) 
-        ) );
+    uint8_t* pIndexDataBegin;
+    ThrowIfFailed( m_IndexBuffer->Map( 0, &readRange, reinterpret_cast<void**>( &pIndexDataBegin ) ) );
+    memcpy( pIndexDataBegin, TriangleIndices, sizeof( TriangleIndices ) );
+    m_IndexBuffer->Unmap( 0, nullptr );
+    m_frameCounters.bytesUploaded += sizeof( TriangleIndices );
 
-        // Copy the triangle data to the vertex buffer. 
-        uint8_t* pVertexDataBegin;
-        CD3DX12_RANGE readRange( 0, 0 ); // We do not intend to read from this resource on the CPU.
-        ThrowIfFailed( m_VertexBuffer->Map( 0, &readRange, reinterpret_cast<void**>( &pVertexDataBegin ) ) );
-        memcpy( pVertexDataBegin, triangleVertices, sizeof( triangleVertices ) );
-        m_VertexBuffer->Unmap( 0, nullptr );
+    m_IndexBufferView.BufferLocation = m_IndexBuffer->GetGPUVirtualAddress();
+    m_IndexBufferView.Format = DXGI_FORMAT_R16_UINT;
+    m_IndexBufferView.SizeInBytes = sizeof( TriangleIndices );
+}
 
-        // Initialize the vertex buffer view.
-        m_VertexBufferView.BufferLocation = m_VertexBuffer->GetGPUVirtualAddress();
-        m_VertexBufferView.StrideInBytes = sizeof( Vertex );
-        m_VertexBufferView.SizeInBytes = vertexBufferSize;
-    }
+// Load the sample assets. The root signature, pipeline state and vertex buffer have
+// already been created by the startup graph (see OnInit()).
+void App::LoadAssets()
+{
+    // Create the command list.
+    ThrowIfFailed( m_Device->CreateCommandList( 0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_CommandAllocators[m_FrameIndex].Get(), m_PipelineState.Get(), IID_PPV_ARGS( &m_CommandList ) ) );
 
     // Create and record the bundle. 
-    {
-        ThrowIfFailed( m_Device->CreateCommandList( 0, D3D12_COMMAND_LIST_TYPE_BUNDLE, m_BundleAllocator.Get(), m_PipelineState.Get(), IID_PPV_ARGS( &m_Bundle ) ) );
-        m_Bundle->SetGraphicsRootSignature( m_RootSignature.Get() );
-        m_Bundle->IASetPrimitiveTopology( D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
-        m_Bundle->IASetVertexBuffers( 0, 1, &m_VertexBufferView );
-        m_Bundle->DrawInstanced( 3, 1, 0, 0 );
-        ThrowIfFailed( m_Bundle->Close() );
-    }
+    RecordBundle();
 
     // Close the command list and execute it to begin the initial GPU setup.
     ThrowIfFailed( m_CommandList->Close() );
     ID3D12CommandList* ppCommandLists[] = { m_CommandList.Get() };
     m_CommandQueue->ExecuteCommandLists( _countof( ppCommandLists ), ppCommandLists );
 
-    // Create synchronization objects and wait until assets have been uploaded to the GPU.
+    // Create synchronization objects.
     {
         ThrowIfFailed( m_Device->CreateFence( 0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS( &m_Fence ) ) );
         m_FenceValues[m_FrameIndex]++;
@@ -293,15 +1328,307 @@ void App::LoadAssets()
             ThrowIfFailed( HRESULT_FROM_WIN32( GetLastError() ) );
         }
 
-        // Wait for the command list to execute; we are reusing the same command 
-        // list in our main loop but for now, we just want to wait for setup to 
-        // complete before continuing.
+        // Wait for the command list to execute. The vertex data lives in an upload heap, but
+        // the first frame resets this frame's command allocator before it signals the fence,
+        // and an allocator may only be reset once the GPU is done with it.
         WaitForGpu();
     }
+
+    m_GpuProfiler.Initialize( m_Device.Get(), m_CommandQueue.Get(), m_config.framesInFlight, m_config.pipelineStatistics );
+
+    // Culling makes the upload vary from frame to frame, so the ring is sized for the worst
+    // case. While a frame allocates, at most framesInFlight - 1 earlier frames still hold
+    // their space (MoveToNextFrame() waited for the one before it in this slot). With the
+    // space skipped at a wrap they span at most framesInFlight worst-case frames, and one
+    // more frame of space always leaves a gap the new frame fits in.
+    const uint64_t instanceBytes = uint64_t( m_config.instanceCount + ( m_OcclusionBuffer ? OccluderCount : 0 ) ) * sizeof( FramePacket::Instance );
+    const uint64_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+    m_UploadRing.Initialize( m_Device.Get(), ( m_config.framesInFlight + 1 ) * ( ( instanceBytes + alignment - 1 ) & ~( alignment - 1 ) ) );
+    m_SharedCounters.Open();
+
+    if (m_config.gpuCulling)
+    {
+        CreateIndirectResources();
+    }
+
+    // Watch the shader sources so edits are picked up without restarting.
+    m_mainPipelineId = m_ShaderHotReload.RegisterPipeline( m_vertexShader, 0, m_pixelShader, m_pixelShaderPermutation,
+        [this]( ID3DBlob* pVertexShader, ID3DBlob* pPixelShader ) { return CreatePipelineState( pVertexShader, pPixelShader ); } );
+    if (m_ResolutionScale)
+    {
+        m_upscalePipelineId = m_ShaderHotReload.RegisterPipeline( m_upscaleVertexShader, 0, m_upscalePixelShader, 0,
+            [this]( ID3DBlob* pVertexShader, ID3DBlob* pPixelShader ) { return CreateUpscalePipelineState( pVertexShader, pPixelShader ); } );
+    }
+    m_ShaderHotReload.Start( GetShaderSourceDirectory() );
+}
+
+// Emit the startup breakdown and the time to first frame (measured from OnInit()).
+void App::ReportStartupTiming()
+{
+    char line[128];
+    sprintf_s( line, "First frame presented at %.2f ms\n", m_StartupGraph->ElapsedMs() );
+    const std::string report = "Startup timing:\n" + m_StartupGraph->Report() + line;
+
+    OutputDebugStringA( report.c_str() );
+
+    std::ofstream file( GetAssetFullPath( L"StartupTiming.txt" ), std::ios::trunc );
+    file << report;
+}
+
+// Describe and create the graphics pipeline state object (PSO), or load it from the
+// pipeline library. Also called from the shader hot-reload thread, so this must not
+// touch per-frame state.
+Microsoft::WRL::ComPtr<ID3D12PipelineState> App::CreatePipelineState( ID3DBlob* pVertexShader, ID3DBlob* pPixelShader )
+{
+    // Define the vertex input layout.
+    static const D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+    };
+
+    auto stream = MakePipelineStateStream(
+        PsoRootSignature( m_RootSignature ),
+        PsoInputLayout( { inputElementDescs, _countof( inputElementDescs ) } ),
+        PsoVS( CD3DX12_SHADER_BYTECODE( pVertexShader ) ),
+        PsoPS( CD3DX12_SHADER_BYTECODE( pPixelShader ) ),
+        SceneFixedState );
+
+    const uint64_t hash = stream.RuntimeHash( HashCombine( SceneFixedStateHash, m_rootSignatureHash ) );
+    return m_PipelineLibrary.GetOrCreate( hash, stream.GetDesc() );
+}
+
+// The upscale pass draws a full-screen triangle without vertex input, with the same
+// fixed-function state as the scene. Also called from the shader hot-reload thread.
+Microsoft::WRL::ComPtr<ID3D12PipelineState> App::CreateUpscalePipelineState( ID3DBlob* pVertexShader, ID3DBlob* pPixelShader )
+{
+    auto stream = MakePipelineStateStream(
+        PsoRootSignature( m_UpscaleRootSignature ),
+        PsoVS( CD3DX12_SHADER_BYTECODE( pVertexShader ) ),
+        PsoPS( CD3DX12_SHADER_BYTECODE( pPixelShader ) ),
+        SceneFixedState );
+
+    const uint64_t hash = stream.RuntimeHash( HashCombine( SceneFixedStateHash, m_upscaleRootSignatureHash ) );
+    return m_PipelineLibrary.GetOrCreate( hash, stream.GetDesc() );
+}
+
+// The culling pass is a compute pipeline. ShaderHotReload only rebuilds graphics pipelines,
+// so edits to Cull.hlsl need a restart.
+Microsoft::WRL::ComPtr<ID3D12PipelineState> App::CreateCullPipelineState( ID3DBlob* pComputeShader )
+{
+    auto stream = MakePipelineStateStream(
+        PsoRootSignature( m_CullRootSignature ),
+        PsoCS( CD3DX12_SHADER_BYTECODE( pComputeShader ) ) );
+
+    const uint64_t hash = stream.RuntimeHash( m_cullRootSignatureHash );
+    return m_PipelineLibrary.GetOrCreate( hash, stream.GetDesc() );
+}
+
+// The buffers the culling pass writes and ExecuteIndirect reads, and the command signature
+// that describes one IndirectDrawCommand.
+void App::CreateIndirectResources()
+{
+    static_assert( sizeof( IndirectDrawCommand ) == sizeof( uint32_t ) + sizeof( D3D12_DRAW_INDEXED_ARGUMENTS ), "IndirectDrawCommand must match the command signature" );
+    static_assert( offsetof( FramePacket::Instance, worldRows ) == 0, "Cull.hlsl reads the world rows at the start of each instance" );
+
+    // Buffers are created in the COMMON state whatever the initial state says.
+    ThrowIfFailed( m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES( D3D12_HEAP_TYPE_DEFAULT ),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer( uint64_t( m_config.instanceCount ) * sizeof( IndirectDrawCommand ), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS ),
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS( &m_IndirectCommands )
+    ) );
+    ThrowIfFailed( m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES( D3D12_HEAP_TYPE_DEFAULT ),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer( sizeof( uint32_t ), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS ),
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS( &m_IndirectCommandCount )
+    ) );
+
+    // A zero copied over the count before every culling pass.
+    ThrowIfFailed( m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES( D3D12_HEAP_TYPE_UPLOAD ),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer( sizeof( uint32_t ) ),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS( &m_IndirectCountReset )
+    ) );
+    void* pReset;
+    CD3DX12_RANGE readRange( 0, 0 );
+    ThrowIfFailed( m_IndirectCountReset->Map( 0, &readRange, &pReset ) );
+    memset( pReset, 0, sizeof( uint32_t ) );
+    m_IndirectCountReset->Unmap( 0, nullptr );
+
+    // Readback buffers can only be in the COPY_DEST state.
+    ThrowIfFailed( m_Device->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES( D3D12_HEAP_TYPE_READBACK ),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer( uint64_t( m_config.instanceCount ) * sizeof( IndirectDrawCommand ) + sizeof( uint32_t ) ),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS( &m_CullReadback )
+    ) );
+
+    // Each command sets the vertex shader's first instance (root parameter 2), then draws.
+    D3D12_INDIRECT_ARGUMENT_DESC arguments[2] = {};
+    arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+    arguments[0].Constant.RootParameterIndex = 2;
+    arguments[0].Constant.DestOffsetIn32BitValues = 0;
+    arguments[0].Constant.Num32BitValuesToSet = 1;
+    arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+    D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+    signatureDesc.ByteStride = sizeof( IndirectDrawCommand );
+    signatureDesc.NumArgumentDescs = _countof( arguments );
+    signatureDesc.pArgumentDescs = arguments;
+    ThrowIfFailed( m_Device->CreateCommandSignature( &signatureDesc, m_RootSignature, IID_PPV_ARGS( &m_CommandSignature ) ) );
+}
+
+// Record the bundle that draws the scene with the current pipeline state. Bundles do not
+// inherit the pipeline state, so this is re-run whenever m_PipelineState is replaced.
+void App::RecordBundle()
+{
+    ThrowIfFailed( m_Device->CreateCommandAllocator( D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS( &m_BundleAllocator ) ) );
+    ThrowIfFailed( m_Device->CreateCommandList( 0, D3D12_COMMAND_LIST_TYPE_BUNDLE, m_BundleAllocator.Get(), m_PipelineState.Get(), IID_PPV_ARGS( &m_Bundle ) ) );
+
+    // Counted once here and added to the frame's counters every time the bundle executes.
+    m_bundleCounters.Reset();
+    m_bundleCounters.pipelineStateBinds++; // The initial pipeline state.
+    CountingCommandList bundle( m_Bundle.Get(), m_bundleCounters );
+    bundle.SetGraphicsRootSignature( m_RootSignature );
+    m_Bundle->IASetPrimitiveTopology( D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+    m_Bundle->IASetVertexBuffers( 0, 1, &m_VertexBufferView );
+    bundle.DrawInstanced( 3, m_config.instanceCount, 0, 0 );
+    ThrowIfFailed( m_Bundle->Close() );
+}
+
+// Swap in pipelines rebuilt by the hot-reload thread. Called at the frame boundary, before
+// recording; the replaced objects may still be in use by frames in flight, so they are
+// retired against the fence value this frame will signal.
+void App::ApplyShaderReloads()
+{
+    std::vector<ShaderHotReload::ReloadedPipeline> reloaded;
+    if (!m_ShaderHotReload.TakeReloadedPipelines( reloaded ))
+    {
+        return;
+    }
+
+    const uint64_t retireFenceValue = m_FenceValues[m_FrameIndex];
+    for (auto& pipeline : reloaded)
+    {
+        if (pipeline.id == m_mainPipelineId && pipeline.psPermutation == m_pixelShaderPermutation)
+        {
+            m_PipelineLibrary.Forget( m_PipelineState.Get() );
+            m_DeferredReleases.Retire( m_PipelineState.Get(), retireFenceValue );
+            m_DeferredReleases.Retire( m_Bundle.Get(), retireFenceValue );
+            m_DeferredReleases.Retire( m_BundleAllocator.Get(), retireFenceValue );
+
+            m_PipelineState = pipeline.pipelineState;
+            RecordBundle();
+        }
+        else if (m_ResolutionScale && pipeline.id == m_upscalePipelineId)
+        {
+            // Set directly on the command list each frame; no bundle to re-record.
+            m_PipelineLibrary.Forget( m_UpscalePipelineState.Get() );
+            m_DeferredReleases.Retire( m_UpscalePipelineState.Get(), retireFenceValue );
+            m_UpscalePipelineState = pipeline.pipelineState;
+        }
+        else
+        {
+            // Built for a permutation switched away from meanwhile; never used.
+            m_PipelineLibrary.Forget( pipeline.pipelineState.Get() );
+        }
+    }
+}
+
+// Switch the scene to the requested pixel shader permutation without stalling a frame. The
+// variant is compiled by a job (RequestVariant() returns null until it is ready), the
+// pipeline is then created by another, and the result is swapped in at the first frame
+// boundary after both are done. A request that changes again in the meantime wins.
+void App::ApplyPixelShaderPermutation()
+{
+    if (m_permutationBuildPending)
+    {
+        if (!m_permutationBuild.IsDone())
+        {
+            return;
+        }
+        m_permutationBuildPending = false;
+
+        if (m_PermutationPipelineState && m_permutationBuildPermutation == m_requestedPixelPermutation)
+        {
+            const uint64_t retireFenceValue = m_FenceValues[m_FrameIndex];
+            m_PipelineLibrary.Forget( m_PipelineState.Get() );
+            m_DeferredReleases.Retire( m_PipelineState.Get(), retireFenceValue );
+            m_DeferredReleases.Retire( m_Bundle.Get(), retireFenceValue );
+            m_DeferredReleases.Retire( m_BundleAllocator.Get(), retireFenceValue );
+
+            m_PipelineState = m_PermutationPipelineState;
+            m_pixelShaderPermutation = m_permutationBuildPermutation;
+            m_ShaderHotReload.SetPermutations( m_mainPipelineId, 0, m_pixelShaderPermutation );
+            RecordBundle();
+        }
+        else if (!m_PermutationPipelineState)
+        {
+            // Creating the pipeline failed; stay on the current one.
+            m_requestedPixelPermutation = m_pixelShaderPermutation;
+        }
+        else
+        {
+            // The request changed while it was built.
+            m_PipelineLibrary.Forget( m_PermutationPipelineState.Get() );
+        }
+        m_PermutationPipelineState.Reset();
+    }
+
+    if (m_requestedPixelPermutation == m_pixelShaderPermutation)
+    {
+        return;
+    }
+
+    bool vertexShaderFailed = false;
+    bool pixelShaderFailed = false;
+    const Microsoft::WRL::ComPtr<ID3DBlob> vertexShader = m_ShaderLibrary.RequestVariant( m_vertexShader, 0, &vertexShaderFailed );
+    const Microsoft::WRL::ComPtr<ID3DBlob> pixelShader = m_ShaderLibrary.RequestVariant( m_pixelShader, m_requestedPixelPermutation, &pixelShaderFailed );
+    if (vertexShaderFailed || pixelShaderFailed)
+    {
+        // The variant will not compile until its source changes; drop the request rather
+        // than asking again every frame. The compile error has already been reported.
+        char message[96];
+        sprintf_s( message, "Pixel shader permutation 0x%x failed to compile; keeping 0x%x.\n", m_requestedPixelPermutation, m_pixelShaderPermutation );
+        OutputDebugStringA( message );
+        m_requestedPixelPermutation = m_pixelShaderPermutation;
+        return;
+    }
+    if (!vertexShader || !pixelShader)
+    {
+        return;
+    }
+
+    m_permutationBuildPending = true;
+    m_permutationBuildPermutation = m_requestedPixelPermutation;
+    m_Jobs.RunBackground( [this, vertexShader, pixelShader]
+    {
+        try
+        {
+            m_PermutationPipelineState = CreatePipelineState( vertexShader.Get(), pixelShader.Get() );
+        }
+        catch (const HrException& e)
+        {
+            OutputDebugStringA( e.what() );
+        }
+    }, &m_permutationBuild );
 }
 
-void App::PopulateCommandList()
+void App::PopulateCommandList( const FramePacket& packet )
 {
+    HW_TRACE_SCOPE( "PopulateCommandList" );
+
     // Command list allocators can only be reset when the associated 
     // command lists have finished execution on the GPU; apps should use 
     // fences to determine GPU execution progress.
@@ -311,31 +1638,302 @@ void App::PopulateCommandList()
     // list, that command list can then be reset at any time and must be before 
     // re-recording.
     ThrowIfFailed( m_CommandList->Reset( m_CommandAllocators[m_FrameIndex].Get(), m_PipelineState.Get() ) );
+    m_frameCounters.pipelineStateBinds++; // Reset() binds the initial pipeline state.
 
-    // Set necessary state.
-    m_CommandList->SetGraphicsRootSignature( m_RootSignature.Get() );
-    m_CommandList->RSSetViewports( 1, &m_Viewport );
-    m_CommandList->RSSetScissorRects( 1, &m_ScissorRect );
+    m_frameTimings[FrameMetricCull] = packet.cullMs;
+    m_frameTimings[FrameMetricOcclusion] = packet.occlusionMs;
+    m_frameTimings[FrameMetricVisibleInstances] = static_cast<double>( packet.instances.size() );
+
+    const uint64_t completedFenceValue = m_Fence->GetCompletedValue();
+    m_UploadRing.Reclaim( completedFenceValue );
+    const D3D12_GPU_VIRTUAL_ADDRESS instanceData = UploadInstances( packet );
+
+    const FrameClock::time_point recordStart = FrameClock::now();
+    m_GpuProfiler.BeginFrame( completedFenceValue );
+    CheckGpuCulling( completedFenceValue );
+    RecordFrame( packet, instanceData );
+    m_GpuProfiler.EndFrame( m_CommandList.Get(), m_FenceValues[m_FrameIndex] );
+    m_UploadRing.EndFrame( m_FenceValues[m_FrameIndex] );
+
+    ThrowIfFailed( m_CommandList->Close() );
+    m_frameTimings[FrameMetricRecord] = ElapsedMs( recordStart, FrameClock::now() );
+}
+
+// Copy the frame's instances into the upload ring, split across the job workers when
+// there are many of them. Returns the GPU address of the copy.
+D3D12_GPU_VIRTUAL_ADDRESS App::UploadInstances( const FramePacket& packet )
+{
+    HW_TRACE_SCOPE( "UploadInstances" );
+    const FrameClock::time_point uploadStart = FrameClock::now();
+
+    const uint32_t count = static_cast<uint32_t>( packet.instances.size() );
+    const uint64_t size = uint64_t( count ) * sizeof( FramePacket::Instance );
+    const UploadRing::Allocation allocation = m_UploadRing.Allocate( size );
+
+    FramePacket::Instance* pDestination = static_cast<FramePacket::Instance*>( allocation.pData );
+    const FramePacket::Instance* pSource = packet.instances.data();
+    m_Jobs.ParallelFor( count, [=]( uint32_t begin, uint32_t end )
+    {
+        memcpy( pDestination + begin, pSource + begin, ( end - begin ) * sizeof( FramePacket::Instance ) );
+    }, 16384 );
+
+    m_frameCounters.bytesUploaded += size;
+    m_frameTimings[FrameMetricUpload] = ElapsedMs( uploadStart, FrameClock::now() );
+    return allocation.gpuAddress;
+}
 
-    // Indicate that the back buffer will be used as a render target.
-    auto rtv = CD3DX12_RESOURCE_BARRIER::Transition( m_RenderTargets[m_FrameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET );
-    m_CommandList->ResourceBarrier( 1, &rtv );
+// Record the scene into the frame's command list.
+void App::RecordFrame( const FramePacket& packet, D3D12_GPU_VIRTUAL_ADDRESS instanceData )
+{
+    CountingCommandList commandList( m_CommandList.Get(), m_frameCounters );
+    GpuProfileScope frameScope( m_GpuProfiler, m_CommandList.Get(), "Frame" );
+
+    if (m_config.gpuCulling)
+    {
+        RecordGpuCulling( commandList, packet, instanceData );
+    }
+
+    const CD3DX12_CPU_DESCRIPTOR_HANDLE backBufferRtv( m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_FrameIndex, m_rtvDescriptorSize );
+    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle = backBufferRtv;
+    CD3DX12_VIEWPORT viewport = m_Viewport;
+    CD3DX12_RECT scissorRect = m_ScissorRect;
+
+    if (m_ResolutionScale)
+    {
+        // The scene goes into the top-left corner of the scene target, at the current scale.
+        m_frameScales[m_FenceValues[m_FrameIndex] % _countof( m_frameScales )] = { m_FenceValues[m_FrameIndex], m_renderScale };
+        const LONG renderWidth = static_cast<LONG>( std::ceil( m_width * m_renderScale ) );
+        const LONG renderHeight = static_cast<LONG>( std::ceil( m_height * m_renderScale ) );
+        viewport = CD3DX12_VIEWPORT( 0.0f, 0.0f, static_cast<float>( renderWidth ), static_cast<float>( renderHeight ) );
+        scissorRect = CD3DX12_RECT( 0, 0, renderWidth, renderHeight );
+        rtvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE( m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_config.framesInFlight, m_rtvDescriptorSize );
+
+        auto rtv = CD3DX12_RESOURCE_BARRIER::Transition( m_SceneTarget.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET );
+        commandList.ResourceBarrier( 1, &rtv );
+    }
+    else
+    {
+        // Indicate that the back buffer will be used as a render target.
+        auto rtv = CD3DX12_RESOURCE_BARRIER::Transition( m_RenderTargets[m_FrameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET );
+        commandList.ResourceBarrier( 1, &rtv );
+    }
 
-    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle( m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_FrameIndex, m_rtvDescriptorSize );
+    // Set necessary state.
+    commandList.SetGraphicsRootSignature( m_RootSignature );
+    m_CommandList->RSSetViewports( 1, &viewport );
+    m_CommandList->RSSetScissorRects( 1, &scissorRect );
     m_CommandList->OMSetRenderTargets( 1, &rtvHandle, false, nullptr );
 
-    // Record commands.
-    const float clearColor[] = { 0.16f, 0.16f, 0.16f, 1.0f };
-    m_CommandList->ClearRenderTargetView( rtvHandle, clearColor, 0, nullptr );
-    
-    // Execute the commands stored in the bundle.
-    m_CommandList->ExecuteBundle( m_Bundle.Get() );
+    // Record commands. Only the part of the target the scene is rendered to is cleared.
+    {
+        GpuProfileScope clearScope( m_GpuProfiler, m_CommandList.Get(), "Clear" );
+        m_CommandList->ClearRenderTargetView( rtvHandle, ClearColor, 1, &scissorRect );
+    }
+
+    {
+        GpuProfileScope sceneScope( m_GpuProfiler, m_CommandList.Get(), "Scene" );
+        m_CommandList->SetGraphicsRoot32BitConstants( 0, sizeof( packet.viewProjection ) / 4, &packet.viewProjection, 0 );
+        m_CommandList->SetGraphicsRootShaderResourceView( 1, instanceData );
+        m_CommandList->SetGraphicsRoot32BitConstant( 2, 0, 0 );
+
+        if (m_config.gpuCulling)
+        {
+            // One command per instance that passed the culling pass: the GPU reads how many
+            // from the count buffer, so recording does not depend on the instance count.
+            m_CommandList->IASetPrimitiveTopology( D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+            m_CommandList->IASetVertexBuffers( 0, 1, &m_VertexBufferView );
+            m_CommandList->IASetIndexBuffer( &m_IndexBufferView );
+            commandList.ExecuteIndirect( m_CommandSignature.Get(), static_cast<uint32_t>( packet.instances.size() ), m_IndirectCommands.Get(), 0, m_IndirectCommandCount.Get(), 0 );
+
+            const D3D12_RESOURCE_BARRIER toCommon[] =
+            {
+                CD3DX12_RESOURCE_BARRIER::Transition( m_IndirectCommands.Get(), IndirectArgumentState, D3D12_RESOURCE_STATE_COMMON ),
+                CD3DX12_RESOURCE_BARRIER::Transition( m_IndirectCommandCount.Get(), IndirectArgumentState, D3D12_RESOURCE_STATE_COMMON )
+            };
+            commandList.ResourceBarrier( _countof( toCommon ), toCommon );
+        }
+        else if (m_config.separateDraws)
+        {
+            // One draw per instance, each pointing the root SRV at its own instance, to
+            // compare the submission cost against the single instanced draw.
+            m_CommandList->IASetPrimitiveTopology( D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+            m_CommandList->IASetVertexBuffers( 0, 1, &m_VertexBufferView );
+            for (size_t i = 0; i < packet.instances.size(); i++)
+            {
+                m_CommandList->SetGraphicsRootShaderResourceView( 1, instanceData + i * sizeof( FramePacket::Instance ) );
+                commandList.DrawInstanced( 3, 1, 0, 0 );
+            }
+        }
+        else if (packet.instances.size() == m_config.instanceCount)
+        {
+            // Execute the commands stored in the bundle; bundles inherit the root arguments
+            // set here.
+            commandList.ExecuteBundle( m_Bundle.Get(), m_bundleCounters );
+        }
+        else
+        {
+            // The bundle draws the whole grid; once culling has removed some of it, the
+            // instance count changes every frame and is drawn directly.
+            m_CommandList->IASetPrimitiveTopology( D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+            m_CommandList->IASetVertexBuffers( 0, 1, &m_VertexBufferView );
+            if (!packet.instances.empty())
+            {
+                commandList.DrawInstanced( 3, static_cast<uint32_t>( packet.instances.size() ), 0, 0 );
+            }
+        }
+    }
+
+    if (m_ResolutionScale)
+    {
+        RecordUpscale( commandList, backBufferRtv, viewport );
+    }
 
     // Indicate that the back buffer will now be used to present.
     auto present = CD3DX12_RESOURCE_BARRIER::Transition( m_RenderTargets[m_FrameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT );
-    m_CommandList->ResourceBarrier( 1, &present);
+    commandList.ResourceBarrier( 1, &present );
+}
 
-    ThrowIfFailed( m_CommandList->Close() );
+// Cull the frame's instances on the GPU: zero the command count, then one thread per
+// instance appends a draw for each visible one. Leaves both buffers ready for
+// ExecuteIndirect, and the scene's pipeline state bound.
+void App::RecordGpuCulling( CountingCommandList& commandList, const FramePacket& packet, D3D12_GPU_VIRTUAL_ADDRESS instanceData )
+{
+    GpuProfileScope cullScope( m_GpuProfiler, m_CommandList.Get(), "Cull" );
+    const uint32_t instanceCount = static_cast<uint32_t>( packet.instances.size() );
+
+    auto toCopy = CD3DX12_RESOURCE_BARRIER::Transition( m_IndirectCommandCount.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST );
+    commandList.ResourceBarrier( 1, &toCopy );
+    m_CommandList->CopyBufferRegion( m_IndirectCommandCount.Get(), 0, m_IndirectCountReset.Get(), 0, sizeof( uint32_t ) );
+
+    const D3D12_RESOURCE_BARRIER toUnorderedAccess[] =
+    {
+        CD3DX12_RESOURCE_BARRIER::Transition( m_IndirectCommandCount.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS ),
+        CD3DX12_RESOURCE_BARRIER::Transition( m_IndirectCommands.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS )
+    };
+    commandList.ResourceBarrier( _countof( toUnorderedAccess ), toUnorderedAccess );
+
+    const IndirectCullConstants constants = MakeIndirectCullConstants( packet.frustum, instanceCount, TriangleIndexCount, TriangleBoundingRadius );
+    commandList.SetComputeRootSignature( m_CullRootSignature );
+    commandList.SetPipelineState( m_CullPipelineState.Get() );
+    m_CommandList->SetComputeRoot32BitConstants( 0, sizeof( constants ) / 4, &constants, 0 );
+    m_CommandList->SetComputeRootShaderResourceView( 1, instanceData );
+    m_CommandList->SetComputeRootUnorderedAccessView( 2, m_IndirectCommands->GetGPUVirtualAddress() );
+    m_CommandList->SetComputeRootUnorderedAccessView( 3, m_IndirectCommandCount->GetGPUVirtualAddress() );
+    commandList.Dispatch( ( instanceCount + CullGroupSize - 1 ) / CullGroupSize, 1, 1 );
+
+    const D3D12_RESOURCE_BARRIER toIndirectArgument[] =
+    {
+        CD3DX12_RESOURCE_BARRIER::Transition( m_IndirectCommandCount.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, IndirectArgumentState ),
+        CD3DX12_RESOURCE_BARRIER::Transition( m_IndirectCommands.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, IndirectArgumentState )
+    };
+    commandList.ResourceBarrier( _countof( toIndirectArgument ), toIndirectArgument );
+
+    // One check at a time; the instances are kept, since the packet is released once
+    // recorded.
+    if (m_cullCheckFenceValue == 0 && instanceCount != 0 && m_framesRendered % CullCheckInterval == 0)
+    {
+        const uint64_t commandBytes = uint64_t( instanceCount ) * sizeof( IndirectDrawCommand );
+        m_CommandList->CopyBufferRegion( m_CullReadback.Get(), 0, m_IndirectCommands.Get(), 0, commandBytes );
+        m_CommandList->CopyBufferRegion( m_CullReadback.Get(), uint64_t( m_config.instanceCount ) * sizeof( IndirectDrawCommand ), m_IndirectCommandCount.Get(), 0, sizeof( uint32_t ) );
+        m_cullCheckFenceValue = m_FenceValues[m_FrameIndex];
+        m_cullCheckConstants = constants;
+        m_cullCheckInstances = packet.instances;
+    }
+
+    commandList.SetPipelineState( m_PipelineState.Get() );
+}
+
+// Diff the culling output read back from an earlier frame against the CPU reference, once
+// that frame has finished on the GPU. Mismatches are logged and counted in the run's
+// statistics.
+void App::CheckGpuCulling( uint64_t completedFenceValue )
+{
+    if (m_cullCheckFenceValue == 0 || completedFenceValue < m_cullCheckFenceValue)
+    {
+        return;
+    }
+    m_cullCheckFenceValue = 0;
+
+    const uint32_t instanceCount = m_cullCheckConstants.instanceCount;
+    const size_t commandBytes = size_t( m_config.instanceCount ) * sizeof( IndirectDrawCommand );
+    void* pData;
+    CD3DX12_RANGE readRange( 0, commandBytes + sizeof( uint32_t ) );
+    ThrowIfFailed( m_CullReadback->Map( 0, &readRange, &pData ) );
+    const IndirectDrawCommand* pCommands = static_cast<const IndirectDrawCommand*>( pData );
+    uint32_t count;
+    memcpy( &count, static_cast<const uint8_t*>( pData ) + commandBytes, sizeof( count ) );
+
+    std::vector<IndirectDrawCommand> expected( instanceCount );
+    expected.resize( CullInstancesReference( m_cullCheckConstants, m_cullCheckInstances.data(), sizeof( FramePacket::Instance ), expected.data() ) );
+
+    // The count is the GPU's; more commands than instances would mean it overran the buffer.
+    const std::string diff = count <= instanceCount
+        ? DiffIndirectCommands( expected.data(), static_cast<uint32_t>( expected.size() ), pCommands, count )
+        : "count " + std::to_string( count ) + " exceeds the " + std::to_string( instanceCount ) + " instances\n";
+    CD3DX12_RANGE writeRange( 0, 0 );
+    m_CullReadback->Unmap( 0, &writeRange );
+
+    m_cullChecks++;
+    if (!diff.empty())
+    {
+        m_cullCheckMismatches++;
+        OutputDebugStringA( ( "GPU culling differs from the CPU reference: " + diff ).c_str() );
+    }
+}
+
+// Stretch the rendered part of the scene target over the whole back buffer.
+void App::RecordUpscale( CountingCommandList& commandList, D3D12_CPU_DESCRIPTOR_HANDLE backBufferRtv, const D3D12_VIEWPORT& sceneViewport )
+{
+    GpuProfileScope upscaleScope( m_GpuProfiler, m_CommandList.Get(), "Upscale" );
+
+    const D3D12_RESOURCE_BARRIER barriers[] =
+    {
+        CD3DX12_RESOURCE_BARRIER::Transition( m_SceneTarget.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE ),
+        CD3DX12_RESOURCE_BARRIER::Transition( m_RenderTargets[m_FrameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET )
+    };
+    commandList.ResourceBarrier( _countof( barriers ), barriers );
+
+    // UVs of the rendered area, clamped half a texel inside it so that bilinear filtering
+    // never picks up what earlier, larger frames left beyond its edge.
+    const float width = static_cast<float>( m_width );
+    const float height = static_cast<float>( m_height );
+    const float constants[] =
+    {
+        sceneViewport.Width / width,
+        sceneViewport.Height / height,
+        ( sceneViewport.Width - 0.5f ) / width,
+        ( sceneViewport.Height - 0.5f ) / height
+    };
+
+    commandList.SetGraphicsRootSignature( m_UpscaleRootSignature );
+    commandList.SetPipelineState( m_UpscalePipelineState.Get() );
+    ID3D12DescriptorHeap* ppHeaps[] = { m_srvHeap.Get() };
+    m_CommandList->SetDescriptorHeaps( _countof( ppHeaps ), ppHeaps );
+    m_CommandList->SetGraphicsRoot32BitConstants( 0, _countof( constants ), constants, 0 );
+    m_CommandList->SetGraphicsRootDescriptorTable( 1, m_srvHeap->GetGPUDescriptorHandleForHeapStart() );
+    m_CommandList->RSSetViewports( 1, &m_Viewport );
+    m_CommandList->RSSetScissorRects( 1, &m_ScissorRect );
+    m_CommandList->OMSetRenderTargets( 1, &backBufferRtv, false, nullptr );
+    m_CommandList->IASetPrimitiveTopology( D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+    commandList.DrawInstanced( 3, 1, 0, 0 );
+}
+
+// Feed the GPU time of the latest profiled frame to the dynamic resolution controller,
+// which picks the scale of the next frame recorded.
+void App::UpdateRenderScale()
+{
+    const uint64_t fenceValue = m_GpuProfiler.GetLatestFenceValue();
+    if (!m_ResolutionScale || fenceValue == m_scaledGpuFenceValue)
+    {
+        return;
+    }
+    m_scaledGpuFenceValue = fenceValue;
+
+    const FrameScale& frame = m_frameScales[fenceValue % _countof( m_frameScales )];
+    if (frame.fenceValue == fenceValue)
+    {
+        m_renderScale = m_ResolutionScale->AddFrame( m_GpuProfiler.GetScopeMilliseconds( "Frame" ), frame.scale );
+    }
 }
 
 // Prepare to render the next frame.
@@ -345,15 +1943,21 @@ void App::MoveToNextFrame()
     const uint64_t currentFenceValue = m_FenceValues[m_FrameIndex];
     ThrowIfFailed( m_CommandQueue->Signal( m_Fence.Get(), currentFenceValue ) );
 
-    // Update the frame index.
-    m_FrameIndex = m_SwapChain->GetCurrentBackBufferIndex();
+    // Update the frame index. Without a swap chain the ring is advanced in order.
+    m_FrameIndex = m_config.headless ? ( m_FrameIndex + 1 ) % m_config.framesInFlight : m_SwapChain->GetCurrentBackBufferIndex();
 
     // If the next frame is not ready to be rendered yet, wait until it's ready.
+    const FrameClock::time_point waitStart = FrameClock::now();
     if (m_Fence->GetCompletedValue() < m_FenceValues[m_FrameIndex])
     {
+        HW_TRACE_SCOPE( "WaitForFrame" );
         ThrowIfFailed( m_Fence->SetEventOnCompletion( m_FenceValues[m_FrameIndex], m_FenceEvent ) );
         WaitForSingleObjectEx( m_FenceEvent, INFINITE, false );
     }
+    m_frameTimings[FrameMetricWait] = ElapsedMs( waitStart, FrameClock::now() );
+
+    // Release objects retired by frames the GPU has finished with.
+    m_DeferredReleases.ReleaseCompleted( m_Fence->GetCompletedValue() );
 
     // Set the fence value for the next frame.
     m_FenceValues[m_FrameIndex] = currentFenceValue + 1;
@@ -380,69 +1984,13 @@ std::wstring App::GetAssetFullPath( LPCWSTR assetName )
     return m_assetsPath + assetName;
 }
 
-// Helper function for acquiring the first available hardware adapter that supports Direct3D 12.
-// If no such adapter can be found, *ppAdapter will be set to nullptr.
-_Use_decl_annotations_
-void App::GetHardwareAdapter(
-    IDXGIFactory1* pFactory,
-    IDXGIAdapter1** ppAdapter,
-    bool requestHighPerformanceAdapter )
+// Debug builds read shaders from the project directory so that edits to the checked-in
+// sources are seen, rather than the copies deployed next to the executable.
+std::wstring App::GetShaderSourceDirectory() const
 {
-    *ppAdapter = nullptr;
-
-    ComPtr<IDXGIAdapter1> adapter;
-
-    ComPtr<IDXGIFactory6> factory6;
-    if (SUCCEEDED( pFactory->QueryInterface( IID_PPV_ARGS( &factory6 ) ) ))
-    {
-        for (
-            UINT adapterIndex = 0;
-            DXGI_ERROR_NOT_FOUND != factory6->EnumAdapterByGpuPreference(
-                adapterIndex,
-                requestHighPerformanceAdapter == true ? DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE : DXGI_GPU_PREFERENCE_UNSPECIFIED,
-                IID_PPV_ARGS( &adapter ) );
-            ++adapterIndex)
-        {
-            DXGI_ADAPTER_DESC1 desc;
-            adapter->GetDesc1( &desc );
-
-            if (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
-            {
-                // Don't select the Basic Render Driver adapter.
-                // If you want a software adapter, pass in "/warp" on the command line.
-                continue;
-            }
-
-            // Check to see whether the adapter supports Direct3D 12, but don't create the
-            // actual device yet.
-            if (SUCCEEDED( D3D12CreateDevice( adapter.Get(), D3D_FEATURE_LEVEL_11_0, _uuidof( ID3D12Device ), nullptr ) ))
-            {
-                break;
-            }
-        }
-    }
-    else
-    {
-        for (UINT adapterIndex = 0; DXGI_ERROR_NOT_FOUND != pFactory->EnumAdapters1( adapterIndex, &adapter ); ++adapterIndex)
-        {
-            DXGI_ADAPTER_DESC1 desc;
-            adapter->GetDesc1( &desc );
-
-            if (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
-            {
-                // Don't select the Basic Render Driver adapter.
-                // If you want a software adapter, pass in "/warp" on the command line.
-                continue;
-            }
-
-            // Check to see whether the adapter supports Direct3D 12, but don't create the
-            // actual device yet.
-            if (SUCCEEDED( D3D12CreateDevice( adapter.Get(), D3D_FEATURE_LEVEL_11_0, _uuidof( ID3D12Device ), nullptr ) ))
-            {
-                break;
-            }
-        }
-    }
-
-    *ppAdapter = adapter.Detach();
-}
\ No newline at end of file
+#if defined(HW_SHADER_SOURCE_DIR)
+    return HW_SHADER_SOURCE_DIR;
+#else
+    return m_assetsPath;
+#endif
+}
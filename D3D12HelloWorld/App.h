@@ -1,6 +1,29 @@
 #pragma once
 
+#include "AdapterSelector.h"
+#include "ApiCounters.h"
+#include "DeferredReleaseQueue.h"
+#include "DynamicResolution.h"
+#include "FramePacer.h"
+#include "FramePacket.h"
+#include "FramePipeline.h"
+#include "FrameStats.h"
+#include "FrustumCulling.h"
+#include "GpuProfiler.h"
 #include "Helpers.h"
+#include "IndirectCulling.h"
+#include "JobSystem.h"
+#include "OcclusionCulling.h"
+#include "PipelineLibrary.h"
+#include "PresentQueue.h"
+#include "RootSignatureCache.h"
+#include "RuntimeConfig.h"
+#include "ShaderHotReload.h"
+#include "ShaderLibrary.h"
+#include "SharedCounters.h"
+#include "TaskGraph.h"
+#include "UploadRing.h"
+#include "Trace.h"
 #include "Window.h"
 
 // Note that while ComPtr is used to manage the lifetime of resources on the CPU,
@@ -9,19 +32,43 @@
 // referenced by the GPU.
 // An example of this can be found in the class method: OnDestroy().
 
+class SimulatedPresentQueue;
+
 class App
 {
 public:
-    App( uint32_t width, uint32_t height, std::wstring name );
+    using FrameClock = std::chrono::steady_clock;
+
+    App( const RuntimeConfig& config, std::wstring name );
 
     void OnInit();
     void OnUpdate();
     void OnRender();
     void OnDestroy();
+    void OnKeyDown( uint8_t key );
+    void OnSizeChanged( uint32_t width, uint32_t height, bool minimized );
+
+    // Stops the simulation thread and releases the render thread if it is waiting for a
+    // frame packet. The window thread calls it before joining the render thread; safe to
+    // call again.
+    void StopSimulation();
+
+    // Offline step for --precompile: returns the number of variants that failed.
+    uint32_t PrecompileShaders();
+
+    // Offline step for --benchmark-culling: returns false if the culling versions disagree.
+    bool BenchmarkCulling();
+
+    // Offline step for --benchmark-transforms: returns false if the report was not written.
+    bool BenchmarkTransforms();
 
     void LoadPipeline();
     void LoadAssets();
-    void PopulateCommandList();
+    void PopulateCommandList( const FramePacket& packet );
+    void RecordFrame( const FramePacket& packet, D3D12_GPU_VIRTUAL_ADDRESS instanceData );
+    void RecordBundle();
+    void ApplyShaderReloads();
+    void ApplyPixelShaderPermutation();
     // void WaitForPreviousFrame();
     void MoveToNextFrame();
     void WaitForGpu();
@@ -30,17 +77,51 @@ public:
     uint32_t GetWidth() const { return m_width; }
     uint32_t GetHeight() const { return m_height; }
     const wchar_t* GetTitle() const { return m_title.c_str(); }
+    const GpuCapabilities& GetCapabilities() const { return m_capabilities; }
+    const RuntimeConfig& GetConfig() const { return m_config; }
+
+    // True once a run with a fixed frame count (--frames) has rendered all its frames.
+    bool IsRunComplete() const;
+
+    // Non-zero while nothing rendered would be seen: how long the render thread may idle
+    // before the next OnRender(). Window events end the wait early.
+    uint32_t GetThrottleIntervalMs() const { return m_throttleIntervalMs; }
 
 private:
     std::wstring GetAssetFullPath( LPCWSTR assetName );
+    std::wstring GetShaderSourceDirectory() const;
 
-    void GetHardwareAdapter(
-        _In_ IDXGIFactory1* pFactory,
-        _Outptr_result_maybenull_ IDXGIAdapter1** ppAdapter,
-        bool requestHighPerformanceAdapter = false );
+    static CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC GetRootSignatureDesc();
+    static CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC GetUpscaleRootSignatureDesc();
+    static CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC GetCullRootSignatureDesc();
+    void CreateRootSignature();
+    void CreateVertexBuffer();
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> CreatePipelineState( ID3DBlob* pVertexShader, ID3DBlob* pPixelShader );
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> CreateUpscalePipelineState( ID3DBlob* pVertexShader, ID3DBlob* pPixelShader );
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> CreateCullPipelineState( ID3DBlob* pComputeShader );
+    void CreateIndirectResources();
+    void RecordGpuCulling( CountingCommandList& commandList, const FramePacket& packet, D3D12_GPU_VIRTUAL_ADDRESS instanceData );
+    void CheckGpuCulling( uint64_t completedFenceValue );
+    void RecordUpscale( CountingCommandList& commandList, D3D12_CPU_DESCRIPTOR_HANDLE backBufferRtv, const D3D12_VIEWPORT& sceneViewport );
+    void UpdateRenderScale();
+    D3D12_GPU_VIRTUAL_ADDRESS UploadInstances( const FramePacket& packet );
+    void ReportStartupTiming();
+    void RecordFrameTimings();
+    void WriteFrameStats();
+    void UpdateOverlay();
+    void TraceGpuScopes();
+    void WriteTrace( const std::wstring& path );
+    uint32_t UpdateThrottling();
+    void ApplyPendingResize();
+    void CreateRenderTargets();
+    bool WaitForPresentQueue();
+    void ReportFramePacing( FrameClock::time_point frameStart, FrameClock::time_point presentTime );
+    void SetFrameLatency( uint32_t frames );
+    void Simulate( FramePacket& packet );
+    void StartSimulation();
 
 private:
-    static const uint32_t FrameCount = 2;
+    static const uint32_t MaxFrameCount = RuntimeConfig::MaxFramesInFlight;
 
     struct Vertex
     {
@@ -51,10 +132,15 @@ private:
     // Viewport dimensions.
     uint32_t m_width;
     uint32_t m_height;
-    float m_aspectRatio;
+    std::atomic<float> m_aspectRatio;     // Read by the simulation thread.
+
+    // Runtime configuration and adapter info.
+    const RuntimeConfig m_config;
+    GpuCapabilities m_capabilities;
 
-    // Adapter info.
-    bool m_useWarpDevice;
+    // Worker pool for all background and parallel work. Declared before everything that
+    // submits jobs, so that it outlives them.
+    JobSystem m_Jobs;
 
 private:
     // Root assets path.
@@ -67,25 +153,173 @@ private:
     CD3DX12_VIEWPORT m_Viewport;
     CD3DX12_RECT m_ScissorRect;
     Microsoft::WRL::ComPtr<IDXGISwapChain3> m_SwapChain;
+    uint32_t m_swapChainFlags;
+    PresentMode m_presentMode;      // The configured mode, unless the display does not support it.
+    std::unique_ptr<PresentQueue> m_PresentQueue;   // Only with --frame-latency.
+    SimulatedPresentQueue* m_pSimulatedDisplay;     // m_PresentQueue in headless runs.
+    std::unique_ptr<FramePacer> m_FramePacer;       // Only with --pacing or --max-fps.
+
+    // Render thread visibility state (see UpdateThrottling()).
+    bool m_minimized;
+    bool m_occluded;
+    uint32_t m_throttleIntervalMs;
+
+    // Latest client size reported since the last frame (see ApplyPendingResize()).
+    bool m_resizePending;
+    uint32_t m_pendingWidth;
+    uint32_t m_pendingHeight;
     Microsoft::WRL::ComPtr<ID3D12Device> m_Device;
-    Microsoft::WRL::ComPtr<ID3D12Resource> m_RenderTargets[FrameCount];
-    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_CommandAllocators[FrameCount];
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_RenderTargets[MaxFrameCount];
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_CommandAllocators[MaxFrameCount];
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_BundleAllocator;
     Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_CommandQueue;
-    Microsoft::WRL::ComPtr<ID3D12RootSignature> m_RootSignature;
+    RootSignatureCache m_RootSignatureCache;
+    ID3D12RootSignature* m_RootSignature; // Owned by m_RootSignatureCache.
+    uint64_t m_rootSignatureHash;
+    PipelineLibrary m_PipelineLibrary;
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
     Microsoft::WRL::ComPtr<ID3D12PipelineState> m_PipelineState;
     Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_CommandList;
     Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_Bundle;
     uint32_t m_rtvDescriptorSize;
 
-    // App resources.
+    // App resources. Instance data is written to m_UploadRing every frame.
     Microsoft::WRL::ComPtr<ID3D12Resource> m_VertexBuffer;
     D3D12_VERTEX_BUFFER_VIEW m_VertexBufferView;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_IndexBuffer;
+    D3D12_INDEX_BUFFER_VIEW m_IndexBufferView;
+    UploadRing m_UploadRing;
+
+    // Dynamic resolution, only with --gpu-budget. The scene is rendered into the top-left
+    // m_renderScale of m_SceneTarget (which has the output's size), and the upscale pass
+    // stretches that over the back buffer. m_frameScales remembers the scale of each
+    // frame in flight, by fence value, to go with its GPU timings when they come back.
+    struct FrameScale
+    {
+        uint64_t fenceValue;
+        double scale;
+    };
+    std::unique_ptr<ResolutionScaleController> m_ResolutionScale;
+    double m_renderScale;
+    FrameScale m_frameScales[2 * MaxFrameCount];
+    uint64_t m_scaledGpuFenceValue;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_SceneTarget;
+    Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_srvHeap;
+    ID3D12RootSignature* m_UpscaleRootSignature; // Owned by m_RootSignatureCache.
+    uint64_t m_upscaleRootSignatureHash;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> m_UpscalePipelineState;
+
+    // GPU-driven culling, only with --gpu-culling. Each frame the culling pass writes one
+    // IndirectDrawCommand per visible instance to m_IndirectCommands and their number to
+    // m_IndirectCommandCount (first zeroed from m_IndirectCountReset), and the scene is
+    // drawn with a single ExecuteIndirect. Both buffers rest in the COMMON state between
+    // frames.
+    ID3D12RootSignature* m_CullRootSignature; // Owned by m_RootSignatureCache.
+    uint64_t m_cullRootSignatureHash;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> m_CullPipelineState;
+    Microsoft::WRL::ComPtr<ID3D12CommandSignature> m_CommandSignature;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_IndirectCommands;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_IndirectCommandCount;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_IndirectCountReset;
+
+    // Every CullCheckInterval frames, the culling pass's output is copied to m_CullReadback
+    // (the commands, then the count) and, once the frame's fence has completed, diffed
+    // against CullInstancesReference() run on the same instances.
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_CullReadback;
+    uint64_t m_cullCheckFenceValue;     // 0 while no check is pending.
+    IndirectCullConstants m_cullCheckConstants;
+    std::vector<FramePacket::Instance> m_cullCheckInstances;
+    uint32_t m_cullChecks;
+    uint32_t m_cullCheckMismatches;
+
+    // Shader variants. Pipelines replaced at runtime by hot-reload or a permutation switch
+    // are retired through m_DeferredReleases.
+    ShaderLibrary m_ShaderLibrary;
+    ShaderLibrary::ShaderId m_vertexShader;
+    ShaderLibrary::ShaderId m_pixelShader;
+    uint32_t m_pixelShaderPermutation;
+
+    // Permutation switch (G toggles grayscale), render thread only: the pipeline for
+    // m_requestedPixelPermutation is built by m_permutationBuild into m_PermutationPipelineState.
+    uint32_t m_grayscaleMask;
+    uint32_t m_requestedPixelPermutation;
+    JobCounter m_permutationBuild;
+    bool m_permutationBuildPending;
+    uint32_t m_permutationBuildPermutation;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> m_PermutationPipelineState;
+    ShaderHotReload m_ShaderHotReload;
+    uint32_t m_mainPipelineId;
+    ShaderLibrary::ShaderId m_upscaleVertexShader;
+    ShaderLibrary::ShaderId m_upscalePixelShader;
+    uint32_t m_upscalePipelineId;
+    ShaderLibrary::ShaderId m_cullShader;
+    DeferredReleaseQueue m_DeferredReleases;
+
+    // Startup. Kept alive until shutdown so tasks the first frame does not need can finish.
+    std::unique_ptr<TaskGraph> m_StartupGraph;
+    bool m_firstFramePresented;
+    uint64_t m_framesRendered;
+
+    // Benchmark measurements; m_FrameStats is only created for runs with a fixed frame count.
+    enum FrameMetric
+    {
+        FrameMetricCpuFrame,
+        FrameMetricWait,
+        FrameMetricPresent,
+        FrameMetricGpuFrame,
+        FrameMetricGpuClear,
+        FrameMetricGpuScene,
+        FrameMetricGpuUpscale,
+        FrameMetricRenderScale,
+        FrameMetricUpload,
+        FrameMetricRecord,
+        FrameMetricCull,
+        FrameMetricVisibleInstances,
+        FrameMetricGpuCull,
+        FrameMetricOcclusion,
+        FrameMetricCount
+    };
+    std::unique_ptr<FrameStats> m_FrameStats;
+    double m_frameTimings[FrameMetricCount];
+    FrameClock::time_point m_lastFrameEnd;
+
+    // API call counts for the frame being recorded, published to shared memory with the
+    // latest GPU pass results at the end of each frame.
+    ApiCounters m_frameCounters;
+    ApiCounters m_bundleCounters;
+    SharedCounters m_SharedCounters;
+
+    // GPU pass timings, shown in the window title and included in the frame stats.
+    GpuProfiler m_GpuProfiler;
+    FrameClock::time_point m_lastOverlayUpdate;
+
+    // Timeline trace (see Trace.h); GPU scopes go on their own track.
+    Trace::Track* m_pGpuTrack;
+    uint64_t m_tracedGpuFenceValue;
+
+    // Simulation stage. OnUpdate() runs on m_simulationThread one frame ahead of the
+    // render thread; the two hand frames over through m_FramePackets.
+    FramePipeline<FramePacket> m_FramePackets;
+    std::thread m_simulationThread;
+    uint64_t m_simulationFrame;
+
+    // Instance bounds for frustum culling, rebuilt when the grid changes, and the indices
+    // of the instances that passed. Only touched by the simulation thread.
+    SphereBounds m_instanceBounds;
+    float m_boundsAspectRatio;
+    std::vector<uint32_t> m_visibleInstances;
+
+    // Occlusion culling, only with --occlusion-culling: the occluders are rasterized into
+    // m_OcclusionBuffer, and the instances that passed frustum culling (m_frustumVisible)
+    // are tested against it.
+    std::unique_ptr<OcclusionBuffer> m_OcclusionBuffer;
+    std::vector<uint32_t> m_frustumVisible;
+    std::atomic<bool> m_stopSimulation;
+    std::exception_ptr m_simulationError;
 
     // Synchronization objects.
     uint32_t m_FrameIndex;
     HANDLE m_FenceEvent;
     Microsoft::WRL::ComPtr<ID3D12Fence> m_Fence;
-    uint64_t m_FenceValues[FrameCount];
+    uint64_t m_FenceValues[MaxFrameCount];
 };
\ No newline at end of file
@@ -0,0 +1,72 @@
+// GPU-driven culling: one thread per instance tests the instance's bounding sphere against
+// the frustum and appends an indirect draw for it if it is visible. The layouts match
+// IndirectCulling.h, and CullInstancesReference() there is this kernel on the CPU.
+
+cbuffer CullConstants : register(b0)
+{
+    float4 planes[6];       // Normalized; inside when dot(plane.xyz, p) + plane.w >= 0.
+    uint instanceCount;
+    uint indexCount;        // Of the mesh every instance draws.
+    float meshRadius;       // Bounding sphere of the mesh, around its origin.
+};
+
+struct Instance
+{
+    float4 worldRows[3];
+    float4 color;
+};
+
+// The root constant for the vertex shader, then D3D12_DRAW_INDEXED_ARGUMENTS.
+struct DrawCommand
+{
+    uint instanceIndex;
+    uint indexCountPerInstance;
+    uint instanceCount;
+    uint startIndexLocation;
+    int baseVertexLocation;
+    uint startInstanceLocation;
+};
+
+StructuredBuffer<Instance> instances : register(t0);
+RWStructuredBuffer<DrawCommand> commands : register(u0);
+RWByteAddressBuffer commandCount : register(u1);    // Zeroed before the dispatch.
+
+[numthreads(64, 1, 1)]
+void CSMain(uint3 dispatchId : SV_DispatchThreadID)
+{
+    const uint index = dispatchId.x;
+    if (index >= instanceCount)
+    {
+        return;
+    }
+
+    // The sphere follows the instance's translation, and grows with its largest axis
+    // scale: the longest column of the upper 3x3.
+    const Instance instance = instances[index];
+    const float3 center = float3(instance.worldRows[0].w, instance.worldRows[1].w, instance.worldRows[2].w);
+    const float3 column0 = float3(instance.worldRows[0].x, instance.worldRows[1].x, instance.worldRows[2].x);
+    const float3 column1 = float3(instance.worldRows[0].y, instance.worldRows[1].y, instance.worldRows[2].y);
+    const float3 column2 = float3(instance.worldRows[0].z, instance.worldRows[1].z, instance.worldRows[2].z);
+    const float radius = meshRadius * sqrt(max(dot(column0, column0), max(dot(column1, column1), dot(column2, column2))));
+
+    [unroll]
+    for (uint p = 0; p < 6; p++)
+    {
+        if (dot(planes[p].xyz, center) + planes[p].w + radius < 0.0f)
+        {
+            return;
+        }
+    }
+
+    uint slot;
+    commandCount.InterlockedAdd(0, 1, slot);
+
+    DrawCommand command;
+    command.instanceIndex = index;
+    command.indexCountPerInstance = indexCount;
+    command.instanceCount = 1;
+    command.startIndexLocation = 0;
+    command.baseVertexLocation = 0;
+    command.startInstanceLocation = 0;
+    commands[slot] = command;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Helpers.h"
+
+#include <deque>
+
+// Keeps objects alive until the GPU has passed the fence value that was current when
+// they were retired. Objects are retired in fence order, so releasing stops at the
+// first entry the GPU has not reached yet.
+class DeferredReleaseQueue
+{
+public:
+    void Retire( IUnknown* pObject, uint64_t fenceValue )
+    {
+        if (pObject)
+        {
+            m_pending.push_back( { fenceValue, pObject } );
+        }
+    }
+
+    void ReleaseCompleted( uint64_t completedFenceValue )
+    {
+        while (!m_pending.empty() && m_pending.front().fenceValue <= completedFenceValue)
+        {
+            m_pending.pop_front();
+        }
+    }
+
+    // Only safe once the GPU is idle.
+    void ReleaseAll() { m_pending.clear(); }
+
+private:
+    struct Entry
+    {
+        uint64_t fenceValue;
+        ComPtr<IUnknown> object;
+    };
+
+    std::deque<Entry> m_pending;
+};
@@ -0,0 +1,76 @@
+// Compiled without the precompiled header so that the controller can be tested on Linux.
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Scales are compared after quantization; anything closer than this is the same.
+    const double ScaleEpsilon = 1e-6;
+}
+
+ResolutionScaleController::ResolutionScaleController( const Settings& settings )
+    : m_settings( settings ),
+    m_scale( settings.maxScale ),
+    m_streak( 0 ),
+    m_streakPeakMs( 0.0 )
+{
+}
+
+void ResolutionScaleController::Reset()
+{
+    m_scale = m_settings.maxScale;
+    m_streak = 0;
+    m_streakPeakMs = 0.0;
+}
+
+double ResolutionScaleController::AddFrame( double gpuMs, double renderScale )
+{
+    // Rendered before the last change: says nothing about the current scale.
+    if (std::abs( renderScale - m_scale ) > ScaleEpsilon || gpuMs <= 0.0 || m_settings.budgetMs <= 0.0)
+    {
+        return m_scale;
+    }
+
+    const double load = gpuMs / m_settings.budgetMs;
+    if (load > m_settings.decreaseLoad)
+    {
+        m_streakPeakMs = m_streak > 0 ? std::max( m_streakPeakMs, gpuMs ) : gpuMs;
+        m_streak = m_streak > 0 ? m_streak + 1 : 1;
+    }
+    else if (load < m_settings.increaseLoad)
+    {
+        m_streakPeakMs = m_streak < 0 ? std::max( m_streakPeakMs, gpuMs ) : gpuMs;
+        m_streak = m_streak < 0 ? m_streak - 1 : -1;
+    }
+    else
+    {
+        m_streak = 0;
+        return m_scale;
+    }
+
+    const double target = m_scale * std::sqrt( m_settings.budgetMs * m_settings.targetLoad / m_streakPeakMs );
+    if (m_streak >= static_cast<int32_t>( m_settings.decreaseFrames ))
+    {
+        // At least one step down, so that a frame just over the threshold still moves.
+        SetScale( std::min( Quantize( target ), m_scale - m_settings.step ) );
+    }
+    else if (-m_streak >= static_cast<int32_t>( m_settings.increaseFrames ))
+    {
+        SetScale( std::min( std::max( Quantize( target ), m_scale + m_settings.step ), m_scale + m_settings.maxIncrease ) );
+    }
+    return m_scale;
+}
+
+double ResolutionScaleController::Quantize( double scale ) const
+{
+    return m_settings.step > 0.0 ? std::floor( scale / m_settings.step + ScaleEpsilon ) * m_settings.step : scale;
+}
+
+void ResolutionScaleController::SetScale( double scale )
+{
+    m_scale = std::min( std::max( scale, m_settings.minScale ), m_settings.maxScale );
+    m_streak = 0;
+    m_streakPeakMs = 0.0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+// Picks the render scale (the fraction of the output width and height the scene is
+// rendered at) that keeps the GPU frame time within a budget.
+//
+// The pixel cost of a frame goes with the square of the scale, so a frame that took
+// gpuMs at scale s is expected to take budget * targetLoad at s * sqrt( budget *
+// targetLoad / gpuMs ). To keep the scale from oscillating around the budget there is a
+// dead band between the two load thresholds in which nothing changes, and a change is only
+// made once enough frames in a row have been outside it: a few to drop the scale, many
+// more to raise it again. Scales are quantized to steps, so small corrections do not
+// resize the viewport every time.
+//
+// Each sample carries the scale its frame was rendered at. GPU timings arrive a few
+// frames late, so samples from before the last change are ignored.
+//
+// Only depends on the standard library, so recorded frame-time traces can be replayed
+// through it outside the app.
+class ResolutionScaleController
+{
+public:
+    struct Settings
+    {
+        double budgetMs = 16.0;
+        double minScale = 0.5;
+        double maxScale = 1.0;
+        double step = 1.0 / 32.0;
+        double maxIncrease = 0.125;     // Largest single step up.
+
+        // Loads (GPU time over budget) outside which the scale changes, and the load a
+        // change aims for.
+        double decreaseLoad = 0.95;
+        double increaseLoad = 0.80;
+        double targetLoad = 0.875;
+
+        // Consecutive samples outside the dead band needed for a change.
+        uint32_t decreaseFrames = 2;
+        uint32_t increaseFrames = 30;
+    };
+
+    explicit ResolutionScaleController( const Settings& settings );
+
+    // Adds the GPU time of a frame rendered at renderScale, and returns the scale to
+    // render the next frame at.
+    double AddFrame( double gpuMs, double renderScale );
+
+    double GetScale() const { return m_scale; }
+    const Settings& GetSettings() const { return m_settings; }
+
+    // Back to the largest scale, e.g. after the output was resized.
+    void Reset();
+
+private:
+    double Quantize( double scale ) const;
+    void SetScale( double scale );
+
+    Settings m_settings;
+    double m_scale;
+
+    // The current run of samples above the dead band (positive) or below it (negative),
+    // and its slowest frame.
+    int32_t m_streak;
+    double m_streakPeakMs;
+};
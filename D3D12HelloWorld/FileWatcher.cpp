@@ -0,0 +1,189 @@
+// Compiled without the precompiled header so that the watcher builds on Linux as well.
+#include "FileWatcher.h"
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::FileWatcher()
+    : m_stop( false )
+#if defined(_WIN32)
+    , m_directoryHandle( INVALID_HANDLE_VALUE ), m_stopEvent( nullptr )
+#else
+    , m_inotifyFd( -1 )
+#endif
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+    Stop();
+}
+
+bool FileWatcher::Start( const std::string& directory, Callback callback )
+{
+    Stop();
+
+    m_directory = directory;
+    m_callback = std::move( callback );
+    m_stop = false;
+
+#if defined(_WIN32)
+    m_directoryHandle = CreateFileA(
+        directory.c_str(),
+        FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+        nullptr );
+    if (m_directoryHandle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    m_stopEvent = CreateEvent( nullptr, true, false, nullptr );
+#else
+    m_inotifyFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    if (m_inotifyFd < 0)
+    {
+        return false;
+    }
+
+    if (inotify_add_watch( m_inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO ) < 0)
+    {
+        close( m_inotifyFd );
+        m_inotifyFd = -1;
+        return false;
+    }
+#endif
+
+    m_thread = std::thread( &FileWatcher::ThreadMain, this );
+    return true;
+}
+
+void FileWatcher::Stop()
+{
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+
+    m_stop = true;
+#if defined(_WIN32)
+    SetEvent( m_stopEvent );
+#endif
+    m_thread.join();
+
+#if defined(_WIN32)
+    CloseHandle( m_directoryHandle );
+    CloseHandle( m_stopEvent );
+    m_directoryHandle = INVALID_HANDLE_VALUE;
+    m_stopEvent = nullptr;
+#else
+    close( m_inotifyFd );
+    m_inotifyFd = -1;
+#endif
+}
+
+#if defined(_WIN32)
+
+void FileWatcher::ThreadMain()
+{
+    alignas( DWORD ) uint8_t buffer[16 * 1024];
+
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEvent( nullptr, false, false, nullptr );
+
+    while (!m_stop)
+    {
+        if (!ReadDirectoryChangesW(
+            m_directoryHandle,
+            buffer,
+            sizeof( buffer ),
+            false,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+            nullptr,
+            &overlapped,
+            nullptr ))
+        {
+            break;
+        }
+
+        HANDLE handles[] = { overlapped.hEvent, m_stopEvent };
+        if (WaitForMultipleObjects( 2, handles, false, INFINITE ) != WAIT_OBJECT_0)
+        {
+            // The read still owns the buffer and the OVERLAPPED, both on this stack, until
+            // the cancellation completes; wait for it before they go out of scope.
+            DWORD cancelledBytes = 0;
+            CancelIoEx( m_directoryHandle, &overlapped );
+            GetOverlappedResult( m_directoryHandle, &overlapped, &cancelledBytes, true );
+            break;
+        }
+
+        DWORD bytes = 0;
+        if (!GetOverlappedResult( m_directoryHandle, &overlapped, &bytes, false ) || bytes == 0)
+        {
+            // The buffer overflowed; nothing to report for this batch.
+            continue;
+        }
+
+        const uint8_t* pCursor = buffer;
+        for (;;)
+        {
+            auto pInfo = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>( pCursor );
+            if (pInfo->Action == FILE_ACTION_MODIFIED || pInfo->Action == FILE_ACTION_ADDED || pInfo->Action == FILE_ACTION_RENAMED_NEW_NAME)
+            {
+                const int length = static_cast<int>( pInfo->FileNameLength / sizeof( WCHAR ) );
+                char name[MAX_PATH] = {};
+                WideCharToMultiByte( CP_UTF8, 0, pInfo->FileName, length, name, MAX_PATH - 1, nullptr, nullptr );
+                m_callback( name );
+            }
+
+            if (pInfo->NextEntryOffset == 0)
+            {
+                break;
+            }
+            pCursor += pInfo->NextEntryOffset;
+        }
+    }
+
+    CloseHandle( overlapped.hEvent );
+}
+
+#else
+
+void FileWatcher::ThreadMain()
+{
+    alignas( inotify_event ) char buffer[16 * 1024];
+
+    while (!m_stop)
+    {
+        // Wake up periodically to observe m_stop.
+        pollfd pfd = { m_inotifyFd, POLLIN, 0 };
+        if (poll( &pfd, 1, 100 ) <= 0)
+        {
+            continue;
+        }
+
+        const ssize_t bytes = read( m_inotifyFd, buffer, sizeof( buffer ) );
+        for (ssize_t offset = 0; offset < bytes;)
+        {
+            auto pEvent = reinterpret_cast<const inotify_event*>( buffer + offset );
+            if (pEvent->len > 0)
+            {
+                m_callback( pEvent->name );
+            }
+            offset += sizeof( inotify_event ) + pEvent->len;
+        }
+    }
+}
+
+#endif
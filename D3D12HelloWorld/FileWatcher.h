@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+// Watches a single directory (non-recursively) on a background thread and reports the
+// names of files that were written or renamed into place. Uses ReadDirectoryChangesW on
+// Windows and inotify on Linux. The callback runs on the watcher thread.
+class FileWatcher
+{
+public:
+    using Callback = std::function<void( const std::string& fileName )>;
+
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher( const FileWatcher& ) = delete;
+    FileWatcher& operator=( const FileWatcher& ) = delete;
+
+    bool Start( const std::string& directory, Callback callback );
+    void Stop();
+
+private:
+    void ThreadMain();
+
+    std::string m_directory;
+    Callback m_callback;
+    std::thread m_thread;
+    std::atomic<bool> m_stop;
+
+#if defined(_WIN32)
+    void* m_directoryHandle;
+    void* m_stopEvent;
+#else
+    int m_inotifyFd;
+#endif
+};
@@ -0,0 +1,215 @@
+// Compiled without the precompiled header so that the pacing model can be tested on Linux.
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+namespace
+{
+    // Weight of the newest sample in the running estimates.
+    const double EstimateWeight = 0.1;
+
+    // Timer sleeps can overshoot by about this much; the rest is spun.
+    const double SpinMs = 0.5;
+}
+
+void FramePacingModel::Estimate::Add( double sample )
+{
+    if (!valid)
+    {
+        mean = sample;
+        deviation = 0.0;
+        valid = true;
+        return;
+    }
+
+    deviation += EstimateWeight * ( std::abs( sample - mean ) - deviation );
+    mean += EstimateWeight * ( sample - mean );
+}
+
+FramePacingModel::FramePacingModel()
+    : m_targetFps( 0.0 ),
+    m_cpu{ 0.0, 0.0, false },
+    m_gpu{ 0.0, 0.0, false },
+    m_vblankMs( -1.0 ),
+    m_vblankCount( 0 ),
+    m_refreshPeriodMs( 0.0 ),
+    m_targetPresentMs( -1.0 )
+{
+}
+
+void FramePacingModel::SetTargetFps( double fps )
+{
+    m_targetFps = std::max( fps, 0.0 );
+}
+
+void FramePacingModel::AddVblank( double timeMs, uint64_t refreshCount )
+{
+    if (m_vblankMs >= 0.0 && refreshCount > m_vblankCount)
+    {
+        m_refreshPeriodMs = ( timeMs - m_vblankMs ) / static_cast<double>( refreshCount - m_vblankCount );
+    }
+    m_vblankMs = timeMs;
+    m_vblankCount = refreshCount;
+}
+
+void FramePacingModel::AddFrame( double cpuMs, double gpuMs )
+{
+    m_cpu.Add( cpuMs );
+    m_gpu.Add( gpuMs );
+}
+
+double FramePacingModel::ScheduleFrame( double nowMs )
+{
+    const double frameMs = GetPredictedFrameMs();
+    const double capIntervalMs = m_targetFps > 0.0 ? 1000.0 / m_targetFps : 0.0;
+    const bool onGrid = m_vblankMs >= 0.0 && m_refreshPeriodMs > 0.0;
+
+    // Nothing to pace against: start right away.
+    if (capIntervalMs == 0.0 && !onGrid)
+    {
+        m_targetPresentMs = nowMs + frameMs;
+        return nowMs;
+    }
+
+    // The earliest slot the frame can make, and no sooner than the cap allows. Allow a
+    // little slack against the cap so that a cap at the refresh rate does not skip vblanks.
+    double presentMs = nowMs + frameMs;
+    if (m_targetPresentMs >= 0.0)
+    {
+        presentMs = std::max( presentMs, m_targetPresentMs + capIntervalMs - ( onGrid ? 0.5 * m_refreshPeriodMs : 0.0 ) );
+    }
+
+    if (onGrid)
+    {
+        // Round up to a vblank, one frame per vblank.
+        double vblanks = std::ceil( ( presentMs - m_vblankMs ) / m_refreshPeriodMs );
+        if (m_targetPresentMs >= 0.0)
+        {
+            const double lastVblank = std::round( ( m_targetPresentMs - m_vblankMs ) / m_refreshPeriodMs );
+            vblanks = std::max( vblanks, lastVblank + 1.0 );
+        }
+        presentMs = m_vblankMs + vblanks * m_refreshPeriodMs;
+    }
+
+    m_targetPresentMs = presentMs;
+    return std::max( nowMs, presentMs - frameMs );
+}
+
+double FramePacingModel::GetPredictedFrameMs() const
+{
+    return m_cpu.Conservative() + m_gpu.Conservative();
+}
+
+FramePacer::FramePacer()
+    : m_origin( Clock::now() ),
+    m_timer( nullptr )
+{
+#if defined(_WIN32)
+    // Falls back to a regular timer before Windows 10 1803.
+    m_timer = CreateWaitableTimerExW( nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS );
+    if (!m_timer)
+    {
+        m_timer = CreateWaitableTimerExW( nullptr, nullptr, 0, TIMER_ALL_ACCESS );
+    }
+#endif
+}
+
+FramePacer::~FramePacer()
+{
+#if defined(_WIN32)
+    if (m_timer)
+    {
+        CloseHandle( m_timer );
+    }
+#endif
+}
+
+void FramePacer::SetTargetFps( double fps )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_model.SetTargetFps( fps );
+}
+
+FramePacer::Clock::time_point FramePacer::WaitForFrameStart()
+{
+    const Clock::time_point now = Clock::now();
+
+    double startMs;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        startMs = m_model.ScheduleFrame( ToMilliseconds( now ) );
+    }
+
+    const Clock::time_point start = m_origin + std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double, std::milli>( startMs ) );
+    if (start > now)
+    {
+        SleepUntil( start );
+    }
+    return Clock::now();
+}
+
+void FramePacer::ReportVblank( Clock::time_point time, uint64_t refreshCount )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_model.AddVblank( ToMilliseconds( time ), refreshCount );
+}
+
+void FramePacer::ReportFrame( Clock::time_point frameStart, Clock::time_point present, double gpuMs )
+{
+    const double cpuMs = std::chrono::duration<double, std::milli>( present - frameStart ).count();
+
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_model.AddFrame( cpuMs, gpuMs );
+}
+
+double FramePacer::GetPredictedFrameMs() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_model.GetPredictedFrameMs();
+}
+
+double FramePacer::ToMilliseconds( Clock::time_point time ) const
+{
+    return std::chrono::duration<double, std::milli>( time - m_origin ).count();
+}
+
+void FramePacer::SleepUntil( Clock::time_point wakeTime )
+{
+    const Clock::time_point spinStart = wakeTime - std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double, std::milli>( SpinMs ) );
+    const Clock::time_point now = Clock::now();
+    if (spinStart > now)
+    {
+#if defined(_WIN32)
+        // Relative due time, in 100 ns units.
+        LARGE_INTEGER dueTime;
+        dueTime.QuadPart = -static_cast<LONGLONG>( std::chrono::duration_cast<std::chrono::nanoseconds>( spinStart - now ).count() / 100 );
+        if (m_timer && SetWaitableTimerEx( m_timer, &dueTime, 0, nullptr, nullptr, nullptr, 0 ))
+        {
+            WaitForSingleObject( m_timer, INFINITE );
+        }
+        else
+        {
+            std::this_thread::sleep_until( spinStart );
+        }
+#else
+        std::this_thread::sleep_until( spinStart );
+#endif
+    }
+
+    while (Clock::now() < wakeTime)
+    {
+        std::this_thread::yield();
+    }
+}
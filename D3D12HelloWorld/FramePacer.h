@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// Decides when the next frame should start so that it is ready just in time for the
+// present slot it is aimed at. Present slots are the display's vertical blanks (when the
+// vblank grid is known), spaced by at least the frame-rate cap. A frame is expected to
+// take its CPU time (start to Present()) plus its GPU time; both are tracked as an
+// exponentially weighted mean plus twice the mean deviation, so that occasional slow
+// frames do not miss their slot.
+//
+// Times are milliseconds on any monotonic clock, so the model can be driven by
+// synthetic timings.
+class FramePacingModel
+{
+public:
+    FramePacingModel();
+
+    // 0 disables the cap.
+    void SetTargetFps( double fps );
+    double GetTargetFps() const { return m_targetFps; }
+
+    // A vertical blank at timeMs; refreshCount counts vblanks on the display. Two calls
+    // with different counts give the refresh period.
+    void AddVblank( double timeMs, uint64_t refreshCount );
+
+    // A finished frame: cpuMs from its start to Present(), gpuMs of GPU work.
+    void AddFrame( double cpuMs, double gpuMs );
+
+    // Picks the present slot for the next frame and returns when the frame should start
+    // to meet it; returns nowMs if it is already late.
+    double ScheduleFrame( double nowMs );
+
+    double GetPredictedFrameMs() const;
+    double GetTargetPresentMs() const { return m_targetPresentMs; }
+    double GetRefreshPeriodMs() const { return m_refreshPeriodMs; }
+
+private:
+    struct Estimate
+    {
+        double mean;
+        double deviation;
+        bool valid;
+
+        void Add( double sample );
+        double Conservative() const { return valid ? mean + 2.0 * deviation : 0.0; }
+    };
+
+    double m_targetFps;
+    Estimate m_cpu;
+    Estimate m_gpu;
+
+    double m_vblankMs;          // A vblank on the grid, or < 0 if unknown.
+    uint64_t m_vblankCount;
+    double m_refreshPeriodMs;   // 0 if unknown.
+
+    double m_targetPresentMs;   // Slot of the last scheduled frame, or < 0 before the first.
+};
+
+// Runtime side of the pacing model: measures on a steady clock and sleeps until the
+// scheduled start on a high-resolution timer, finishing with a short spin. Scheduling
+// (one thread) and reporting (another) may happen concurrently.
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FramePacer();
+    ~FramePacer();
+
+    FramePacer( const FramePacer& ) = delete;
+    FramePacer& operator=( const FramePacer& ) = delete;
+
+    void SetTargetFps( double fps );
+
+    // Sleeps until the next frame should start, and returns the start time.
+    Clock::time_point WaitForFrameStart();
+
+    void ReportVblank( Clock::time_point time, uint64_t refreshCount );
+    void ReportFrame( Clock::time_point frameStart, Clock::time_point present, double gpuMs );
+
+    double GetPredictedFrameMs() const;
+
+    // Milliseconds since the pacer was created, the model's time base.
+    double ToMilliseconds( Clock::time_point time ) const;
+
+private:
+    void SleepUntil( Clock::time_point wakeTime );
+
+    const Clock::time_point m_origin;
+    void* m_timer;      // High-resolution waitable timer on Windows.
+
+    mutable std::mutex m_mutex;     // Guards m_model.
+    FramePacingModel m_model;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "FrustumCulling.h"
+
+#include <DirectXMath.h>
+#include <chrono>
+#include <vector>
+
+// Everything the render stage needs from the simulation stage for one frame. Written by
+// the simulation thread and immutable once handed over (see FramePipeline).
+struct FramePacket
+{
+    // Per-instance data, copied as is into the frame's instance buffer (a StructuredBuffer
+    // of the same layout in shaders.hlsl).
+    struct Instance
+    {
+        // The first three rows of the transposed world matrix: row i gives output
+        // coordinate i as a dot product with the position.
+        DirectX::XMFLOAT4 worldRows[3];
+        DirectX::XMFLOAT4 color;
+    };
+
+    uint64_t frameNumber;
+    double simulationTime;
+    std::chrono::steady_clock::time_point startTime;   // When the simulation started the frame.
+
+    // Transposed for HLSL's column-major constant layout.
+    DirectX::XMFLOAT4X4 viewProjection;
+    Frustum frustum;
+
+    // Only the instances that passed frustum and occlusion culling, followed by the
+    // occluders, and how long each culling step took. With --gpu-culling, every instance:
+    // they are culled on the GPU instead.
+    std::vector<Instance> instances;
+    double cullMs;
+    double occlusionMs;
+};
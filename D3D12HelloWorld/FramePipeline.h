@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Double-buffered hand-off between two pipeline stages running on their own threads:
+// the producer fills frame N+1 while the consumer works on frame N. A slot is immutable
+// from EndWrite() until the consumer's EndRead(), and the producer never runs more than
+// one frame ahead. Close() releases both sides, after which Begin*() return nullptr.
+template<typename T>
+class FramePipeline
+{
+public:
+    FramePipeline() : m_written( 0 ), m_read( 0 ), m_closed( false ) {}
+
+    FramePipeline( const FramePipeline& ) = delete;
+    FramePipeline& operator=( const FramePipeline& ) = delete;
+
+    // Producer: blocks while both slots are in use.
+    T* BeginWrite()
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_changed.wait( lock, [this] { return m_closed || m_written - m_read < 2; } );
+        return m_closed ? nullptr : &m_slots[m_written % 2];
+    }
+
+    void EndWrite()
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_written++;
+        }
+        m_changed.notify_all();
+    }
+
+    // Consumer: blocks until a frame has been written.
+    const T* BeginRead()
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_changed.wait( lock, [this] { return m_closed || m_read < m_written; } );
+        return m_closed ? nullptr : &m_slots[m_read % 2];
+    }
+
+    void EndRead()
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_read++;
+        }
+        m_changed.notify_all();
+    }
+
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_closed = true;
+        }
+        m_changed.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    T m_slots[2];
+    uint64_t m_written;
+    uint64_t m_read;
+    bool m_closed;
+};
@@ -0,0 +1,205 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+    std::string EscapeJson( const std::string& str )
+    {
+        std::string escaped;
+        for (char c : str)
+        {
+            if (c == '"' || c == '\\')
+            {
+                escaped += '\\';
+                escaped += c;
+            }
+            else if (static_cast<unsigned char>( c ) < 0x20)
+            {
+                char code[8];
+                snprintf( code, sizeof( code ), "\\u%04x", c );
+                escaped += code;
+            }
+            else
+            {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    // Enough digits to round-trip the sub-microsecond part of a millisecond timing.
+    std::string FormatNumber( double value )
+    {
+        char number[32];
+        snprintf( number, sizeof( number ), "%.4f", value );
+        return number;
+    }
+
+    // CSV fields containing separators or quotes are quoted, with quotes doubled.
+    std::string EscapeCsv( const std::string& str )
+    {
+        if (str.find_first_of( ",\"\n" ) == std::string::npos)
+        {
+            return str;
+        }
+
+        std::string escaped = "\"";
+        for (char c : str)
+        {
+            escaped += c;
+            if (c == '"')
+            {
+                escaped += '"';
+            }
+        }
+        return escaped + "\"";
+    }
+}
+
+FrameStats::FrameStats( std::vector<std::string> metricNames, size_t warmupFrames )
+    : m_metricNames( std::move( metricNames ) ),
+    m_warmupFramesLeft( warmupFrames )
+{
+}
+
+void FrameStats::Reserve( size_t frameCount )
+{
+    m_samples.reserve( frameCount * m_metricNames.size() );
+}
+
+void FrameStats::AddFrame( const double* values )
+{
+    if (m_warmupFramesLeft != 0)
+    {
+        m_warmupFramesLeft--;
+        return;
+    }
+    m_samples.insert( m_samples.end(), values, values + m_metricNames.size() );
+}
+
+void FrameStats::SetTag( const std::string& key, const std::string& value )
+{
+    m_tags[key] = value;
+}
+
+FrameStats::Summary FrameStats::Summarize( size_t metric ) const
+{
+    Summary summary = {};
+    const size_t frameCount = GetFrameCount();
+    if (frameCount == 0)
+    {
+        return summary;
+    }
+
+    std::vector<double> sorted( frameCount );
+    double sum = 0.0;
+    for (size_t frame = 0; frame < frameCount; ++frame)
+    {
+        sorted[frame] = GetSample( frame, metric );
+        sum += sorted[frame];
+    }
+    std::sort( sorted.begin(), sorted.end() );
+
+    // Nearest rank: the smallest sample with at least p percent of samples at or below it.
+    auto percentile = [&sorted]( double p )
+    {
+        const size_t rank = static_cast<size_t>( std::ceil( p / 100.0 * sorted.size() ) );
+        return sorted[rank > 0 ? rank - 1 : 0];
+    };
+
+    summary.mean = sum / frameCount;
+    summary.p50 = percentile( 50.0 );
+    summary.p95 = percentile( 95.0 );
+    summary.p99 = percentile( 99.0 );
+    summary.max = sorted.back();
+    return summary;
+}
+
+void FrameStats::WriteJson( std::ostream& out ) const
+{
+    out << "{\n  \"tags\": {";
+    const char* separator = "";
+    for (const auto& tag : m_tags)
+    {
+        out << separator << "\n    \"" << EscapeJson( tag.first ) << "\": \"" << EscapeJson( tag.second ) << "\"";
+        separator = ",";
+    }
+    out << ( m_tags.empty() ? "},\n" : "\n  },\n" );
+
+    out << "  \"frameCount\": " << GetFrameCount() << ",\n  \"summary\": {";
+    for (size_t metric = 0; metric < m_metricNames.size(); ++metric)
+    {
+        const Summary summary = Summarize( metric );
+        out << ( metric ? "," : "" ) << "\n    \"" << EscapeJson( m_metricNames[metric] ) << "\": { "
+            << "\"mean\": " << FormatNumber( summary.mean )
+            << ", \"p50\": " << FormatNumber( summary.p50 )
+            << ", \"p95\": " << FormatNumber( summary.p95 )
+            << ", \"p99\": " << FormatNumber( summary.p99 )
+            << ", \"max\": " << FormatNumber( summary.max ) << " }";
+    }
+    out << "\n  },\n  \"samples\": {";
+    for (size_t metric = 0; metric < m_metricNames.size(); ++metric)
+    {
+        out << ( metric ? "," : "" ) << "\n    \"" << EscapeJson( m_metricNames[metric] ) << "\": [";
+        for (size_t frame = 0; frame < GetFrameCount(); ++frame)
+        {
+            out << ( frame ? ", " : "" ) << FormatNumber( GetSample( frame, metric ) );
+        }
+        out << "]";
+    }
+    out << "\n  }\n}\n";
+}
+
+// Raw samples, one row per frame, preceded by the summary rows (frame column holds the
+// statistic's name) so that a single file carries both.
+void FrameStats::WriteCsv( std::ostream& out ) const
+{
+    for (const auto& tag : m_tags)
+    {
+        out << "# " << tag.first << ": " << tag.second << "\n";
+    }
+
+    out << "frame";
+    for (const std::string& name : m_metricNames)
+    {
+        out << "," << EscapeCsv( name );
+    }
+    out << "\n";
+
+    std::vector<Summary> summaries;
+    for (size_t metric = 0; metric < m_metricNames.size(); ++metric)
+    {
+        summaries.push_back( Summarize( metric ) );
+    }
+
+    static const struct
+    {
+        const char* name;
+        double Summary::* field;
+    } statistics[] =
+    {
+        { "mean", &Summary::mean }, { "p50", &Summary::p50 }, { "p95", &Summary::p95 }, { "p99", &Summary::p99 }, { "max", &Summary::max }
+    };
+    for (const auto& statistic : statistics)
+    {
+        out << statistic.name;
+        for (const Summary& summary : summaries)
+        {
+            out << "," << FormatNumber( summary.*statistic.field );
+        }
+        out << "\n";
+    }
+
+    for (size_t frame = 0; frame < GetFrameCount(); ++frame)
+    {
+        out << frame;
+        for (size_t metric = 0; metric < m_metricNames.size(); ++metric)
+        {
+            out << "," << FormatNumber( GetSample( frame, metric ) );
+        }
+        out << "\n";
+    }
+}
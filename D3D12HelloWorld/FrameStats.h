@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per-frame timing samples for benchmark runs. Each frame records one value per metric,
+// in the order the metrics were named at construction; the summary and the raw samples
+// can be written as JSON or CSV. Has no platform dependencies.
+class FrameStats
+{
+public:
+    struct Summary
+    {
+        double mean;
+        double p50;
+        double p95;
+        double p99;
+        double max;
+    };
+
+    // The first warmupFrames frames added are not recorded.
+    explicit FrameStats( std::vector<std::string> metricNames, size_t warmupFrames = 0 );
+
+    void Reserve( size_t frameCount );
+
+    // values holds one entry per metric.
+    void AddFrame( const double* values );
+
+    // Free-form run description (adapter, present mode, ...) written alongside the results.
+    void SetTag( const std::string& key, const std::string& value );
+
+    size_t GetFrameCount() const { return m_samples.size() / m_metricNames.size(); }
+    size_t GetMetricCount() const { return m_metricNames.size(); }
+    const std::string& GetMetricName( size_t metric ) const { return m_metricNames[metric]; }
+
+    // Percentiles use the nearest-rank method. All zero if no frames were recorded.
+    Summary Summarize( size_t metric ) const;
+
+    void WriteJson( std::ostream& out ) const;
+    void WriteCsv( std::ostream& out ) const;
+
+private:
+    double GetSample( size_t frame, size_t metric ) const { return m_samples[frame * m_metricNames.size() + metric]; }
+
+    std::vector<std::string> m_metricNames;
+    std::map<std::string, std::string> m_tags;
+    size_t m_warmupFramesLeft;
+
+    // Frame-major: all metrics of frame 0, then frame 1, ...
+    std::vector<double> m_samples;
+};
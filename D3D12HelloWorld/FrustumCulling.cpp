@@ -0,0 +1,383 @@
+// Compiled without the precompiled header so that the culling kernels can be tested and
+// benchmarked on Linux.
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include <xmmintrin.h>
+
+namespace
+{
+    // Volumes per parallel chunk. A multiple of four, so chunks start on SIMD blocks.
+    const uint32_t ChunkSize = 16 * 1024;
+
+    // Padding volumes: no plane distance can make up for a radius this negative.
+    const float NeverVisible = -FLT_MAX;
+
+    uint32_t PaddedCount( uint32_t count )
+    {
+        return ( count + 3 ) & ~3u;
+    }
+
+    void ResizePadded( std::vector<float>& values, uint32_t count, uint32_t padded, float padding )
+    {
+        values.resize( padded );
+        std::fill( values.begin() + count, values.end(), padding );
+    }
+
+    // The planes as one register per coefficient, each replicated across the lanes.
+    struct SimdPlanes
+    {
+        __m128 a[6];
+        __m128 b[6];
+        __m128 c[6];
+        __m128 d[6];
+
+        explicit SimdPlanes( const Frustum& frustum )
+        {
+            for (int p = 0; p < 6; p++)
+            {
+                a[p] = _mm_set1_ps( frustum.planes[p][0] );
+                b[p] = _mm_set1_ps( frustum.planes[p][1] );
+                c[p] = _mm_set1_ps( frustum.planes[p][2] );
+                d[p] = _mm_set1_ps( frustum.planes[p][3] );
+            }
+        }
+    };
+
+    // Writes the four indices from first and advances past the visible ones, without
+    // branches; the slots after the last visible index are overwritten later or ignored.
+    uint32_t Compact( int mask, uint32_t first, uint32_t* pVisible, uint32_t count )
+    {
+        pVisible[count] = first;
+        count += mask & 1;
+        pVisible[count] = first + 1;
+        count += ( mask >> 1 ) & 1;
+        pVisible[count] = first + 2;
+        count += ( mask >> 2 ) & 1;
+        pVisible[count] = first + 3;
+        count += ( mask >> 3 ) & 1;
+        return count;
+    }
+
+    template <typename Cull, typename Bounds>
+    void CullParallel( JobSystem& jobs, const Frustum& frustum, const Bounds& bounds, std::vector<uint32_t>& visible, Cull cull )
+    {
+        const uint32_t chunkCount = ( bounds.count + ChunkSize - 1 ) / ChunkSize;
+        std::vector<uint32_t> chunkVisible( chunkCount );
+
+        // Each chunk compacts into its own slice; the slices are closed up afterwards.
+        visible.resize( PaddedCount( bounds.count ) );
+        uint32_t* pVisible = visible.data();
+        jobs.ParallelFor( chunkCount, [&]( uint32_t begin, uint32_t end )
+        {
+            for (uint32_t chunk = begin; chunk < end; chunk++)
+            {
+                const uint32_t first = chunk * ChunkSize;
+                chunkVisible[chunk] = cull( frustum, bounds, first, std::min( first + ChunkSize, bounds.count ), pVisible + first );
+            }
+        } );
+
+        uint32_t total = 0;
+        for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+        {
+            if (total != chunk * ChunkSize)
+            {
+                memmove( pVisible + total, pVisible + chunk * ChunkSize, chunkVisible[chunk] * sizeof( uint32_t ) );
+            }
+            total += chunkVisible[chunk];
+        }
+        visible.resize( total );
+    }
+}
+
+Frustum Frustum::FromViewProjection( const float m[4][4] )
+{
+    // Clip coordinate j is the dot product of the point with column j; the planes bound
+    // -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+    static const int Signs[6][2] = { { 0, 1 }, { 0, -1 }, { 1, 1 }, { 1, -1 }, { 2, 0 }, { 2, -1 } };
+
+    Frustum frustum;
+    for (int p = 0; p < 6; p++)
+    {
+        const int column = Signs[p][0];
+        const float sign = static_cast<float>( Signs[p][1] );
+        float* plane = frustum.planes[p];
+        for (int i = 0; i < 4; i++)
+        {
+            // The near plane (z >= 0) is column 2 alone; the others are w +/- the column.
+            plane[i] = p == 4 ? m[i][column] : m[i][3] + sign * m[i][column];
+        }
+
+        const float length = std::sqrt( plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2] );
+        if (length > 0.0f)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                plane[i] /= length;
+            }
+        }
+    }
+    return frustum;
+}
+
+void SphereBounds::Resize( uint32_t newCount )
+{
+    const uint32_t padded = PaddedCount( newCount );
+    count = newCount;
+    ResizePadded( centerX, newCount, padded, 0.0f );
+    ResizePadded( centerY, newCount, padded, 0.0f );
+    ResizePadded( centerZ, newCount, padded, 0.0f );
+    ResizePadded( radius, newCount, padded, NeverVisible );
+}
+
+void SphereBounds::Set( uint32_t index, float x, float y, float z, float r )
+{
+    centerX[index] = x;
+    centerY[index] = y;
+    centerZ[index] = z;
+    radius[index] = r;
+}
+
+void BoxBounds::Resize( uint32_t newCount )
+{
+    const uint32_t padded = PaddedCount( newCount );
+    count = newCount;
+    ResizePadded( centerX, newCount, padded, 0.0f );
+    ResizePadded( centerY, newCount, padded, 0.0f );
+    ResizePadded( centerZ, newCount, padded, 0.0f );
+    ResizePadded( extentX, newCount, padded, NeverVisible );
+    ResizePadded( extentY, newCount, padded, NeverVisible );
+    ResizePadded( extentZ, newCount, padded, NeverVisible );
+}
+
+void BoxBounds::Set( uint32_t index, float x, float y, float z, float ex, float ey, float ez )
+{
+    centerX[index] = x;
+    centerY[index] = y;
+    centerZ[index] = z;
+    extentX[index] = ex;
+    extentY[index] = ey;
+    extentZ[index] = ez;
+}
+
+// A sphere is outside once its center is further than its radius behind any plane.
+uint32_t CullSpheres( const Frustum& frustum, const SphereBounds& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible )
+{
+    const SimdPlanes planes( frustum );
+    const __m128 zero = _mm_setzero_ps();
+
+    uint32_t visibleCount = 0;
+    for (uint32_t i = begin; i < end; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps( &bounds.centerX[i] );
+        const __m128 y = _mm_loadu_ps( &bounds.centerY[i] );
+        const __m128 z = _mm_loadu_ps( &bounds.centerZ[i] );
+        const __m128 r = _mm_loadu_ps( &bounds.radius[i] );
+
+        __m128 inside = _mm_cmpeq_ps( zero, zero );
+        for (int p = 0; p < 6; p++)
+        {
+            const __m128 distance = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, planes.a[p] ), _mm_mul_ps( y, planes.b[p] ) ), _mm_mul_ps( z, planes.c[p] ) ), planes.d[p] );
+            inside = _mm_and_ps( inside, _mm_cmpge_ps( _mm_add_ps( distance, r ), zero ) );
+        }
+        visibleCount = Compact( _mm_movemask_ps( inside ), i, pVisible, visibleCount );
+    }
+    return visibleCount;
+}
+
+// A box reaches as far towards a plane as its extents projected on the plane's normal.
+uint32_t CullBoxes( const Frustum& frustum, const BoxBounds& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible )
+{
+    const SimdPlanes planes( frustum );
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signMask = _mm_set1_ps( -0.0f );
+
+    uint32_t visibleCount = 0;
+    for (uint32_t i = begin; i < end; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps( &bounds.centerX[i] );
+        const __m128 y = _mm_loadu_ps( &bounds.centerY[i] );
+        const __m128 z = _mm_loadu_ps( &bounds.centerZ[i] );
+        const __m128 ex = _mm_loadu_ps( &bounds.extentX[i] );
+        const __m128 ey = _mm_loadu_ps( &bounds.extentY[i] );
+        const __m128 ez = _mm_loadu_ps( &bounds.extentZ[i] );
+
+        __m128 inside = _mm_cmpeq_ps( zero, zero );
+        for (int p = 0; p < 6; p++)
+        {
+            const __m128 distance = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, planes.a[p] ), _mm_mul_ps( y, planes.b[p] ) ), _mm_mul_ps( z, planes.c[p] ) ), planes.d[p] );
+            const __m128 reach = _mm_add_ps( _mm_add_ps(
+                _mm_mul_ps( ex, _mm_andnot_ps( signMask, planes.a[p] ) ),
+                _mm_mul_ps( ey, _mm_andnot_ps( signMask, planes.b[p] ) ) ),
+                _mm_mul_ps( ez, _mm_andnot_ps( signMask, planes.c[p] ) ) );
+            inside = _mm_and_ps( inside, _mm_cmpge_ps( _mm_add_ps( distance, reach ), zero ) );
+        }
+        visibleCount = Compact( _mm_movemask_ps( inside ), i, pVisible, visibleCount );
+    }
+    return visibleCount;
+}
+
+uint32_t CullSpheresScalar( const Frustum& frustum, const SphereBounds& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible )
+{
+    uint32_t visibleCount = 0;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++)
+        {
+            const float* plane = frustum.planes[p];
+            const float distance = bounds.centerX[i] * plane[0] + bounds.centerY[i] * plane[1] + bounds.centerZ[i] * plane[2] + plane[3];
+            inside = distance + bounds.radius[i] >= 0.0f;
+        }
+        if (inside)
+        {
+            pVisible[visibleCount++] = i;
+        }
+    }
+    return visibleCount;
+}
+
+uint32_t CullBoxesScalar( const Frustum& frustum, const BoxBounds& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible )
+{
+    uint32_t visibleCount = 0;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++)
+        {
+            const float* plane = frustum.planes[p];
+            const float distance = bounds.centerX[i] * plane[0] + bounds.centerY[i] * plane[1] + bounds.centerZ[i] * plane[2] + plane[3];
+            const float reach = bounds.extentX[i] * std::abs( plane[0] ) + bounds.extentY[i] * std::abs( plane[1] ) + bounds.extentZ[i] * std::abs( plane[2] );
+            inside = distance + reach >= 0.0f;
+        }
+        if (inside)
+        {
+            pVisible[visibleCount++] = i;
+        }
+    }
+    return visibleCount;
+}
+
+void CullSpheres( JobSystem& jobs, const Frustum& frustum, const SphereBounds& bounds, std::vector<uint32_t>& visible )
+{
+    CullParallel( jobs, frustum, bounds, visible, []( const Frustum& f, const SphereBounds& b, uint32_t begin, uint32_t end, uint32_t* pVisible )
+    {
+        return CullSpheres( f, b, begin, end, pVisible );
+    } );
+}
+
+void CullBoxes( JobSystem& jobs, const Frustum& frustum, const BoxBounds& bounds, std::vector<uint32_t>& visible )
+{
+    CullParallel( jobs, frustum, bounds, visible, []( const Frustum& f, const BoxBounds& b, uint32_t begin, uint32_t end, uint32_t* pVisible )
+    {
+        return CullBoxes( f, b, begin, end, pVisible );
+    } );
+}
+
+std::string BenchmarkCulling( JobSystem& jobs, uint32_t count, bool& resultsMatch )
+{
+    using Clock = std::chrono::steady_clock;
+    const int Runs = 10;
+
+    // Volumes scattered around a camera at the origin looking down +z, with a 60 degree
+    // vertical field of view: roughly a tenth of them end up visible.
+    std::mt19937 random( 12345 );
+    std::uniform_real_distribution<float> position( -100.0f, 100.0f );
+    std::uniform_real_distribution<float> size( 0.5f, 2.0f );
+    SphereBounds spheres;
+    BoxBounds boxes;
+    spheres.Resize( count );
+    boxes.Resize( count );
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const float x = position( random );
+        const float y = position( random );
+        const float z = position( random );
+        spheres.Set( i, x, y, z, size( random ) );
+        boxes.Set( i, x, y, z, size( random ), size( random ), size( random ) );
+    }
+
+    const float nearZ = 0.1f;
+    const float farZ = 100.0f;
+    const float yScale = 1.0f / std::tan( 3.14159265f / 6.0f );
+    const float xScale = yScale * 9.0f / 16.0f;
+    const float zScale = farZ / ( farZ - nearZ );
+    const float viewProjection[4][4] =
+    {
+        { xScale, 0.0f, 0.0f, 0.0f },
+        { 0.0f, yScale, 0.0f, 0.0f },
+        { 0.0f, 0.0f, zScale, 1.0f },
+        { 0.0f, 0.0f, -nearZ * zScale, 0.0f }
+    };
+    const Frustum frustum = Frustum::FromViewProjection( viewProjection );
+
+    // Best of several runs, after a first one that also warms the caches.
+    std::vector<uint32_t> visible( PaddedCount( count ) );
+    auto time = [&]( std::vector<uint32_t>& result, auto cull )
+    {
+        double bestMs = 0.0;
+        for (int run = 0; run <= Runs; run++)
+        {
+            const Clock::time_point start = Clock::now();
+            cull( result );
+            const double ms = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+            bestMs = run == 1 ? ms : std::min( bestMs, ms );
+        }
+        return bestMs;
+    };
+
+    resultsMatch = true;
+    std::string report;
+    char line[256];
+    snprintf( line, sizeof( line ), "Culling benchmark: %u volumes, %u threads, best of %d runs\n", count, jobs.GetWorkerCount() + 1, Runs );
+    report += line;
+
+    for (int kind = 0; kind < 2; kind++)
+    {
+        const bool sphere = kind == 0;
+        std::vector<uint32_t> scalar( PaddedCount( count ) );
+        std::vector<uint32_t> simd( PaddedCount( count ) );
+        std::vector<uint32_t> parallel;
+
+        const double scalarMs = time( scalar, [&]( std::vector<uint32_t>& result )
+        {
+            result.resize( sphere ? CullSpheresScalar( frustum, spheres, 0, count, result.data() ) : CullBoxesScalar( frustum, boxes, 0, count, result.data() ) );
+            result.resize( PaddedCount( count ) );
+        } );
+        scalar.resize( sphere ? CullSpheresScalar( frustum, spheres, 0, count, scalar.data() ) : CullBoxesScalar( frustum, boxes, 0, count, scalar.data() ) );
+
+        const double simdMs = time( simd, [&]( std::vector<uint32_t>& result )
+        {
+            result.resize( sphere ? CullSpheres( frustum, spheres, 0, count, result.data() ) : CullBoxes( frustum, boxes, 0, count, result.data() ) );
+            result.resize( PaddedCount( count ) );
+        } );
+        simd.resize( sphere ? CullSpheres( frustum, spheres, 0, count, simd.data() ) : CullBoxes( frustum, boxes, 0, count, simd.data() ) );
+
+        const double parallelMs = time( parallel, [&]( std::vector<uint32_t>& result )
+        {
+            if (sphere)
+            {
+                CullSpheres( jobs, frustum, spheres, result );
+            }
+            else
+            {
+                CullBoxes( jobs, frustum, boxes, result );
+            }
+        } );
+
+        const bool match = scalar == simd && scalar == parallel;
+        resultsMatch = resultsMatch && match;
+        snprintf( line, sizeof( line ), "%-8s scalar %8.3f ms   simd %8.3f ms   parallel %8.3f ms   visible %u%s\n",
+            sphere ? "spheres" : "boxes", scalarMs, simdMs, parallelMs, static_cast<uint32_t>( scalar.size() ), match ? "" : "   MISMATCH" );
+        report += line;
+    }
+    return report;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// A view frustum as six normalized planes (a, b, c, d); a point is inside a plane when
+// a x + b y + c z + d >= 0.
+struct Frustum
+{
+    float planes[6][4];
+
+    // From a view-projection matrix in DirectXMath's convention: row vectors (clip =
+    // v * M), stored row-major as m[row][column], with D3D's 0 to 1 clip depth.
+    static Frustum FromViewProjection( const float m[4][4] );
+};
+
+// Bounding volumes in structure-of-arrays layout: one array per component, so that four
+// consecutive volumes load as one SIMD register per component. The arrays are padded to a
+// multiple of four with volumes that are never visible, so the SIMD loops have no tail.
+struct SphereBounds
+{
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+    uint32_t count = 0;
+
+    void Resize( uint32_t newCount );
+    void Set( uint32_t index, float x, float y, float z, float r );
+};
+
+// Axis-aligned boxes as centers and half extents.
+struct BoxBounds
+{
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> extentX;
+    std::vector<float> extentY;
+    std::vector<float> extentZ;
+    uint32_t count = 0;
+
+    void Resize( uint32_t newCount );
+    void Set( uint32_t index, float x, float y, float z, float ex, float ey, float ez );
+};
+
+// Write the indices of the volumes in [begin, end) that intersect the frustum to
+// pVisible, in increasing order, and return how many there are. begin must be a multiple
+// of four, and so must end unless it is the volume count; pVisible needs room for
+// end - begin rounded up to a multiple of four. Four volumes are tested per iteration
+// with SSE (x64's baseline, and what XMVECTOR is built on).
+uint32_t CullSpheres( const Frustum& frustum, const SphereBounds& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible );
+uint32_t CullBoxes( const Frustum& frustum, const BoxBounds& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible );
+
+// Scalar reference versions: one volume at a time, same results.
+uint32_t CullSpheresScalar( const Frustum& frustum, const SphereBounds& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible );
+uint32_t CullBoxesScalar( const Frustum& frustum, const BoxBounds& bounds, uint32_t begin, uint32_t end, uint32_t* pVisible );
+
+// Cull every volume, split into fixed chunks across the job system, and replace visible
+// with the compacted list of visible indices.
+void CullSpheres( JobSystem& jobs, const Frustum& frustum, const SphereBounds& bounds, std::vector<uint32_t>& visible );
+void CullBoxes( JobSystem& jobs, const Frustum& frustum, const BoxBounds& bounds, std::vector<uint32_t>& visible );
+
+// Times the scalar, SIMD and parallel versions on count randomly placed spheres and boxes
+// and returns a report. resultsMatch is set if every version found the same volumes.
+std::string BenchmarkCulling( JobSystem& jobs, uint32_t count, bool& resultsMatch );
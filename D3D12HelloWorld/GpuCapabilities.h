@@ -0,0 +1,31 @@
+#pragma once
+
+#include <d3d12.h>
+
+// Everything the renderer needs to know about the adapter it runs on, probed once per
+// adapter and driver version (see AdapterSelector) and immutable afterwards. Query this
+// instead of calling CheckFeatureSupport at the point of use.
+//
+// Plain data: it is persisted to disk byte for byte.
+struct GpuCapabilities
+{
+    LUID adapterLuid;
+    uint64_t driverVersion;
+    wchar_t description[128];
+    uint32_t vendorId;
+    uint32_t deviceId;
+    uint64_t dedicatedVideoMemory;
+    bool isSoftware;
+
+    // False if device creation failed; the adapter is skipped without probing again.
+    bool supported;
+
+    D3D_FEATURE_LEVEL maxFeatureLevel;
+    D3D_ROOT_SIGNATURE_VERSION rootSignatureVersion;
+    D3D_SHADER_MODEL shaderModel;
+    D3D12_RESOURCE_BINDING_TIER resourceBindingTier;
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options;
+    D3D12_FEATURE_DATA_D3D12_OPTIONS1 options1;
+    D3D12_FEATURE_DATA_D3D12_OPTIONS3 options3;
+    D3D12_FEATURE_DATA_D3D12_OPTIONS5 options5;
+};
@@ -0,0 +1,239 @@
+#include "hwpch.h"
+#include "GpuProfiler.h"
+
+namespace
+{
+    // Every scope takes a begin and an end timestamp.
+    const uint32_t QueriesPerFrame = GpuProfiler::MaxScopesPerFrame * 2;
+
+    // ticks * 1e9 / frequency without overflowing 64 bits.
+    uint64_t TicksToNanoseconds( uint64_t ticks, uint64_t frequency )
+    {
+        return ticks / frequency * 1000000000ull + ticks % frequency * 1000000000ull / frequency;
+    }
+}
+
+GpuProfiler::GpuProfiler()
+    : m_timestampFrequency( 0 ), m_qpcFrequency( 0 ), m_calibrationGpuTimestamp( 0 ), m_calibrationCpuTimestamp( 0 ),
+    m_currentFrame( 0 ), m_recording( false ), m_depth( 0 ), m_latestFenceValue( 0 )
+{
+}
+
+void GpuProfiler::Initialize( ID3D12Device* pDevice, ID3D12CommandQueue* pQueue, uint32_t frameLatency, bool pipelineStatistics )
+{
+    m_CommandQueue = pQueue;
+    ThrowIfFailed( pQueue->GetTimestampFrequency( &m_timestampFrequency ) );
+
+    LARGE_INTEGER qpcFrequency;
+    QueryPerformanceFrequency( &qpcFrequency );
+    m_qpcFrequency = static_cast<uint64_t>( qpcFrequency.QuadPart );
+    Calibrate();
+
+    // One range more than the frame latency, so the range about to be recorded has
+    // normally been read back already.
+    m_frames.resize( frameLatency + 1 );
+    for (Frame& frame : m_frames)
+    {
+        frame.scopes.reserve( MaxScopesPerFrame );
+        frame.fenceValue = 0;
+        frame.pending = false;
+    }
+
+    D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    queryHeapDesc.Count = QueriesPerFrame * static_cast<uint32_t>( m_frames.size() );
+    ThrowIfFailed( pDevice->CreateQueryHeap( &queryHeapDesc, IID_PPV_ARGS( &m_QueryHeap ) ) );
+
+    ThrowIfFailed( pDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES( D3D12_HEAP_TYPE_READBACK ),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer( queryHeapDesc.Count * sizeof( uint64_t ) ),
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS( &m_ReadbackBuffer )
+    ) );
+
+    // One statistics query per scope.
+    if (pipelineStatistics)
+    {
+        D3D12_QUERY_HEAP_DESC statisticsHeapDesc = {};
+        statisticsHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_PIPELINE_STATISTICS;
+        statisticsHeapDesc.Count = MaxScopesPerFrame * static_cast<uint32_t>( m_frames.size() );
+        ThrowIfFailed( pDevice->CreateQueryHeap( &statisticsHeapDesc, IID_PPV_ARGS( &m_StatisticsQueryHeap ) ) );
+
+        ThrowIfFailed( pDevice->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES( D3D12_HEAP_TYPE_READBACK ),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer( statisticsHeapDesc.Count * sizeof( D3D12_QUERY_DATA_PIPELINE_STATISTICS ) ),
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr,
+            IID_PPV_ARGS( &m_StatisticsReadbackBuffer )
+        ) );
+    }
+}
+
+void GpuProfiler::BeginFrame( uint64_t completedFenceValue )
+{
+    // Read back every range the GPU has finished with; the newest one becomes the result.
+    for (uint32_t i = 0; i < m_frames.size(); ++i)
+    {
+        if (m_frames[i].pending && m_frames[i].fenceValue <= completedFenceValue)
+        {
+            ReadBack( m_frames[i], i );
+        }
+    }
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter( &now );
+    if (static_cast<uint64_t>( now.QuadPart ) - m_calibrationCpuTimestamp > m_qpcFrequency)
+    {
+        Calibrate();
+    }
+
+    m_currentFrame = ( m_currentFrame + 1 ) % m_frames.size();
+    Frame& frame = m_frames[m_currentFrame];
+
+    // Still in flight: skip this frame rather than stall.
+    m_recording = !frame.pending;
+    m_depth = 0;
+    if (m_recording)
+    {
+        frame.scopes.clear();
+    }
+}
+
+void GpuProfiler::EndFrame( ID3D12GraphicsCommandList* pCommandList, uint64_t fenceValue )
+{
+    Frame& frame = m_frames[m_currentFrame];
+    if (!m_recording || frame.scopes.empty())
+    {
+        return;
+    }
+
+    const uint32_t firstQuery = m_currentFrame * QueriesPerFrame;
+    pCommandList->ResolveQueryData(
+        m_QueryHeap.Get(),
+        D3D12_QUERY_TYPE_TIMESTAMP,
+        firstQuery,
+        static_cast<uint32_t>( frame.scopes.size() ) * 2,
+        m_ReadbackBuffer.Get(),
+        firstQuery * sizeof( uint64_t ) );
+
+    if (m_StatisticsQueryHeap)
+    {
+        const uint32_t firstStatisticsQuery = m_currentFrame * MaxScopesPerFrame;
+        pCommandList->ResolveQueryData(
+            m_StatisticsQueryHeap.Get(),
+            D3D12_QUERY_TYPE_PIPELINE_STATISTICS,
+            firstStatisticsQuery,
+            static_cast<uint32_t>( frame.scopes.size() ),
+            m_StatisticsReadbackBuffer.Get(),
+            firstStatisticsQuery * sizeof( D3D12_QUERY_DATA_PIPELINE_STATISTICS ) );
+    }
+
+    frame.fenceValue = fenceValue;
+    frame.pending = true;
+    m_recording = false;
+}
+
+uint32_t GpuProfiler::BeginScope( ID3D12GraphicsCommandList* pCommandList, const char* name )
+{
+    Frame& frame = m_frames[m_currentFrame];
+    if (!m_recording || frame.scopes.size() == MaxScopesPerFrame)
+    {
+        return InvalidScope;
+    }
+
+    const uint32_t scope = static_cast<uint32_t>( frame.scopes.size() );
+    frame.scopes.push_back( { name, m_depth++ } );
+    pCommandList->EndQuery( m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, m_currentFrame * QueriesPerFrame + scope * 2 );
+    if (m_StatisticsQueryHeap)
+    {
+        pCommandList->BeginQuery( m_StatisticsQueryHeap.Get(), D3D12_QUERY_TYPE_PIPELINE_STATISTICS, m_currentFrame * MaxScopesPerFrame + scope );
+    }
+    return scope;
+}
+
+void GpuProfiler::EndScope( ID3D12GraphicsCommandList* pCommandList, uint32_t scope )
+{
+    if (scope == InvalidScope || !m_recording)
+    {
+        return;
+    }
+
+    m_depth--;
+    if (m_StatisticsQueryHeap)
+    {
+        pCommandList->EndQuery( m_StatisticsQueryHeap.Get(), D3D12_QUERY_TYPE_PIPELINE_STATISTICS, m_currentFrame * MaxScopesPerFrame + scope );
+    }
+    pCommandList->EndQuery( m_QueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, m_currentFrame * QueriesPerFrame + scope * 2 + 1 );
+}
+
+uint64_t GpuProfiler::ToCpuNanoseconds( uint64_t gpuTimestamp ) const
+{
+    const uint64_t calibrationNs = TicksToNanoseconds( m_calibrationCpuTimestamp, m_qpcFrequency );
+    if (gpuTimestamp >= m_calibrationGpuTimestamp)
+    {
+        return calibrationNs + TicksToNanoseconds( gpuTimestamp - m_calibrationGpuTimestamp, m_timestampFrequency );
+    }
+    return calibrationNs - TicksToNanoseconds( m_calibrationGpuTimestamp - gpuTimestamp, m_timestampFrequency );
+}
+
+// The GPU and CPU clocks drift apart, so the pairing is refreshed periodically.
+void GpuProfiler::Calibrate()
+{
+    ThrowIfFailed( m_CommandQueue->GetClockCalibration( &m_calibrationGpuTimestamp, &m_calibrationCpuTimestamp ) );
+}
+
+double GpuProfiler::GetScopeMilliseconds( const char* name ) const
+{
+    for (const ScopeTiming& timing : m_latestTimings)
+    {
+        if (strcmp( timing.name, name ) == 0)
+        {
+            return timing.milliseconds;
+        }
+    }
+    return 0.0;
+}
+
+void GpuProfiler::ReadBack( Frame& frame, uint32_t frameIndex )
+{
+    frame.pending = false;
+    if (frame.fenceValue < m_latestFenceValue)
+    {
+        return;
+    }
+
+    const size_t offset = frameIndex * QueriesPerFrame * sizeof( uint64_t );
+    const D3D12_RANGE readRange = { offset, offset + frame.scopes.size() * 2 * sizeof( uint64_t ) };
+    uint8_t* pData = nullptr;
+    ThrowIfFailed( m_ReadbackBuffer->Map( 0, &readRange, reinterpret_cast<void**>( &pData ) ) );
+    const uint64_t* pTimestamps = reinterpret_cast<const uint64_t*>( pData + offset );
+
+    const double ticksToMilliseconds = 1000.0 / static_cast<double>( m_timestampFrequency );
+    m_latestTimings.clear();
+    for (size_t i = 0; i < frame.scopes.size(); ++i)
+    {
+        const uint64_t begin = pTimestamps[i * 2];
+        const uint64_t end = pTimestamps[i * 2 + 1];
+        m_latestTimings.push_back( { frame.scopes[i].name, frame.scopes[i].depth, end > begin ? ( end - begin ) * ticksToMilliseconds : 0.0, begin, end, {} } );
+    }
+
+    const D3D12_RANGE writeRange = { 0, 0 };
+    m_ReadbackBuffer->Unmap( 0, &writeRange );
+
+    if (m_StatisticsQueryHeap)
+    {
+        const size_t statisticsOffset = frameIndex * MaxScopesPerFrame * sizeof( D3D12_QUERY_DATA_PIPELINE_STATISTICS );
+        const D3D12_RANGE statisticsRange = { statisticsOffset, statisticsOffset + frame.scopes.size() * sizeof( D3D12_QUERY_DATA_PIPELINE_STATISTICS ) };
+        ThrowIfFailed( m_StatisticsReadbackBuffer->Map( 0, &statisticsRange, reinterpret_cast<void**>( &pData ) ) );
+        const D3D12_QUERY_DATA_PIPELINE_STATISTICS* pStatistics = reinterpret_cast<const D3D12_QUERY_DATA_PIPELINE_STATISTICS*>( pData + statisticsOffset );
+        for (size_t i = 0; i < frame.scopes.size(); ++i)
+        {
+            m_latestTimings[i].statistics = pStatistics[i];
+        }
+        m_StatisticsReadbackBuffer->Unmap( 0, &writeRange );
+    }
+    m_latestFenceValue = frame.fenceValue;
+}
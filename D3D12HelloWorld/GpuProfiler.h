@@ -0,0 +1,118 @@
+#pragma once
+
+#include "Helpers.h"
+
+#include <vector>
+
+// GPU pass timing from timestamp queries. Each frame in flight owns a range of the query
+// heap and of a readback buffer; EndFrame() resolves the frame's queries into its range,
+// and BeginFrame() reads back the ranges whose fence value the GPU has passed. A range
+// that is still in flight is never waited on: that frame simply goes unprofiled.
+//
+// Scopes nest, and must be recorded on direct command lists (queries are not allowed in
+// bundles). Use GpuProfileScope to pair the begin and end timestamps. Optionally each
+// scope also collects pipeline statistics (vertices, primitives, shader invocations).
+class GpuProfiler
+{
+public:
+    static const uint32_t MaxScopesPerFrame = 32;
+    static const uint32_t InvalidScope = UINT32_MAX;
+
+    struct ScopeTiming
+    {
+        const char* name;
+        uint32_t depth;
+        double milliseconds;
+
+        // Raw GPU timestamps; see ToCpuNanoseconds().
+        uint64_t beginTimestamp;
+        uint64_t endTimestamp;
+
+        // All zero unless pipeline statistics are enabled.
+        D3D12_QUERY_DATA_PIPELINE_STATISTICS statistics;
+    };
+
+    GpuProfiler();
+
+    // frameLatency is the number of frames the CPU may record ahead of the GPU.
+    void Initialize( ID3D12Device* pDevice, ID3D12CommandQueue* pQueue, uint32_t frameLatency, bool pipelineStatistics = false );
+
+    // completedFenceValue is the queue fence's current value; fenceValue in EndFrame() is
+    // the value the queue will signal once this frame's command lists have executed.
+    void BeginFrame( uint64_t completedFenceValue );
+    void EndFrame( ID3D12GraphicsCommandList* pCommandList, uint64_t fenceValue );
+
+    // name must outlive the results (string literals in practice).
+    uint32_t BeginScope( ID3D12GraphicsCommandList* pCommandList, const char* name );
+    void EndScope( ID3D12GraphicsCommandList* pCommandList, uint32_t scope );
+
+    // Scopes of the most recent frame read back, in the order they began. Lags the frame
+    // being recorded by the frame latency.
+    const std::vector<ScopeTiming>& GetLatestTimings() const { return m_latestTimings; }
+
+    // Duration of the named scope in the latest results, or 0 if it was not recorded.
+    double GetScopeMilliseconds( const char* name ) const;
+
+    // Fence value of the frame the latest results belong to; changes when new ones arrive.
+    uint64_t GetLatestFenceValue() const { return m_latestFenceValue; }
+
+    // Maps a GPU timestamp onto the CPU timeline (QueryPerformanceCounter, in
+    // nanoseconds), using GetClockCalibration(). Recalibrated about once a second.
+    uint64_t ToCpuNanoseconds( uint64_t gpuTimestamp ) const;
+
+private:
+    struct Scope
+    {
+        const char* name;
+        uint32_t depth;
+    };
+
+    struct Frame
+    {
+        std::vector<Scope> scopes;
+        uint64_t fenceValue;
+        bool pending;
+    };
+
+    void ReadBack( Frame& frame, uint32_t frameIndex );
+    void Calibrate();
+
+    Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_QueryHeap;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_ReadbackBuffer;
+    Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_StatisticsQueryHeap;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_StatisticsReadbackBuffer;
+    uint64_t m_timestampFrequency;
+
+    Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_CommandQueue;
+    uint64_t m_qpcFrequency;
+    uint64_t m_calibrationGpuTimestamp;
+    uint64_t m_calibrationCpuTimestamp;
+
+    std::vector<Frame> m_frames;
+    uint32_t m_currentFrame;
+    bool m_recording;
+    uint32_t m_depth;
+
+    std::vector<ScopeTiming> m_latestTimings;
+    uint64_t m_latestFenceValue;
+};
+
+// Records a GPU scope for the lifetime of the object.
+class GpuProfileScope
+{
+public:
+    GpuProfileScope( GpuProfiler& profiler, ID3D12GraphicsCommandList* pCommandList, const char* name )
+        : m_profiler( profiler ), m_pCommandList( pCommandList ), m_scope( profiler.BeginScope( pCommandList, name ) )
+    {
+    }
+
+    ~GpuProfileScope() { m_profiler.EndScope( m_pCommandList, m_scope ); }
+
+    GpuProfileScope( const GpuProfileScope& ) = delete;
+    GpuProfileScope& operator=( const GpuProfileScope& ) = delete;
+
+private:
+    GpuProfiler& m_profiler;
+    ID3D12GraphicsCommandList* m_pCommandList;
+    const uint32_t m_scope;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a. The constexpr overloads allow cache keys to be folded at compile time
+// when their inputs are constant.
+constexpr uint64_t FnvOffsetBasis = 0xcbf29ce484222325ull;
+constexpr uint64_t FnvPrime = 0x100000001b3ull;
+
+constexpr uint64_t HashCombine( uint64_t seed, uint64_t value )
+{
+    for (int i = 0; i < 8; i++)
+    {
+        seed ^= ( value >> ( i * 8 ) ) & 0xff;
+        seed *= FnvPrime;
+    }
+    return seed;
+}
+
+constexpr uint64_t HashString( const char* str, uint64_t seed = FnvOffsetBasis )
+{
+    while (*str)
+    {
+        seed ^= static_cast<uint8_t>( *str++ );
+        seed *= FnvPrime;
+    }
+    return seed;
+}
+
+inline uint64_t HashBytes( const void* pData, size_t size, uint64_t seed = FnvOffsetBasis )
+{
+    const uint8_t* pBytes = static_cast<const uint8_t*>( pData );
+    for (size_t i = 0; i < size; i++)
+    {
+        seed ^= pBytes[i];
+        seed *= FnvPrime;
+    }
+    return seed;
+}
@@ -55,4 +55,20 @@ inline void GetAssetsPath( _Out_writes_( pathSize ) WCHAR* path, UINT pathSize )
     {
         *( lastSlash + 1 ) = L'\0';
     }
+}
+
+inline std::string ToUtf8( const std::wstring& str )
+{
+    const int length = WideCharToMultiByte( CP_UTF8, 0, str.c_str(), -1, nullptr, 0, nullptr, nullptr );
+    std::string result( length > 0 ? length - 1 : 0, '\0' );
+    WideCharToMultiByte( CP_UTF8, 0, str.c_str(), -1, &result[0], length, nullptr, nullptr );
+    return result;
+}
+
+inline std::wstring ToWide( const std::string& str )
+{
+    const int length = MultiByteToWideChar( CP_UTF8, 0, str.c_str(), -1, nullptr, 0 );
+    std::wstring result( length > 0 ? length - 1 : 0, L'\0' );
+    MultiByteToWideChar( CP_UTF8, 0, str.c_str(), -1, &result[0], length );
+    return result;
 }
\ No newline at end of file
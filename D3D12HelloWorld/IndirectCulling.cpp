@@ -0,0 +1,136 @@
+// Compiled without the precompiled header so that the reference kernel can be tested on
+// Linux.
+#include "IndirectCulling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // Differences described before the rest are summed up.
+    const uint32_t MaxReportedDifferences = 8;
+
+    std::vector<IndirectDrawCommand> SortedByInstance( const IndirectDrawCommand* pCommands, uint32_t count )
+    {
+        std::vector<IndirectDrawCommand> sorted( pCommands, pCommands + count );
+        std::stable_sort( sorted.begin(), sorted.end(), []( const IndirectDrawCommand& a, const IndirectDrawCommand& b ) { return a.instanceIndex < b.instanceIndex; } );
+        return sorted;
+    }
+
+    bool SameArguments( const IndirectDrawCommand& a, const IndirectDrawCommand& b )
+    {
+        return a.indexCountPerInstance == b.indexCountPerInstance && a.instanceCount == b.instanceCount && a.startIndexLocation == b.startIndexLocation
+            && a.baseVertexLocation == b.baseVertexLocation && a.startInstanceLocation == b.startInstanceLocation;
+    }
+}
+
+IndirectCullConstants MakeIndirectCullConstants( const Frustum& frustum, uint32_t instanceCount, uint32_t indexCount, float meshRadius )
+{
+    IndirectCullConstants constants;
+    memcpy( constants.planes, frustum.planes, sizeof( constants.planes ) );
+    constants.instanceCount = instanceCount;
+    constants.indexCount = indexCount;
+    constants.meshRadius = meshRadius;
+    return constants;
+}
+
+// Mirrors CSMain in Cull.hlsl, one instance per iteration instead of per thread.
+uint32_t CullInstancesReference( const IndirectCullConstants& constants, const void* pInstances, size_t stride, IndirectDrawCommand* pCommands )
+{
+    uint32_t commandCount = 0;
+    for (uint32_t index = 0; index < constants.instanceCount; index++)
+    {
+        const float( *rows )[4] = reinterpret_cast<const float( * )[4]>( static_cast<const uint8_t*>( pInstances ) + index * stride );
+
+        // The sphere follows the instance's translation, and grows with its largest axis
+        // scale: the longest column of the upper 3x3.
+        const float center[3] = { rows[0][3], rows[1][3], rows[2][3] };
+        float scaleSquared = 0.0f;
+        for (int column = 0; column < 3; column++)
+        {
+            const float lengthSquared = rows[0][column] * rows[0][column] + rows[1][column] * rows[1][column] + rows[2][column] * rows[2][column];
+            scaleSquared = std::max( scaleSquared, lengthSquared );
+        }
+        const float radius = constants.meshRadius * std::sqrt( scaleSquared );
+
+        bool visible = true;
+        for (int p = 0; p < 6 && visible; p++)
+        {
+            const float* plane = constants.planes[p];
+            visible = plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] + radius >= 0.0f;
+        }
+        if (!visible)
+        {
+            continue;
+        }
+
+        IndirectDrawCommand& command = pCommands[commandCount++];
+        command.instanceIndex = index;
+        command.indexCountPerInstance = constants.indexCount;
+        command.instanceCount = 1;
+        command.startIndexLocation = 0;
+        command.baseVertexLocation = 0;
+        command.startInstanceLocation = 0;
+    }
+    return commandCount;
+}
+
+// Both lists sorted by instance, then merged: an instance on one side only is missing or
+// extra, and one on both sides must have the same draw arguments.
+std::string DiffIndirectCommands( const IndirectDrawCommand* pExpected, uint32_t expectedCount, const IndirectDrawCommand* pActual, uint32_t actualCount )
+{
+    const std::vector<IndirectDrawCommand> expected = SortedByInstance( pExpected, expectedCount );
+    const std::vector<IndirectDrawCommand> actual = SortedByInstance( pActual, actualCount );
+
+    std::string report;
+    uint32_t differences = 0;
+    char line[160];
+    auto addDifference = [&]( const char* format, uint32_t instance )
+    {
+        if (differences++ < MaxReportedDifferences)
+        {
+            snprintf( line, sizeof( line ), format, instance );
+            report += line;
+        }
+    };
+
+    size_t e = 0;
+    size_t a = 0;
+    while (e < expected.size() || a < actual.size())
+    {
+        if (a == actual.size() || ( e < expected.size() && expected[e].instanceIndex < actual[a].instanceIndex ))
+        {
+            addDifference( "  instance %u: missing\n", expected[e++].instanceIndex );
+        }
+        else if (e == expected.size() || actual[a].instanceIndex < expected[e].instanceIndex)
+        {
+            addDifference( "  instance %u: not expected\n", actual[a++].instanceIndex );
+        }
+        else
+        {
+            if (!SameArguments( expected[e], actual[a] ))
+            {
+                addDifference( "  instance %u: different draw arguments\n", actual[a].instanceIndex );
+            }
+            e++;
+            a++;
+
+            // The same instance more than once.
+            while (a < actual.size() && actual[a].instanceIndex == actual[a - 1].instanceIndex)
+            {
+                addDifference( "  instance %u: drawn again\n", actual[a++].instanceIndex );
+            }
+        }
+    }
+
+    if (differences == 0)
+    {
+        return std::string();
+    }
+
+    snprintf( line, sizeof( line ), "%u commands, %u expected, %u difference(s)%s\n", actualCount, expectedCount, differences, differences > MaxReportedDifferences ? " (first ones listed)" : "" );
+    return line + report;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "FrustumCulling.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// GPU-driven culling (Cull.hlsl): one compute thread per instance tests the instance's
+// bounding sphere against the frustum and appends an indirect draw for it if it is
+// visible; the count of appended draws goes to a separate buffer that ExecuteIndirect
+// reads. The layouts below match the shader's, and CullInstancesReference() runs the same
+// kernel on the CPU, so argument generation can be checked without a GPU, and the GPU's
+// output can be checked against it (DiffIndirectCommands()).
+
+// One indirect command: the root constant that tells the vertex shader which instance to
+// draw, followed by the fields of D3D12_DRAW_INDEXED_ARGUMENTS.
+struct IndirectDrawCommand
+{
+    uint32_t instanceIndex;
+    uint32_t indexCountPerInstance;
+    uint32_t instanceCount;
+    uint32_t startIndexLocation;
+    int32_t baseVertexLocation;
+    uint32_t startInstanceLocation;
+};
+
+// The culling pass's root constants (CullConstants in Cull.hlsl).
+struct IndirectCullConstants
+{
+    float planes[6][4];
+    uint32_t instanceCount;
+    uint32_t indexCount;        // Of the mesh every instance draws.
+    float meshRadius;           // Bounding sphere of the mesh, around its origin.
+};
+
+IndirectCullConstants MakeIndirectCullConstants( const Frustum& frustum, uint32_t instanceCount, uint32_t indexCount, float meshRadius );
+
+// Writes the commands for the visible instances to pCommands, which needs room for every
+// instance, and returns how many there are. pInstances points at the first instance's
+// world rows: three rows of four floats, with the translation in the last column, as in
+// the shaders; stride is the distance between instances in bytes.
+//
+// The commands come out in instance order, while the GPU appends them in whatever order
+// its threads finish: compare the two sorted by instanceIndex.
+uint32_t CullInstancesReference( const IndirectCullConstants& constants, const void* pInstances, size_t stride, IndirectDrawCommand* pCommands );
+
+// Compares commands written by the GPU, in any order, with the expected ones, and
+// describes the first few differences; returns an empty string if they match. An instance
+// whose bounding sphere just touches a plane may come out differently on the GPU, whose
+// float arithmetic can round differently.
+std::string DiffIndirectCommands( const IndirectDrawCommand* pExpected, uint32_t expectedCount, const IndirectDrawCommand* pActual, uint32_t actualCount );
@@ -0,0 +1,618 @@
+// Compiled without the precompiled header so that the scheduler builds on Linux as well.
+#include "JobSystem.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <intrin.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct JobCounter::Job
+{
+    std::function<void()> work;
+    JobCounter* pCounter;
+};
+
+namespace
+{
+    // Chase-Lev deque of pointers over a fixed ring. The owner pushes and pops at the bottom; any
+    // thread may steal from the top. The sequentially consistent operations on top and
+    // bottom order the owner's pop against concurrent steals of the last job.
+    template<typename Job>
+    class WorkStealingDeque
+    {
+    public:
+        static const int64_t Capacity = 4096;
+
+        WorkStealingDeque() : m_top( 0 ), m_bottom( 0 ) {}
+
+        // Owner only. Returns false if the deque is full.
+        bool Push( Job* pJob )
+        {
+            const int64_t bottom = m_bottom.load( std::memory_order_relaxed );
+            const int64_t top = m_top.load( std::memory_order_acquire );
+            if (bottom - top >= Capacity)
+            {
+                return false;
+            }
+
+            m_slots[bottom & ( Capacity - 1 )].store( pJob, std::memory_order_relaxed );
+            m_bottom.store( bottom + 1, std::memory_order_release );
+            return true;
+        }
+
+        // Owner only.
+        Job* Pop()
+        {
+            const int64_t bottom = m_bottom.load( std::memory_order_relaxed ) - 1;
+            m_bottom.store( bottom, std::memory_order_seq_cst );
+            int64_t top = m_top.load( std::memory_order_seq_cst );
+            if (top > bottom)
+            {
+                m_bottom.store( bottom + 1, std::memory_order_relaxed );
+                return nullptr;
+            }
+
+            Job* pJob = m_slots[bottom & ( Capacity - 1 )].load( std::memory_order_relaxed );
+            if (top == bottom)
+            {
+                // Last job: race the thieves for it.
+                if (!m_top.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed ))
+                {
+                    pJob = nullptr;
+                }
+                m_bottom.store( bottom + 1, std::memory_order_relaxed );
+            }
+            return pJob;
+        }
+
+        Job* Steal()
+        {
+            int64_t top = m_top.load( std::memory_order_seq_cst );
+            const int64_t bottom = m_bottom.load( std::memory_order_seq_cst );
+            if (top >= bottom)
+            {
+                return nullptr;
+            }
+
+            Job* pJob = m_slots[top & ( Capacity - 1 )].load( std::memory_order_relaxed );
+            if (!m_top.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed ))
+            {
+                return nullptr;
+            }
+            return pJob;
+        }
+
+        bool IsEmpty() const
+        {
+            return m_bottom.load( std::memory_order_relaxed ) <= m_top.load( std::memory_order_relaxed );
+        }
+
+    private:
+        alignas( 64 ) std::atomic<int64_t> m_top;
+        alignas( 64 ) std::atomic<int64_t> m_bottom;
+        alignas( 64 ) std::atomic<Job*> m_slots[Capacity];
+    };
+
+    // Tries this many times to find a job before going to sleep.
+    const uint32_t SpinCount = 64;
+
+    uint32_t NextRandom( uint32_t& state )
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // One logical processor per physical core, in processor order. Empty if unknown.
+    std::vector<int> PhysicalCoreProcessors()
+    {
+        std::vector<int> processors;
+#if defined(_WIN32)
+        DWORD size = 0;
+        GetLogicalProcessorInformationEx( RelationProcessorCore, nullptr, &size );
+        std::vector<char> buffer( size );
+        if (!GetLogicalProcessorInformationEx( RelationProcessorCore, reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>( buffer.data() ), &size ))
+        {
+            return processors;
+        }
+
+        for (DWORD offset = 0; offset < size; )
+        {
+            const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* pInfo = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>( buffer.data() + offset );
+            const GROUP_AFFINITY& affinity = pInfo->Processor.GroupMask[0];
+            unsigned long bit;
+            if (_BitScanForward64( &bit, affinity.Mask ))
+            {
+                processors.push_back( affinity.Group * 64 + static_cast<int>( bit ) );
+            }
+            offset += pInfo->Size;
+        }
+#elif defined(__linux__)
+        // A processor is the first of its core if it heads its own sibling list.
+        const unsigned processorCount = std::thread::hardware_concurrency();
+        for (unsigned processor = 0; processor < processorCount; processor++)
+        {
+            char path[96];
+            snprintf( path, sizeof( path ), "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", processor );
+            std::ifstream siblings( path );
+            unsigned first;
+            if (siblings >> first && first == processor)
+            {
+                processors.push_back( static_cast<int>( processor ) );
+            }
+        }
+#endif
+        return processors;
+    }
+
+    void PinCurrentThread( int processor )
+    {
+#if defined(_WIN32)
+        GROUP_AFFINITY affinity = {};
+        affinity.Group = static_cast<WORD>( processor / 64 );
+        affinity.Mask = KAFFINITY( 1 ) << ( processor % 64 );
+        SetThreadGroupAffinity( GetCurrentThread(), &affinity, nullptr );
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO( &set );
+        CPU_SET( processor, &set );
+        pthread_setaffinity_np( pthread_self(), sizeof( set ), &set );
+#else
+        (void)processor;
+#endif
+    }
+}
+
+struct JobSystem::Worker
+{
+    JobSystem* pOwner;
+    uint32_t index;
+    uint32_t randomState;
+    char name[32];
+    WorkStealingDeque<Job> deque;
+    std::thread thread;
+};
+
+thread_local JobSystem::Worker* JobSystem::t_pWorker = nullptr;
+
+namespace
+{
+    thread_local uint32_t t_randomState = 0;
+}
+
+JobSystem::JobSystem( uint32_t workerCount, bool pinToPhysicalCores )
+    : m_stop( false ),
+    m_sharedCount( 0 ),
+    m_backgroundCount( 0 ),
+    m_epoch( 0 ),
+    m_sleepers( 0 )
+{
+    if (workerCount == 0)
+    {
+        const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = std::max( hardwareThreads, 2u ) - 1;
+    }
+
+    std::vector<int> processors;
+    if (pinToPhysicalCores)
+    {
+        processors = PhysicalCoreProcessors();
+    }
+
+    // All workers exist before any of them starts stealing.
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        m_workers.emplace_back( new Worker() );
+        Worker& worker = *m_workers.back();
+        worker.pOwner = this;
+        worker.index = i + 1;
+        worker.randomState = 0x9E3779B9u * ( i + 1 );
+        snprintf( worker.name, sizeof( worker.name ), "Job worker %u", i + 1 );
+    }
+
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        const int processor = i + 1 < processors.size() ? processors[i + 1] : -1;
+        m_workers[i]->thread = std::thread( &JobSystem::WorkerMain, this, m_workers[i].get(), processor );
+    }
+}
+
+// Workers drain the queues before they exit, so jobs already submitted still run.
+JobSystem::~JobSystem()
+{
+    m_stop.store( true, std::memory_order_release );
+    WakeSleepers( true );
+
+    for (std::unique_ptr<Worker>& pWorker : m_workers)
+    {
+        pWorker->thread.join();
+    }
+}
+
+void JobSystem::Run( std::function<void()> work, JobCounter* pCounter )
+{
+    if (pCounter)
+    {
+        pCounter->m_pending.fetch_add( 1, std::memory_order_acq_rel );
+    }
+    Submit( new Job{ std::move( work ), pCounter } );
+}
+
+void JobSystem::RunBackground( std::function<void()> work, JobCounter* pCounter )
+{
+    if (pCounter)
+    {
+        pCounter->m_pending.fetch_add( 1, std::memory_order_acq_rel );
+    }
+    {
+        std::lock_guard<std::mutex> lock( m_backgroundMutex );
+        m_background.push_back( new Job{ std::move( work ), pCounter } );
+        m_backgroundCount.fetch_add( 1, std::memory_order_release );
+    }
+
+    // Waking a single sleeper could pick a thread in Wait() that will not take it.
+    WakeSleepers( true );
+}
+
+void JobSystem::RunAfter( JobCounter& dependency, std::function<void()> work, JobCounter* pCounter )
+{
+    if (pCounter)
+    {
+        pCounter->m_pending.fetch_add( 1, std::memory_order_acq_rel );
+    }
+    Job* pJob = new Job{ std::move( work ), pCounter };
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock( dependency.m_mutex );
+        if (dependency.m_pending.load( std::memory_order_acquire ) != 0)
+        {
+            dependency.m_continuations.push_back( pJob );
+            return;
+        }
+        error = dependency.m_error;
+    }
+
+    if (error)
+    {
+        Finish( pJob, error );
+    }
+    else
+    {
+        Submit( pJob );
+    }
+}
+
+void JobSystem::Wait( JobCounter& counter )
+{
+    Worker* pWorker = GetCurrentWorker();
+    while (!counter.IsDone())
+    {
+        const uint64_t epoch = m_epoch.load( std::memory_order_seq_cst );
+        if (Job* pJob = FindJob( pWorker, &counter ))
+        {
+            Execute( pJob );
+        }
+        else if (!counter.IsDone())
+        {
+            WaitForWork( epoch, [&counter] { return counter.IsDone(); } );
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock( counter.m_mutex );
+        std::swap( error, counter.m_error );
+    }
+    if (error)
+    {
+        std::rethrow_exception( error );
+    }
+}
+
+void JobSystem::ParallelFor( uint32_t count, const std::function<void( uint32_t, uint32_t )>& body, uint32_t minGrain )
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Enough chunks for every thread to steal several times over.
+    const uint32_t threadCount = GetWorkerCount() + 1;
+    const uint32_t grain = std::max( { minGrain, count / ( threadCount * 8 ), 1u } );
+
+    JobCounter counter;
+    Run( [this, count, grain, &body, &counter] { ParallelForRange( 0, count, grain, body, counter ); }, &counter );
+    Wait( counter );
+}
+
+uint32_t JobSystem::GetCurrentWorkerIndex() const
+{
+    const Worker* pWorker = GetCurrentWorker();
+    return pWorker ? pWorker->index : 0;
+}
+
+JobSystem::Worker* JobSystem::GetCurrentWorker() const
+{
+    return t_pWorker && t_pWorker->pOwner == this ? t_pWorker : nullptr;
+}
+
+void JobSystem::Submit( Job* pJob )
+{
+    Worker* pWorker = GetCurrentWorker();
+    if (pWorker)
+    {
+        if (!pWorker->deque.Push( pJob ))
+        {
+            // Deque full: the pool is saturated anyway.
+            Execute( pJob );
+            return;
+        }
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock( m_sharedMutex );
+        m_shared.push_back( pJob );
+        m_sharedCount.fetch_add( 1, std::memory_order_release );
+    }
+
+    WakeSleepers( false );
+}
+
+// Own deque first (most recent, likely still in cache), then the shared queue, then the
+// other workers starting from a random one, and background jobs last.
+JobSystem::Job* JobSystem::FindJob( Worker* pWorker, const JobCounter* pWaitCounter )
+{
+    if (pWorker)
+    {
+        if (Job* pJob = pWorker->deque.Pop())
+        {
+            return pJob;
+        }
+    }
+
+    // A thread outside the pool only helps with the jobs it waits for: anything else (a
+    // startup task, say) could hold it far longer than its own work, and the workers will
+    // get to it. Without workers it has to run everything.
+    const uint32_t workerCount = GetWorkerCount();
+    const bool ownJobsOnly = !pWorker && pWaitCounter && workerCount != 0;
+
+    if (m_sharedCount.load( std::memory_order_acquire ) != 0)
+    {
+        std::lock_guard<std::mutex> lock( m_sharedMutex );
+        auto it = m_shared.begin();
+        if (ownJobsOnly)
+        {
+            it = std::find_if( m_shared.begin(), m_shared.end(), [pWaitCounter]( const Job* pJob ) { return pJob->pCounter == pWaitCounter; } );
+        }
+        if (it != m_shared.end())
+        {
+            Job* pJob = *it;
+            m_shared.erase( it );
+            m_sharedCount.fetch_sub( 1, std::memory_order_relaxed );
+            return pJob;
+        }
+    }
+
+    // Stolen jobs cannot be picked by counter, so such threads do not steal.
+    if (workerCount == 0 || ownJobsOnly)
+    {
+        return FindBackgroundJob( pWaitCounter );
+    }
+
+    uint32_t& randomState = pWorker ? pWorker->randomState : t_randomState;
+    if (randomState == 0)
+    {
+        randomState = static_cast<uint32_t>( std::hash<std::thread::id>()( std::this_thread::get_id() ) ) | 1;
+    }
+
+    const uint32_t first = NextRandom( randomState ) % workerCount;
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        Worker& victim = *m_workers[( first + i ) % workerCount];
+        if (&victim == pWorker)
+        {
+            continue;
+        }
+        if (Job* pJob = victim.deque.Steal())
+        {
+            return pJob;
+        }
+    }
+    return FindBackgroundJob( pWaitCounter );
+}
+
+// Idle workers take the oldest job; waiting threads only one of the jobs they wait for.
+JobSystem::Job* JobSystem::FindBackgroundJob( const JobCounter* pWaitCounter )
+{
+    if (m_backgroundCount.load( std::memory_order_acquire ) == 0)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock( m_backgroundMutex );
+    auto it = m_background.begin();
+    if (pWaitCounter)
+    {
+        it = std::find_if( m_background.begin(), m_background.end(), [pWaitCounter]( const Job* pJob ) { return pJob->pCounter == pWaitCounter; } );
+    }
+    if (it == m_background.end())
+    {
+        return nullptr;
+    }
+
+    Job* pJob = *it;
+    m_background.erase( it );
+    m_backgroundCount.fetch_sub( 1, std::memory_order_relaxed );
+    return pJob;
+}
+
+void JobSystem::Execute( Job* pJob )
+{
+    std::exception_ptr error;
+    try
+    {
+        pJob->work();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    Finish( pJob, error );
+}
+
+// Continuations of a counter that failed are skipped and fail their own counters in turn.
+void JobSystem::Finish( Job* pJob, std::exception_ptr error )
+{
+    JobCounter* pCounter = pJob->pCounter;
+    delete pJob;
+    if (!pCounter)
+    {
+        return;
+    }
+
+    std::vector<Job*> continuations;
+    std::exception_ptr counterError;
+    bool completed;
+    {
+        std::lock_guard<std::mutex> lock( pCounter->m_mutex );
+        if (error && !pCounter->m_error)
+        {
+            pCounter->m_error = error;
+        }
+
+        completed = pCounter->m_pending.fetch_sub( 1, std::memory_order_acq_rel ) == 1;
+        if (completed)
+        {
+            continuations.swap( pCounter->m_continuations );
+            counterError = pCounter->m_error;
+        }
+    }
+
+    if (!completed)
+    {
+        return;
+    }
+
+    for (Job* pContinuation : continuations)
+    {
+        if (counterError)
+        {
+            Finish( pContinuation, counterError );
+        }
+        else
+        {
+            Submit( pContinuation );
+        }
+    }
+
+    // Any sleeper may be waiting on this counter.
+    WakeSleepers( true );
+}
+
+// A new job needs one thread to pick it up; a finished counter may have several waiters.
+void JobSystem::WakeSleepers( bool all )
+{
+    m_epoch.fetch_add( 1, std::memory_order_seq_cst );
+    if (m_sleepers.load( std::memory_order_seq_cst ) == 0)
+    {
+        return;
+    }
+
+    // Taking the lock orders the bump against a sleeper that is between checking the
+    // epoch and blocking.
+    {
+        std::lock_guard<std::mutex> lock( m_sleepMutex );
+    }
+    if (all)
+    {
+        m_wake.notify_all();
+    }
+    else
+    {
+        m_wake.notify_one();
+    }
+}
+
+// Sleeps until the epoch moves past seenEpoch (read before the caller last looked for
+// work, so nothing queued since can be missed) or wake() returns true.
+void JobSystem::WaitForWork( uint64_t seenEpoch, const std::function<bool()>& wake )
+{
+    for (uint32_t i = 0; i < SpinCount; i++)
+    {
+        if (m_epoch.load( std::memory_order_seq_cst ) != seenEpoch || wake())
+        {
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    std::unique_lock<std::mutex> lock( m_sleepMutex );
+    m_sleepers.fetch_add( 1, std::memory_order_seq_cst );
+    m_wake.wait( lock, [this, seenEpoch, &wake] { return m_epoch.load( std::memory_order_seq_cst ) != seenEpoch || wake(); } );
+    m_sleepers.fetch_sub( 1, std::memory_order_relaxed );
+}
+
+// Works through [begin, end) grain by grain. Whenever the thread's own queue has run
+// dry, the second half of what is left is handed off for others to steal.
+void JobSystem::ParallelForRange( uint32_t begin, uint32_t end, uint32_t grain, const std::function<void( uint32_t, uint32_t )>& body, JobCounter& counter )
+{
+    Worker* pWorker = GetCurrentWorker();
+    while (begin < end)
+    {
+        const bool starved = pWorker ? pWorker->deque.IsEmpty() : m_sharedCount.load( std::memory_order_relaxed ) == 0;
+        if (end - begin > grain && starved)
+        {
+            const uint32_t middle = begin + ( end - begin ) / 2;
+            Run( [this, middle, end, grain, &body, &counter] { ParallelForRange( middle, end, grain, body, counter ); }, &counter );
+            end = middle;
+            continue;
+        }
+
+        const uint32_t chunkEnd = end - begin > grain ? begin + grain : end;
+        body( begin, chunkEnd );
+        begin = chunkEnd;
+    }
+}
+
+void JobSystem::WorkerMain( Worker* pWorker, int processor )
+{
+    t_pWorker = pWorker;
+    Trace::SetThreadName( pWorker->name );
+    if (processor >= 0)
+    {
+        PinCurrentThread( processor );
+    }
+
+    for (;;)
+    {
+        const uint64_t epoch = m_epoch.load( std::memory_order_seq_cst );
+        if (Job* pJob = FindJob( pWorker, nullptr ))
+        {
+            Execute( pJob );
+        }
+        else if (m_stop.load( std::memory_order_acquire ))
+        {
+            return;
+        }
+        else
+        {
+            WaitForWork( epoch, [this] { return m_stop.load( std::memory_order_acquire ); } );
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// Tracks a group of jobs. Running a job with a counter adds one to it, and the job's
+// completion removes one; JobSystem::Wait() returns once it drops to zero. Jobs scheduled
+// with RunAfter() are held by their dependency's counter until then. The first exception
+// thrown by one of the counted jobs is kept and rethrown by Wait().
+//
+// A counter must outlive its jobs; waiting on it before it goes out of scope is enough.
+class JobCounter
+{
+public:
+    JobCounter() : m_pending( 0 ) {}
+
+    JobCounter( const JobCounter& ) = delete;
+    JobCounter& operator=( const JobCounter& ) = delete;
+
+    bool IsDone() const { return m_pending.load( std::memory_order_acquire ) == 0; }
+
+private:
+    friend class JobSystem;
+    struct Job;
+
+    std::atomic<uint32_t> m_pending;
+
+    // Guards everything below. Also held while the count drops to zero, so that a waiter
+    // that sees zero and locks it knows the finishing job is done with the counter.
+    std::mutex m_mutex;
+    std::vector<Job*> m_continuations;
+    std::exception_ptr m_error;
+};
+
+// Work-stealing job scheduler. Each worker owns a Chase-Lev deque: it pushes and pops
+// jobs at the bottom, and idle workers steal from the top of a random victim. Jobs
+// submitted from threads outside the pool go through a shared queue instead. Threads
+// that Wait() run jobs while they wait, so waiting inside a job does not deadlock; a
+// thread outside the pool only runs the jobs it waits for.
+// Long-running work (shader compiles, pipeline builds) goes through a separate
+// background queue, which only idle workers take from, so that a frame's ParallelFor()
+// never picks up a compile while it waits for its own chunks.
+//
+// Only depends on the standard library (plus the OS call for pinning), so it can be
+// built and stress-tested outside the app.
+class JobSystem
+{
+public:
+    // workerCount == 0 picks one worker per hardware thread, minus the calling thread.
+    // Pinned workers get one physical core each, skipping the first (left to the caller);
+    // workers beyond the number of cores are left unpinned.
+    explicit JobSystem( uint32_t workerCount = 0, bool pinToPhysicalCores = false );
+    ~JobSystem();
+
+    JobSystem( const JobSystem& ) = delete;
+    JobSystem& operator=( const JobSystem& ) = delete;
+
+    void Run( std::function<void()> work, JobCounter* pCounter = nullptr );
+
+    // Queues a job that only idle workers run, after every other queued job. A thread in
+    // Wait() only takes the background jobs counted by the counter it waits on, so waiting
+    // for them still makes progress without workers. Jobs a background job runs in turn
+    // are ordinary jobs.
+    void RunBackground( std::function<void()> work, JobCounter* pCounter = nullptr );
+
+    // Runs the job once every job counted by dependency has finished. If one of them
+    // failed, the job is skipped and counts as failed with the same exception.
+    void RunAfter( JobCounter& dependency, std::function<void()> work, JobCounter* pCounter = nullptr );
+
+    // Runs other jobs until the counter reaches zero, then rethrows the first exception
+    // of its jobs (clearing it, so the counter can be reused). Background jobs counted by
+    // other counters are left to the workers, as are all other jobs when the caller is not
+    // a worker (unless there are no workers).
+    void Wait( JobCounter& counter );
+
+    // Calls body( begin, end ) over [0, count) in chunks of at least minGrain items, and
+    // returns once all of them are done. Ranges are split lazily: a job only hands off
+    // half of what is left while its own deque is empty, i.e. while other threads are
+    // taking its work, so busy pools end up with fewer, larger chunks.
+    void ParallelFor( uint32_t count, const std::function<void( uint32_t, uint32_t )>& body, uint32_t minGrain = 1 );
+
+    uint32_t GetWorkerCount() const { return static_cast<uint32_t>( m_workers.size() ); }
+
+    // 1-based index of the worker running the calling thread, or 0 for other threads.
+    uint32_t GetCurrentWorkerIndex() const;
+
+private:
+    using Job = JobCounter::Job;
+    struct Worker;
+
+    Worker* GetCurrentWorker() const;
+    void Submit( Job* pJob );
+    // pWaitCounter is the counter the thread is waiting on, or null for an idle worker.
+    Job* FindJob( Worker* pWorker, const JobCounter* pWaitCounter );
+    Job* FindBackgroundJob( const JobCounter* pWaitCounter );
+    void Execute( Job* pJob );
+    void Finish( Job* pJob, std::exception_ptr error );
+    void WaitForWork( uint64_t seenEpoch, const std::function<bool()>& wake );
+    void WakeSleepers( bool all );
+    void ParallelForRange( uint32_t begin, uint32_t end, uint32_t grain, const std::function<void( uint32_t, uint32_t )>& body, JobCounter& counter );
+    void WorkerMain( Worker* pWorker, int processor );
+
+    static thread_local Worker* t_pWorker;
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<bool> m_stop;
+
+    // Jobs submitted from outside the pool.
+    std::mutex m_sharedMutex;
+    std::deque<Job*> m_shared;
+    std::atomic<uint32_t> m_sharedCount;
+
+    // Background jobs, oldest first.
+    std::mutex m_backgroundMutex;
+    std::deque<Job*> m_background;
+    std::atomic<uint32_t> m_backgroundCount;
+
+    // Idle threads sleep until the epoch changes; it is bumped whenever a job is queued
+    // or a counter reaches zero.
+    std::atomic<uint64_t> m_epoch;
+    std::atomic<uint32_t> m_sleepers;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bump allocator over a caller-owned block of memory. Allocations are never freed
+// individually; the whole arena is recycled with Reset(). Used for short-lived scratch
+// data (e.g. root signature conversion) that would otherwise hit the process heap.
+class LinearAllocator
+{
+public:
+    LinearAllocator( void* pMemory, size_t size )
+        : m_pBase( static_cast<uint8_t*>( pMemory ) ), m_size( size ), m_offset( 0 )
+    {
+    }
+
+    // Returns nullptr when the arena is exhausted.
+    void* Allocate( size_t size, size_t alignment = alignof( std::max_align_t ) )
+    {
+        const size_t aligned = ( m_offset + ( alignment - 1 ) ) & ~( alignment - 1 );
+        if (aligned > m_size || size > m_size - aligned)
+        {
+            return nullptr;
+        }
+
+        m_offset = aligned + size;
+        return m_pBase + aligned;
+    }
+
+    template <typename T>
+    T* Allocate( size_t count )
+    {
+        return static_cast<T*>( Allocate( sizeof( T ) * count, alignof( T ) ) );
+    }
+
+    void Reset() { m_offset = 0; }
+
+    // Accessors.
+    size_t GetUsed() const { return m_offset; }
+    size_t GetCapacity() const { return m_size; }
+
+private:
+    uint8_t* m_pBase;
+    size_t m_size;
+    size_t m_offset;
+};
+
+// Arena with inline storage, for scratch allocations on the stack.
+template <size_t Size>
+class StackArena : public LinearAllocator
+{
+public:
+    StackArena() : LinearAllocator( m_storage, Size ) {}
+
+    StackArena( const StackArena& ) = delete;
+    StackArena& operator=( const StackArena& ) = delete;
+
+private:
+    alignas( std::max_align_t ) uint8_t m_storage[Size];
+};
@@ -9,6 +9,33 @@ int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow )
    // be rendered in a DPI sensitive fashion.
     SetThreadDpiAwarenessContext( DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2 );
 
-    App sample( 1280, 720, L"D3D12 Hello Bundles" );
+    RuntimeConfig config;
+    try
+    {
+        config = RuntimeConfig::FromCommandLine( GetCommandLineW() );
+    }
+    catch (const std::invalid_argument& e)
+    {
+        MessageBoxA( nullptr, e.what(), "D3D12 Hello Bundles", MB_OK | MB_ICONERROR );
+        return EXIT_FAILURE;
+    }
+
+    App sample( config, L"D3D12 Hello Bundles" );
+
+    if (!config.precompileManifest.empty())
+    {
+        return sample.PrecompileShaders() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (config.cullingBenchmarkCount != 0)
+    {
+        return sample.BenchmarkCulling() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (config.transformBenchmarkCount != 0)
+    {
+        return sample.BenchmarkTransforms() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     return Window::Run( &sample, hInstance, nCmdShow );
 }
\ No newline at end of file
@@ -0,0 +1,518 @@
+// Compiled without the precompiled header so that the rasterizer can be tested against
+// golden depth buffers on Linux.
+#include "OcclusionCulling.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+
+#include <emmintrin.h>
+
+namespace
+{
+    // Candidates per parallel test chunk.
+    const uint32_t ChunkSize = 4096;
+
+    // Largest region refined to the next pyramid level before giving up and calling the
+    // volume visible.
+    const uint32_t MaxRefineTexels = 64;
+
+    // Clip-space w below which a box corner counts as crossing the near plane.
+    const float MinClipW = 1e-5f;
+
+    void TransformPoint( const float m[4][4], float x, float y, float z, float clip[4] )
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            clip[j] = x * m[0][j] + y * m[1][j] + z * m[2][j] + m[3][j];
+        }
+    }
+
+    // Calls isVisible( index ) for each candidate across the job system, and compacts the
+    // visible ones in order.
+    template <typename IsVisible>
+    void CullCandidates( JobSystem& jobs, const std::vector<uint32_t>& candidates, std::vector<uint32_t>& visible, IsVisible isVisible )
+    {
+        const uint32_t count = static_cast<uint32_t>( candidates.size() );
+        const uint32_t chunkCount = ( count + ChunkSize - 1 ) / ChunkSize;
+        std::vector<uint32_t> chunkVisible( chunkCount );
+
+        visible.resize( count );
+        uint32_t* pVisible = visible.data();
+        const uint32_t* pCandidates = candidates.data();
+        jobs.ParallelFor( chunkCount, [&]( uint32_t begin, uint32_t end )
+        {
+            for (uint32_t chunk = begin; chunk < end; chunk++)
+            {
+                const uint32_t first = chunk * ChunkSize;
+                const uint32_t last = std::min( first + ChunkSize, count );
+                uint32_t visibleCount = 0;
+                for (uint32_t i = first; i < last; i++)
+                {
+                    if (isVisible( pCandidates[i] ))
+                    {
+                        pVisible[first + visibleCount++] = pCandidates[i];
+                    }
+                }
+                chunkVisible[chunk] = visibleCount;
+            }
+        } );
+
+        uint32_t total = 0;
+        for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+        {
+            if (total != chunk * ChunkSize)
+            {
+                std::copy( pVisible + chunk * ChunkSize, pVisible + chunk * ChunkSize + chunkVisible[chunk], pVisible + total );
+            }
+            total += chunkVisible[chunk];
+        }
+        visible.resize( total );
+    }
+}
+
+OcclusionBuffer::OcclusionBuffer( uint32_t width, uint32_t height )
+    : m_width( width ),
+    m_height( height ),
+    m_tilesX( width / TileWidth )
+{
+    if (width == 0 || height == 0 || width % TileWidth != 0 || height % TileHeight != 0)
+    {
+        throw std::invalid_argument( "Occlusion buffer size must be a non-zero multiple of the tile size" );
+    }
+
+    m_depth.resize( size_t( width ) * height );
+    m_bins.resize( m_tilesX * ( height / TileHeight ) );
+
+    Level level = { width, height, {}, {} };
+    m_levels.push_back( level );
+    while (level.width > 1 || level.height > 1)
+    {
+        level.width = ( level.width + 1 ) / 2;
+        level.height = ( level.height + 1 ) / 2;
+        level.minDepth.resize( size_t( level.width ) * level.height );
+        level.maxDepth.resize( size_t( level.width ) * level.height );
+        m_levels.push_back( level );
+    }
+    Clear();
+}
+
+void OcclusionBuffer::Clear()
+{
+    std::fill( m_depth.begin(), m_depth.end(), 1.0f );
+    m_triangles.clear();
+}
+
+void OcclusionBuffer::AddOccluder( const float objectToClip[4][4], const float* pPositions, uint32_t vertexCount, const uint16_t* pIndices, uint32_t triangleCount )
+{
+    // Project every vertex once: pixel x and y, and depth.
+    std::vector<float> screen( size_t( vertexCount ) * 3 );
+    std::vector<bool> inFront( vertexCount );
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        float clip[4];
+        TransformPoint( objectToClip, pPositions[v * 3], pPositions[v * 3 + 1], pPositions[v * 3 + 2], clip );
+        inFront[v] = clip[3] > MinClipW && clip[2] >= 0.0f;
+        if (inFront[v])
+        {
+            screen[v * 3] = ( clip[0] / clip[3] * 0.5f + 0.5f ) * m_width;
+            screen[v * 3 + 1] = ( 0.5f - clip[1] / clip[3] * 0.5f ) * m_height;
+            screen[v * 3 + 2] = clip[2] / clip[3];
+        }
+    }
+
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        uint32_t index[3] = { pIndices[t * 3], pIndices[t * 3 + 1], pIndices[t * 3 + 2] };
+        if (!inFront[index[0]] || !inFront[index[1]] || !inFront[index[2]])
+        {
+            continue;
+        }
+
+        // Both windings are rasterized: swap to make the area positive.
+        const float* p0 = &screen[index[0] * 3];
+        const float* p1 = &screen[index[1] * 3];
+        const float* p2 = &screen[index[2] * 3];
+        float area = ( p1[0] - p0[0] ) * ( p2[1] - p0[1] ) - ( p2[0] - p0[0] ) * ( p1[1] - p0[1] );
+        if (area < 0.0f)
+        {
+            std::swap( p1, p2 );
+            area = -area;
+        }
+        if (!( area > 0.0f ))
+        {
+            continue;
+        }
+
+        // Clamped before converting, since vertices close to the near plane project far
+        // outside the buffer.
+        const float minX = std::max( std::ceil( std::min( { p0[0], p1[0], p2[0] } ) - 0.5f ), 0.0f );
+        const float minY = std::max( std::ceil( std::min( { p0[1], p1[1], p2[1] } ) - 0.5f ), 0.0f );
+        const float maxX = std::min( std::floor( std::max( { p0[0], p1[0], p2[0] } ) - 0.5f ), m_width - 1.0f );
+        const float maxY = std::min( std::floor( std::max( { p0[1], p1[1], p2[1] } ) - 0.5f ), m_height - 1.0f );
+        if (!( minX <= maxX && minY <= maxY ))
+        {
+            continue;
+        }
+
+        Triangle triangle;
+        triangle.minX = static_cast<int32_t>( minX );
+        triangle.minY = static_cast<int32_t>( minY );
+        triangle.maxX = static_cast<int32_t>( maxX );
+        triangle.maxY = static_cast<int32_t>( maxY );
+
+        // Edge i runs from vertex i to vertex i + 1; the opposite vertex is on its
+        // positive side.
+        const float* corners[3] = { p0, p1, p2 };
+        for (int i = 0; i < 3; i++)
+        {
+            const float* a = corners[i];
+            const float* b = corners[( i + 1 ) % 3];
+            triangle.edgeA[i] = a[1] - b[1];
+            triangle.edgeB[i] = b[0] - a[0];
+            triangle.edgeC[i] = ( b[1] - a[1] ) * a[0] - ( b[0] - a[0] ) * a[1];
+        }
+
+        // Depth over the screen is linear after the perspective divide.
+        triangle.depthA = ( ( p1[2] - p0[2] ) * ( p2[1] - p0[1] ) - ( p2[2] - p0[2] ) * ( p1[1] - p0[1] ) ) / area;
+        triangle.depthB = ( ( p1[0] - p0[0] ) * ( p2[2] - p0[2] ) - ( p2[0] - p0[0] ) * ( p1[2] - p0[2] ) ) / area;
+        triangle.depthC = p0[2] - triangle.depthA * p0[0] - triangle.depthB * p0[1];
+        m_triangles.push_back( triangle );
+    }
+}
+
+void OcclusionBuffer::Rasterize( JobSystem& jobs )
+{
+    for (auto& bin : m_bins)
+    {
+        bin.clear();
+    }
+    for (uint32_t t = 0; t < m_triangles.size(); t++)
+    {
+        const Triangle& triangle = m_triangles[t];
+        for (int32_t tileY = triangle.minY / TileHeight; tileY <= triangle.maxY / static_cast<int32_t>( TileHeight ); tileY++)
+        {
+            for (int32_t tileX = triangle.minX / TileWidth; tileX <= triangle.maxX / static_cast<int32_t>( TileWidth ); tileX++)
+            {
+                m_bins[tileY * m_tilesX + tileX].push_back( t );
+            }
+        }
+    }
+
+    jobs.ParallelFor( static_cast<uint32_t>( m_bins.size() ), [this]( uint32_t begin, uint32_t end )
+    {
+        for (uint32_t tile = begin; tile < end; tile++)
+        {
+            RasterizeTile( tile );
+        }
+    } );
+    BuildHierarchy();
+}
+
+// Four pixels of a row per iteration. Tiles start on multiples of four, so the blocks
+// never straddle two tiles; lanes outside the triangle's bounding box are masked off, so
+// the result matches the per-pixel reference exactly.
+void OcclusionBuffer::RasterizeTile( uint32_t tile )
+{
+    const int32_t tileMinX = ( tile % m_tilesX ) * TileWidth;
+    const int32_t tileMinY = ( tile / m_tilesX ) * TileHeight;
+    const int32_t tileMaxX = tileMinX + TileWidth - 1;
+    const int32_t tileMaxY = tileMinY + TileHeight - 1;
+    const __m128 laneOffsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+    const __m128 zero = _mm_setzero_ps();
+
+    for (uint32_t t : m_bins[tile])
+    {
+        const Triangle& triangle = m_triangles[t];
+        const int32_t minX = std::max( triangle.minX, tileMinX );
+        const int32_t maxX = std::min( triangle.maxX, tileMaxX );
+        const int32_t minY = std::max( triangle.minY, tileMinY );
+        const int32_t maxY = std::min( triangle.maxY, tileMaxY );
+
+        const __m128 boxMinX = _mm_set1_ps( minX + 0.5f );
+        const __m128 boxMaxX = _mm_set1_ps( maxX + 0.5f );
+        __m128 edgeA[3];
+        __m128 edgeB[3];
+        __m128 edgeC[3];
+        for (int i = 0; i < 3; i++)
+        {
+            edgeA[i] = _mm_set1_ps( triangle.edgeA[i] );
+            edgeB[i] = _mm_set1_ps( triangle.edgeB[i] );
+            edgeC[i] = _mm_set1_ps( triangle.edgeC[i] );
+        }
+        const __m128 depthA = _mm_set1_ps( triangle.depthA );
+        const __m128 depthB = _mm_set1_ps( triangle.depthB );
+        const __m128 depthC = _mm_set1_ps( triangle.depthC );
+
+        for (int32_t y = minY; y <= maxY; y++)
+        {
+            const __m128 pixelY = _mm_set1_ps( y + 0.5f );
+            float* pRow = &m_depth[size_t( y ) * m_width];
+            for (int32_t x = minX & ~3; x <= maxX; x += 4)
+            {
+                const __m128 pixelX = _mm_add_ps( _mm_set1_ps( static_cast<float>( x ) ), laneOffsets );
+                __m128 inside = _mm_and_ps( _mm_cmpge_ps( pixelX, boxMinX ), _mm_cmple_ps( pixelX, boxMaxX ) );
+                for (int i = 0; i < 3; i++)
+                {
+                    const __m128 edge = _mm_add_ps( _mm_add_ps( _mm_mul_ps( edgeA[i], pixelX ), _mm_mul_ps( edgeB[i], pixelY ) ), edgeC[i] );
+                    inside = _mm_and_ps( inside, _mm_cmpge_ps( edge, zero ) );
+                }
+                if (_mm_movemask_ps( inside ) == 0)
+                {
+                    continue;
+                }
+
+                const __m128 depth = _mm_add_ps( _mm_add_ps( _mm_mul_ps( depthA, pixelX ), _mm_mul_ps( depthB, pixelY ) ), depthC );
+                const __m128 previous = _mm_loadu_ps( pRow + x );
+                const __m128 nearest = _mm_min_ps( previous, depth );
+                _mm_storeu_ps( pRow + x, _mm_or_ps( _mm_and_ps( inside, nearest ), _mm_andnot_ps( inside, previous ) ) );
+            }
+        }
+    }
+}
+
+void OcclusionBuffer::RasterizeReference()
+{
+    for (const Triangle& triangle : m_triangles)
+    {
+        for (int32_t y = triangle.minY; y <= triangle.maxY; y++)
+        {
+            const float pixelY = y + 0.5f;
+            for (int32_t x = triangle.minX; x <= triangle.maxX; x++)
+            {
+                const float pixelX = x + 0.5f;
+                bool inside = true;
+                for (int i = 0; i < 3; i++)
+                {
+                    inside = inside && triangle.edgeA[i] * pixelX + triangle.edgeB[i] * pixelY + triangle.edgeC[i] >= 0.0f;
+                }
+                if (inside)
+                {
+                    const float depth = triangle.depthA * pixelX + triangle.depthB * pixelY + triangle.depthC;
+                    float& previous = m_depth[size_t( y ) * m_width + x];
+                    previous = previous < depth ? previous : depth;
+                }
+            }
+        }
+    }
+    BuildHierarchy();
+}
+
+// Each texel covers up to 2x2 texels of the level below; at odd sizes the last row and
+// column cover one.
+void OcclusionBuffer::BuildHierarchy()
+{
+    for (size_t l = 1; l < m_levels.size(); l++)
+    {
+        const uint32_t sourceWidth = m_levels[l - 1].width;
+        const uint32_t sourceHeight = m_levels[l - 1].height;
+        const float* pSourceMin = GetMinDepth( static_cast<uint32_t>( l - 1 ) );
+        const float* pSourceMax = GetMaxDepth( static_cast<uint32_t>( l - 1 ) );
+        Level& level = m_levels[l];
+        for (uint32_t y = 0; y < level.height; y++)
+        {
+            const uint32_t y0 = y * 2;
+            const uint32_t y1 = std::min( y0 + 1, sourceHeight - 1 );
+            for (uint32_t x = 0; x < level.width; x++)
+            {
+                const uint32_t x0 = x * 2;
+                const uint32_t x1 = std::min( x0 + 1, sourceWidth - 1 );
+                level.minDepth[y * level.width + x] = std::min(
+                    std::min( pSourceMin[y0 * sourceWidth + x0], pSourceMin[y0 * sourceWidth + x1] ),
+                    std::min( pSourceMin[y1 * sourceWidth + x0], pSourceMin[y1 * sourceWidth + x1] ) );
+                level.maxDepth[y * level.width + x] = std::max(
+                    std::max( pSourceMax[y0 * sourceWidth + x0], pSourceMax[y0 * sourceWidth + x1] ),
+                    std::max( pSourceMax[y1 * sourceWidth + x0], pSourceMax[y1 * sourceWidth + x1] ) );
+            }
+        }
+    }
+}
+
+bool OcclusionBuffer::IsBoxVisible( const float viewProjection[4][4], float centerX, float centerY, float centerZ, float extentX, float extentY, float extentZ ) const
+{
+    float minX = INFINITY;
+    float minY = INFINITY;
+    float maxX = -INFINITY;
+    float maxY = -INFINITY;
+    float nearestDepth = INFINITY;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        float clip[4];
+        TransformPoint( viewProjection,
+            centerX + ( corner & 1 ? extentX : -extentX ),
+            centerY + ( corner & 2 ? extentY : -extentY ),
+            centerZ + ( corner & 4 ? extentZ : -extentZ ), clip );
+        if (clip[3] <= MinClipW || clip[2] < 0.0f)
+        {
+            return true;
+        }
+
+        const float x = ( clip[0] / clip[3] * 0.5f + 0.5f ) * m_width;
+        const float y = ( 0.5f - clip[1] / clip[3] * 0.5f ) * m_height;
+        minX = std::min( minX, x );
+        maxX = std::max( maxX, x );
+        minY = std::min( minY, y );
+        maxY = std::max( maxY, y );
+        nearestDepth = std::min( nearestDepth, clip[2] / clip[3] );
+    }
+
+    // Off screen is frustum culling's business.
+    if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height)
+    {
+        return true;
+    }
+
+    // Every pixel the box's footprint touches, not only those whose centres it covers.
+    return IsRectVisible(
+        static_cast<int32_t>( std::max( minX, 0.0f ) ),
+        static_cast<int32_t>( std::max( minY, 0.0f ) ),
+        static_cast<int32_t>( std::min( maxX, m_width - 1.0f ) ),
+        static_cast<int32_t>( std::min( maxY, m_height - 1.0f ) ),
+        nearestDepth );
+}
+
+// Starts at the finest level where the rectangle covers at most 2x2 texels and refines
+// while the answer is unclear: occluded if the volume is behind the farthest occluder
+// depth in the rectangle, visible if it is in front of the nearest.
+bool OcclusionBuffer::IsRectVisible( int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, float nearestDepth ) const
+{
+    uint32_t level = 0;
+    while (( maxX >> level ) - ( minX >> level ) > 1 || ( maxY >> level ) - ( minY >> level ) > 1)
+    {
+        level++;
+    }
+
+    for (;;)
+    {
+        const uint32_t width = m_levels[level].width;
+        const float* pMin = GetMinDepth( level );
+        const float* pMax = GetMaxDepth( level );
+        float nearest = INFINITY;
+        float farthest = -INFINITY;
+        for (int32_t y = minY >> level; y <= maxY >> level; y++)
+        {
+            for (int32_t x = minX >> level; x <= maxX >> level; x++)
+            {
+                nearest = std::min( nearest, pMin[y * width + x] );
+                farthest = std::max( farthest, pMax[y * width + x] );
+            }
+        }
+
+        if (nearestDepth > farthest)
+        {
+            return false;
+        }
+        if (nearestDepth <= nearest || level == 0)
+        {
+            return true;
+        }
+
+        level--;
+        const uint32_t texels = uint32_t( ( maxX >> level ) - ( minX >> level ) + 1 ) * uint32_t( ( maxY >> level ) - ( minY >> level ) + 1 );
+        if (texels > MaxRefineTexels)
+        {
+            return true;
+        }
+    }
+}
+
+void OcclusionBuffer::CullBoxes( JobSystem& jobs, const float viewProjection[4][4], const BoxBounds& bounds, const std::vector<uint32_t>& candidates, std::vector<uint32_t>& visible ) const
+{
+    CullCandidates( jobs, candidates, visible, [&]( uint32_t i )
+    {
+        return IsBoxVisible( viewProjection, bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i] );
+    } );
+}
+
+void OcclusionBuffer::CullSpheres( JobSystem& jobs, const float viewProjection[4][4], const SphereBounds& bounds, const std::vector<uint32_t>& candidates, std::vector<uint32_t>& visible ) const
+{
+    CullCandidates( jobs, candidates, visible, [&]( uint32_t i )
+    {
+        const float r = bounds.radius[i];
+        return IsBoxVisible( viewProjection, bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], r, r, r );
+    } );
+}
+
+std::string BenchmarkOcclusion( JobSystem& jobs, uint32_t count, bool& resultsMatch )
+{
+    using Clock = std::chrono::steady_clock;
+    const int Runs = 10;
+
+    // The culling benchmark's camera: at the origin, looking down +z, 60 degrees vertically.
+    const float nearZ = 0.1f;
+    const float farZ = 100.0f;
+    const float yScale = 1.0f / std::tan( 3.14159265f / 6.0f );
+    const float xScale = yScale * 9.0f / 16.0f;
+    const float zScale = farZ / ( farZ - nearZ );
+    const float viewProjection[4][4] =
+    {
+        { xScale, 0.0f, 0.0f, 0.0f },
+        { 0.0f, yScale, 0.0f, 0.0f },
+        { 0.0f, 0.0f, zScale, 1.0f },
+        { 0.0f, 0.0f, -nearZ * zScale, 0.0f }
+    };
+
+    // Three walls, two triangles each, in front of boxes scattered further back.
+    static const float Walls[3][4] = { { -12.0f, 0.0f, 20.0f, 8.0f }, { 4.0f, -3.0f, 25.0f, 9.0f }, { 14.0f, 6.0f, 30.0f, 7.0f } };
+    static const uint16_t QuadIndices[] = { 0, 1, 2, 2, 1, 3 };
+
+    OcclusionBuffer reference( 256, 128 );
+    OcclusionBuffer buffer( 256, 128 );
+    auto addWalls = [&]( OcclusionBuffer& target )
+    {
+        target.Clear();
+        for (const float* wall : Walls)
+        {
+            const float x = wall[0], y = wall[1], z = wall[2], half = wall[3];
+            const float positions[] = { x - half, y + half, z, x + half, y + half, z, x - half, y - half, z, x + half, y - half, z };
+            target.AddOccluder( viewProjection, positions, 4, QuadIndices, 2 );
+        }
+    };
+
+    std::mt19937 random( 12345 );
+    std::uniform_real_distribution<float> position( -25.0f, 25.0f );
+    std::uniform_real_distribution<float> depth( 35.0f, 90.0f );
+    std::uniform_real_distribution<float> size( 0.5f, 2.0f );
+    BoxBounds boxes;
+    boxes.Resize( count );
+    std::vector<uint32_t> candidates( count );
+    for (uint32_t i = 0; i < count; i++)
+    {
+        boxes.Set( i, position( random ), position( random ), depth( random ), size( random ), size( random ), size( random ) );
+        candidates[i] = i;
+    }
+
+    auto time = [&]( auto work )
+    {
+        double bestMs = 0.0;
+        for (int run = 0; run <= Runs; run++)
+        {
+            const Clock::time_point start = Clock::now();
+            work();
+            const double ms = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+            bestMs = run == 1 ? ms : std::min( bestMs, ms );
+        }
+        return bestMs;
+    };
+
+    const double referenceMs = time( [&] { addWalls( reference ); reference.RasterizeReference(); } );
+    const double simdMs = time( [&] { addWalls( buffer ); buffer.Rasterize( jobs ); } );
+    resultsMatch = std::equal( reference.GetMinDepth( 0 ), reference.GetMinDepth( 0 ) + 256 * 128, buffer.GetMinDepth( 0 ) );
+
+    std::vector<uint32_t> visible;
+    const double testMs = time( [&] { buffer.CullBoxes( jobs, viewProjection, boxes, candidates, visible ); } );
+
+    std::string report;
+    char line[256];
+    snprintf( line, sizeof( line ), "Occlusion benchmark: %ux%u buffer, %u occluder triangles, %u boxes\n", buffer.GetWidth(), buffer.GetHeight(), buffer.GetTriangleCount(), count );
+    report += line;
+    snprintf( line, sizeof( line ), "raster   reference %8.3f ms   simd %8.3f ms%s\n", referenceMs, simdMs, resultsMatch ? "" : "   MISMATCH" );
+    report += line;
+    snprintf( line, sizeof( line ), "test     parallel %8.3f ms   occluded %u\n", testMs, count - static_cast<uint32_t>( visible.size() ) );
+    report += line;
+    return report;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "FrustumCulling.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// Software occlusion culling. Occluder triangles are rasterized on the CPU into a small
+// depth buffer, which is then reduced into min/max depth pyramids; bounding volumes are
+// projected onto the pyramids and rejected when they lie entirely behind the occluders.
+//
+// Depth follows D3D's convention, 0 at the near plane and 1 at the far plane, and each
+// pixel keeps its nearest occluder. A pixel is covered when its centre is. Matrices are
+// in DirectXMath's convention, as in Frustum::FromViewProjection().
+class OcclusionBuffer
+{
+public:
+    // Rasterization is split into tiles of this size, one job per tile.
+    static const uint32_t TileWidth = 32;
+    static const uint32_t TileHeight = 16;
+
+    // width and height must be multiples of the tile size.
+    OcclusionBuffer( uint32_t width, uint32_t height );
+
+    // Resets the depth to the far plane and drops the occluders.
+    void Clear();
+
+    // Adds occluder triangles: pPositions holds xyz per vertex, pIndices three vertex
+    // indices per triangle, and objectToClip takes the positions to clip space. Triangles
+    // that cross the near plane are dropped, which only makes the culling more conservative.
+    void AddOccluder( const float objectToClip[4][4], const float* pPositions, uint32_t vertexCount, const uint16_t* pIndices, uint32_t triangleCount );
+
+    // Rasterizes the occluders added since Clear() and rebuilds the pyramids. Rasterize()
+    // tests four pixels at a time with SSE, each tile as its own job; RasterizeReference()
+    // is the same per pixel on the calling thread, and produces the same depth.
+    void Rasterize( JobSystem& jobs );
+    void RasterizeReference();
+
+    // True unless the world-space box is entirely behind the occluders. Boxes crossing the
+    // near plane, or outside the view, are reported visible.
+    bool IsBoxVisible( const float viewProjection[4][4], float centerX, float centerY, float centerZ, float extentX, float extentY, float extentZ ) const;
+
+    // Tests the volumes listed in candidates (spheres by their bounding boxes) across the
+    // job system and replaces visible with those that are not occluded, in the same order.
+    void CullBoxes( JobSystem& jobs, const float viewProjection[4][4], const BoxBounds& bounds, const std::vector<uint32_t>& candidates, std::vector<uint32_t>& visible ) const;
+    void CullSpheres( JobSystem& jobs, const float viewProjection[4][4], const SphereBounds& bounds, const std::vector<uint32_t>& candidates, std::vector<uint32_t>& visible ) const;
+
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    uint32_t GetTriangleCount() const { return static_cast<uint32_t>( m_triangles.size() ); }
+
+    // Level 0 is the depth buffer itself, row-major; each further level halves the size
+    // (rounding up) and keeps the nearest and farthest depth of the texels it covers.
+    uint32_t GetLevelCount() const { return static_cast<uint32_t>( m_levels.size() ); }
+    uint32_t GetLevelWidth( uint32_t level ) const { return m_levels[level].width; }
+    uint32_t GetLevelHeight( uint32_t level ) const { return m_levels[level].height; }
+    const float* GetMinDepth( uint32_t level ) const { return level == 0 ? m_depth.data() : m_levels[level].minDepth.data(); }
+    const float* GetMaxDepth( uint32_t level ) const { return level == 0 ? m_depth.data() : m_levels[level].maxDepth.data(); }
+
+private:
+    // Edge functions and depth as planes over pixel coordinates: a pixel centre (x, y) is
+    // inside when edgeA[i] x + edgeB[i] y + edgeC[i] >= 0 for all three edges.
+    struct Triangle
+    {
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        float depthA;
+        float depthB;
+        float depthC;
+        int32_t minX;   // Pixels whose centres are in the bounding box, clamped to the buffer.
+        int32_t minY;
+        int32_t maxX;
+        int32_t maxY;
+    };
+
+    struct Level
+    {
+        uint32_t width;
+        uint32_t height;
+        std::vector<float> minDepth;
+        std::vector<float> maxDepth;
+    };
+
+    void RasterizeTile( uint32_t tile );
+    void BuildHierarchy();
+    bool IsRectVisible( int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, float nearestDepth ) const;
+
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_tilesX;
+    std::vector<float> m_depth;
+    std::vector<Level> m_levels;    // m_levels[0] only holds the size.
+    std::vector<Triangle> m_triangles;
+    std::vector<std::vector<uint32_t>> m_bins;  // Triangles overlapping each tile.
+};
+
+// Times occluder rasterization (reference and SIMD) and occlusion tests on count random
+// boxes behind a few occluder walls, and returns a report. resultsMatch is set if both
+// rasterizers produced the same depth.
+std::string BenchmarkOcclusion( JobSystem& jobs, uint32_t count, bool& resultsMatch );
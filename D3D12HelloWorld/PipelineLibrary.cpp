@@ -0,0 +1,133 @@
+#include "hwpch.h"
+#include "PipelineLibrary.h"
+
+#include <fstream>
+#include <iterator>
+
+PipelineLibrary::PipelineLibrary()
+    : m_dirty( false )
+{
+}
+
+void PipelineLibrary::Read( const std::wstring& path )
+{
+    std::ifstream file( path, std::ios::binary );
+    if (file)
+    {
+        m_serialized.assign( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() );
+    }
+}
+
+void PipelineLibrary::Open( ID3D12Device* pDevice )
+{
+    ThrowIfFailed( pDevice->QueryInterface( IID_PPV_ARGS( &m_Device ) ) );
+
+    // A library written by a different driver or adapter is rejected; start over.
+    HRESULT hr = E_FAIL;
+    if (!m_serialized.empty())
+    {
+        hr = m_Device->CreatePipelineLibrary( m_serialized.data(), m_serialized.size(), IID_PPV_ARGS( &m_Library ) );
+    }
+    if (FAILED( hr ))
+    {
+        m_serialized.clear();
+        if (FAILED( m_Device->CreatePipelineLibrary( nullptr, 0, IID_PPV_ARGS( &m_Library ) ) ))
+        {
+            // Unsupported (e.g. older drivers); every pipeline is compiled.
+            m_Library.Reset();
+        }
+    }
+}
+
+void PipelineLibrary::Save( const std::wstring& path )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    if (!m_Library || !m_dirty)
+    {
+        return;
+    }
+
+    std::vector<uint8_t> data( m_Library->GetSerializedSize() );
+    if (FAILED( m_Library->Serialize( data.data(), data.size() ) ))
+    {
+        return;
+    }
+
+    std::ofstream file( path, std::ios::binary | std::ios::trunc );
+    file.write( reinterpret_cast<const char*>( data.data() ), data.size() );
+    m_dirty = false;
+}
+
+Microsoft::WRL::ComPtr<ID3D12PipelineState> PipelineLibrary::GetOrCreate( uint64_t hash, const D3D12_PIPELINE_STATE_STREAM_DESC& desc )
+{
+    wchar_t name[17];
+    swprintf_s( name, L"%016llx", static_cast<unsigned long long>( hash ) );
+
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        if (m_Library && SUCCEEDED( m_Library->LoadPipeline( name, &desc, IID_PPV_ARGS( &pipelineState ) ) ))
+        {
+            m_pipelines[name] = pipelineState;
+            return pipelineState;
+        }
+    }
+
+    // Compile outside the lock so that pipelines can be created in parallel.
+    ThrowIfFailed( m_Device->CreatePipelineState( &desc, IID_PPV_ARGS( &pipelineState ) ) );
+
+    // Storing fails with E_INVALIDARG if the name is taken: either by another thread that
+    // created the same pipeline meanwhile, or by an entry whose description no longer
+    // matches (after a root signature change, say). Entries cannot be replaced, so the
+    // second case rebuilds the library.
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_pipelines[name] = pipelineState;
+    if (m_Library)
+    {
+        HRESULT hr = m_Library->StorePipeline( name, pipelineState.Get() );
+        if (hr == E_INVALIDARG)
+        {
+            Microsoft::WRL::ComPtr<ID3D12PipelineState> stored;
+            if (FAILED( m_Library->LoadPipeline( name, &desc, IID_PPV_ARGS( &stored ) ) ))
+            {
+                Rebuild();
+            }
+        }
+        else if (SUCCEEDED( hr ))
+        {
+            m_dirty = true;
+        }
+    }
+
+    return pipelineState;
+}
+
+void PipelineLibrary::Forget( ID3D12PipelineState* pPipelineState )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    for (auto it = m_pipelines.begin(); it != m_pipelines.end(); )
+    {
+        it = it->second.Get() == pPipelineState ? m_pipelines.erase( it ) : std::next( it );
+    }
+}
+
+// Start a new library holding only the pipelines of this run, which drops stale entries
+// along with the ones nothing uses any more. Called with m_mutex held.
+void PipelineLibrary::Rebuild()
+{
+    Microsoft::WRL::ComPtr<ID3D12PipelineLibrary1> library;
+    if (FAILED( m_Device->CreatePipelineLibrary( nullptr, 0, IID_PPV_ARGS( &library ) ) ))
+    {
+        return;
+    }
+
+    for (const auto& it : m_pipelines)
+    {
+        library->StorePipeline( it.first.c_str(), it.second.Get() );
+    }
+
+    // The old library no longer needs the memory it was created from.
+    m_Library = library;
+    m_serialized.clear();
+    m_dirty = true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Helpers.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Disk-backed PSO cache built on ID3D12PipelineLibrary1. Pipelines are stored under the
+// hex form of their stream hash (see PipelineStateStream.h), so a pipeline seen in a
+// previous run is loaded from the driver cache instead of being compiled again. Falls
+// back to plain creation when pipeline libraries are unsupported. Thread-safe.
+class PipelineLibrary
+{
+public:
+    PipelineLibrary();
+
+    // Reading the file does not need the device, so it can overlap device creation.
+    void Read( const std::wstring& path );
+    void Open( ID3D12Device* pDevice );
+    void Save( const std::wstring& path );
+
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> GetOrCreate( uint64_t hash, const D3D12_PIPELINE_STATE_STREAM_DESC& desc );
+
+    // Drops the library's reference to a pipeline the app has stopped using (replaced by a
+    // hot reload or another permutation). Its stored entry stays, so it loads again if asked
+    // for, but a rebuild no longer carries it over.
+    void Forget( ID3D12PipelineState* pPipelineState );
+
+private:
+    void Rebuild();
+
+    std::mutex m_mutex;
+    Microsoft::WRL::ComPtr<ID3D12Device2> m_Device;
+    Microsoft::WRL::ComPtr<ID3D12PipelineLibrary1> m_Library;
+
+    // The library references this memory for its whole lifetime.
+    std::vector<uint8_t> m_serialized;
+    bool m_dirty;
+
+    // The pipelines of this run still in use, by name, so that the library can be rebuilt
+    // when an entry goes stale.
+    std::unordered_map<std::wstring, Microsoft::WRL::ComPtr<ID3D12PipelineState>> m_pipelines;
+};
@@ -0,0 +1,307 @@
+#pragma once
+
+#include "Hash.h"
+
+#include <d3d12.h>
+#include <type_traits>
+
+// Compile-time pipeline state stream builder.
+//
+// MakePipelineStateStream() packs only the subobjects a pipeline actually sets into a
+// tightly laid out stream for ID3D12Device2::CreatePipelineState. Every subobject is
+// pointer-aligned, which is the layout the runtime expects, so streams can also be
+// nested: a constexpr stream of fixed-function state can be embedded in a stream that
+// adds the root signature and shaders at runtime.
+//
+// Unlike the CD3DX12_PIPELINE_STATE_STREAM_* helpers, subobjects here are constexpr-
+// constructible, so the hash of constant state can be folded by the compiler:
+//
+//     constexpr auto FixedState = MakePipelineStateStream( PsoRasterizer( DefaultRasterizerDesc ), ... );
+//     constexpr uint64_t FixedStateHash = FixedState.ConstantHash();
+//     uint64_t key = MakePipelineStateStream( PsoVS( vs ), ..., FixedState ).RuntimeHash( FixedStateHash );
+
+namespace PipelineStreamDetail
+{
+    // Exact, constexpr-friendly key for a finite float (no bit casts in constant expressions).
+    constexpr uint64_t FloatKey( float value )
+    {
+        if (value == 0.0f)
+        {
+            return 0;
+        }
+
+        const uint64_t sign = value < 0.0f ? 1 : 0;
+        double magnitude = value < 0.0f ? -static_cast<double>( value ) : static_cast<double>( value );
+        int64_t exponent = 0;
+        while (magnitude >= 2.0)
+        {
+            magnitude *= 0.5;
+            exponent++;
+        }
+        while (magnitude < 1.0)
+        {
+            magnitude *= 2.0;
+            exponent--;
+        }
+        const uint64_t mantissa = static_cast<uint64_t>( ( magnitude - 1.0 ) * static_cast<double>( 1ull << 52 ) );
+        return ( sign << 63 ) ^ ( static_cast<uint64_t>( exponent + 2048 ) << 52 ) ^ mantissa;
+    }
+
+    template <typename T>
+    constexpr typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, uint64_t>::type
+    HashValue( uint64_t seed, T value )
+    {
+        return HashCombine( seed, static_cast<uint64_t>( value ) );
+    }
+
+    constexpr uint64_t HashValue( uint64_t seed, const DXGI_SAMPLE_DESC& desc )
+    {
+        return HashCombine( HashCombine( seed, desc.Count ), desc.Quality );
+    }
+
+    constexpr uint64_t HashValue( uint64_t seed, const D3D12_RT_FORMAT_ARRAY& formats )
+    {
+        seed = HashCombine( seed, formats.NumRenderTargets );
+        for (UINT i = 0; i < formats.NumRenderTargets && i < 8; i++)
+        {
+            seed = HashCombine( seed, formats.RTFormats[i] );
+        }
+        return seed;
+    }
+
+    constexpr uint64_t HashValue( uint64_t seed, const D3D12_RASTERIZER_DESC& desc )
+    {
+        seed = HashCombine( seed, desc.FillMode );
+        seed = HashCombine( seed, desc.CullMode );
+        seed = HashCombine( seed, desc.FrontCounterClockwise );
+        seed = HashCombine( seed, static_cast<uint64_t>( desc.DepthBias ) );
+        seed = HashCombine( seed, FloatKey( desc.DepthBiasClamp ) );
+        seed = HashCombine( seed, FloatKey( desc.SlopeScaledDepthBias ) );
+        seed = HashCombine( seed, desc.DepthClipEnable );
+        seed = HashCombine( seed, desc.MultisampleEnable );
+        seed = HashCombine( seed, desc.AntialiasedLineEnable );
+        seed = HashCombine( seed, desc.ForcedSampleCount );
+        return HashCombine( seed, desc.ConservativeRaster );
+    }
+
+    constexpr uint64_t HashValue( uint64_t seed, const D3D12_RENDER_TARGET_BLEND_DESC& desc )
+    {
+        seed = HashCombine( seed, desc.BlendEnable );
+        seed = HashCombine( seed, desc.LogicOpEnable );
+        seed = HashCombine( seed, desc.SrcBlend );
+        seed = HashCombine( seed, desc.DestBlend );
+        seed = HashCombine( seed, desc.BlendOp );
+        seed = HashCombine( seed, desc.SrcBlendAlpha );
+        seed = HashCombine( seed, desc.DestBlendAlpha );
+        seed = HashCombine( seed, desc.BlendOpAlpha );
+        seed = HashCombine( seed, desc.LogicOp );
+        return HashCombine( seed, desc.RenderTargetWriteMask );
+    }
+
+    constexpr uint64_t HashValue( uint64_t seed, const D3D12_BLEND_DESC& desc )
+    {
+        seed = HashCombine( seed, desc.AlphaToCoverageEnable );
+        seed = HashCombine( seed, desc.IndependentBlendEnable );
+        const UINT count = desc.IndependentBlendEnable ? 8 : 1;
+        for (UINT i = 0; i < count; i++)
+        {
+            seed = HashValue( seed, desc.RenderTarget[i] );
+        }
+        return seed;
+    }
+
+    constexpr uint64_t HashValue( uint64_t seed, const D3D12_DEPTH_STENCILOP_DESC& desc )
+    {
+        seed = HashCombine( seed, desc.StencilFailOp );
+        seed = HashCombine( seed, desc.StencilDepthFailOp );
+        seed = HashCombine( seed, desc.StencilPassOp );
+        return HashCombine( seed, desc.StencilFunc );
+    }
+
+    constexpr uint64_t HashValue( uint64_t seed, const D3D12_DEPTH_STENCIL_DESC& desc )
+    {
+        seed = HashCombine( seed, desc.DepthEnable );
+        seed = HashCombine( seed, desc.DepthWriteMask );
+        seed = HashCombine( seed, desc.DepthFunc );
+        seed = HashCombine( seed, desc.StencilEnable );
+        seed = HashCombine( seed, desc.StencilReadMask );
+        seed = HashCombine( seed, desc.StencilWriteMask );
+        seed = HashValue( seed, desc.FrontFace );
+        return HashValue( seed, desc.BackFace );
+    }
+
+    // Subobjects that reference memory can only be hashed at runtime.
+    inline uint64_t HashValue( uint64_t seed, const D3D12_SHADER_BYTECODE& bytecode )
+    {
+        return HashBytes( bytecode.pShaderBytecode, bytecode.BytecodeLength, HashCombine( seed, bytecode.BytecodeLength ) );
+    }
+
+    inline uint64_t HashValue( uint64_t seed, const D3D12_INPUT_LAYOUT_DESC& layout )
+    {
+        seed = HashCombine( seed, layout.NumElements );
+        for (UINT i = 0; i < layout.NumElements; i++)
+        {
+            const D3D12_INPUT_ELEMENT_DESC& element = layout.pInputElementDescs[i];
+            seed = HashString( element.SemanticName, seed );
+            seed = HashCombine( seed, element.SemanticIndex );
+            seed = HashCombine( seed, element.Format );
+            seed = HashCombine( seed, element.InputSlot );
+            seed = HashCombine( seed, element.AlignedByteOffset );
+            seed = HashCombine( seed, element.InputSlotClass );
+            seed = HashCombine( seed, element.InstanceDataStepRate );
+        }
+        return seed;
+    }
+
+    // The root signature is identified by the caller (e.g. by its description hash passed
+    // as the seed); its address is not stable across runs.
+    inline uint64_t HashValue( uint64_t seed, ID3D12RootSignature* )
+    {
+        return seed;
+    }
+
+    template <typename T> struct IsRuntimeHashed : std::false_type {};
+    template <> struct IsRuntimeHashed<D3D12_SHADER_BYTECODE> : std::true_type {};
+    template <> struct IsRuntimeHashed<D3D12_INPUT_LAYOUT_DESC> : std::true_type {};
+    template <> struct IsRuntimeHashed<ID3D12RootSignature*> : std::true_type {};
+}
+
+template <typename Inner, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE Type>
+class alignas( void* ) PipelineStreamSubobject
+{
+public:
+    constexpr PipelineStreamSubobject( const Inner& inner ) : m_type( Type ), m_inner( inner ) {}
+
+    constexpr const Inner& Get() const { return m_inner; }
+
+    constexpr uint64_t ConstantHash( uint64_t seed ) const
+    {
+        if constexpr (PipelineStreamDetail::IsRuntimeHashed<Inner>::value)
+        {
+            return seed;
+        }
+        else
+        {
+            return PipelineStreamDetail::HashValue( HashCombine( seed, Type ), m_inner );
+        }
+    }
+
+    uint64_t RuntimeHash( uint64_t seed ) const
+    {
+        if constexpr (PipelineStreamDetail::IsRuntimeHashed<Inner>::value)
+        {
+            return PipelineStreamDetail::HashValue( HashCombine( seed, Type ), m_inner );
+        }
+        else
+        {
+            return seed;
+        }
+    }
+
+private:
+    D3D12_PIPELINE_STATE_SUBOBJECT_TYPE m_type;
+    Inner m_inner;
+};
+
+using PsoRootSignature = PipelineStreamSubobject<ID3D12RootSignature*, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_ROOT_SIGNATURE>;
+using PsoInputLayout = PipelineStreamSubobject<D3D12_INPUT_LAYOUT_DESC, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_INPUT_LAYOUT>;
+using PsoPrimitiveTopology = PipelineStreamSubobject<D3D12_PRIMITIVE_TOPOLOGY_TYPE, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PRIMITIVE_TOPOLOGY>;
+using PsoVS = PipelineStreamSubobject<D3D12_SHADER_BYTECODE, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_VS>;
+using PsoPS = PipelineStreamSubobject<D3D12_SHADER_BYTECODE, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_PS>;
+using PsoCS = PipelineStreamSubobject<D3D12_SHADER_BYTECODE, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_CS>;
+using PsoBlend = PipelineStreamSubobject<D3D12_BLEND_DESC, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_BLEND>;
+using PsoDepthStencil = PipelineStreamSubobject<D3D12_DEPTH_STENCIL_DESC, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL>;
+using PsoDepthStencilFormat = PipelineStreamSubobject<DXGI_FORMAT, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_DEPTH_STENCIL_FORMAT>;
+using PsoRasterizer = PipelineStreamSubobject<D3D12_RASTERIZER_DESC, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RASTERIZER>;
+using PsoRenderTargetFormats = PipelineStreamSubobject<D3D12_RT_FORMAT_ARRAY, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_RENDER_TARGET_FORMATS>;
+using PsoSampleDesc = PipelineStreamSubobject<DXGI_SAMPLE_DESC, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_DESC>;
+using PsoSampleMask = PipelineStreamSubobject<UINT, D3D12_PIPELINE_STATE_SUBOBJECT_TYPE_SAMPLE_MASK>;
+
+// constexpr equivalents of the CD3DX12_*_DESC( D3D12_DEFAULT ) states.
+constexpr D3D12_RASTERIZER_DESC DefaultRasterizerDesc =
+{
+    D3D12_FILL_MODE_SOLID, D3D12_CULL_MODE_BACK, FALSE,
+    D3D12_DEFAULT_DEPTH_BIAS, D3D12_DEFAULT_DEPTH_BIAS_CLAMP, D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS,
+    TRUE, FALSE, FALSE, 0, D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF
+};
+
+constexpr D3D12_RENDER_TARGET_BLEND_DESC DefaultRenderTargetBlendDesc =
+{
+    FALSE, FALSE,
+    D3D12_BLEND_ONE, D3D12_BLEND_ZERO, D3D12_BLEND_OP_ADD,
+    D3D12_BLEND_ONE, D3D12_BLEND_ZERO, D3D12_BLEND_OP_ADD,
+    D3D12_LOGIC_OP_NOOP, D3D12_COLOR_WRITE_ENABLE_ALL
+};
+
+constexpr D3D12_BLEND_DESC DefaultBlendDesc =
+{
+    FALSE, FALSE,
+    {
+        DefaultRenderTargetBlendDesc, DefaultRenderTargetBlendDesc, DefaultRenderTargetBlendDesc, DefaultRenderTargetBlendDesc,
+        DefaultRenderTargetBlendDesc, DefaultRenderTargetBlendDesc, DefaultRenderTargetBlendDesc, DefaultRenderTargetBlendDesc
+    }
+};
+
+constexpr D3D12_DEPTH_STENCIL_DESC DepthStencilDisabledDesc =
+{
+    FALSE, D3D12_DEPTH_WRITE_MASK_ZERO, D3D12_COMPARISON_FUNC_ALWAYS,
+    FALSE, D3D12_DEFAULT_STENCIL_READ_MASK, D3D12_DEFAULT_STENCIL_WRITE_MASK,
+    { D3D12_STENCIL_OP_KEEP, D3D12_STENCIL_OP_KEEP, D3D12_STENCIL_OP_KEEP, D3D12_COMPARISON_FUNC_ALWAYS },
+    { D3D12_STENCIL_OP_KEEP, D3D12_STENCIL_OP_KEEP, D3D12_STENCIL_OP_KEEP, D3D12_COMPARISON_FUNC_ALWAYS }
+};
+
+// Packed storage. There is deliberately no empty terminator: it would add a padded
+// member to the end of the stream.
+template <typename... Subobjects>
+struct PipelineStateStreamStorage;
+
+template <typename Last>
+struct PipelineStateStreamStorage<Last>
+{
+    constexpr PipelineStateStreamStorage( const Last& last ) : first( last ) {}
+
+    constexpr uint64_t ConstantHash( uint64_t seed ) const { return first.ConstantHash( seed ); }
+    uint64_t RuntimeHash( uint64_t seed ) const { return first.RuntimeHash( seed ); }
+
+    Last first;
+};
+
+template <typename First, typename Second, typename... Rest>
+struct PipelineStateStreamStorage<First, Second, Rest...>
+{
+    constexpr PipelineStateStreamStorage( const First& f, const Second& s, const Rest&... r ) : first( f ), rest( s, r... ) {}
+
+    constexpr uint64_t ConstantHash( uint64_t seed ) const { return rest.ConstantHash( first.ConstantHash( seed ) ); }
+    uint64_t RuntimeHash( uint64_t seed ) const { return rest.RuntimeHash( first.RuntimeHash( seed ) ); }
+
+    First first;
+    PipelineStateStreamStorage<Second, Rest...> rest;
+};
+
+template <typename... Subobjects>
+class alignas( void* ) PipelineStateStream
+{
+public:
+    static_assert( sizeof...( Subobjects ) > 0, "A pipeline state stream needs at least one subobject." );
+
+    constexpr PipelineStateStream( const Subobjects&... subobjects ) : m_storage( subobjects... ) {}
+
+    // Hash of the subobjects whose values are known at compile time.
+    constexpr uint64_t ConstantHash( uint64_t seed = FnvOffsetBasis ) const { return m_storage.ConstantHash( seed ); }
+
+    // Hash of the subobjects that reference runtime data (shaders, input layouts).
+    uint64_t RuntimeHash( uint64_t seed ) const { return m_storage.RuntimeHash( seed ); }
+
+    uint64_t Hash( uint64_t seed = FnvOffsetBasis ) const { return RuntimeHash( ConstantHash( seed ) ); }
+
+    D3D12_PIPELINE_STATE_STREAM_DESC GetDesc() { return { sizeof( m_storage ), &m_storage }; }
+
+private:
+    PipelineStateStreamStorage<Subobjects...> m_storage;
+};
+
+template <typename... Subobjects>
+constexpr PipelineStateStream<Subobjects...> MakePipelineStateStream( const Subobjects&... subobjects )
+{
+    return PipelineStateStream<Subobjects...>( subobjects... );
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+// The back-pressure side of a swap chain: how many presented frames may be queued ahead
+// of the display, and a way to wait for room in that queue. Frame pacing is written
+// against this so it can run on a real swap chain or a simulated one.
+//
+// Each successful WaitForFrame() must be followed by exactly one Present() of the frame
+// it admitted; the queue hands out as many admissions as the maximum frame latency and
+// gets one back each time a presented frame leaves the queue. A frame whose wait timed
+// out must not be presented; presenting it anyway lets one more frame through from then on.
+class PresentQueue
+{
+public:
+    virtual ~PresentQueue() = default;
+
+    // Lowering the latency takes effect as queued frames drain.
+    virtual void SetMaximumFrameLatency( uint32_t frames ) = 0;
+    virtual uint32_t GetMaximumFrameLatency() const = 0;
+
+    // Blocks until another frame may be started. Returns false on timeout.
+    virtual bool WaitForFrame( uint32_t timeoutMs ) = 0;
+};
@@ -0,0 +1,293 @@
+#include "hwpch.h"
+#include "RootSignatureCache.h"
+#include "Hash.h"
+
+#include <fstream>
+
+_Use_decl_annotations_
+HRESULT SerializeVersionedRootSignature(
+    const D3D12_VERSIONED_ROOT_SIGNATURE_DESC* pRootSignatureDesc,
+    D3D_ROOT_SIGNATURE_VERSION MaxVersion,
+    LinearAllocator& arena,
+    ID3DBlob** ppBlob,
+    ID3DBlob** ppErrorBlob )
+{
+    if (MaxVersion != D3D_ROOT_SIGNATURE_VERSION_1_0 || pRootSignatureDesc->Version != D3D_ROOT_SIGNATURE_VERSION_1_1)
+    {
+        // No conversion needed; the d3dx12 helper does not allocate on these paths.
+        return D3DX12SerializeVersionedRootSignature( pRootSignatureDesc, MaxVersion, ppBlob, ppErrorBlob );
+    }
+
+    if (ppErrorBlob != nullptr)
+    {
+        *ppErrorBlob = nullptr;
+    }
+
+    const D3D12_ROOT_SIGNATURE_DESC1& desc_1_1 = pRootSignatureDesc->Desc_1_1;
+
+    // Everything allocated below is released in one step when the caller rewinds the arena.
+    D3D12_ROOT_PARAMETER* pParameters_1_0 = arena.Allocate<D3D12_ROOT_PARAMETER>( desc_1_1.NumParameters );
+    if (desc_1_1.NumParameters > 0 && pParameters_1_0 == nullptr)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    for (UINT n = 0; n < desc_1_1.NumParameters; n++)
+    {
+        const D3D12_ROOT_PARAMETER1& param_1_1 = desc_1_1.pParameters[n];
+        D3D12_ROOT_PARAMETER& param_1_0 = pParameters_1_0[n];
+        param_1_0.ParameterType = param_1_1.ParameterType;
+        param_1_0.ShaderVisibility = param_1_1.ShaderVisibility;
+
+        switch (param_1_1.ParameterType)
+        {
+            case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+                param_1_0.Constants = param_1_1.Constants;
+                break;
+
+            case D3D12_ROOT_PARAMETER_TYPE_CBV:
+            case D3D12_ROOT_PARAMETER_TYPE_SRV:
+            case D3D12_ROOT_PARAMETER_TYPE_UAV:
+                param_1_0.Descriptor.RegisterSpace = param_1_1.Descriptor.RegisterSpace;
+                param_1_0.Descriptor.ShaderRegister = param_1_1.Descriptor.ShaderRegister;
+                break;
+
+            case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+            {
+                const D3D12_ROOT_DESCRIPTOR_TABLE1& table_1_1 = param_1_1.DescriptorTable;
+
+                D3D12_DESCRIPTOR_RANGE* pRanges_1_0 = arena.Allocate<D3D12_DESCRIPTOR_RANGE>( table_1_1.NumDescriptorRanges );
+                if (table_1_1.NumDescriptorRanges > 0 && pRanges_1_0 == nullptr)
+                {
+                    return E_OUTOFMEMORY;
+                }
+
+                for (UINT x = 0; x < table_1_1.NumDescriptorRanges; x++)
+                {
+                    pRanges_1_0[x].BaseShaderRegister = table_1_1.pDescriptorRanges[x].BaseShaderRegister;
+                    pRanges_1_0[x].NumDescriptors = table_1_1.pDescriptorRanges[x].NumDescriptors;
+                    pRanges_1_0[x].OffsetInDescriptorsFromTableStart = table_1_1.pDescriptorRanges[x].OffsetInDescriptorsFromTableStart;
+                    pRanges_1_0[x].RangeType = table_1_1.pDescriptorRanges[x].RangeType;
+                    pRanges_1_0[x].RegisterSpace = table_1_1.pDescriptorRanges[x].RegisterSpace;
+                }
+
+                param_1_0.DescriptorTable.NumDescriptorRanges = table_1_1.NumDescriptorRanges;
+                param_1_0.DescriptorTable.pDescriptorRanges = pRanges_1_0;
+                break;
+            }
+        }
+    }
+
+    CD3DX12_ROOT_SIGNATURE_DESC desc_1_0( desc_1_1.NumParameters, pParameters_1_0, desc_1_1.NumStaticSamplers, desc_1_1.pStaticSamplers, desc_1_1.Flags );
+    return D3D12SerializeRootSignature( &desc_1_0, D3D_ROOT_SIGNATURE_VERSION_1, ppBlob, ppErrorBlob );
+}
+
+namespace
+{
+    template <typename T>
+    void Append( std::vector<uint8_t>& bytes, const T* pValues, size_t count )
+    {
+        const uint8_t* pBytes = reinterpret_cast<const uint8_t*>( pValues );
+        bytes.insert( bytes.end(), pBytes, pBytes + sizeof( T ) * count );
+    }
+
+    template <typename T>
+    void Append( std::vector<uint8_t>& bytes, const T& value )
+    {
+        Append( bytes, &value, 1 );
+    }
+
+    // Same layout for 1.0 and 1.1 descriptions; only the range and descriptor types differ.
+    template <typename Desc>
+    void AppendDesc( std::vector<uint8_t>& bytes, const Desc& d )
+    {
+        Append( bytes, d.Flags );
+        Append( bytes, d.NumParameters );
+        for (UINT n = 0; n < d.NumParameters; n++)
+        {
+            const auto& p = d.pParameters[n];
+            Append( bytes, p.ParameterType );
+            Append( bytes, p.ShaderVisibility );
+            if (p.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
+            {
+                Append( bytes, p.DescriptorTable.NumDescriptorRanges );
+                Append( bytes, p.DescriptorTable.pDescriptorRanges, p.DescriptorTable.NumDescriptorRanges );
+            }
+            else if (p.ParameterType == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+            {
+                Append( bytes, p.Constants );
+            }
+            else
+            {
+                Append( bytes, p.Descriptor );
+            }
+        }
+        Append( bytes, d.NumStaticSamplers );
+        Append( bytes, d.pStaticSamplers, d.NumStaticSamplers );
+    }
+}
+
+std::vector<uint8_t> FlattenRootSignatureDesc( const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc, D3D_ROOT_SIGNATURE_VERSION maxVersion )
+{
+    std::vector<uint8_t> bytes;
+    Append( bytes, desc.Version );
+    Append( bytes, maxVersion );
+    if (desc.Version == D3D_ROOT_SIGNATURE_VERSION_1_0)
+    {
+        AppendDesc( bytes, desc.Desc_1_0 );
+    }
+    else
+    {
+        AppendDesc( bytes, desc.Desc_1_1 );
+    }
+    return bytes;
+}
+
+uint64_t HashRootSignatureDesc( const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc, D3D_ROOT_SIGNATURE_VERSION maxVersion )
+{
+    const std::vector<uint8_t> bytes = FlattenRootSignatureDesc( desc, maxVersion );
+    return HashBytes( bytes.data(), bytes.size() );
+}
+
+RootSignatureCache::RootSignatureCache()
+    : m_scratchMemory( new uint8_t[ScratchSize] ),
+    m_scratch( m_scratchMemory.get(), ScratchSize ),
+    m_dirty( false )
+{
+}
+
+// Replace the cache with the blobs persisted by a previous run. A missing, malformed or
+// truncated file leaves the cache empty.
+void RootSignatureCache::Load( const std::wstring& path )
+{
+    m_entries.clear();
+
+    std::ifstream file( path, std::ios::binary | std::ios::ate );
+    if (!file)
+    {
+        return;
+    }
+    const uint64_t fileSize = static_cast<uint64_t>( file.tellg() );
+    file.seekg( 0 );
+
+    uint32_t header[3] = {};
+    file.read( reinterpret_cast<char*>( header ), sizeof( header ) );
+    if (!file || header[0] != FileMagic || header[1] != FileVersion)
+    {
+        return;
+    }
+
+    std::unordered_map<uint64_t, Entry> entries;
+    for (uint32_t i = 0; i < header[2]; i++)
+    {
+        uint64_t hash = 0;
+        uint32_t sizes[2] = {};    // Flattened description, then blob.
+        file.read( reinterpret_cast<char*>( &hash ), sizeof( hash ) );
+        file.read( reinterpret_cast<char*>( sizes ), sizeof( sizes ) );
+        if (!file)
+        {
+            return;
+        }
+
+        // The sizes come from the file, so bound them by what is left of it before allocating.
+        const uint64_t remaining = fileSize - static_cast<uint64_t>( file.tellg() );
+        if (sizes[1] == 0 || static_cast<uint64_t>( sizes[0] ) + sizes[1] > remaining)
+        {
+            return;
+        }
+
+        Entry entry;
+        entry.desc.resize( sizes[0] );
+        file.read( reinterpret_cast<char*>( entry.desc.data() ), sizes[0] );
+        ThrowIfFailed( D3DCreateBlob( sizes[1], &entry.blob ) );
+        file.read( static_cast<char*>( entry.blob->GetBufferPointer() ), sizes[1] );
+        if (!file || !entries.emplace( hash, std::move( entry ) ).second)
+        {
+            return;
+        }
+    }
+
+    m_entries.swap( entries );
+}
+
+void RootSignatureCache::Save( const std::wstring& path )
+{
+    if (!m_dirty)
+    {
+        return;
+    }
+
+    std::ofstream file( path, std::ios::binary | std::ios::trunc );
+    if (!file)
+    {
+        return;
+    }
+
+    const uint32_t header[3] = { FileMagic, FileVersion, static_cast<uint32_t>( m_entries.size() ) };
+    file.write( reinterpret_cast<const char*>( header ), sizeof( header ) );
+
+    for (const auto& it : m_entries)
+    {
+        const uint32_t sizes[2] = { static_cast<uint32_t>( it.second.desc.size() ), static_cast<uint32_t>( it.second.blob->GetBufferSize() ) };
+        file.write( reinterpret_cast<const char*>( &it.first ), sizeof( it.first ) );
+        file.write( reinterpret_cast<const char*>( sizes ), sizeof( sizes ) );
+        file.write( reinterpret_cast<const char*>( it.second.desc.data() ), sizes[0] );
+        file.write( static_cast<const char*>( it.second.blob->GetBufferPointer() ), sizes[1] );
+    }
+
+    m_dirty = false;
+}
+
+void RootSignatureCache::Serialize( const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc, D3D_ROOT_SIGNATURE_VERSION maxVersion )
+{
+    GetOrSerialize( desc, maxVersion );
+}
+
+ID3D12RootSignature* RootSignatureCache::GetOrCreate(
+    ID3D12Device* pDevice,
+    const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc,
+    D3D_ROOT_SIGNATURE_VERSION maxVersion )
+{
+    Entry& entry = GetOrSerialize( desc, maxVersion );
+    if (!entry.rootSignature)
+    {
+        ThrowIfFailed( pDevice->CreateRootSignature( 0, entry.blob->GetBufferPointer(), entry.blob->GetBufferSize(), IID_PPV_ARGS( &entry.rootSignature ) ) );
+    }
+
+    return entry.rootSignature.Get();
+}
+
+// Entries are keyed by hash, but matched on the flattened description: a different
+// description under the same hash moves on to the next free key.
+RootSignatureCache::Entry& RootSignatureCache::GetOrSerialize( const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc, D3D_ROOT_SIGNATURE_VERSION maxVersion )
+{
+    std::vector<uint8_t> flattened = FlattenRootSignatureDesc( desc, maxVersion );
+    uint64_t hash = HashBytes( flattened.data(), flattened.size() );
+    auto it = m_entries.find( hash );
+    while (it != m_entries.end() && it->second.desc != flattened)
+    {
+        it = m_entries.find( ++hash );
+    }
+    if (it != m_entries.end())
+    {
+        return it->second;
+    }
+
+    Entry& entry = m_entries[hash];
+    ComPtr<ID3DBlob> error;
+    HRESULT hr = SerializeVersionedRootSignature( &desc, maxVersion, m_scratch, &entry.blob, &error );
+    m_scratch.Reset();
+    if (FAILED( hr ))
+    {
+        if (error)
+        {
+            OutputDebugStringA( static_cast<const char*>( error->GetBufferPointer() ) );
+        }
+        m_entries.erase( hash );
+        ThrowIfFailed( hr );
+    }
+
+    entry.desc = std::move( flattened );
+    m_dirty = true;
+    return entry;
+}
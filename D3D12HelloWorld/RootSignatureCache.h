@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Helpers.h"
+#include "LinearAllocator.h"
+
+#include <unordered_map>
+#include <vector>
+
+// Same contract as D3DX12SerializeVersionedRootSignature, but the 1.1 -> 1.0 conversion
+// places its temporary parameter and descriptor range arrays in the given arena instead
+// of the process heap. Returns E_OUTOFMEMORY if the arena is too small.
+HRESULT SerializeVersionedRootSignature(
+    _In_ const D3D12_VERSIONED_ROOT_SIGNATURE_DESC* pRootSignatureDesc,
+    D3D_ROOT_SIGNATURE_VERSION MaxVersion,
+    LinearAllocator& arena,
+    _Outptr_ ID3DBlob** ppBlob,
+    _Always_( _Outptr_opt_result_maybenull_ ) ID3DBlob** ppErrorBlob );
+
+// Everything that affects the serialized form of a root signature, as bytes: descriptor
+// ranges and static samplers are inlined in place of their pointers.
+std::vector<uint8_t> FlattenRootSignatureDesc( const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc, D3D_ROOT_SIGNATURE_VERSION maxVersion );
+
+// Hash of the flattened description.
+uint64_t HashRootSignatureDesc( const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc, D3D_ROOT_SIGNATURE_VERSION maxVersion );
+
+// Serialized root signatures keyed by description hash. Identical descriptions share
+// one blob and one ID3D12RootSignature, and blobs are persisted to disk so that
+// subsequent runs skip serialization entirely. Each entry keeps its flattened description
+// too, so a hash collision cannot hand out the wrong blob. Not thread-safe; callers
+// serialize access.
+class RootSignatureCache
+{
+public:
+    RootSignatureCache();
+
+    void Load( const std::wstring& path );
+    void Save( const std::wstring& path );
+
+    // Serialize without creating the device object, e.g. ahead of device creation.
+    void Serialize( const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc, D3D_ROOT_SIGNATURE_VERSION maxVersion );
+
+    ID3D12RootSignature* GetOrCreate(
+        ID3D12Device* pDevice,
+        const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc,
+        D3D_ROOT_SIGNATURE_VERSION maxVersion );
+
+private:
+    struct Entry;
+    Entry& GetOrSerialize( const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc, D3D_ROOT_SIGNATURE_VERSION maxVersion );
+
+    static const size_t ScratchSize = 64 * 1024;
+    static const uint32_t FileMagic = 0x43535248; // 'HRSC'
+    static const uint32_t FileVersion = 2;
+
+    struct Entry
+    {
+        std::vector<uint8_t> desc;  // Flattened.
+        ComPtr<ID3DBlob> blob;
+        ComPtr<ID3D12RootSignature> rootSignature;
+    };
+
+    std::unordered_map<uint64_t, Entry> m_entries;
+    std::unique_ptr<uint8_t[]> m_scratchMemory;
+    LinearAllocator m_scratch;
+    bool m_dirty;
+};
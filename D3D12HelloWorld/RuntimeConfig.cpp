@@ -0,0 +1,402 @@
+#include "hwpch.h"
+#include "RuntimeConfig.h"
+
+#include <cmath>
+#include <fstream>
+
+namespace
+{
+    // Options that are switched on by their presence alone.
+    bool IsFlag( const std::wstring& key )
+    {
+        return key == L"headless" || key == L"warp" || key == L"pipeline-stats" || key == L"pin-workers" || key == L"pacing" || key == L"separate-draws" || key == L"gpu-culling" || key == L"occlusion-culling" || key == L"grayscale";
+    }
+
+    std::wstring Trim( const std::wstring& str )
+    {
+        const size_t first = str.find_first_not_of( L" \t\r" );
+        if (first == std::wstring::npos)
+        {
+            return std::wstring();
+        }
+        const size_t last = str.find_last_not_of( L" \t\r" );
+        return str.substr( first, last - first + 1 );
+    }
+
+    [[noreturn]] void ThrowInvalid( const std::wstring& key, const std::wstring& value )
+    {
+        throw std::invalid_argument( "Invalid value '" + ToUtf8( value ) + "' for option '" + ToUtf8( key ) + "'" );
+    }
+
+    // Digits only: std::stoul() would also take leading blanks and a sign, and wrap "-1"
+    // around to the largest value.
+    uint32_t ParseUInt( const std::wstring& key, const std::wstring& value, uint32_t minValue = 0, uint32_t maxValue = UINT32_MAX )
+    {
+        if (value.empty() || value[0] < L'0' || value[0] > L'9')
+        {
+            ThrowInvalid( key, value );
+        }
+
+        size_t end = 0;
+        unsigned long long result = 0;
+        try
+        {
+            result = std::stoull( value, &end, 10 );
+        }
+        catch (const std::exception&)
+        {
+            ThrowInvalid( key, value );
+        }
+
+        if (end != value.size() || result < minValue || result > maxValue)
+        {
+            ThrowInvalid( key, value );
+        }
+        return static_cast<uint32_t>( result );
+    }
+
+    double ParseDouble( const std::wstring& key, const std::wstring& value )
+    {
+        size_t end = 0;
+        double result = 0.0;
+        try
+        {
+            result = std::stod( value, &end );
+        }
+        catch (const std::exception&)
+        {
+            ThrowInvalid( key, value );
+        }
+
+        if (end != value.size() || !std::isfinite( result ))
+        {
+            ThrowInvalid( key, value );
+        }
+        return result;
+    }
+
+    bool ParseBool( const std::wstring& key, const std::wstring& value )
+    {
+        if (value == L"1" || value == L"true" || value == L"on")
+        {
+            return true;
+        }
+        if (value == L"0" || value == L"false" || value == L"off")
+        {
+            return false;
+        }
+        ThrowInvalid( key, value );
+    }
+}
+
+const char* PresentModeName( PresentMode mode )
+{
+    switch (mode)
+    {
+        case PresentMode::Vsync:        return "vsync";
+        case PresentMode::Immediate:    return "immediate";
+        case PresentMode::Tearing:      return "tearing";
+        case PresentMode::None:         return "none";
+    }
+    return "unknown";
+}
+
+RuntimeConfig RuntimeConfig::FromCommandLine( LPCWSTR commandLine )
+{
+    std::vector<std::wstring> arguments;
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW( commandLine, &argc );
+    if (argv)
+    {
+        // Skip the executable name.
+        for (int i = 1; i < argc; ++i)
+        {
+            arguments.push_back( argv[i] );
+        }
+        LocalFree( argv );
+    }
+
+    // The config file is applied first so that the command line overrides it.
+    WCHAR assetsPath[512];
+    GetAssetsPath( assetsPath, _countof( assetsPath ) );
+    std::wstring configPath = std::wstring( assetsPath ) + L"Config.ini";
+    bool explicitConfig = false;
+    for (size_t i = 0; i < arguments.size(); ++i)
+    {
+        if (arguments[i].compare( 0, 9, L"--config=" ) == 0)
+        {
+            configPath = arguments[i].substr( 9 );
+            explicitConfig = true;
+        }
+        else if (arguments[i] == L"--config" && i + 1 < arguments.size())
+        {
+            configPath = arguments[i + 1];
+            explicitConfig = true;
+        }
+    }
+
+    RuntimeConfig config;
+    if (!config.LoadFile( configPath ) && explicitConfig)
+    {
+        throw std::invalid_argument( "Config file not found: " + ToUtf8( configPath ) );
+    }
+    config.ParseArguments( arguments );
+
+    // Derived once everything is parsed, so that the order of --headless and --present does
+    // not matter. Headless runs have nothing to present to, whichever mode was asked for.
+    config.headless = config.headless || config.presentMode == PresentMode::None;
+    if (config.headless)
+    {
+        config.presentMode = PresentMode::None;
+    }
+    return config;
+}
+
+bool RuntimeConfig::LoadFile( const std::wstring& path )
+{
+    std::ifstream file( path );
+    if (!file)
+    {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline( file, line ))
+    {
+        std::wstring text = ToWide( line.substr( 0, line.find( '#' ) ) );
+        const size_t equals = text.find( L'=' );
+        if (equals == std::wstring::npos)
+        {
+            text = Trim( text );
+            if (!text.empty())
+            {
+                Set( text, IsFlag( text ) ? L"true" : L"" );
+            }
+            continue;
+        }
+
+        Set( Trim( text.substr( 0, equals ) ), Trim( text.substr( equals + 1 ) ) );
+    }
+    return true;
+}
+
+void RuntimeConfig::ParseArguments( const std::vector<std::wstring>& arguments )
+{
+    for (size_t i = 0; i < arguments.size(); ++i)
+    {
+        const std::wstring& argument = arguments[i];
+
+        // The legacy single-dash and slash spellings of the WARP switch.
+        if (argument == L"/warp" || argument == L"-warp")
+        {
+            Set( L"warp", L"true" );
+            continue;
+        }
+
+        if (argument.compare( 0, 2, L"--" ) != 0)
+        {
+            throw std::invalid_argument( "Unexpected argument '" + ToUtf8( argument ) + "'" );
+        }
+
+        std::wstring key = argument.substr( 2 );
+        std::wstring value;
+        const size_t equals = key.find( L'=' );
+        if (equals != std::wstring::npos)
+        {
+            value = key.substr( equals + 1 );
+            key.resize( equals );
+        }
+        else if (IsFlag( key ))
+        {
+            value = L"true";
+        }
+        else if (i + 1 < arguments.size())
+        {
+            value = arguments[++i];
+        }
+
+        // Handled by FromCommandLine().
+        if (key == L"config")
+        {
+            continue;
+        }
+
+        Set( key, value );
+    }
+}
+
+void RuntimeConfig::Set( const std::wstring& key, const std::wstring& value )
+{
+    if (key == L"adapter")
+    {
+        if (value == L"high-performance" || value == L"hardware")
+        {
+            adapterPolicy = AdapterPolicy::HighPerformance;
+        }
+        else if (value == L"minimum-power")
+        {
+            adapterPolicy = AdapterPolicy::MinimumPower;
+        }
+        else if (value == L"warp")
+        {
+            adapterPolicy = AdapterPolicy::Warp;
+        }
+        else
+        {
+            // An explicit LUID, as a 64-bit hex number (HighPart:LowPart).
+            size_t end = 0;
+            unsigned long long luid = 0;
+            try
+            {
+                luid = std::stoull( value, &end, 16 );
+            }
+            catch (const std::exception&)
+            {
+                ThrowInvalid( key, value );
+            }
+            if (end != value.size())
+            {
+                ThrowInvalid( key, value );
+            }
+
+            adapterPolicy = AdapterPolicy::ExplicitLuid;
+            adapterLuid.LowPart = static_cast<DWORD>( luid );
+            adapterLuid.HighPart = static_cast<LONG>( luid >> 32 );
+        }
+    }
+    else if (key == L"warp")
+    {
+        if (ParseBool( key, value ))
+        {
+            adapterPolicy = AdapterPolicy::Warp;
+        }
+    }
+    else if (key == L"frames-in-flight")
+    {
+        framesInFlight = ParseUInt( key, value, 2, MaxFramesInFlight );
+    }
+    else if (key == L"present")
+    {
+        if (value == L"vsync")
+        {
+            presentMode = PresentMode::Vsync;
+        }
+        else if (value == L"immediate")
+        {
+            presentMode = PresentMode::Immediate;
+        }
+        else if (value == L"tearing")
+        {
+            presentMode = PresentMode::Tearing;
+        }
+        else if (value == L"none")
+        {
+            presentMode = PresentMode::None;
+        }
+        else
+        {
+            ThrowInvalid( key, value );
+        }
+    }
+    else if (key == L"frame-latency")
+    {
+        frameLatency = ParseUInt( key, value, 0, MaxFrameLatency );
+    }
+    else if (key == L"pacing")
+    {
+        framePacing = ParseBool( key, value );
+    }
+    else if (key == L"max-fps")
+    {
+        maxFps = ParseUInt( key, value );
+    }
+    else if (key == L"gpu-budget")
+    {
+        gpuBudgetMs = ParseDouble( key, value );
+        if (gpuBudgetMs < 0.0)
+        {
+            ThrowInvalid( key, value );
+        }
+    }
+    else if (key == L"min-render-scale")
+    {
+        minRenderScale = ParseDouble( key, value );
+        if (minRenderScale < 0.25 || minRenderScale > 1.0)
+        {
+            ThrowInvalid( key, value );
+        }
+    }
+    else if (key == L"pipeline-stats")
+    {
+        pipelineStatistics = ParseBool( key, value );
+    }
+    else if (key == L"headless")
+    {
+        headless = ParseBool( key, value );
+    }
+    else if (key == L"workers")
+    {
+        workerThreads = ParseUInt( key, value, 0, MaxWorkerThreads );
+    }
+    else if (key == L"pin-workers")
+    {
+        pinWorkers = ParseBool( key, value );
+    }
+    else if (key == L"width" || key == L"height")
+    {
+        const uint32_t size = ParseUInt( key, value, 1, D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION );
+        ( key == L"width" ? width : height ) = size;
+    }
+    else if (key == L"instances")
+    {
+        instanceCount = ParseUInt( key, value, 1, MaxInstances );
+    }
+    else if (key == L"separate-draws")
+    {
+        separateDraws = ParseBool( key, value );
+    }
+    else if (key == L"gpu-culling")
+    {
+        gpuCulling = ParseBool( key, value );
+    }
+    else if (key == L"occlusion-culling")
+    {
+        occlusionCulling = ParseBool( key, value );
+    }
+    else if (key == L"grayscale")
+    {
+        grayscale = ParseBool( key, value );
+    }
+    else if (key == L"frames")
+    {
+        frameCount = ParseUInt( key, value );
+    }
+    else if (key == L"warmup")
+    {
+        warmupFrames = ParseUInt( key, value );
+    }
+    else if (key == L"stats")
+    {
+        statsPath = value;
+    }
+    else if (key == L"trace")
+    {
+        tracePath = value;
+    }
+    else if (key == L"precompile")
+    {
+        precompileManifest = value;
+    }
+    else if (key == L"benchmark-culling")
+    {
+        cullingBenchmarkCount = ParseUInt( key, value, 1 );
+    }
+    else if (key == L"benchmark-transforms")
+    {
+        transformBenchmarkCount = ParseUInt( key, value, 1 );
+    }
+    else
+    {
+        throw std::invalid_argument( "Unknown option '" + ToUtf8( key ) + "'" );
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "AdapterSelector.h"
+
+#include <string>
+#include <vector>
+
+enum class PresentMode
+{
+    Vsync,      // Present( 1, 0 ): one frame per vertical blank.
+    Immediate,  // Present( 0, 0 ): the newest frame replaces any queued one.
+    Tearing,    // Present( 0, DXGI_PRESENT_ALLOW_TEARING ): uncapped, if the display supports it.
+    None        // Headless: frames end at the fence and are never presented.
+};
+
+const char* PresentModeName( PresentMode mode );
+
+// Settings that vary between runs without a recompile. Read from a config file of
+// key=value lines, then overridden by the command line:
+//
+//   --config=<path>               config file (default: Config.ini next to the executable)
+//   --adapter=<policy>            high-performance | minimum-power | warp | <LUID in hex>
+//   --warp                        same as --adapter=warp (also accepted as /warp)
+//   --frames-in-flight=<n>        frame ring depth, 2 to MaxFramesInFlight
+//   --present=<mode>              vsync | immediate | tearing | none (same as --headless)
+//   --frame-latency=<n>           start frames on the swap chain's latency waitable object, with
+//                                 at most n frames queued for display (0: off, Present() blocks);
+//                                 headless runs pace against a simulated 60 Hz display instead
+//   --pacing                      start each frame just in time for its present slot
+//   --max-fps=<n>                 cap the frame rate (0: no cap); implies --pacing
+//   --gpu-budget=<ms>             dynamic resolution: scale the scene's render resolution to keep the
+//                                 GPU frame time within ms, upscaling to the output (0: off)
+//   --min-render-scale=<s>        smallest render scale dynamic resolution may pick, 0.25 to 1
+//   --pipeline-stats              collect pipeline statistics for every GPU profiler scope
+//   --headless                    render offscreen without a swap chain or visible window
+//   --workers=<n>                 job system worker threads, up to MaxWorkerThreads (0: one per
+//                                 hardware thread, minus one)
+//   --pin-workers                 pin each job worker to its own physical core
+//   --width=<n> --height=<n>      resolution
+//   --instances=<n>               instances drawn, on a grid (stress test), 1 to MaxInstances
+//   --separate-draws              one draw call per instance instead of one instanced draw
+//   --gpu-culling                 cull instances in a compute pass and draw them with ExecuteIndirect
+//                                 (takes precedence over --separate-draws); the output is checked
+//                                 against the CPU reference every 120 frames
+//   --occlusion-culling           draw a few large occluders over the grid and cull the instances
+//                                 they hide with a CPU depth buffer (ignored with --gpu-culling)
+//   --grayscale                   start with the grayscale pixel shader permutation (G toggles it)
+//   --frames=<n>                  measured frames to run before exiting (0: until closed)
+//   --warmup=<n>                  frames to run before measuring
+//   --stats=<path>                where run statistics are written
+//   --trace=<path>                where the timeline trace is written on exit (and on F11)
+//   --precompile=<manifest>       compile the listed shader variants into the cache and exit
+//   --benchmark-culling=<n>       time frustum and occlusion culling of n bounding volumes, write the
+//                                 report and exit
+//   --benchmark-transforms=<n>    time world-matrix updates of a generated n-node transform hierarchy,
+//                                 write the report and exit
+//
+// Options take their value either as --key=value or as the next argument. Config file
+// keys are the option names without the leading dashes; '#' starts a comment.
+struct RuntimeConfig
+{
+    static const uint32_t MaxFramesInFlight = 4;
+    static const uint32_t MaxFrameLatency = 16;  // DXGI's limit.
+    static const uint32_t MaxInstances = 4 * 1024 * 1024;
+    static const uint32_t MaxWorkerThreads = 256;
+
+    AdapterPolicy adapterPolicy = AdapterPolicy::HighPerformance;
+    LUID adapterLuid = {};
+    uint32_t framesInFlight = 2;
+    PresentMode presentMode = PresentMode::Vsync;
+    uint32_t frameLatency = 0;
+    bool framePacing = false;
+    uint32_t maxFps = 0;
+    double gpuBudgetMs = 0.0;
+    double minRenderScale = 0.5;
+    bool pipelineStatistics = false;
+    bool headless = false;
+    uint32_t workerThreads = 0;
+    bool pinWorkers = false;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    uint32_t instanceCount = 1;
+    bool separateDraws = false;
+    bool gpuCulling = false;
+    bool occlusionCulling = false;
+    bool grayscale = false;
+    uint32_t frameCount = 0;
+    uint32_t warmupFrames = 0;
+    std::wstring statsPath;
+    std::wstring tracePath;
+    std::wstring precompileManifest;
+    uint32_t cullingBenchmarkCount = 0;
+    uint32_t transformBenchmarkCount = 0;
+
+    // Throws std::invalid_argument on an unknown key or malformed value.
+    static RuntimeConfig FromCommandLine( LPCWSTR commandLine );
+
+    // Returns false if the file does not exist.
+    bool LoadFile( const std::wstring& path );
+    void ParseArguments( const std::vector<std::wstring>& arguments );
+    void Set( const std::wstring& key, const std::wstring& value );
+};
@@ -0,0 +1,27 @@
+#include "hwpch.h"
+#include "ShaderCompiler.h"
+
+_Use_decl_annotations_
+HRESULT CompileShaderFromFile(
+    const std::wstring& path,
+    const char* entryPoint,
+    const char* target,
+    const D3D_SHADER_MACRO* pDefines,
+    ID3DBlob** ppCode )
+{
+#if defined(_DEBUG)
+    // Enable better shader debugging with the graphics debugging tools.
+    uint32_t compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+    uint32_t compileFlags = 0;
+#endif
+
+    ComPtr<ID3DBlob> errors;
+    HRESULT hr = D3DCompileFromFile( path.c_str(), pDefines, D3D_COMPILE_STANDARD_FILE_INCLUDE, entryPoint, target, compileFlags, 0, ppCode, &errors );
+    if (errors)
+    {
+        OutputDebugStringA( static_cast<const char*>( errors->GetBufferPointer() ) );
+    }
+
+    return hr;
+}
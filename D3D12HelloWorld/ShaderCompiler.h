@@ -0,0 +1,13 @@
+#pragma once
+
+#include "Helpers.h"
+
+// Compile one entry point of an HLSL file. Compiler errors are written to the debugger
+// output and returned as a failing HRESULT so callers can decide whether to throw
+// (startup) or keep the previous shader (hot reload).
+HRESULT CompileShaderFromFile(
+    const std::wstring& path,
+    const char* entryPoint,
+    const char* target,
+    const D3D_SHADER_MACRO* pDefines,
+    _Outptr_ ID3DBlob** ppCode );
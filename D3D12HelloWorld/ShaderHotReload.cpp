@@ -0,0 +1,192 @@
+#include "hwpch.h"
+#include "ShaderHotReload.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Editors tend to save in several writes; wait for the burst to settle before compiling.
+    const auto DebounceInterval = std::chrono::milliseconds( 100 );
+
+    // The file may still be locked by the editor when the change notification arrives.
+    const int CompileRetries = 5;
+
+    bool SameFileName( const std::wstring& a, const std::wstring& b )
+    {
+        return _wcsicmp( a.c_str(), b.c_str() ) == 0;
+    }
+}
+
+ShaderHotReload::ShaderHotReload( ShaderLibrary& library )
+    : m_library( library ), m_stop( false )
+{
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+    Stop();
+}
+
+void ShaderHotReload::Start( const std::wstring& directory )
+{
+    m_stop = false;
+    m_thread = std::thread( &ShaderHotReload::ThreadMain, this );
+
+    if (!m_watcher.Start( ToUtf8( directory ), [this]( const std::string& fileName ) { OnFileChanged( fileName ); } ))
+    {
+        OutputDebugStringA( "ShaderHotReload: unable to watch the shader directory.\n" );
+    }
+}
+
+void ShaderHotReload::Stop()
+{
+    m_watcher.Stop();
+
+    if (m_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_stop = true;
+        }
+        m_changed.notify_one();
+        m_thread.join();
+    }
+}
+
+uint32_t ShaderHotReload::RegisterPipeline(
+    ShaderLibrary::ShaderId vertexShader,
+    uint32_t vsPermutation,
+    ShaderLibrary::ShaderId pixelShader,
+    uint32_t psPermutation,
+    PipelineFactory factory )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_pipelines.push_back( { vertexShader, vsPermutation, pixelShader, psPermutation, std::move( factory ) } );
+    return static_cast<uint32_t>( m_pipelines.size() - 1 );
+}
+
+void ShaderHotReload::SetPermutations( uint32_t id, uint32_t vsPermutation, uint32_t psPermutation )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_pipelines[id].vsPermutation = vsPermutation;
+    m_pipelines[id].psPermutation = psPermutation;
+}
+
+bool ShaderHotReload::TakeReloadedPipelines( std::vector<ReloadedPipeline>& reloaded )
+{
+    std::unique_lock<std::mutex> lock( m_resultsMutex, std::try_to_lock );
+    if (!lock.owns_lock())
+    {
+        return false;
+    }
+
+    for (auto& result : m_results)
+    {
+        reloaded.push_back( std::move( result ) );
+    }
+    m_results.clear();
+    return true;
+}
+
+// Runs on the watcher thread.
+void ShaderHotReload::OnFileChanged( const std::string& fileName )
+{
+    const std::wstring name = ToWide( fileName );
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        bool watched = false;
+        for (const Pipeline& pipeline : m_pipelines)
+        {
+            watched |= SameFileName( m_library.GetFileName( pipeline.vertexShader ), name );
+            watched |= SameFileName( m_library.GetFileName( pipeline.pixelShader ), name );
+        }
+        if (!watched)
+        {
+            return;
+        }
+        m_changedFiles.insert( name );
+    }
+    m_changed.notify_one();
+}
+
+void ShaderHotReload::ThreadMain()
+{
+    for (;;)
+    {
+        std::set<std::wstring> changedFiles;
+        {
+            std::unique_lock<std::mutex> lock( m_mutex );
+            m_changed.wait( lock, [this] { return m_stop || !m_changedFiles.empty(); } );
+
+            // Coalesce the rest of the save burst.
+            m_changed.wait_for( lock, DebounceInterval, [this] { return m_stop; } );
+            if (m_stop)
+            {
+                return;
+            }
+            changedFiles.swap( m_changedFiles );
+        }
+
+        for (const std::wstring& fileName : changedFiles)
+        {
+            Rebuild( fileName );
+        }
+    }
+}
+
+// Recompile the entry points that live in fileName and rebuild only their pipelines.
+void ShaderHotReload::Rebuild( const std::wstring& fileName )
+{
+    const std::vector<ShaderLibrary::ShaderId> changedShaders = m_library.Invalidate( fileName );
+    auto changed = [&changedShaders]( ShaderLibrary::ShaderId shader )
+    {
+        return std::find( changedShaders.begin(), changedShaders.end(), shader ) != changedShaders.end();
+    };
+
+    std::vector<std::pair<uint32_t, Pipeline>> affected;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        for (uint32_t id = 0; id < m_pipelines.size(); id++)
+        {
+            if (changed( m_pipelines[id].vertexShader ) || changed( m_pipelines[id].pixelShader ))
+            {
+                affected.push_back( { id, m_pipelines[id] } );
+            }
+        }
+    }
+
+    for (const auto& it : affected)
+    {
+        const Pipeline& pipeline = it.second;
+        ComPtr<ID3D12PipelineState> pipelineState;
+
+        for (int attempt = 0; attempt < CompileRetries && !pipelineState; attempt++)
+        {
+            if (attempt > 0)
+            {
+                std::this_thread::sleep_for( DebounceInterval );
+            }
+
+            try
+            {
+                ComPtr<ID3DBlob> vertexShader = m_library.GetVariant( pipeline.vertexShader, pipeline.vsPermutation );
+                ComPtr<ID3DBlob> pixelShader = m_library.GetVariant( pipeline.pixelShader, pipeline.psPermutation );
+                pipelineState = pipeline.factory( vertexShader.Get(), pixelShader.Get() );
+            }
+            catch (const HrException& e)
+            {
+                OutputDebugStringA( e.what() );
+            }
+        }
+
+        if (!pipelineState)
+        {
+            // Keep the pipeline that is currently in use.
+            OutputDebugStringA( "ShaderHotReload: rebuild failed, keeping the previous pipeline.\n" );
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock( m_resultsMutex );
+        m_results.push_back( { it.first, pipeline.vsPermutation, pipeline.psPermutation, std::move( pipelineState ) } );
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "FileWatcher.h"
+#include "Helpers.h"
+#include "ShaderLibrary.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// Recompiles shaders when their source files change and rebuilds the pipelines that
+// depend on them. Compilation (through the ShaderLibrary, which owns the variants) and
+// PSO creation happen on a background thread; the render thread collects finished
+// pipelines at a frame boundary with TakeReloadedPipelines(), which never blocks.
+class ShaderHotReload
+{
+public:
+    // Builds a pipeline from freshly compiled shaders. Called on the reload thread, so it
+    // must only use free-threaded device methods.
+    using PipelineFactory = std::function<ComPtr<ID3D12PipelineState>( ID3DBlob* pVertexShader, ID3DBlob* pPixelShader )>;
+
+    struct ReloadedPipeline
+    {
+        uint32_t id;
+        uint32_t vsPermutation;     // The variants it was built from.
+        uint32_t psPermutation;
+        ComPtr<ID3D12PipelineState> pipelineState;
+    };
+
+    explicit ShaderHotReload( ShaderLibrary& library );
+    ~ShaderHotReload();
+
+    void Start( const std::wstring& directory );
+    void Stop();
+
+    // Returns the id reported back by TakeReloadedPipelines().
+    uint32_t RegisterPipeline(
+        ShaderLibrary::ShaderId vertexShader,
+        uint32_t vsPermutation,
+        ShaderLibrary::ShaderId pixelShader,
+        uint32_t psPermutation,
+        PipelineFactory factory );
+
+    // Rebuild the pipeline from other variants on the next change to its sources. Results
+    // already in flight keep the permutations they were built with.
+    void SetPermutations( uint32_t id, uint32_t vsPermutation, uint32_t psPermutation );
+
+    // Appends pipelines rebuilt since the last call. Returns false without waiting if the
+    // reload thread currently holds the results.
+    bool TakeReloadedPipelines( std::vector<ReloadedPipeline>& reloaded );
+
+private:
+    void OnFileChanged( const std::string& fileName );
+    void ThreadMain();
+    void Rebuild( const std::wstring& fileName );
+
+    struct Pipeline
+    {
+        ShaderLibrary::ShaderId vertexShader;
+        uint32_t vsPermutation;
+        ShaderLibrary::ShaderId pixelShader;
+        uint32_t psPermutation;
+        PipelineFactory factory;
+    };
+
+    ShaderLibrary& m_library;
+    FileWatcher m_watcher;
+    std::thread m_thread;
+    bool m_stop;
+
+    // Guards m_pipelines, m_changedFiles and m_stop.
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::vector<Pipeline> m_pipelines;
+    std::set<std::wstring> m_changedFiles;
+
+    std::mutex m_resultsMutex;
+    std::vector<ReloadedPipeline> m_results;
+};
@@ -0,0 +1,473 @@
+#include "hwpch.h"
+#include "ShaderLibrary.h"
+#include "Hash.h"
+#include "ShaderCompiler.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+    // Identifies a variant on disk. The source hash is part of the key, so edited sources
+    // (or edited includes, see HashSource()) never pick up stale blobs and no explicit
+    // invalidation of the disk cache is needed.
+    std::wstring CacheFileName( const std::wstring& fileName, const std::string& entryPoint, const std::string& target, const std::vector<std::string>& keywords, uint64_t sourceHash )
+    {
+        uint64_t hash = HashString( ToUtf8( fileName ).c_str() );
+        hash = HashString( entryPoint.c_str(), hash );
+        hash = HashString( target.c_str(), hash );
+        for (const std::string& keyword : keywords)
+        {
+            hash = HashString( keyword.c_str(), HashCombine( hash, keyword.size() ) );
+        }
+        hash = HashCombine( hash, sourceHash );
+
+        wchar_t name[64];
+        swprintf_s( name, L"%016llx.cso", static_cast<unsigned long long>( hash ) );
+        return name;
+    }
+
+    // The file name of an #include directive on the line, or an empty string.
+    std::string IncludedFileName( const std::string& line )
+    {
+        size_t pos = line.find_first_not_of( " \t" );
+        if (pos == std::string::npos || line[pos] != '#')
+        {
+            return std::string();
+        }
+        pos = line.find_first_not_of( " \t", pos + 1 );
+        if (pos == std::string::npos || line.compare( pos, 7, "include" ) != 0)
+        {
+            return std::string();
+        }
+        pos = line.find_first_not_of( " \t", pos + 7 );
+        if (pos == std::string::npos || ( line[pos] != '"' && line[pos] != '<' ))
+        {
+            return std::string();
+        }
+        const size_t end = line.find( line[pos] == '"' ? '"' : '>', pos + 1 );
+        return end == std::string::npos ? std::string() : line.substr( pos + 1, end - pos - 1 );
+    }
+
+    // Folds the file and, recursively, the files it includes into the hash. Includes are
+    // resolved against the including file's directory, as D3D_COMPILE_STANDARD_FILE_INCLUDE
+    // does; ones that cannot be opened are hashed by name, since the compile fails on them
+    // anyway. Includes inside inactive #if blocks are followed too, which at worst makes the
+    // key change more often than it needs to.
+    bool HashSource( const std::wstring& path, uint64_t* pHash, std::vector<std::wstring>& visited )
+    {
+        for (const std::wstring& seen : visited)
+        {
+            if (_wcsicmp( seen.c_str(), path.c_str() ) == 0)
+            {
+                return true;
+            }
+        }
+        visited.push_back( path );
+
+        std::ifstream file( path, std::ios::binary );
+        if (!file)
+        {
+            return false;
+        }
+
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        const std::string source = contents.str();
+        *pHash = HashBytes( source.data(), source.size(), *pHash );
+
+        const std::wstring directory = path.substr( 0, path.find_last_of( L"\\/" ) + 1 );
+        std::istringstream lines( source );
+        std::string line;
+        while (std::getline( lines, line ))
+        {
+            const std::string include = IncludedFileName( line );
+            if (!include.empty() && !HashSource( directory + ToWide( include ), pHash, visited ))
+            {
+                *pHash = HashString( include.c_str(), *pHash );
+            }
+        }
+        return true;
+    }
+
+    struct ManifestEntry
+    {
+        std::wstring fileName;
+        std::string entryPoint;
+        std::string target;
+        std::vector<std::string> keywords;
+    };
+
+    // One variant per line: <file> <entry point> <target> [keyword ...]
+    std::vector<ManifestEntry> ReadManifest( const std::wstring& path )
+    {
+        std::vector<ManifestEntry> entries;
+        std::ifstream file( path );
+        std::string line;
+        while (std::getline( file, line ))
+        {
+            std::istringstream tokens( line );
+            std::string fileName;
+            ManifestEntry entry;
+            if (!( tokens >> fileName >> entry.entryPoint >> entry.target ))
+            {
+                continue;
+            }
+
+            entry.fileName = ToWide( fileName );
+            std::string keyword;
+            while (tokens >> keyword)
+            {
+                entry.keywords.push_back( keyword );
+            }
+            entries.push_back( std::move( entry ) );
+        }
+        return entries;
+    }
+}
+
+ShaderLibrary::ShaderLibrary()
+    : m_pJobs( nullptr ),
+    m_stop( false )
+{
+}
+
+ShaderLibrary::~ShaderLibrary()
+{
+    Stop();
+}
+
+void ShaderLibrary::Start( JobSystem& jobs, const std::wstring& sourceDirectory, const std::wstring& cacheDirectory )
+{
+    m_sourceDirectory = sourceDirectory;
+    m_cacheDirectory = cacheDirectory;
+    CreateDirectoryW( cacheDirectory.c_str(), nullptr );
+
+    m_stop = false;
+    m_pJobs = &jobs;
+}
+
+// Compiles that have not started yet are dropped.
+void ShaderLibrary::Stop()
+{
+    if (m_pJobs)
+    {
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_stop = true;
+        }
+        m_pJobs->Wait( m_compileJobs );
+        m_pJobs = nullptr;
+    }
+}
+
+ShaderLibrary::ShaderId ShaderLibrary::DeclareShader( const std::wstring& fileName, const char* entryPoint, const char* target, std::initializer_list<const char*> keywords )
+{
+    if (keywords.size() > MaxKeywords)
+    {
+        throw std::invalid_argument( "Too many shader keywords." );
+    }
+
+    ShaderDesc desc = { fileName, entryPoint, target, {} };
+    for (const char* keyword : keywords)
+    {
+        desc.keywords.push_back( keyword );
+    }
+
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_shaders.push_back( std::move( desc ) );
+    return static_cast<ShaderId>( m_shaders.size() - 1 );
+}
+
+uint32_t ShaderLibrary::GetKeywordMask( ShaderId shader, const char* keyword ) const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    const std::vector<std::string>& keywords = m_shaders[shader].keywords;
+    for (uint32_t i = 0; i < keywords.size(); i++)
+    {
+        if (keywords[i] == keyword)
+        {
+            return 1u << i;
+        }
+    }
+    return 0;
+}
+
+std::wstring ShaderLibrary::GetFileName( ShaderId shader ) const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_shaders[shader].fileName;
+}
+
+ComPtr<ID3DBlob> ShaderLibrary::RequestVariant( ShaderId shader, uint32_t permutation, bool* pFailed )
+{
+    const uint64_t key = VariantKey( shader, permutation );
+
+    ComPtr<ID3DBlob> blob;
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        auto it = m_variants.find( key );
+        if (it == m_variants.end())
+        {
+            it = m_variants.emplace( key, Variant{ VariantState::Stale, 0, nullptr } ).first;
+        }
+
+        Variant& variant = it->second;
+        if (variant.state == VariantState::Stale)
+        {
+            variant.state = VariantState::Queued;
+            queued = true;
+        }
+        if (variant.state == VariantState::Ready)
+        {
+            blob = variant.blob;
+        }
+        if (pFailed)
+        {
+            *pFailed = variant.state == VariantState::Failed;
+        }
+    }
+
+    if (queued)
+    {
+        ScheduleCompiles( { key } );
+    }
+    return blob;
+}
+
+ComPtr<ID3DBlob> ShaderLibrary::GetVariant( ShaderId shader, uint32_t permutation )
+{
+    const uint64_t key = VariantKey( shader, permutation );
+
+    ShaderDesc desc;
+    std::vector<std::string> keywords;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        auto it = m_variants.find( key );
+        if (it != m_variants.end() && it->second.state == VariantState::Ready)
+        {
+            return it->second.blob;
+        }
+
+        desc = m_shaders[shader];
+        keywords = EnabledKeywords( desc, permutation );
+    }
+
+    // Compile here rather than waiting for a compile job; if both end up
+    // compiling the same variant, the results are identical.
+    ComPtr<ID3DBlob> blob;
+    ThrowIfFailed( CompileOrLoad( desc, keywords, m_sourceDirectory, m_cacheDirectory, &blob ) );
+
+    std::lock_guard<std::mutex> lock( m_mutex );
+    Variant& variant = m_variants[key];
+    variant.state = VariantState::Ready;
+    variant.blob = blob;
+    return blob;
+}
+
+std::vector<ShaderLibrary::ShaderId> ShaderLibrary::Invalidate( const std::wstring& fileName )
+{
+    std::vector<ShaderId> affected;
+
+    std::lock_guard<std::mutex> lock( m_mutex );
+    for (ShaderId shader = 0; shader < m_shaders.size(); shader++)
+    {
+        if (_wcsicmp( m_shaders[shader].fileName.c_str(), fileName.c_str() ) == 0)
+        {
+            affected.push_back( shader );
+        }
+    }
+
+    // Keep the entries so the manifest still lists them.
+    for (auto& it : m_variants)
+    {
+        const ShaderId shader = static_cast<ShaderId>( it.first >> 32 );
+        if (std::find( affected.begin(), affected.end(), shader ) != affected.end())
+        {
+            it.second.state = VariantState::Stale;
+            it.second.generation++;
+            it.second.blob.Reset();
+        }
+    }
+
+    return affected;
+}
+
+void ShaderLibrary::PrewarmFromManifest( const std::wstring& path )
+{
+    const std::vector<ManifestEntry> entries = ReadManifest( path );
+
+    std::vector<uint64_t> queued;
+    std::unique_lock<std::mutex> lock( m_mutex );
+    for (const ManifestEntry& entry : entries)
+    {
+        for (ShaderId shader = 0; shader < m_shaders.size(); shader++)
+        {
+            const ShaderDesc& desc = m_shaders[shader];
+            if (_wcsicmp( desc.fileName.c_str(), entry.fileName.c_str() ) != 0 || desc.entryPoint != entry.entryPoint || desc.target != entry.target)
+            {
+                continue;
+            }
+
+            uint32_t permutation = 0;
+            for (const std::string& keyword : entry.keywords)
+            {
+                auto it = std::find( desc.keywords.begin(), desc.keywords.end(), keyword );
+                if (it != desc.keywords.end())
+                {
+                    permutation |= 1u << static_cast<uint32_t>( it - desc.keywords.begin() );
+                }
+            }
+
+            const uint64_t key = VariantKey( shader, permutation );
+            if (m_variants.find( key ) == m_variants.end())
+            {
+                m_variants[key] = { VariantState::Queued, 0, nullptr };
+                queued.push_back( key );
+            }
+        }
+    }
+    lock.unlock();
+
+    ScheduleCompiles( queued );
+}
+
+void ShaderLibrary::SaveManifest( const std::wstring& path ) const
+{
+    std::ofstream file( path, std::ios::trunc );
+
+    std::lock_guard<std::mutex> lock( m_mutex );
+    for (const auto& it : m_variants)
+    {
+        const ShaderDesc& desc = m_shaders[static_cast<ShaderId>( it.first >> 32 )];
+        file << ToUtf8( desc.fileName ) << ' ' << desc.entryPoint << ' ' << desc.target;
+        for (const std::string& keyword : EnabledKeywords( desc, static_cast<uint32_t>( it.first ) ))
+        {
+            file << ' ' << keyword;
+        }
+        file << '\n';
+    }
+}
+
+uint32_t ShaderLibrary::PrecompileManifest( JobSystem& jobs, const std::wstring& manifestPath, const std::wstring& sourceDirectory, const std::wstring& cacheDirectory )
+{
+    CreateDirectoryW( cacheDirectory.c_str(), nullptr );
+
+    const std::vector<ManifestEntry> entries = ReadManifest( manifestPath );
+    std::atomic<uint32_t> failures( 0 );
+    jobs.ParallelFor( static_cast<uint32_t>( entries.size() ), [&]( uint32_t begin, uint32_t end )
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            const ManifestEntry& entry = entries[i];
+            ShaderDesc desc = { entry.fileName, entry.entryPoint, entry.target, entry.keywords };
+            ComPtr<ID3DBlob> blob;
+            if (FAILED( CompileOrLoad( desc, entry.keywords, sourceDirectory, cacheDirectory, &blob ) ))
+            {
+                failures++;
+            }
+        }
+    } );
+    return failures;
+}
+
+_Use_decl_annotations_
+HRESULT ShaderLibrary::CompileOrLoad(
+    const ShaderDesc& desc,
+    const std::vector<std::string>& enabledKeywords,
+    const std::wstring& sourceDirectory,
+    const std::wstring& cacheDirectory,
+    ID3DBlob** ppBlob )
+{
+    const std::wstring sourcePath = sourceDirectory + desc.fileName;
+
+    uint64_t sourceHash = FnvOffsetBasis;
+    std::vector<std::wstring> visited;
+    if (!HashSource( sourcePath, &sourceHash, visited ))
+    {
+        return HRESULT_FROM_WIN32( ERROR_FILE_NOT_FOUND );
+    }
+
+    const std::wstring cachePath = cacheDirectory + CacheFileName( desc.fileName, desc.entryPoint, desc.target, enabledKeywords, sourceHash );
+    if (SUCCEEDED( D3DReadFileToBlob( cachePath.c_str(), ppBlob ) ))
+    {
+        return S_OK;
+    }
+
+    std::vector<D3D_SHADER_MACRO> defines;
+    for (const std::string& keyword : enabledKeywords)
+    {
+        defines.push_back( { keyword.c_str(), "1" } );
+    }
+    defines.push_back( { nullptr, nullptr } );
+
+    HRESULT hr = CompileShaderFromFile( sourcePath, desc.entryPoint.c_str(), desc.target.c_str(), defines.data(), ppBlob );
+    if (SUCCEEDED( hr ))
+    {
+        // A failed write only costs a recompile next time.
+        D3DWriteBlobToFile( *ppBlob, cachePath.c_str(), true );
+    }
+    return hr;
+}
+
+std::vector<std::string> ShaderLibrary::EnabledKeywords( const ShaderDesc& desc, uint32_t permutation ) const
+{
+    std::vector<std::string> keywords;
+    for (uint32_t i = 0; i < desc.keywords.size(); i++)
+    {
+        if (permutation & ( 1u << i ))
+        {
+            keywords.push_back( desc.keywords[i] );
+        }
+    }
+    return keywords;
+}
+
+// Background jobs: a compile takes milliseconds, too long to be picked up by a frame's
+// ParallelFor() while it waits. Called without m_mutex held, since Stop() may run the
+// jobs inline on this thread.
+void ShaderLibrary::ScheduleCompiles( const std::vector<uint64_t>& keys )
+{
+    for (uint64_t key : keys)
+    {
+        m_pJobs->RunBackground( [this, key] { CompileQueued( key ); }, &m_compileJobs );
+    }
+}
+
+void ShaderLibrary::CompileQueued( uint64_t key )
+{
+    uint32_t generation;
+    ShaderDesc desc;
+    std::vector<std::string> keywords;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        Variant& variant = m_variants[key];
+        if (m_stop || variant.state != VariantState::Queued)
+        {
+            return;
+        }
+        variant.state = VariantState::Compiling;
+        generation = variant.generation;
+
+        desc = m_shaders[static_cast<ShaderId>( key >> 32 )];
+        keywords = EnabledKeywords( desc, static_cast<uint32_t>( key ) );
+    }
+
+    ComPtr<ID3DBlob> blob;
+    HRESULT hr;
+    {
+        HW_TRACE_SCOPE( "CompileShaderVariant" );
+        hr = CompileOrLoad( desc, keywords, m_sourceDirectory, m_cacheDirectory, &blob );
+    }
+
+    std::lock_guard<std::mutex> lock( m_mutex );
+    Variant& variant = m_variants[key];
+    if (variant.state == VariantState::Compiling && variant.generation == generation)
+    {
+        variant.state = SUCCEEDED( hr ) ? VariantState::Ready : VariantState::Failed;
+        variant.blob = blob;
+    }
+}
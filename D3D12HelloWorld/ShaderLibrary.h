@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Helpers.h"
+#include "JobSystem.h"
+
+#include <initializer_list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Shader permutations. Each shader declares up to 32 feature keywords; a permutation is
+// the bitmask of keywords that are enabled, and each enabled keyword is passed to the
+// compiler as a define. Variants are compiled lazily as jobs the first time
+// they are requested and backed by an on-disk blob cache keyed by the hash of the source
+// and the files it includes, so only variants that are actually used are ever compiled.
+//
+// Every variant requested during a session is recorded; the manifest written by
+// SaveManifest() can be fed to PrecompileManifest() offline to populate the disk cache.
+class ShaderLibrary
+{
+public:
+    using ShaderId = uint32_t;
+    static const uint32_t MaxKeywords = 32;
+
+    ShaderLibrary();
+    ~ShaderLibrary();
+
+    void Start( JobSystem& jobs, const std::wstring& sourceDirectory, const std::wstring& cacheDirectory );
+    void Stop();
+
+    ShaderId DeclareShader( const std::wstring& fileName, const char* entryPoint, const char* target, std::initializer_list<const char*> keywords );
+    uint32_t GetKeywordMask( ShaderId shader, const char* keyword ) const;
+    std::wstring GetFileName( ShaderId shader ) const;
+
+    // Returns the variant if it is ready; otherwise schedules it and returns nullptr. A
+    // variant that failed to compile is not retried until its source changes; *pFailed
+    // tells the caller so it can stop asking.
+    ComPtr<ID3DBlob> RequestVariant( ShaderId shader, uint32_t permutation, bool* pFailed = nullptr );
+
+    // Returns the variant, compiling it on the calling thread if needed. Throws on
+    // compile errors.
+    ComPtr<ID3DBlob> GetVariant( ShaderId shader, uint32_t permutation );
+
+    // Mark compiled variants of a file stale after its source changed. Returns the shaders affected.
+    std::vector<ShaderId> Invalidate( const std::wstring& fileName );
+
+    // Schedule every variant listed in a manifest that belongs to a declared shader.
+    void PrewarmFromManifest( const std::wstring& path );
+    void SaveManifest( const std::wstring& path ) const;
+
+    // Offline: compile every variant in a manifest into the disk cache, in parallel. Does
+    // not need the shaders to be declared. Returns the number of variants that failed.
+    static uint32_t PrecompileManifest( JobSystem& jobs, const std::wstring& manifestPath, const std::wstring& sourceDirectory, const std::wstring& cacheDirectory );
+
+private:
+    struct ShaderDesc
+    {
+        std::wstring fileName;
+        std::string entryPoint;
+        std::string target;
+        std::vector<std::string> keywords;
+    };
+
+    enum class VariantState
+    {
+        Queued,
+        Compiling,
+        Ready,
+        Failed,
+        Stale       // Source changed; recompiled on the next request.
+    };
+
+    struct Variant
+    {
+        VariantState state;
+        uint32_t generation;    // Bumped on invalidation so in-flight compiles of old sources are discarded.
+        ComPtr<ID3DBlob> blob;
+    };
+
+    static uint64_t VariantKey( ShaderId shader, uint32_t permutation ) { return ( static_cast<uint64_t>( shader ) << 32 ) | permutation; }
+    static HRESULT CompileOrLoad(
+        const ShaderDesc& desc,
+        const std::vector<std::string>& enabledKeywords,
+        const std::wstring& sourceDirectory,
+        const std::wstring& cacheDirectory,
+        ID3DBlob** ppBlob );
+
+    std::vector<std::string> EnabledKeywords( const ShaderDesc& desc, uint32_t permutation ) const;
+    void ScheduleCompiles( const std::vector<uint64_t>& keys );
+    void CompileQueued( uint64_t key );
+
+    std::wstring m_sourceDirectory;
+    std::wstring m_cacheDirectory;
+    JobSystem* m_pJobs;
+    JobCounter m_compileJobs;
+
+    // Guards everything below.
+    mutable std::mutex m_mutex;
+    std::vector<ShaderDesc> m_shaders;
+    std::unordered_map<uint64_t, Variant> m_variants;
+    bool m_stop;
+};
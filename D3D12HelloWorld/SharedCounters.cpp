@@ -0,0 +1,85 @@
+#include "hwpch.h"
+#include "SharedCounters.h"
+
+SharedCounters::SharedCounters()
+    : m_mapping( nullptr ), m_pBlock( nullptr )
+{
+}
+
+SharedCounters::~SharedCounters()
+{
+    Close();
+}
+
+void SharedCounters::Open( const wchar_t* name )
+{
+    m_mapping = CreateFileMappingW( INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof( SharedCounterBlock ), name );
+    if (!m_mapping)
+    {
+        OutputDebugStringA( "SharedCounters: CreateFileMapping failed; counters will not be published.\n" );
+        return;
+    }
+
+    void* pView = MapViewOfFile( m_mapping, FILE_MAP_WRITE, 0, 0, sizeof( SharedCounterBlock ) );
+    if (!pView)
+    {
+        Close();
+        return;
+    }
+
+    // The mapping starts zeroed; the header marks the block as valid to readers.
+    m_pBlock = new ( pView ) SharedCounterBlock();
+    m_pBlock->magic = SharedCounterBlock::Magic;
+    m_pBlock->version = SharedCounterBlock::Version;
+    m_pBlock->sequence.store( 0, std::memory_order_release );
+}
+
+void SharedCounters::Close()
+{
+    if (m_pBlock)
+    {
+        UnmapViewOfFile( m_pBlock );
+        m_pBlock = nullptr;
+    }
+    if (m_mapping)
+    {
+        CloseHandle( m_mapping );
+        m_mapping = nullptr;
+    }
+}
+
+void SharedCounters::Publish( uint64_t frameNumber, const ApiCounters& counters, const std::vector<GpuProfiler::ScopeTiming>& passes )
+{
+    if (!m_pBlock)
+    {
+        return;
+    }
+
+    // Odd while the block is being written.
+    const uint64_t sequence = m_pBlock->sequence.load( std::memory_order_relaxed );
+    m_pBlock->sequence.store( sequence + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    m_pBlock->frameNumber = frameNumber;
+    m_pBlock->counters = counters;
+    m_pBlock->passCount = 0;
+    for (const GpuProfiler::ScopeTiming& timing : passes)
+    {
+        if (m_pBlock->passCount == SharedCounterBlock::MaxPasses)
+        {
+            break;
+        }
+
+        SharedCounterBlock::Pass& pass = m_pBlock->passes[m_pBlock->passCount++];
+        strncpy_s( pass.name, timing.name, _TRUNCATE );
+        pass.depth = timing.depth;
+        pass.gpuMilliseconds = timing.milliseconds;
+        pass.vertices = timing.statistics.IAVertices;
+        pass.primitives = timing.statistics.IAPrimitives;
+        pass.vertexShaderInvocations = timing.statistics.VSInvocations;
+        pass.pixelShaderInvocations = timing.statistics.PSInvocations;
+        pass.computeShaderInvocations = timing.statistics.CSInvocations;
+    }
+
+    m_pBlock->sequence.store( sequence + 2, std::memory_order_release );
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ApiCounters.h"
+#include "GpuProfiler.h"
+
+#include <atomic>
+#include <vector>
+
+// Layout of the shared-memory block the counters are published in, for dashboards that
+// read them from another process. The block is updated once per frame under a sequence
+// count: readers copy it and retry if the sequence was odd or changed during the copy.
+struct SharedCounterBlock
+{
+    static const uint32_t Magic = 0x54434848; // 'HHCT'
+    static const uint32_t Version = 2;
+    static const uint32_t MaxPasses = 16;
+
+    struct Pass
+    {
+        char name[32];
+        uint32_t depth;
+        double gpuMilliseconds;
+        uint64_t vertices;
+        uint64_t primitives;
+        uint64_t vertexShaderInvocations;
+        uint64_t pixelShaderInvocations;
+        uint64_t computeShaderInvocations;
+    };
+
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint64_t> sequence;
+
+    uint64_t frameNumber;
+    ApiCounters counters;
+
+    // The GPU passes of the latest frame read back; lags frameNumber by the frames in flight.
+    uint32_t passCount;
+    Pass passes[MaxPasses];
+};
+
+// Owns the named file mapping and writes SharedCounterBlock into it.
+class SharedCounters
+{
+public:
+    static constexpr const wchar_t* DefaultName = L"Local\\D3D12HelloWorld.Counters";
+
+    SharedCounters();
+    ~SharedCounters();
+
+    SharedCounters( const SharedCounters& ) = delete;
+    SharedCounters& operator=( const SharedCounters& ) = delete;
+
+    // Publishing is skipped (not an error) if the mapping cannot be created.
+    void Open( const wchar_t* name = DefaultName );
+    void Close();
+
+    void Publish( uint64_t frameNumber, const ApiCounters& counters, const std::vector<GpuProfiler::ScopeTiming>& passes );
+
+private:
+    HANDLE m_mapping;
+    SharedCounterBlock* m_pBlock;
+};
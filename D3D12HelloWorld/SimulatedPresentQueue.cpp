@@ -0,0 +1,123 @@
+// Compiled without the precompiled header so that pacing can be tested on Linux as well.
+#include "SimulatedPresentQueue.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+SimulatedPresentQueue::SimulatedPresentQueue( double refreshHz, uint32_t maximumFrameLatency )
+    : m_origin( Clock::now() ),
+    m_refreshPeriod( std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( 1.0 / refreshHz ) ) ),
+    m_maximumFrameLatency( maximumFrameLatency ),
+    m_admissions( maximumFrameLatency ),
+    m_unpresented( 0 ),
+    m_lastScheduledVblank( 0 ),
+    m_displayedFrames( 0 )
+{
+}
+
+void SimulatedPresentQueue::SetMaximumFrameLatency( uint32_t frames )
+{
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_admissions += static_cast<int64_t>( frames ) - m_maximumFrameLatency;
+        m_maximumFrameLatency = frames;
+    }
+    m_retired.notify_all();
+}
+
+uint32_t SimulatedPresentQueue::GetMaximumFrameLatency() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_maximumFrameLatency;
+}
+
+bool SimulatedPresentQueue::WaitForFrame( uint32_t timeoutMs )
+{
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds( timeoutMs );
+
+    std::unique_lock<std::mutex> lock( m_mutex );
+    for (;;)
+    {
+        const Clock::time_point now = Clock::now();
+        RetireLocked( now );
+        if (m_admissions > 0)
+        {
+            m_admissions--;
+            m_unpresented++;
+            return true;
+        }
+        if (now >= deadline)
+        {
+            return false;
+        }
+
+        // Nothing is woken by the display itself: sleep until the next queued frame is
+        // shown, or until a latency change or the deadline.
+        const Clock::time_point wake = m_queue.empty() ? deadline : std::min( deadline, VblankTime( m_queue.front() ) );
+        m_retired.wait_until( lock, wake );
+    }
+}
+
+void SimulatedPresentQueue::Present()
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    if (m_unpresented == 0)
+    {
+        throw std::logic_error( "Present() without a frame admitted by WaitForFrame()" );
+    }
+    m_unpresented--;
+
+    const Clock::time_point now = Clock::now();
+    RetireLocked( now );
+
+    // Flip model: one frame per vertical blank, in order.
+    const uint64_t vblank = std::max( VblankIndex( now ) + 1, m_lastScheduledVblank + 1 );
+    m_queue.push_back( vblank );
+    m_lastScheduledVblank = vblank;
+}
+
+uint64_t SimulatedPresentQueue::GetVblankCount() const
+{
+    return VblankIndex( Clock::now() );
+}
+
+void SimulatedPresentQueue::GetLastVblank( Clock::time_point& time, uint64_t& count ) const
+{
+    count = VblankIndex( Clock::now() );
+    time = VblankTime( count );
+}
+
+uint64_t SimulatedPresentQueue::GetDisplayedFrameCount() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_displayedFrames;
+}
+
+uint32_t SimulatedPresentQueue::GetQueuedFrameCount() const
+{
+    const uint64_t currentVblank = VblankIndex( Clock::now() );
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return static_cast<uint32_t>( std::count_if( m_queue.begin(), m_queue.end(), [currentVblank]( uint64_t vblank ) { return vblank > currentVblank; } ) );
+}
+
+// Index of the last vertical blank at or before time.
+uint64_t SimulatedPresentQueue::VblankIndex( Clock::time_point time ) const
+{
+    return static_cast<uint64_t>( ( time - m_origin ) / m_refreshPeriod );
+}
+
+SimulatedPresentQueue::Clock::time_point SimulatedPresentQueue::VblankTime( uint64_t index ) const
+{
+    return m_origin + m_refreshPeriod * static_cast<Clock::rep>( index );
+}
+
+void SimulatedPresentQueue::RetireLocked( Clock::time_point now )
+{
+    const uint64_t currentVblank = VblankIndex( now );
+    while (!m_queue.empty() && m_queue.front() <= currentVblank)
+    {
+        m_queue.pop_front();
+        m_admissions++;
+        m_displayedFrames++;
+    }
+}
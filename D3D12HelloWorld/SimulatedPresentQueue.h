@@ -0,0 +1,53 @@
+#pragma once
+
+#include "PresentQueue.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// A display that scans out at a fixed refresh rate, with a flip queue in front of it.
+// Each presented frame is shown at the first vertical blank after it was presented (and
+// after the frame before it), and leaves the queue then. Used by headless runs to pace
+// like a real display, and to exercise the pacing logic without a GPU.
+class SimulatedPresentQueue : public PresentQueue
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SimulatedPresentQueue( double refreshHz, uint32_t maximumFrameLatency );
+
+    void SetMaximumFrameLatency( uint32_t frames ) override;
+    uint32_t GetMaximumFrameLatency() const override;
+    bool WaitForFrame( uint32_t timeoutMs ) override;
+
+    // Throws std::logic_error if no WaitForFrame() admission is left to present.
+    void Present();
+
+    // Vertical blanks since construction, and frames that have reached the display.
+    uint64_t GetVblankCount() const;
+    void GetLastVblank( Clock::time_point& time, uint64_t& count ) const;
+    uint64_t GetDisplayedFrameCount() const;
+
+    // Frames presented but not yet shown.
+    uint32_t GetQueuedFrameCount() const;
+
+private:
+    uint64_t VblankIndex( Clock::time_point time ) const;
+    Clock::time_point VblankTime( uint64_t index ) const;
+    void RetireLocked( Clock::time_point now );
+
+    const Clock::time_point m_origin;
+    const Clock::duration m_refreshPeriod;
+
+    // Guards everything below.
+    mutable std::mutex m_mutex;
+    std::condition_variable m_retired;
+    uint32_t m_maximumFrameLatency;
+    int64_t m_admissions;               // Negative after lowering the latency with frames queued.
+    uint32_t m_unpresented;             // Admitted frames not presented yet.
+    std::deque<uint64_t> m_queue;       // Vertical blank each queued frame is shown at.
+    uint64_t m_lastScheduledVblank;
+    uint64_t m_displayedFrames;
+};
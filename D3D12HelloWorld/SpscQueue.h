@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// Capacity must be a power of two. Push() fails instead of blocking when the queue is
+// full, so the producer never waits on the consumer.
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert( Capacity > 0 && ( Capacity & ( Capacity - 1 ) ) == 0, "Capacity must be a power of two" );
+
+public:
+    SpscQueue() : m_head( 0 ), m_tail( 0 ) {}
+
+    SpscQueue( const SpscQueue& ) = delete;
+    SpscQueue& operator=( const SpscQueue& ) = delete;
+
+    // Producer only.
+    bool Push( const T& item )
+    {
+        const size_t tail = m_tail.load( std::memory_order_relaxed );
+        if (tail - m_head.load( std::memory_order_acquire ) == Capacity)
+        {
+            return false;
+        }
+
+        m_items[tail & ( Capacity - 1 )] = item;
+        m_tail.store( tail + 1, std::memory_order_release );
+        return true;
+    }
+
+    // Consumer only.
+    bool Pop( T& item )
+    {
+        const size_t head = m_head.load( std::memory_order_relaxed );
+        if (head == m_tail.load( std::memory_order_acquire ))
+        {
+            return false;
+        }
+
+        item = m_items[head & ( Capacity - 1 )];
+        m_head.store( head + 1, std::memory_order_release );
+        return true;
+    }
+
+private:
+    // Head and tail on separate cache lines, so the two threads do not share one.
+    alignas( 64 ) std::atomic<size_t> m_head;
+    alignas( 64 ) std::atomic<size_t> m_tail;
+    alignas( 64 ) T m_items[Capacity];
+};
@@ -0,0 +1,36 @@
+#include "hwpch.h"
+#include "SwapChainPresentQueue.h"
+
+SwapChainPresentQueue::SwapChainPresentQueue( IDXGISwapChain2* pSwapChain, uint32_t maximumFrameLatency )
+    : m_SwapChain( pSwapChain ),
+    m_frameLatencyWaitable( nullptr ),
+    m_maximumFrameLatency( 0 )
+{
+    SetMaximumFrameLatency( maximumFrameLatency );
+    m_frameLatencyWaitable = m_SwapChain->GetFrameLatencyWaitableObject();
+    if (!m_frameLatencyWaitable)
+    {
+        ThrowIfFailed( HRESULT_FROM_WIN32( GetLastError() ) );
+    }
+}
+
+SwapChainPresentQueue::~SwapChainPresentQueue()
+{
+    CloseHandle( m_frameLatencyWaitable );
+}
+
+void SwapChainPresentQueue::SetMaximumFrameLatency( uint32_t frames )
+{
+    ThrowIfFailed( m_SwapChain->SetMaximumFrameLatency( frames ) );
+    m_maximumFrameLatency.store( frames, std::memory_order_relaxed );
+}
+
+uint32_t SwapChainPresentQueue::GetMaximumFrameLatency() const
+{
+    return m_maximumFrameLatency.load( std::memory_order_relaxed );
+}
+
+bool SwapChainPresentQueue::WaitForFrame( uint32_t timeoutMs )
+{
+    return WaitForSingleObjectEx( m_frameLatencyWaitable, timeoutMs, TRUE ) == WAIT_OBJECT_0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Helpers.h"
+#include "PresentQueue.h"
+
+#include <atomic>
+
+// PresentQueue over a swap chain created with DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT.
+// Waiting on the frame latency object before a frame starts keeps Present() from blocking,
+// so the frame is built from the freshest input instead of waiting behind queued frames.
+class SwapChainPresentQueue : public PresentQueue
+{
+public:
+    SwapChainPresentQueue( IDXGISwapChain2* pSwapChain, uint32_t maximumFrameLatency );
+    ~SwapChainPresentQueue();
+
+    SwapChainPresentQueue( const SwapChainPresentQueue& ) = delete;
+    SwapChainPresentQueue& operator=( const SwapChainPresentQueue& ) = delete;
+
+    // Call on the thread that presents; waiting is safe from any thread.
+    void SetMaximumFrameLatency( uint32_t frames ) override;
+    uint32_t GetMaximumFrameLatency() const override;
+    bool WaitForFrame( uint32_t timeoutMs ) override;
+
+private:
+    ComPtr<IDXGISwapChain2> m_SwapChain;
+    HANDLE m_frameLatencyWaitable;
+    std::atomic<uint32_t> m_maximumFrameLatency;
+};
@@ -0,0 +1,219 @@
+// Compiled without the precompiled header; the task graph only depends on the standard library
+// and the job system.
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+TaskGraph::TaskGraph( JobSystem& jobs )
+    : m_origin( Clock::now() ),
+    m_jobs( jobs ),
+    m_completed( 0 ),
+    m_started( false )
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_taskCompleted.wait( lock, [this] { return !m_started || m_completed == m_tasks.size(); } );
+    }
+
+    // The last task's job may still be unwinding after it reported completion.
+    m_jobs.Wait( m_runningJobs );
+}
+
+TaskGraph::TaskId TaskGraph::Add( const char* name, std::function<void()> work, std::initializer_list<TaskId> dependencies )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    if (m_started)
+    {
+        throw std::logic_error( "Tasks must be added before the graph is started." );
+    }
+
+    const TaskId id = static_cast<TaskId>( m_tasks.size() );
+    m_tasks.push_back( { name, std::move( work ), {}, 0, false, TaskState::Pending, 0, {}, {}, nullptr } );
+
+    for (TaskId dependency : dependencies)
+    {
+        m_tasks[dependency].dependents.push_back( id );
+        m_tasks[id].pendingDependencies++;
+    }
+    return id;
+}
+
+TaskGraph::TaskId TaskGraph::AddExternal( const char* name )
+{
+    const TaskId id = Add( name, nullptr );
+
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_tasks[id].external = true;
+    return id;
+}
+
+void TaskGraph::Start()
+{
+    std::vector<TaskId> ready;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_started = true;
+        for (TaskId id = 0; id < m_tasks.size(); id++)
+        {
+            if (!m_tasks[id].external && m_tasks[id].pendingDependencies == 0)
+            {
+                m_tasks[id].state = TaskState::Ready;
+                ready.push_back( id );
+            }
+        }
+    }
+    Dispatch( ready );
+}
+
+void TaskGraph::BeginExternal( TaskId task )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_tasks[task].state = TaskState::Running;
+    m_tasks[task].start = Clock::now();
+}
+
+void TaskGraph::CompleteExternal( TaskId task, std::exception_ptr error )
+{
+    std::vector<TaskId> ready;
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        FinishLocked( task, error, ready );
+    }
+    m_taskCompleted.notify_all();
+    Dispatch( ready );
+}
+
+void TaskGraph::Wait( TaskId task )
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    m_taskCompleted.wait( lock, [this, task] { return m_tasks[task].state == TaskState::Complete; } );
+    if (m_tasks[task].error)
+    {
+        std::rethrow_exception( m_tasks[task].error );
+    }
+}
+
+void TaskGraph::WaitAll()
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    m_taskCompleted.wait( lock, [this] { return m_completed == m_tasks.size(); } );
+    for (const Task& task : m_tasks)
+    {
+        if (task.error)
+        {
+            std::rethrow_exception( task.error );
+        }
+    }
+}
+
+bool TaskGraph::IsComplete( TaskId task ) const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_tasks[task].state == TaskState::Complete;
+}
+
+double TaskGraph::ElapsedMs() const
+{
+    return std::chrono::duration<double, std::milli>( Clock::now() - m_origin ).count();
+}
+
+std::string TaskGraph::Report() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+
+    std::vector<const Task*> sorted;
+    for (const Task& task : m_tasks)
+    {
+        sorted.push_back( &task );
+    }
+    std::sort( sorted.begin(), sorted.end(), []( const Task* a, const Task* b ) { return a->start < b->start; } );
+
+    std::string report;
+    char line[256];
+    for (const Task* pTask : sorted)
+    {
+        if (pTask->state != TaskState::Complete)
+        {
+            snprintf( line, sizeof( line ), "%-28s (not finished)\n", pTask->name.c_str() );
+        }
+        else
+        {
+            const double start = std::chrono::duration<double, std::milli>( pTask->start - m_origin ).count();
+            const double duration = std::chrono::duration<double, std::milli>( pTask->end - pTask->start ).count();
+            snprintf( line, sizeof( line ), "%-28s start %8.2f ms  duration %8.2f ms  thread %u%s\n",
+                pTask->name.c_str(), start, duration, pTask->threadIndex, pTask->error ? "  FAILED" : "" );
+        }
+        report += line;
+    }
+    return report;
+}
+
+void TaskGraph::RunTask( TaskId id )
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    Task& task = m_tasks[id];
+    task.state = TaskState::Running;
+    task.threadIndex = m_jobs.GetCurrentWorkerIndex();
+    task.start = Clock::now();
+
+    std::exception_ptr error = task.error;
+    if (!error)
+    {
+        lock.unlock();
+        try
+        {
+            task.work();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        lock.lock();
+    }
+
+    std::vector<TaskId> ready;
+    FinishLocked( id, error, ready );
+    lock.unlock();
+
+    m_taskCompleted.notify_all();
+    Dispatch( ready );
+}
+
+// A failed task fails its dependents without running them.
+void TaskGraph::FinishLocked( TaskId id, std::exception_ptr error, std::vector<TaskId>& ready )
+{
+    Task& task = m_tasks[id];
+    task.end = Clock::now();
+    task.error = error;
+    task.state = TaskState::Complete;
+    m_completed++;
+
+    for (TaskId dependentId : task.dependents)
+    {
+        Task& dependent = m_tasks[dependentId];
+        if (error && !dependent.error)
+        {
+            dependent.error = error;
+        }
+
+        if (--dependent.pendingDependencies == 0 && !dependent.external)
+        {
+            dependent.state = TaskState::Ready;
+            ready.push_back( dependentId );
+        }
+    }
+}
+
+void TaskGraph::Dispatch( const std::vector<TaskId>& ready )
+{
+    for (TaskId id : ready)
+    {
+        m_jobs.Run( [this, id] { RunTask( id ); }, &m_runningJobs );
+    }
+}
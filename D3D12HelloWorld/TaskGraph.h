@@ -0,0 +1,89 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Dependency graph of one-shot tasks run on the job system, with per-task timing. Built
+// for startup: everything is added up front, Start() queues the tasks that have no
+// dependencies, and callers wait only on the tasks they need. External tasks are run by the caller
+// (e.g. work that must stay on the window thread) but take part in dependencies and
+// timing like any other task.
+class TaskGraph
+{
+public:
+    using TaskId = uint32_t;
+    using Clock = std::chrono::steady_clock;
+
+    explicit TaskGraph( JobSystem& jobs );
+    ~TaskGraph();
+
+    TaskGraph( const TaskGraph& ) = delete;
+    TaskGraph& operator=( const TaskGraph& ) = delete;
+
+    TaskId Add( const char* name, std::function<void()> work, std::initializer_list<TaskId> dependencies = {} );
+    TaskId AddExternal( const char* name );
+
+    void Start();
+
+    void BeginExternal( TaskId task );
+    void CompleteExternal( TaskId task, std::exception_ptr error = nullptr );
+
+    // Rethrows the exception of the task or of the dependency that prevented it from running.
+    void Wait( TaskId task );
+    void WaitAll();
+    bool IsComplete( TaskId task ) const;
+
+    // Milliseconds since the graph was created.
+    double ElapsedMs() const;
+
+    // One line per task: start, duration, and the job worker it ran on (0 = another thread,
+    // e.g. external tasks).
+    std::string Report() const;
+
+private:
+    enum class TaskState
+    {
+        Pending,
+        Ready,
+        Running,
+        Complete
+    };
+
+    struct Task
+    {
+        std::string name;
+        std::function<void()> work;
+        std::vector<TaskId> dependents;
+        uint32_t pendingDependencies;
+        bool external;
+        TaskState state;
+        uint32_t threadIndex;
+        Clock::time_point start;
+        Clock::time_point end;
+        std::exception_ptr error;
+    };
+
+    void RunTask( TaskId task );
+    void FinishLocked( TaskId task, std::exception_ptr error, std::vector<TaskId>& ready );
+    void Dispatch( const std::vector<TaskId>& ready );
+
+    Clock::time_point m_origin;
+    JobSystem& m_jobs;
+    JobCounter m_runningJobs;
+
+    // Guards everything below.
+    mutable std::mutex m_mutex;
+    std::condition_variable m_taskCompleted;
+    std::vector<Task> m_tasks;
+    uint32_t m_completed;
+    bool m_started;
+};
@@ -0,0 +1,165 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Events are written with relaxed atomic stores (plain moves on x64), so a reader racing
+// a writer sees stale or new values but never undefined behaviour. The head is published
+// after each event; a reader drops every slot the writer may have started overwriting.
+struct Trace::Track
+{
+    struct Event
+    {
+        std::atomic<const char*> name;
+        std::atomic<uint64_t> begin;
+        std::atomic<uint64_t> end;
+    };
+
+    std::atomic<const char*> name;
+    uint32_t id;
+    std::atomic<uint64_t> head;
+    Event events[Capacity];
+};
+
+namespace
+{
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Trace::Track>> tracks;
+    };
+
+    // Tracks are never freed, so a thread's scopes can be written after it has exited.
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    thread_local Trace::Track* t_pTrack = nullptr;
+
+    struct CompleteEvent
+    {
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    void EscapeJson( std::ostream& out, const char* str )
+    {
+        for (; *str; ++str)
+        {
+            if (*str == '"' || *str == '\\')
+            {
+                out << '\\';
+            }
+            if (static_cast<unsigned char>( *str ) >= 0x20)
+            {
+                out << *str;
+            }
+        }
+    }
+}
+
+void Trace::SetThreadName( const char* name )
+{
+    GetThreadTrack()->name.store( name, std::memory_order_relaxed );
+}
+
+Trace::Track* Trace::GetThreadTrack()
+{
+    if (!t_pTrack)
+    {
+        t_pTrack = CreateTrack( "Thread" );
+    }
+    return t_pTrack;
+}
+
+Trace::Track* Trace::CreateTrack( const char* name )
+{
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock( registry.mutex );
+
+    std::unique_ptr<Track> track( new Track() );
+    track->name.store( name, std::memory_order_relaxed );
+    track->id = static_cast<uint32_t>( registry.tracks.size() ) + 1;
+    track->head.store( 0, std::memory_order_relaxed );
+    registry.tracks.push_back( std::move( track ) );
+    return registry.tracks.back().get();
+}
+
+void Trace::Record( Track* pTrack, const char* name, uint64_t beginNs, uint64_t endNs )
+{
+    const uint64_t head = pTrack->head.load( std::memory_order_relaxed );
+    Track::Event& event = pTrack->events[head % Capacity];
+    event.name.store( name, std::memory_order_relaxed );
+    event.begin.store( beginNs, std::memory_order_relaxed );
+    event.end.store( endNs, std::memory_order_relaxed );
+    pTrack->head.store( head + 1, std::memory_order_release );
+}
+
+void Trace::WriteChromeTrace( std::ostream& out )
+{
+    std::vector<Track*> tracks;
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock( registry.mutex );
+        for (const auto& track : registry.tracks)
+        {
+            tracks.push_back( track.get() );
+        }
+    }
+
+    // Copy every ring first, so that timestamps can be made relative to the earliest one.
+    std::vector<std::vector<CompleteEvent>> events( tracks.size() );
+    uint64_t origin = UINT64_MAX;
+    for (size_t i = 0; i < tracks.size(); ++i)
+    {
+        Track& track = *tracks[i];
+        const uint64_t head = track.head.load( std::memory_order_acquire );
+        const uint64_t first = head > Capacity ? head - Capacity : 0;
+        for (uint64_t index = first; index < head; ++index)
+        {
+            const Track::Event& event = track.events[index % Capacity];
+            // Acquire loads keep the head re-read below from moving ahead of the copy.
+            events[i].push_back( { event.name.load( std::memory_order_acquire ), event.begin.load( std::memory_order_acquire ), event.end.load( std::memory_order_acquire ) } );
+        }
+
+        // Drop the slots overwritten meanwhile, including the one the writer may be
+        // part-way into.
+        const uint64_t newHead = track.head.load( std::memory_order_acquire );
+        const uint64_t firstValid = newHead + 1 > Capacity ? newHead + 1 - Capacity : 0;
+        if (firstValid > first)
+        {
+            events[i].erase( events[i].begin(), events[i].begin() + static_cast<size_t>( std::min( firstValid - first, head - first ) ) );
+        }
+
+        for (const CompleteEvent& event : events[i])
+        {
+            origin = std::min( origin, event.begin );
+        }
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    const char* separator = "\n";
+    for (size_t i = 0; i < tracks.size(); ++i)
+    {
+        out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tracks[i]->id << ",\"args\":{\"name\":\"";
+        EscapeJson( out, tracks[i]->name.load( std::memory_order_relaxed ) );
+        out << "\"}}";
+        separator = ",\n";
+
+        char times[64];
+        for (const CompleteEvent& event : events[i])
+        {
+            snprintf( times, sizeof( times ), "\"ts\":%.3f,\"dur\":%.3f", ( event.begin - origin ) / 1000.0, ( event.end - event.begin ) / 1000.0 );
+            out << separator << "{\"name\":\"";
+            EscapeJson( out, event.name );
+            out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tracks[i]->id << "," << times << "}";
+        }
+    }
+    out << "\n]}\n";
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Tracing compiles out entirely (HW_TRACE_SCOPE expands to nothing) unless enabled.
+#if !defined(HW_TRACING_ENABLED)
+#define HW_TRACING_ENABLED 1
+#endif
+
+// Low-overhead timeline of CPU (and GPU) scopes, written as Chrome trace-event JSON
+// (load it in chrome://tracing or Perfetto). Each thread records into its own ring buffer
+// without locks; a ring keeps the most recent Capacity scopes. Tracks not tied to a
+// thread, such as a GPU queue, are created explicitly and must also have a single writer.
+//
+// Timestamps are nanoseconds on the steady clock, which is QueryPerformanceCounter on
+// Windows, so GPU timestamps calibrated against QPC line up with CPU scopes.
+class Trace
+{
+public:
+    struct Track;
+
+    static const uint32_t Capacity = 1 << 14;
+
+    static uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    // name must be a string literal (or otherwise outlive the trace), as must scope names.
+    static void SetThreadName( const char* name );
+    static Track* GetThreadTrack();
+    static Track* CreateTrack( const char* name );
+
+    static void Record( Track* pTrack, const char* name, uint64_t beginNs, uint64_t endNs );
+
+    // Safe to call while other threads are recording; scopes being overwritten are dropped.
+    static void WriteChromeTrace( std::ostream& out );
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope( const char* name ) : m_name( name ), m_begin( Trace::Now() ) {}
+    ~TraceScope() { Trace::Record( Trace::GetThreadTrack(), m_name, m_begin, Trace::Now() ); }
+
+    TraceScope( const TraceScope& ) = delete;
+    TraceScope& operator=( const TraceScope& ) = delete;
+
+private:
+    const char* m_name;
+    const uint64_t m_begin;
+};
+
+#if HW_TRACING_ENABLED
+#define HW_TRACE_CONCAT_INNER( a, b ) a##b
+#define HW_TRACE_CONCAT( a, b ) HW_TRACE_CONCAT_INNER( a, b )
+#define HW_TRACE_SCOPE( name ) TraceScope HW_TRACE_CONCAT( traceScope, __LINE__ )( name )
+#else
+#define HW_TRACE_SCOPE( name ) ( (void)0 )
+#endif
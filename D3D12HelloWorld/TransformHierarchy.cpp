@@ -0,0 +1,295 @@
+// Compiled without the precompiled header: besides the job system it only needs
+// DirectXMath, which is header-only, so the hierarchy can be benchmarked outside the app.
+#include "TransformHierarchy.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+
+using namespace DirectX;
+
+namespace
+{
+    // Nodes per job when a level is split across the job system.
+    const uint32_t UpdateGrain = 2048;
+}
+
+TransformHierarchy::TransformHierarchy()
+    : m_levelStarts( 1, 0 ),
+    m_sorted( true ),
+    m_anyDirty( false )
+{
+}
+
+void TransformHierarchy::Reserve( uint32_t nodeCount )
+{
+    m_parents.reserve( nodeCount );
+    m_locals.reserve( nodeCount );
+    m_worlds.reserve( nodeCount );
+    m_dirty.reserve( nodeCount );
+    m_ids.reserve( nodeCount );
+    m_parentIds.reserve( nodeCount );
+    m_positions.reserve( nodeCount );
+}
+
+TransformHierarchy::NodeId TransformHierarchy::AddNode( NodeId parent, FXMMATRIX local )
+{
+    if (parent != NoParent && parent >= m_positions.size())
+    {
+        throw std::invalid_argument( "Parent node does not exist" );
+    }
+
+    // Appended at the end; Update() sorts it into its level and sets its parent's position.
+    const NodeId id = static_cast<NodeId>( m_positions.size() );
+    const uint32_t position = static_cast<uint32_t>( m_parents.size() );
+    m_parents.push_back( 0 );
+    m_locals.emplace_back();
+    XMStoreFloat4x4A( &m_locals.back(), local );
+    m_worlds.emplace_back();
+    XMStoreFloat4x4A( &m_worlds.back(), local );
+    m_dirty.push_back( 1 );
+    m_ids.push_back( id );
+    m_parentIds.push_back( parent );
+    m_positions.push_back( position );
+
+    m_sorted = false;
+    m_anyDirty = true;
+    return id;
+}
+
+void TransformHierarchy::SetParent( NodeId node, NodeId parent )
+{
+    if (node >= m_positions.size() || ( parent != NoParent && parent >= m_positions.size() ))
+    {
+        throw std::invalid_argument( "Node does not exist" );
+    }
+    for (NodeId ancestor = parent; ancestor != NoParent; ancestor = m_parentIds[ancestor])
+    {
+        if (ancestor == node)
+        {
+            throw std::invalid_argument( "A node cannot be moved under itself" );
+        }
+    }
+
+    // Its depth, and that of its subtree, may change: re-sorted on the next Update(). The
+    // subtree follows through the dirty flag.
+    m_parentIds[node] = parent;
+    m_dirty[m_positions[node]] = 1;
+    m_sorted = false;
+    m_anyDirty = true;
+}
+
+void TransformHierarchy::SetLocal( NodeId node, FXMMATRIX local )
+{
+    const uint32_t position = m_positions[node];
+    XMStoreFloat4x4A( &m_locals[position], local );
+    m_dirty[position] = 1;
+    m_anyDirty = true;
+}
+
+XMMATRIX TransformHierarchy::GetLocal( NodeId node ) const
+{
+    return XMLoadFloat4x4A( &m_locals[m_positions[node]] );
+}
+
+XMMATRIX TransformHierarchy::GetWorld( NodeId node ) const
+{
+    return XMLoadFloat4x4A( &m_worlds[m_positions[node]] );
+}
+
+// Stable counting sort by depth: nodes keep their relative order within a level.
+void TransformHierarchy::SortByDepth()
+{
+    const uint32_t count = GetNodeCount();
+
+    // Depths by node id, from the parents. A node may have been moved under one with a
+    // higher id, so each walks up to the first ancestor whose depth is known.
+    std::vector<uint32_t> depths( count, UINT32_MAX );
+    std::vector<NodeId> chain;
+    for (NodeId id = 0; id < count; id++)
+    {
+        NodeId ancestor = id;
+        while (ancestor != NoParent && depths[ancestor] == UINT32_MAX)
+        {
+            chain.push_back( ancestor );
+            ancestor = m_parentIds[ancestor];
+        }
+
+        uint32_t depth = ancestor != NoParent ? depths[ancestor] + 1 : 0;
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        {
+            depths[*it] = depth++;
+        }
+        chain.clear();
+    }
+
+    const uint32_t levelCount = count != 0 ? *std::max_element( depths.begin(), depths.end() ) + 1 : 0;
+    m_levelStarts.assign( levelCount + 1, 0 );
+    for (uint32_t depth : depths)
+    {
+        m_levelStarts[depth + 1]++;
+    }
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        m_levelStarts[level + 1] += m_levelStarts[level];
+    }
+
+    // New positions, visiting the nodes in their current order.
+    std::vector<uint32_t> next( m_levelStarts.begin(), m_levelStarts.end() - 1 );
+    for (uint32_t position = 0; position < count; position++)
+    {
+        const NodeId id = m_ids[position];
+        m_positions[id] = next[depths[id]]++;
+    }
+
+    std::vector<uint32_t> parents( count );
+    std::vector<XMFLOAT4X4A> locals( count );
+    std::vector<XMFLOAT4X4A> worlds( count );
+    std::vector<uint8_t> dirty( count );
+    std::vector<NodeId> ids( count );
+    for (uint32_t position = 0; position < count; position++)
+    {
+        const NodeId id = m_ids[position];
+        const uint32_t newPosition = m_positions[id];
+        parents[newPosition] = m_parentIds[id] != NoParent ? m_positions[m_parentIds[id]] : 0;
+        locals[newPosition] = m_locals[position];
+        worlds[newPosition] = m_worlds[position];
+        dirty[newPosition] = m_dirty[position];
+        ids[newPosition] = id;
+    }
+    m_parents.swap( parents );
+    m_locals.swap( locals );
+    m_worlds.swap( worlds );
+    m_dirty.swap( dirty );
+    m_ids.swap( ids );
+    m_sorted = true;
+}
+
+// Level by level, since each level reads the world matrices of the one before. A node's
+// dirty flag is set from its parent's as the level is processed, so a change reaches the
+// whole subtree below it; the flags are cleared once every level is done.
+uint32_t TransformHierarchy::Update( JobSystem& jobs )
+{
+    if (!m_anyDirty)
+    {
+        return 0;
+    }
+    if (!m_sorted)
+    {
+        SortByDepth();
+    }
+
+    std::atomic<uint32_t> updated( 0 );
+    const uint32_t* pParents = m_parents.data();
+    const XMFLOAT4X4A* pLocals = m_locals.data();
+    XMFLOAT4X4A* pWorlds = m_worlds.data();
+    uint8_t* pDirty = m_dirty.data();
+    for (uint32_t level = 0; level < GetLevelCount(); level++)
+    {
+        const uint32_t first = m_levelStarts[level];
+        const bool roots = level == 0;
+        jobs.ParallelFor( m_levelStarts[level + 1] - first, [=, &updated]( uint32_t begin, uint32_t end )
+        {
+            uint32_t rangeUpdated = 0;
+            for (uint32_t node = first + begin; node < first + end; node++)
+            {
+                if (roots)
+                {
+                    if (pDirty[node])
+                    {
+                        pWorlds[node] = pLocals[node];
+                        rangeUpdated++;
+                    }
+                }
+                else if (pDirty[node] | pDirty[pParents[node]])
+                {
+                    pDirty[node] = 1;
+                    XMStoreFloat4x4A( &pWorlds[node], XMMatrixMultiply( XMLoadFloat4x4A( &pLocals[node] ), XMLoadFloat4x4A( &pWorlds[pParents[node]] ) ) );
+                    rangeUpdated++;
+                }
+            }
+            updated.fetch_add( rangeUpdated, std::memory_order_relaxed );
+        }, UpdateGrain );
+    }
+
+    std::fill( m_dirty.begin(), m_dirty.end(), 0 );
+    m_anyDirty = false;
+    return updated.load( std::memory_order_relaxed );
+}
+
+std::string BenchmarkTransforms( JobSystem& jobs, uint32_t nodeCount )
+{
+    using Clock = std::chrono::steady_clock;
+    const int Runs = 10;
+    const uint32_t RootCount = 16;
+
+    // Sixteen roots, then eight children per node in breadth-first order: about seven
+    // levels for half a million nodes.
+    std::mt19937 random( 12345 );
+    std::uniform_real_distribution<float> angle( -XM_PI, XM_PI );
+    std::uniform_real_distribution<float> offset( -1.0f, 1.0f );
+    auto randomLocal = [&]
+    {
+        return XMMatrixMultiply( XMMatrixRotationY( angle( random ) ), XMMatrixTranslation( offset( random ), offset( random ), offset( random ) ) );
+    };
+
+    TransformHierarchy hierarchy;
+    hierarchy.Reserve( nodeCount );
+    for (uint32_t i = 0; i < nodeCount; i++)
+    {
+        hierarchy.AddNode( i < RootCount ? TransformHierarchy::NoParent : ( i - RootCount ) / 8, randomLocal() );
+    }
+    hierarchy.Update( jobs );
+
+    // Each scenario changes its nodes before every timed update.
+    std::vector<TransformHierarchy::NodeId> partial;
+    for (uint32_t i = 0; i < nodeCount; i++)
+    {
+        if (random() % 100 == 0)
+        {
+            partial.push_back( i );
+        }
+    }
+    std::vector<TransformHierarchy::NodeId> roots;
+    for (uint32_t i = 0; i < std::min( RootCount, nodeCount ); i++)
+    {
+        roots.push_back( i );
+    }
+
+    struct Scenario
+    {
+        const char* name;
+        const std::vector<TransformHierarchy::NodeId>* pChanged;
+    };
+    const std::vector<TransformHierarchy::NodeId> none;
+    const Scenario scenarios[] = { { "static", &none }, { "partial", &partial }, { "full", &roots } };
+
+    std::string report;
+    char line[256];
+    snprintf( line, sizeof( line ), "Transform benchmark: %u nodes, %u levels, %u threads, best of %d runs\n", nodeCount, hierarchy.GetLevelCount(), jobs.GetWorkerCount() + 1, Runs );
+    report += line;
+    for (const Scenario& scenario : scenarios)
+    {
+        double bestMs = 0.0;
+        uint32_t updated = 0;
+        for (int run = 0; run <= Runs; run++)
+        {
+            for (TransformHierarchy::NodeId node : *scenario.pChanged)
+            {
+                hierarchy.SetLocal( node, XMMatrixMultiply( hierarchy.GetLocal( node ), XMMatrixRotationY( 0.01f ) ) );
+            }
+
+            const Clock::time_point start = Clock::now();
+            updated = hierarchy.Update( jobs );
+            const double ms = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+            bestMs = run == 1 ? ms : std::min( bestMs, ms );
+        }
+        snprintf( line, sizeof( line ), "%-8s %8.3f ms   %u changed   %u updated\n", scenario.name, bestMs, static_cast<uint32_t>( scenario.pChanged->size() ), updated );
+        report += line;
+    }
+    return report;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+// Scene graph transforms in data-oriented form. Each node has a local transform relative
+// to its parent and a world transform; both are kept in contiguous arrays, with the parent
+// indices and dirty flags alongside, sorted by depth in the hierarchy so that a node's
+// parent always comes before it. Update() walks the levels in order and computes the
+// world matrices of each level in parallel; a node is recomputed only if it or one of its
+// ancestors changed since the last update.
+//
+// Matrices are in DirectXMath's row-vector convention: world = local * parent world.
+// Nodes are named by the id AddNode() returns, which stays valid when the arrays are
+// re-sorted.
+class TransformHierarchy
+{
+public:
+    using NodeId = uint32_t;
+    static const NodeId NoParent = UINT32_MAX;
+
+    TransformHierarchy();
+
+    TransformHierarchy( const TransformHierarchy& ) = delete;
+    TransformHierarchy& operator=( const TransformHierarchy& ) = delete;
+
+    void Reserve( uint32_t nodeCount );
+
+    // parent must already exist (or be NoParent). The new node starts dirty.
+    NodeId AddNode( NodeId parent, DirectX::FXMMATRIX local );
+
+    // Moves the node, with its subtree, under another parent (or makes it a root). The
+    // local transform is kept, so the subtree moves with its new parent. Throws if parent
+    // is the node itself or one of its descendants.
+    void SetParent( NodeId node, NodeId parent );
+
+    void SetLocal( NodeId node, DirectX::FXMMATRIX local );
+    DirectX::XMMATRIX GetLocal( NodeId node ) const;
+
+    // As of the last Update().
+    DirectX::XMMATRIX GetWorld( NodeId node ) const;
+
+    // Re-sorts first if nodes were added or moved. Returns the number of world matrices
+    // recomputed.
+    uint32_t Update( JobSystem& jobs );
+
+    uint32_t GetNodeCount() const { return static_cast<uint32_t>( m_parents.size() ); }
+    uint32_t GetLevelCount() const { return static_cast<uint32_t>( m_levelStarts.size() ) - 1; }
+
+private:
+    void SortByDepth();
+
+    // Indexed by position in depth order. Roots make up the first level, and their parent
+    // index is unused.
+    std::vector<uint32_t> m_parents;
+    std::vector<DirectX::XMFLOAT4X4A> m_locals;
+    std::vector<DirectX::XMFLOAT4X4A> m_worlds;
+    std::vector<uint8_t> m_dirty;
+    std::vector<NodeId> m_ids;
+
+    // Indexed by node id: its parent's id, and its position in the arrays above. The
+    // positions of the parents and the depth levels are derived from these when sorting;
+    // level d spans [m_levelStarts[d], m_levelStarts[d + 1]).
+    std::vector<NodeId> m_parentIds;
+    std::vector<uint32_t> m_positions;
+    std::vector<uint32_t> m_levelStarts;
+    bool m_sorted;
+    bool m_anyDirty;
+};
+
+// Times Update() on a generated hierarchy of nodeCount nodes with nothing changed, with
+// about one percent of the nodes changed (and so their subtrees), and with every root
+// changed, and returns a report.
+std::string BenchmarkTransforms( JobSystem& jobs, uint32_t nodeCount );
@@ -0,0 +1,88 @@
+#include "hwpch.h"
+#include "UploadRing.h"
+
+UploadRing::UploadRing()
+    : m_pData( nullptr ),
+    m_size( 0 ),
+    m_head( 0 ),
+    m_tail( 0 ),
+    m_used( 0 ),
+    m_frameBytes( 0 )
+{
+}
+
+UploadRing::~UploadRing()
+{
+    if (m_Buffer)
+    {
+        m_Buffer->Unmap( 0, nullptr );
+    }
+}
+
+void UploadRing::Initialize( ID3D12Device* pDevice, uint64_t size )
+{
+    ThrowIfFailed( pDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES( D3D12_HEAP_TYPE_UPLOAD ),
+        D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer( size ),
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS( &m_Buffer )
+    ) );
+
+    // Upload heaps may stay mapped; the CPU never reads from it.
+    CD3DX12_RANGE readRange( 0, 0 );
+    ThrowIfFailed( m_Buffer->Map( 0, &readRange, reinterpret_cast<void**>( &m_pData ) ) );
+    m_size = size;
+}
+
+UploadRing::Allocation UploadRing::Allocate( uint64_t size, uint64_t alignment )
+{
+    // Start over at the beginning whenever the ring drains, so large allocations fit.
+    if (m_used == 0)
+    {
+        m_head = 0;
+        m_tail = 0;
+    }
+
+    uint64_t offset = ( m_head + alignment - 1 ) & ~( alignment - 1 );
+    const bool full = m_used != 0 && m_head == m_tail;
+    if (full || ( m_head < m_tail && offset + size > m_tail ))
+    {
+        throw std::runtime_error( "Upload ring is out of space" );
+    }
+    if (m_head >= m_tail && offset + size > m_size)
+    {
+        // Skip the rest of the buffer and wrap around.
+        offset = 0;
+        if (size > m_tail)
+        {
+            throw std::runtime_error( "Upload ring is out of space" );
+        }
+    }
+
+    const uint64_t bytes = offset >= m_head ? offset + size - m_head : m_size - m_head + size;
+    m_used += bytes;
+    m_frameBytes += bytes;
+    m_head = offset + size;
+    return { m_pData + offset, m_Buffer->GetGPUVirtualAddress() + offset };
+}
+
+void UploadRing::EndFrame( uint64_t fenceValue )
+{
+    if (m_frameBytes != 0)
+    {
+        m_frames.push_back( { fenceValue, m_head, m_frameBytes } );
+        m_frameBytes = 0;
+    }
+}
+
+void UploadRing::Reclaim( uint64_t completedFenceValue )
+{
+    while (!m_frames.empty() && m_frames.front().fenceValue <= completedFenceValue)
+    {
+        m_tail = m_frames.front().end;
+        m_used -= m_frames.front().bytes;
+        m_frames.pop_front();
+    }
+}
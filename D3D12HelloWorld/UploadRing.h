@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Helpers.h"
+
+#include <deque>
+
+// Per-frame data the CPU writes and the GPU reads once, sub-allocated from one persistently
+// mapped upload-heap buffer used as a ring. Allocations made between two EndFrame() calls
+// belong to that frame, and their space comes back once the GPU has passed the frame's
+// fence value. The ring never waits: it must be sized for every frame that can be in
+// flight, and Allocate() throws if it is not.
+class UploadRing
+{
+public:
+    struct Allocation
+    {
+        void* pData;
+        D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+    };
+
+    UploadRing();
+    ~UploadRing();
+
+    UploadRing( const UploadRing& ) = delete;
+    UploadRing& operator=( const UploadRing& ) = delete;
+
+    void Initialize( ID3D12Device* pDevice, uint64_t size );
+
+    Allocation Allocate( uint64_t size, uint64_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT );
+
+    // Tags everything allocated since the last call with the fence value the queue will
+    // signal once the frame's command lists have executed.
+    void EndFrame( uint64_t fenceValue );
+
+    // Frees the space of frames the GPU has finished with.
+    void Reclaim( uint64_t completedFenceValue );
+
+    uint64_t GetSize() const { return m_size; }
+
+private:
+    struct Frame
+    {
+        uint64_t fenceValue;
+        uint64_t end;       // m_head when the frame ended.
+        uint64_t bytes;     // Including padding and space skipped at the wrap.
+    };
+
+    ComPtr<ID3D12Resource> m_Buffer;
+    uint8_t* m_pData;
+    uint64_t m_size;
+
+    // Allocations go at m_head; m_tail is the start of the oldest frame still in use.
+    // m_used disambiguates head == tail (empty or full).
+    uint64_t m_head;
+    uint64_t m_tail;
+    uint64_t m_used;
+    uint64_t m_frameBytes;
+    std::deque<Frame> m_frames;
+};
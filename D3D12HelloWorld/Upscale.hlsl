@@ -0,0 +1,34 @@
+// Stretches the part of the scene target that was rendered to (the top-left renderScale
+// of it) over the whole output.
+
+cbuffer UpscaleConstants : register(b0)
+{
+    float2 uvScale;     // Rendered size over the scene target size.
+    float2 uvMax;       // Half a texel inside the rendered area, so filtering stays in it.
+};
+
+Texture2D sceneTexture : register(t0);
+SamplerState linearSampler : register(s0);
+
+struct PSInput
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD;
+};
+
+// One triangle that covers the viewport; no vertex buffer.
+PSInput VSMain(uint vertexId : SV_VertexID)
+{
+    PSInput result;
+
+    const float2 uv = float2((vertexId << 1) & 2, vertexId & 2);
+    result.position = float4(uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+    result.uv = uv;
+
+    return result;
+}
+
+float4 PSMain(PSInput input) : SV_TARGET
+{
+    return sceneTexture.SampleLevel(linearSampler, min(input.uv * uvScale, uvMax), 0);
+}
@@ -2,6 +2,18 @@
 #include "Window.h"
 
 HWND Window::m_hWnd = nullptr;
+App* Window::m_pSample = nullptr;
+std::thread Window::m_renderThread;
+std::atomic<bool> Window::m_stopRendering( false );
+std::atomic<bool> Window::m_renderThreadExited( false );
+std::exception_ptr Window::m_renderError;
+SpscQueue<WindowEvent, 256> Window::m_events;
+HANDLE Window::m_eventPosted = nullptr;
+std::mutex Window::m_resizeMutex;
+WindowEvent Window::m_pendingResize = {};
+bool Window::m_resizePending = false;
+std::mutex Window::m_titleMutex;
+std::wstring Window::m_pendingTitle;
 
 int Window::Run( App* pSample, HINSTANCE hInstance, int nCmdShow )
 {
@@ -15,6 +27,10 @@ int Window::Run( App* pSample, HINSTANCE hInstance, int nCmdShow )
     wc.lpszClassName = L"DXSampleClass";
     RegisterClassEx( &wc );
 
+    // Created before the window, whose first WM_SIZE already signals it.
+    m_eventPosted = CreateEvent( nullptr, FALSE, FALSE, nullptr );
+    m_pSample = pSample;
+
     RECT windowRect = { 0, 0, static_cast<LONG>(pSample->GetWidth()), static_cast<LONG>( pSample->GetHeight() ) };
     AdjustWindowRect( &windowRect, WS_OVERLAPPED, false );
 
@@ -36,29 +52,172 @@ int Window::Run( App* pSample, HINSTANCE hInstance, int nCmdShow )
     // Initialize the sample. OnInit is defined in each child-implementation of DXSample.
     pSample->OnInit();
 
-    ShowWindow( m_hWnd, nCmdShow );
+    // Headless runs keep the window hidden; it only drives the message loop.
+    if (!pSample->GetConfig().headless)
+    {
+        ShowWindow( m_hWnd, nCmdShow );
+    }
 
-    // Main sample loop.
+    m_renderThread = std::thread( RenderThreadMain, pSample );
+
+    // Main message loop. Blocks until there are messages, and handles all of them.
     MSG msg = {};
-    while (msg.message != WM_QUIT)
+    while (GetMessage( &msg, nullptr, 0, 0 ) > 0)
+    {
+        TranslateMessage( &msg );
+        DispatchMessage( &msg );
+    }
+
+    StopRenderThread();
+    CloseHandle( m_eventPosted );
+
+    // Shut down even if rendering failed, so that the simulation thread is joined, the GPU
+    // drained and the stats written. The render error is the one reported.
+    try
+    {
+        pSample->OnDestroy();
+    }
+    catch (...)
     {
-        // Process any messages in the queue.
-        if (PeekMessage( &msg, nullptr, 0, 0, PM_REMOVE ))
+        if (!m_renderError)
         {
-            TranslateMessage( &msg );
-            DispatchMessage( &msg );
+            throw;
         }
-
-        pSample->OnUpdate();
-        pSample->OnRender();
     }
-
-    pSample->OnDestroy();
+    if (m_renderError)
+    {
+        std::rethrow_exception( m_renderError );
+    }
 
     // Return this part of the WM_QUIT message to Windows.
     return static_cast<char>( msg.wParam );
 }
 
+void Window::SetTitle( const std::wstring& title )
+{
+    {
+        std::lock_guard<std::mutex> lock( m_titleMutex );
+        m_pendingTitle = title;
+    }
+    PostMessage( m_hWnd, WM_APP_SETTITLE, 0, 0 );
+}
+
+void Window::RenderThreadMain( App* pSample )
+{
+    Trace::SetThreadName( "Render" );
+
+    try
+    {
+        while (!m_stopRendering.load( std::memory_order_acquire ))
+        {
+            WindowEvent event;
+            bool resized;
+            {
+                std::lock_guard<std::mutex> lock( m_resizeMutex );
+                event = m_pendingResize;
+                resized = m_resizePending;
+                m_resizePending = false;
+            }
+            if (resized)
+            {
+                pSample->OnSizeChanged( event.width, event.height, event.minimized );
+            }
+
+            while (m_events.Pop( event ))
+            {
+                switch (event.type)
+                {
+                    case WindowEvent::Type::KeyDown:
+                        pSample->OnKeyDown( static_cast<uint8_t>( event.key ) );
+                        break;
+
+                    case WindowEvent::Type::Resize:
+                        pSample->OnSizeChanged( event.width, event.height, event.minimized );
+                        break;
+                }
+            }
+
+            // OnUpdate() runs on the simulation thread (see App::StartSimulation()).
+            pSample->OnRender();
+
+            // Nothing is visible: idle until something changes instead of spinning.
+            const uint32_t throttleMs = pSample->GetThrottleIntervalMs();
+            if (throttleMs != 0)
+            {
+                HW_TRACE_SCOPE( "Throttled" );
+                WaitForEvents( throttleMs );
+            }
+
+            // Runs with a fixed frame count end once it has been rendered.
+            if (pSample->IsRunComplete())
+            {
+                break;
+            }
+        }
+    }
+    catch (...)
+    {
+        m_renderError = std::current_exception();
+    }
+
+    const bool stopRequested = m_stopRendering.load( std::memory_order_acquire );
+    m_renderThreadExited.store( true, std::memory_order_release );
+
+    // Finished on its own (run complete or failed): close the window to end the loop.
+    if (!stopRequested)
+    {
+        PostMessage( m_hWnd, WM_CLOSE, 0, 0 );
+    }
+}
+
+void Window::WaitForEvents( uint32_t timeoutMs )
+{
+    WaitForSingleObject( m_eventPosted, timeoutMs );
+}
+
+void Window::PostEvent( const WindowEvent& event )
+{
+    if (!m_events.Push( event ))
+    {
+        OutputDebugStringA( "Window: event queue full, event dropped.\n" );
+    }
+    SetEvent( m_eventPosted );
+}
+
+// Replaces any resize the render thread has not applied yet.
+void Window::PostResize( const WindowEvent& event )
+{
+    {
+        std::lock_guard<std::mutex> lock( m_resizeMutex );
+        m_pendingResize = event;
+        m_resizePending = true;
+    }
+    SetEvent( m_eventPosted );
+}
+
+void Window::StopRenderThread()
+{
+    if (!m_renderThread.joinable())
+    {
+        return;
+    }
+
+    m_stopRendering.store( true, std::memory_order_release );
+    SetEvent( m_eventPosted );
+    m_pSample->StopSimulation();
+    while (!m_renderThreadExited.load( std::memory_order_acquire ))
+    {
+        MSG msg;
+        while (PeekMessage( &msg, nullptr, 0, 0, PM_REMOVE ))
+        {
+            TranslateMessage( &msg );
+            DispatchMessage( &msg );
+        }
+        MsgWaitForMultipleObjects( 0, nullptr, FALSE, 1, QS_ALLINPUT );
+    }
+    m_renderThread.join();
+}
+
 LRESULT CALLBACK Window::WindowProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam )
 {
     App* pSample = reinterpret_cast<App*>( GetWindowLongPtr( hWnd, GWLP_USERDATA ) );
@@ -81,6 +240,31 @@ LRESULT CALLBACK Window::WindowProc( HWND hWnd, UINT message, WPARAM wParam, LPA
                // pSample->OnRender();
         //   }
         //   return 0;
+        case WM_KEYDOWN:
+            PostEvent( { WindowEvent::Type::KeyDown, static_cast<uint32_t>( wParam ), 0, 0, false } );
+            return 0;
+
+        case WM_SIZE:
+            PostResize( { WindowEvent::Type::Resize, 0, LOWORD( lParam ), HIWORD( lParam ), wParam == SIZE_MINIMIZED } );
+            return 0;
+
+        case WM_APP_SETTITLE:
+        {
+            std::lock_guard<std::mutex> lock( m_titleMutex );
+            SetWindowTextW( hWnd, m_pendingTitle.c_str() );
+        }
+        return 0;
+
+        case WM_CLOSE:
+            // The render thread must be done with the swap chain before the window goes.
+            // A second close while that is in progress is ignored.
+            if (!m_stopRendering.load( std::memory_order_acquire ))
+            {
+                StopRenderThread();
+                DestroyWindow( hWnd );
+            }
+            return 0;
+
         case WM_DESTROY:
             PostQuitMessage( 0 );
             return 0;
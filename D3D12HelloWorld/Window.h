@@ -1,17 +1,78 @@
 #pragma once
 
 #include "App.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 class App;
 
+// Input and window events, forwarded from the UI thread to the render thread.
+struct WindowEvent
+{
+    enum class Type
+    {
+        KeyDown,
+        Resize
+    };
+
+    Type type;
+    uint32_t key;
+    uint32_t width;
+    uint32_t height;
+    bool minimized;
+};
+
+// The window thread only pumps messages; OnUpdate()/OnRender() run on a dedicated render
+// thread, so dragging, resizing or a flood of input does not stall rendering and a slow
+// frame does not delay message handling. Events reach the render thread through a
+// lock-free queue and are handled at the start of the next frame; resizes go through a
+// single slot instead, so only the latest size is applied and none is lost.
 class Window
 {
 public:
     static int Run( App* pSample, HINSTANCE hInstance, int nCmdShow );
     static HWND GetHwnd() { return m_hWnd; }
 
+    // Callable from any thread; the title is applied by the window thread.
+    static void SetTitle( const std::wstring& title );
+
+    // Render thread: sleeps until a window event arrives, a stop is requested, or the
+    // timeout passes.
+    static void WaitForEvents( uint32_t timeoutMs );
+
 private:
     static LRESULT CALLBACK WindowProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam );
+
+    static void RenderThreadMain( App* pSample );
+    static void PostEvent( const WindowEvent& event );
+    static void PostResize( const WindowEvent& event );
+
+    // Stops the simulation first, so the render thread cannot stay blocked waiting for a
+    // frame packet, then keeps pumping messages until the render thread has exited, so it
+    // cannot deadlock on a call that waits for the window thread.
+    static void StopRenderThread();
+
+    static const UINT WM_APP_SETTITLE = WM_APP;
+
 private:
     static HWND m_hWnd;
-};
\ No newline at end of file
+    static App* m_pSample;
+
+    static std::thread m_renderThread;
+    static std::atomic<bool> m_stopRendering;
+    static std::atomic<bool> m_renderThreadExited;
+    static std::exception_ptr m_renderError;
+    static SpscQueue<WindowEvent, 256> m_events;
+    static HANDLE m_eventPosted;
+
+    static std::mutex m_resizeMutex;
+    static WindowEvent m_pendingResize;
+    static bool m_resizePending;
+
+    static std::mutex m_titleMutex;
+    static std::wstring m_pendingTitle;
+};
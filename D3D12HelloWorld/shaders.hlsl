@@ -9,23 +9,51 @@
 //
 //*********************************************************
 
+cbuffer FrameConstants : register(b0)
+{
+    float4x4 viewProjection;
+};
+
+// The first instance of the draw: non-zero for the draws ExecuteIndirect issues per
+// instance (see Cull.hlsl).
+cbuffer DrawConstants : register(b1)
+{
+    uint instanceBase;
+};
+
+struct Instance
+{
+    float4 worldRows[3];
+    float4 color;
+};
+
+StructuredBuffer<Instance> instances : register(t0);
+
 struct PSInput
 {
     float4 position : SV_POSITION;
     float4 color : COLOR;
 };
 
-PSInput VSMain(float4 position : POSITION, float4 color : COLOR)
+PSInput VSMain(float4 position : POSITION, float4 color : COLOR, uint instanceId : SV_InstanceID)
 {
     PSInput result;
 
-    result.position = position;
-    result.color = color;
+    const Instance instance = instances[instanceBase + instanceId];
+    const float3 world = float3(dot(instance.worldRows[0], position), dot(instance.worldRows[1], position), dot(instance.worldRows[2], position));
+    result.position = mul(float4(world, 1.0f), viewProjection);
+    result.color = color * instance.color;
 
     return result;
 }
 
+// Keywords: GRAYSCALE
 float4 PSMain(PSInput input) : SV_TARGET
 {
+#if GRAYSCALE
+    float luminance = dot(input.color.rgb, float3(0.299f, 0.587f, 0.114f));
+    return float4(luminance.xxx, input.color.a);
+#else
     return input.color;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "TestFramework.h"
+#include "FramePacer.h"
+
+// FramePacingModel only sees the times it is given, so these drive it with synthetic
+// milliseconds. The expected values follow from the model's 0.1 estimate weight.
+namespace
+{
+    const double Tolerance = 1e-9;
+
+    // A model whose frames are predicted to take cpuMs + gpuMs.
+    FramePacingModel SteadyModel( double cpuMs, double gpuMs )
+    {
+        FramePacingModel model;
+        model.AddFrame( cpuMs, gpuMs );
+        return model;
+    }
+
+    // A 16 ms vblank grid with a vblank at 16 ms.
+    void AddGrid( FramePacingModel& model )
+    {
+        model.AddVblank( 0.0, 100 );
+        model.AddVblank( 16.0, 101 );
+    }
+}
+
+TEST( PredictsNothingBeforeTheFirstFrame )
+{
+    const FramePacingModel model;
+    CHECK_EQ( model.GetPredictedFrameMs(), 0.0 );
+    CHECK_EQ( model.GetRefreshPeriodMs(), 0.0 );
+    CHECK( model.GetTargetPresentMs() < 0.0 );
+}
+
+TEST( FirstFrameIsTakenAsIs )
+{
+    const FramePacingModel model = SteadyModel( 10.0, 4.0 );
+    CHECK_NEAR( model.GetPredictedFrameMs(), 14.0, Tolerance );
+}
+
+// Mean plus twice the mean deviation, for the CPU and GPU times each.
+TEST( PredictionIsMeanPlusTwiceTheDeviation )
+{
+    FramePacingModel model = SteadyModel( 10.0, 4.0 );
+
+    // CPU: deviation 0.1 * 10 = 1, mean 10 + 0.1 * 10 = 11. GPU unchanged.
+    model.AddFrame( 20.0, 4.0 );
+    CHECK_NEAR( model.GetPredictedFrameMs(), 11.0 + 2.0 * 1.0 + 4.0, Tolerance );
+
+    // CPU: deviation 1 + 0.1 * ( 1 - 1 ) = 1, mean 11 - 0.1 = 10.9. GPU: deviation 0.2, mean 4.2.
+    model.AddFrame( 10.0, 6.0 );
+    CHECK_NEAR( model.GetPredictedFrameMs(), 10.9 + 2.0 * 1.0 + 4.2 + 2.0 * 0.2, Tolerance );
+}
+
+TEST( PredictionSettlesAfterASpike )
+{
+    FramePacingModel model = SteadyModel( 10.0, 5.0 );
+    model.AddFrame( 40.0, 5.0 );
+    const double afterSpike = model.GetPredictedFrameMs();
+    CHECK( afterSpike > 15.0 + 6.0 );
+
+    for (int i = 0; i < 200; i++)
+    {
+        model.AddFrame( 10.0, 5.0 );
+    }
+    CHECK_NEAR( model.GetPredictedFrameMs(), 15.0, 1e-6 );
+}
+
+TEST( WithoutGridOrCapFramesStartAtOnce )
+{
+    FramePacingModel model = SteadyModel( 3.0, 2.0 );
+    CHECK_EQ( model.ScheduleFrame( 100.0 ), 100.0 );
+    CHECK_NEAR( model.GetTargetPresentMs(), 105.0, Tolerance );
+    CHECK_EQ( model.ScheduleFrame( 101.0 ), 101.0 );
+    CHECK_NEAR( model.GetTargetPresentMs(), 106.0, Tolerance );
+}
+
+TEST( NegativeCapDisablesIt )
+{
+    FramePacingModel model;
+    model.SetTargetFps( -30.0 );
+    CHECK_EQ( model.GetTargetFps(), 0.0 );
+}
+
+// 50 fps: presents 20 ms apart, each frame starting its predicted 5 ms before.
+TEST( CapSpacesPresents )
+{
+    FramePacingModel model = SteadyModel( 3.0, 2.0 );
+    model.SetTargetFps( 50.0 );
+
+    CHECK_NEAR( model.ScheduleFrame( 0.0 ), 0.0, Tolerance );
+    CHECK_NEAR( model.GetTargetPresentMs(), 5.0, Tolerance );
+
+    CHECK_NEAR( model.ScheduleFrame( 1.0 ), 20.0, Tolerance );
+    CHECK_NEAR( model.GetTargetPresentMs(), 25.0, Tolerance );
+
+    CHECK_NEAR( model.ScheduleFrame( 21.0 ), 40.0, Tolerance );
+    CHECK_NEAR( model.GetTargetPresentMs(), 45.0, Tolerance );
+}
+
+// A late frame starts at once and is spaced from its own present, without trying to
+// catch up on the slots it missed.
+TEST( LateFrameUnderCapStartsAtOnce )
+{
+    FramePacingModel model = SteadyModel( 3.0, 2.0 );
+    model.SetTargetFps( 50.0 );
+    model.ScheduleFrame( 0.0 );
+
+    CHECK_NEAR( model.ScheduleFrame( 100.0 ), 100.0, Tolerance );
+    CHECK_NEAR( model.GetTargetPresentMs(), 105.0, Tolerance );
+    CHECK_NEAR( model.ScheduleFrame( 101.0 ), 120.0, Tolerance );
+}
+
+TEST( TwoVblanksGiveTheRefreshPeriod )
+{
+    FramePacingModel model;
+    model.AddVblank( 10.0, 5 );
+    CHECK_EQ( model.GetRefreshPeriodMs(), 0.0 );
+
+    // Three refreshes apart.
+    model.AddVblank( 60.0, 8 );
+    CHECK_NEAR( model.GetRefreshPeriodMs(), 50.0 / 3.0, Tolerance );
+
+    // The same count again keeps the period.
+    model.AddVblank( 61.0, 8 );
+    CHECK_NEAR( model.GetRefreshPeriodMs(), 50.0 / 3.0, Tolerance );
+}
+
+// On the grid, the present is rounded up to the next vblank the frame can make.
+TEST( GridRoundsPresentsUpToAVblank )
+{
+    FramePacingModel model = SteadyModel( 3.0, 2.0 );
+    AddGrid( model );
+
+    // Ready at 25, shown at 32.
+    CHECK_NEAR( model.ScheduleFrame( 20.0 ), 27.0, Tolerance );
+    CHECK_NEAR( model.GetTargetPresentMs(), 32.0, Tolerance );
+}
+
+// However early the next frame is asked for, it goes to the vblank after the last one.
+TEST( GridGivesOneFramePerVblank )
+{
+    FramePacingModel model = SteadyModel( 3.0, 2.0 );
+    AddGrid( model );
+
+    model.ScheduleFrame( 20.0 );
+    CHECK_NEAR( model.ScheduleFrame( 21.0 ), 43.0, Tolerance );
+    CHECK_NEAR( model.GetTargetPresentMs(), 48.0, Tolerance );
+    CHECK_NEAR( model.ScheduleFrame( 22.0 ), 59.0, Tolerance );
+    CHECK_NEAR( model.GetTargetPresentMs(), 64.0, Tolerance );
+}
+
+// A frame that can no longer make its vblank aims for the first one it can.
+TEST( LateFrameOnTheGridSkipsToTheNextVblankItCanMake )
+{
+    FramePacingModel model = SteadyModel( 3.0, 2.0 );
+    AddGrid( model );
+    model.ScheduleFrame( 20.0 );
+
+    // Ready at 84: the vblanks at 48, 64 and 80 are gone.
+    CHECK_NEAR( model.ScheduleFrame( 79.0 ), 91.0, Tolerance );
+    CHECK_NEAR( model.GetTargetPresentMs(), 96.0, Tolerance );
+}
+
+// 30 fps on a 62.5 Hz grid: every other vblank.
+TEST( CapBelowTheRefreshRateSkipsVblanks )
+{
+    FramePacingModel model = SteadyModel( 3.0, 2.0 );
+    AddGrid( model );
+    model.SetTargetFps( 30.0 );
+
+    model.ScheduleFrame( 20.0 );
+    CHECK_NEAR( model.GetTargetPresentMs(), 32.0, Tolerance );
+    CHECK_NEAR( model.ScheduleFrame( 21.0 ), 59.0, Tolerance );
+    CHECK_NEAR( model.GetTargetPresentMs(), 64.0, Tolerance );
+    model.ScheduleFrame( 59.0 );
+    CHECK_NEAR( model.GetTargetPresentMs(), 96.0, Tolerance );
+}
+
+// A cap just under the refresh rate (60 fps against 62.5 Hz) must not skip every other
+// vblank: half a refresh period of slack absorbs the difference.
+TEST( CapNearTheRefreshRateKeepsEveryVblank )
+{
+    FramePacingModel model = SteadyModel( 3.0, 2.0 );
+    AddGrid( model );
+    model.SetTargetFps( 60.0 );
+
+    model.ScheduleFrame( 20.0 );
+    model.ScheduleFrame( 21.0 );
+    CHECK_NEAR( model.GetTargetPresentMs(), 48.0, Tolerance );
+    model.ScheduleFrame( 22.0 );
+    CHECK_NEAR( model.GetTargetPresentMs(), 64.0, Tolerance );
+}
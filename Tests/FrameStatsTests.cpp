@@ -0,0 +1,178 @@
+#include "TestFramework.h"
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+
+namespace
+{
+    void AddFrames( FrameStats& stats, std::initializer_list<double> values )
+    {
+        for (double value : values)
+        {
+            stats.AddFrame( &value );
+        }
+    }
+}
+
+TEST( SummaryOfNoFramesIsZero )
+{
+    const FrameStats stats( { "ms" } );
+    const FrameStats::Summary summary = stats.Summarize( 0 );
+    CHECK_EQ( stats.GetFrameCount(), 0u );
+    CHECK_EQ( summary.mean, 0.0 );
+    CHECK_EQ( summary.p50, 0.0 );
+    CHECK_EQ( summary.p95, 0.0 );
+    CHECK_EQ( summary.p99, 0.0 );
+    CHECK_EQ( summary.max, 0.0 );
+}
+
+TEST( SummaryOfOneFrameIsThatFrame )
+{
+    FrameStats stats( { "ms" } );
+    AddFrames( stats, { 16.5 } );
+    const FrameStats::Summary summary = stats.Summarize( 0 );
+    CHECK_EQ( summary.mean, 16.5 );
+    CHECK_EQ( summary.p50, 16.5 );
+    CHECK_EQ( summary.p95, 16.5 );
+    CHECK_EQ( summary.p99, 16.5 );
+    CHECK_EQ( summary.max, 16.5 );
+}
+
+// Nearest rank: the smallest sample with at least p percent of the samples at or below it.
+TEST( PercentilesUseNearestRank )
+{
+    FrameStats stats( { "ms" } );
+    AddFrames( stats, { 30.0, 10.0, 20.0 } );
+    const FrameStats::Summary summary = stats.Summarize( 0 );
+    CHECK_EQ( summary.mean, 20.0 );
+    CHECK_EQ( summary.p50, 20.0 );  // Rank ceil( 1.5 ) = 2.
+    CHECK_EQ( summary.p95, 30.0 );  // Rank ceil( 2.85 ) = 3.
+    CHECK_EQ( summary.p99, 30.0 );
+    CHECK_EQ( summary.max, 30.0 );
+}
+
+TEST( PercentilesOfAHundredShuffledFrames )
+{
+    std::vector<double> values;
+    for (int i = 1; i <= 100; i++)
+    {
+        values.push_back( i );
+    }
+    std::shuffle( values.begin(), values.end(), std::mt19937( 7 ) );
+
+    FrameStats stats( { "ms" } );
+    for (double value : values)
+    {
+        stats.AddFrame( &value );
+    }
+
+    const FrameStats::Summary summary = stats.Summarize( 0 );
+    CHECK_EQ( stats.GetFrameCount(), 100u );
+    CHECK_NEAR( summary.mean, 50.5, 1e-9 );
+    CHECK_EQ( summary.p50, 50.0 );
+    CHECK_EQ( summary.p95, 95.0 );
+    CHECK_EQ( summary.p99, 99.0 );
+    CHECK_EQ( summary.max, 100.0 );
+}
+
+TEST( MetricsAreSummarizedSeparately )
+{
+    FrameStats stats( { "a", "b" } );
+    const double frames[][2] = { { 1.0, 100.0 }, { 2.0, 300.0 } };
+    for (const auto& frame : frames)
+    {
+        stats.AddFrame( frame );
+    }
+    CHECK_EQ( stats.GetMetricCount(), 2u );
+    CHECK_EQ( stats.Summarize( 0 ).max, 2.0 );
+    CHECK_EQ( stats.Summarize( 1 ).mean, 200.0 );
+}
+
+TEST( WarmupFramesAreNotRecorded )
+{
+    FrameStats stats( { "ms" }, 2 );
+    AddFrames( stats, { 100.0, 90.0, 1.0, 2.0, 3.0 } );
+    CHECK_EQ( stats.GetFrameCount(), 3u );
+    CHECK_EQ( stats.Summarize( 0 ).max, 3.0 );
+    CHECK_EQ( stats.Summarize( 0 ).mean, 2.0 );
+}
+
+TEST( WarmupLongerThanTheRunRecordsNothing )
+{
+    FrameStats stats( { "ms" }, 10 );
+    AddFrames( stats, { 1.0, 2.0 } );
+    CHECK_EQ( stats.GetFrameCount(), 0u );
+}
+
+TEST( JsonOutput )
+{
+    FrameStats stats( { "ms", "count" } );
+    stats.SetTag( "adapter", "GPU \"X\"\\1" );
+    const double frames[][2] = { { 1.0, 2.0 }, { 3.0, 4.0 } };
+    for (const auto& frame : frames)
+    {
+        stats.AddFrame( frame );
+    }
+
+    std::ostringstream out;
+    stats.WriteJson( out );
+    CHECK_EQ( out.str(), std::string(
+        "{\n"
+        "  \"tags\": {\n"
+        "    \"adapter\": \"GPU \\\"X\\\"\\\\1\"\n"
+        "  },\n"
+        "  \"frameCount\": 2,\n"
+        "  \"summary\": {\n"
+        "    \"ms\": { \"mean\": 2.0000, \"p50\": 1.0000, \"p95\": 3.0000, \"p99\": 3.0000, \"max\": 3.0000 },\n"
+        "    \"count\": { \"mean\": 3.0000, \"p50\": 2.0000, \"p95\": 4.0000, \"p99\": 4.0000, \"max\": 4.0000 }\n"
+        "  },\n"
+        "  \"samples\": {\n"
+        "    \"ms\": [1.0000, 3.0000],\n"
+        "    \"count\": [2.0000, 4.0000]\n"
+        "  }\n"
+        "}\n" ) );
+}
+
+TEST( JsonOutputWithoutFramesOrTags )
+{
+    const FrameStats stats( { "ms" } );
+    std::ostringstream out;
+    stats.WriteJson( out );
+    CHECK_EQ( out.str(), std::string(
+        "{\n"
+        "  \"tags\": {},\n"
+        "  \"frameCount\": 0,\n"
+        "  \"summary\": {\n"
+        "    \"ms\": { \"mean\": 0.0000, \"p50\": 0.0000, \"p95\": 0.0000, \"p99\": 0.0000, \"max\": 0.0000 }\n"
+        "  },\n"
+        "  \"samples\": {\n"
+        "    \"ms\": []\n"
+        "  }\n"
+        "}\n" ) );
+}
+
+TEST( CsvOutput )
+{
+    FrameStats stats( { "ms", "a,\"b\"" } );
+    stats.SetTag( "adapter", "GPU" );
+    const double frames[][2] = { { 1.0, 2.0 }, { 3.0, 4.0 } };
+    for (const auto& frame : frames)
+    {
+        stats.AddFrame( frame );
+    }
+
+    std::ostringstream out;
+    stats.WriteCsv( out );
+    CHECK_EQ( out.str(), std::string(
+        "# adapter: GPU\n"
+        "frame,ms,\"a,\"\"b\"\"\"\n"
+        "mean,2.0000,3.0000\n"
+        "p50,1.0000,2.0000\n"
+        "p95,3.0000,4.0000\n"
+        "p99,3.0000,4.0000\n"
+        "max,3.0000,4.0000\n"
+        "0,1.0000,2.0000\n"
+        "1,3.0000,4.0000\n" ) );
+}
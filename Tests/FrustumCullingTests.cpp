@@ -0,0 +1,211 @@
+#include "TestFramework.h"
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // The identity view-projection: x and y in [-1, 1], z in [0, 1]. Its planes are unit
+    // length already, so distances to them are exact for the values used here.
+    Frustum UnitFrustum()
+    {
+        const float identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+        return Frustum::FromViewProjection( identity );
+    }
+
+    // Looking down +z, 60 degrees vertically at 16:9, from 0.1 to 100.
+    Frustum PerspectiveFrustum()
+    {
+        const float nearZ = 0.1f;
+        const float farZ = 100.0f;
+        const float yScale = 1.0f / std::tan( 3.14159265f / 6.0f );
+        const float zScale = farZ / ( farZ - nearZ );
+        const float m[4][4] =
+        {
+            { yScale * 9.0f / 16.0f, 0.0f, 0.0f, 0.0f },
+            { 0.0f, yScale, 0.0f, 0.0f },
+            { 0.0f, 0.0f, zScale, 1.0f },
+            { 0.0f, 0.0f, -nearZ * zScale, 0.0f }
+        };
+        return Frustum::FromViewProjection( m );
+    }
+
+    // Room for the SIMD versions, which write whole blocks of four.
+    std::vector<uint32_t> VisibleBuffer( uint32_t count )
+    {
+        return std::vector<uint32_t>( ( count + 3 ) & ~3u );
+    }
+
+    std::vector<uint32_t> SpheresSimd( const Frustum& frustum, const SphereBounds& bounds, uint32_t begin = 0 )
+    {
+        std::vector<uint32_t> visible = VisibleBuffer( bounds.count );
+        visible.resize( CullSpheres( frustum, bounds, begin, bounds.count, visible.data() ) );
+        return visible;
+    }
+
+    std::vector<uint32_t> SpheresScalar( const Frustum& frustum, const SphereBounds& bounds, uint32_t begin = 0 )
+    {
+        std::vector<uint32_t> visible = VisibleBuffer( bounds.count );
+        visible.resize( CullSpheresScalar( frustum, bounds, begin, bounds.count, visible.data() ) );
+        return visible;
+    }
+
+    std::vector<uint32_t> BoxesSimd( const Frustum& frustum, const BoxBounds& bounds, uint32_t begin = 0 )
+    {
+        std::vector<uint32_t> visible = VisibleBuffer( bounds.count );
+        visible.resize( CullBoxes( frustum, bounds, begin, bounds.count, visible.data() ) );
+        return visible;
+    }
+
+    std::vector<uint32_t> BoxesScalar( const Frustum& frustum, const BoxBounds& bounds, uint32_t begin = 0 )
+    {
+        std::vector<uint32_t> visible = VisibleBuffer( bounds.count );
+        visible.resize( CullBoxesScalar( frustum, bounds, begin, bounds.count, visible.data() ) );
+        return visible;
+    }
+
+    // Positions and sizes on a 1/8 grid around the unit frustum, so that many volumes
+    // touch a plane exactly and the comparison is decided by >= rather than by rounding.
+    void RandomOnGrid( uint32_t count, uint32_t seed, SphereBounds& spheres, BoxBounds& boxes )
+    {
+        std::mt19937 random( seed );
+        std::uniform_int_distribution<int> position( -12, 12 );
+        std::uniform_int_distribution<int> size( 0, 4 );
+        spheres.Resize( count );
+        boxes.Resize( count );
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const float x = position( random ) / 8.0f;
+            const float y = position( random ) / 8.0f;
+            const float z = position( random ) / 8.0f;
+            spheres.Set( i, x, y, z, size( random ) / 8.0f );
+            boxes.Set( i, x, y, z, size( random ) / 8.0f, size( random ) / 8.0f, size( random ) / 8.0f );
+        }
+    }
+
+    void RandomInView( uint32_t count, uint32_t seed, SphereBounds& spheres, BoxBounds& boxes )
+    {
+        std::mt19937 random( seed );
+        std::uniform_real_distribution<float> position( -80.0f, 80.0f );
+        std::uniform_real_distribution<float> depth( -10.0f, 120.0f );
+        std::uniform_real_distribution<float> size( 0.1f, 5.0f );
+        spheres.Resize( count );
+        boxes.Resize( count );
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const float x = position( random ), y = position( random ), z = depth( random );
+            spheres.Set( i, x, y, z, size( random ) );
+            boxes.Set( i, x, y, z, size( random ), size( random ), size( random ) );
+        }
+    }
+}
+
+// Spheres exactly touching a plane from outside are kept, ones just beyond it are not.
+// Seven spheres: one SIMD block and a tail of three.
+TEST( SpheresTouchingAPlaneAreVisible )
+{
+    SphereBounds spheres;
+    spheres.Resize( 7 );
+    spheres.Set( 0, 1.5f, 0.0f, 0.5f, 0.5f );       // Touches x = 1.
+    spheres.Set( 1, 1.5f, 0.0f, 0.5f, 0.375f );     // An eighth short of it.
+    spheres.Set( 2, 0.0f, -1.25f, 0.5f, 0.25f );    // Touches y = -1.
+    spheres.Set( 3, 0.0f, 0.0f, -0.5f, 0.5f );      // Touches the near plane.
+    spheres.Set( 4, 0.0f, 0.0f, 1.75f, 0.75f );     // Touches the far plane.
+    spheres.Set( 5, 0.0f, 0.0f, 1.75f, 0.5f );      // Beyond the far plane.
+    spheres.Set( 6, -1.0f, 1.0f, 0.0f, 0.0f );      // A point on a corner.
+
+    const std::vector<uint32_t> expected = { 0, 2, 3, 4, 6 };
+    CHECK( SpheresSimd( UnitFrustum(), spheres ) == expected );
+    CHECK( SpheresScalar( UnitFrustum(), spheres ) == expected );
+}
+
+TEST( BoxesTouchingAPlaneAreVisible )
+{
+    BoxBounds boxes;
+    boxes.Resize( 6 );
+    boxes.Set( 0, -1.5f, 0.0f, 0.5f, 0.5f, 0.1f, 0.1f );     // Touches x = -1.
+    boxes.Set( 1, -1.5f, 0.0f, 0.5f, 0.25f, 2.0f, 2.0f );    // Only large along the other axes.
+    boxes.Set( 2, 0.0f, 1.125f, 0.5f, 0.0f, 0.125f, 0.0f );  // Touches y = 1.
+    boxes.Set( 3, 0.0f, 0.0f, -0.25f, 0.0f, 0.0f, 0.25f );   // Touches the near plane.
+    boxes.Set( 4, 0.0f, 0.0f, -0.25f, 1.0f, 1.0f, 0.125f );  // In front of it.
+    boxes.Set( 5, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f );      // A point inside.
+
+    const std::vector<uint32_t> expected = { 0, 2, 3, 5 };
+    CHECK( BoxesSimd( UnitFrustum(), boxes ) == expected );
+    CHECK( BoxesScalar( UnitFrustum(), boxes ) == expected );
+}
+
+// Counts that leave a tail of one, two and three volumes after the last full block.
+TEST( SimdMatchesScalarWithATail )
+{
+    for (uint32_t count : { 1u, 2u, 3u, 4u, 5u, 1001u, 1002u, 1003u })
+    {
+        SphereBounds spheres;
+        BoxBounds boxes;
+        RandomOnGrid( count, count, spheres, boxes );
+        CHECK( SpheresSimd( UnitFrustum(), spheres ) == SpheresScalar( UnitFrustum(), spheres ) );
+        CHECK( BoxesSimd( UnitFrustum(), boxes ) == BoxesScalar( UnitFrustum(), boxes ) );
+    }
+}
+
+// On the grid, a fair share of the volumes touch a plane; some are kept, some are not.
+TEST( SimdMatchesScalarOnTheGrid )
+{
+    SphereBounds spheres;
+    BoxBounds boxes;
+    RandomOnGrid( 20003, 11, spheres, boxes );
+
+    const std::vector<uint32_t> visibleSpheres = SpheresScalar( UnitFrustum(), spheres );
+    CHECK( !visibleSpheres.empty() && visibleSpheres.size() < spheres.count );
+    CHECK( SpheresSimd( UnitFrustum(), spheres ) == visibleSpheres );
+
+    const std::vector<uint32_t> visibleBoxes = BoxesScalar( UnitFrustum(), boxes );
+    CHECK( !visibleBoxes.empty() && visibleBoxes.size() < boxes.count );
+    CHECK( BoxesSimd( UnitFrustum(), boxes ) == visibleBoxes );
+
+    // Starting at a later block.
+    CHECK( SpheresSimd( UnitFrustum(), spheres, 4000 ) == SpheresScalar( UnitFrustum(), spheres, 4000 ) );
+    CHECK( BoxesSimd( UnitFrustum(), boxes, 4000 ) == BoxesScalar( UnitFrustum(), boxes, 4000 ) );
+}
+
+TEST( SimdMatchesScalarInPerspective )
+{
+    SphereBounds spheres;
+    BoxBounds boxes;
+    RandomInView( 10001, 3, spheres, boxes );
+
+    const Frustum frustum = PerspectiveFrustum();
+    const std::vector<uint32_t> visibleSpheres = SpheresScalar( frustum, spheres );
+    CHECK( !visibleSpheres.empty() && visibleSpheres.size() < spheres.count );
+    CHECK( SpheresSimd( frustum, spheres ) == visibleSpheres );
+    CHECK( BoxesSimd( frustum, boxes ) == BoxesScalar( frustum, boxes ) );
+}
+
+// Several parallel chunks, the last one ending in a tail.
+TEST( ParallelMatchesScalar )
+{
+    JobSystem jobs( 3 );
+    SphereBounds spheres;
+    BoxBounds boxes;
+    RandomInView( 40003, 8, spheres, boxes );
+
+    const Frustum frustum = PerspectiveFrustum();
+    std::vector<uint32_t> visible;
+    CullSpheres( jobs, frustum, spheres, visible );
+    CHECK( visible == SpheresScalar( frustum, spheres ) );
+    CullBoxes( jobs, frustum, boxes, visible );
+    CHECK( visible == BoxesScalar( frustum, boxes ) );
+}
+
+// --benchmark-culling makes the same comparison over its own random volumes.
+TEST( BenchmarkFindsTheVersionsAgree )
+{
+    JobSystem jobs( 2 );
+    bool resultsMatch = false;
+    const std::string report = BenchmarkCulling( jobs, 5003, resultsMatch );
+    CHECK( resultsMatch );
+    CHECK( !report.empty() );
+}
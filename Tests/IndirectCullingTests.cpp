@@ -0,0 +1,205 @@
+#include "TestFramework.h"
+#include "IndirectCulling.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // The layout of FramePacket::Instance: three world rows, then a color the kernel skips.
+    struct Instance
+    {
+        float worldRows[3][4];
+        float color[4];
+    };
+
+    const uint32_t IndexCount = 3;
+    const float MeshRadius = 0.5f;
+
+    // The identity view-projection: x and y in [-1, 1], z in [0, 1].
+    Frustum UnitFrustum()
+    {
+        const float identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+        return Frustum::FromViewProjection( identity );
+    }
+
+    // Columns of the upper 3x3 given as rows of the transposed matrix, as in the shaders.
+    Instance MakeInstance( const float upper[3][3], float x, float y, float z )
+    {
+        Instance instance = {};
+        const float translation[3] = { x, y, z };
+        for (int row = 0; row < 3; row++)
+        {
+            for (int column = 0; column < 3; column++)
+            {
+                instance.worldRows[row][column] = upper[row][column];
+            }
+            instance.worldRows[row][3] = translation[row];
+        }
+        return instance;
+    }
+
+    Instance Scaled( float sx, float sy, float sz, float x, float y, float z )
+    {
+        const float upper[3][3] = { { sx, 0, 0 }, { 0, sy, 0 }, { 0, 0, sz } };
+        return MakeInstance( upper, x, y, z );
+    }
+
+    // A quarter turn about z after scaling x by sx: the longest column has length sx.
+    Instance TurnedAndStretched( float sx, float x, float y, float z )
+    {
+        const float upper[3][3] = { { 0, -1, 0 }, { sx, 0, 0 }, { 0, 0, 1 } };
+        return MakeInstance( upper, x, y, z );
+    }
+
+    IndirectDrawCommand ExpectedCommand( uint32_t instance )
+    {
+        return { instance, IndexCount, 1, 0, 0, 0 };
+    }
+
+    std::vector<IndirectDrawCommand> Cull( const Frustum& frustum, const std::vector<Instance>& instances )
+    {
+        const IndirectCullConstants constants = MakeIndirectCullConstants( frustum, static_cast<uint32_t>( instances.size() ), IndexCount, MeshRadius );
+        std::vector<IndirectDrawCommand> commands( instances.size() + 1 );
+        const uint32_t count = CullInstancesReference( constants, instances.data(), sizeof( Instance ), commands.data() );
+        commands.resize( count );
+        return commands;
+    }
+
+    bool SameCommand( const IndirectDrawCommand& a, const IndirectDrawCommand& b )
+    {
+        return a.instanceIndex == b.instanceIndex && a.indexCountPerInstance == b.indexCountPerInstance && a.instanceCount == b.instanceCount
+            && a.startIndexLocation == b.startIndexLocation && a.baseVertexLocation == b.baseVertexLocation && a.startInstanceLocation == b.startInstanceLocation;
+    }
+}
+
+TEST( ConstantsCarryTheFrustumAndMesh )
+{
+    const Frustum frustum = UnitFrustum();
+    const IndirectCullConstants constants = MakeIndirectCullConstants( frustum, 7, IndexCount, MeshRadius );
+    CHECK_EQ( constants.instanceCount, 7u );
+    CHECK_EQ( constants.indexCount, IndexCount );
+    CHECK_EQ( constants.meshRadius, MeshRadius );
+    CHECK( std::equal( &constants.planes[0][0], &constants.planes[0][0] + 24, &frustum.planes[0][0] ) );
+}
+
+// Fixed instances around the unit frustum, each a short distance inside or outside a
+// plane once its scaled radius is counted.
+TEST( ReferenceEmitsOneCommandPerVisibleInstance )
+{
+    const std::vector<Instance> instances =
+    {
+        Scaled( 1, 1, 1, 0.0f, 0.0f, 0.5f ),        // 0: centered.
+        Scaled( 1, 1, 1, 2.0f, 0.0f, 0.5f ),        // 1: 0.5 beyond the right plane.
+        Scaled( 1, 1, 1, 1.4f, 0.0f, 0.5f ),        // 2: straddles the right plane.
+        Scaled( 0.5f, 0.5f, 0.5f, 1.4f, 0.0f, 0.5f ), // 3: as 2, but half the radius: outside.
+        Scaled( 1, 1, 1, 0.0f, 0.0f, -0.6f ),       // 4: behind the near plane.
+        Scaled( 1, 1, 1, 0.0f, 0.0f, -0.4f ),       // 5: crosses the near plane.
+        Scaled( 0.1f, 2, 0.1f, 0.0f, 1.9f, 0.5f ),  // 6: the largest axis scale sets the radius.
+        TurnedAndStretched( 3, -2.4f, 0.0f, 0.5f ), // 7: radius 1.5, reaches past the left plane.
+        TurnedAndStretched( 2, -2.4f, 0.0f, 0.5f ), // 8: radius 1, falls short of it.
+        Scaled( 1, 1, 1, 0.0f, 0.0f, 1.6f ),        // 9: beyond the far plane.
+        Scaled( 1, 1, 1, 0.0f, -1.4f, 1.4f ),       // 10: straddles the bottom and far planes.
+    };
+
+    const std::vector<IndirectDrawCommand> commands = Cull( UnitFrustum(), instances );
+    const uint32_t visible[] = { 0, 2, 5, 6, 7, 10 };
+    REQUIRE( commands.size() == sizeof( visible ) / sizeof( visible[0] ) );
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        CHECK( SameCommand( commands[i], ExpectedCommand( visible[i] ) ) );
+    }
+}
+
+TEST( ReferenceOfNoInstancesIsEmpty )
+{
+    CHECK( Cull( UnitFrustum(), {} ).empty() );
+}
+
+// The kernel's sphere test must agree with the CPU culling path on the same spheres.
+TEST( ReferenceMatchesSphereCulling )
+{
+    std::mt19937 random( 7 );
+    std::uniform_real_distribution<float> position( -2.0f, 2.0f );
+    std::uniform_real_distribution<float> scale( 0.05f, 1.0f );
+
+    const uint32_t Count = 5000;
+    std::vector<Instance> instances;
+    SphereBounds spheres;
+    spheres.Resize( Count );
+    for (uint32_t i = 0; i < Count; i++)
+    {
+        const float s = scale( random );
+        instances.push_back( Scaled( s, s, s, position( random ), position( random ), position( random ) ) );
+        const Instance& instance = instances.back();
+        spheres.Set( i, instance.worldRows[0][3], instance.worldRows[1][3], instance.worldRows[2][3], MeshRadius * s );
+    }
+
+    const Frustum frustum = UnitFrustum();
+    const std::vector<IndirectDrawCommand> commands = Cull( frustum, instances );
+    std::vector<uint32_t> visible( ( Count + 3 ) & ~3u );
+    visible.resize( CullSpheresScalar( frustum, spheres, 0, Count, visible.data() ) );
+
+    REQUIRE( commands.size() == visible.size() );
+    CHECK( !visible.empty() && visible.size() < Count );
+    bool same = true;
+    for (size_t i = 0; i < visible.size(); i++)
+    {
+        same = same && commands[i].instanceIndex == visible[i];
+    }
+    CHECK( same );
+}
+
+TEST( DiffOfTheSameCommandsInAnotherOrderIsEmpty )
+{
+    std::vector<IndirectDrawCommand> expected;
+    for (uint32_t i = 0; i < 100; i += 3)
+    {
+        expected.push_back( ExpectedCommand( i ) );
+    }
+    std::vector<IndirectDrawCommand> actual = expected;
+    std::reverse( actual.begin(), actual.end() );
+    std::swap( actual[3], actual[10] );
+
+    CHECK_EQ( DiffIndirectCommands( expected.data(), static_cast<uint32_t>( expected.size() ), actual.data(), static_cast<uint32_t>( actual.size() ) ), std::string() );
+    CHECK_EQ( DiffIndirectCommands( nullptr, 0, nullptr, 0 ), std::string() );
+}
+
+TEST( DiffNamesMissingExtraAndRepeatedInstances )
+{
+    const IndirectDrawCommand expected[] = { ExpectedCommand( 1 ), ExpectedCommand( 4 ), ExpectedCommand( 9 ) };
+    const IndirectDrawCommand actual[] = { ExpectedCommand( 9 ), ExpectedCommand( 5 ), ExpectedCommand( 1 ), ExpectedCommand( 9 ) };
+
+    const std::string diff = DiffIndirectCommands( expected, 3, actual, 4 );
+    CHECK( diff.find( "4 commands, 3 expected, 3 difference(s)" ) != std::string::npos );
+    CHECK( diff.find( "instance 4: missing" ) != std::string::npos );
+    CHECK( diff.find( "instance 5: not expected" ) != std::string::npos );
+    CHECK( diff.find( "instance 9: drawn again" ) != std::string::npos );
+    CHECK( diff.find( "instance 1:" ) == std::string::npos );
+}
+
+TEST( DiffNamesDifferentDrawArguments )
+{
+    const IndirectDrawCommand expected[] = { ExpectedCommand( 2 ), ExpectedCommand( 3 ) };
+    IndirectDrawCommand actual[] = { ExpectedCommand( 2 ), ExpectedCommand( 3 ) };
+    actual[1].instanceCount = 0;
+
+    const std::string diff = DiffIndirectCommands( expected, 2, actual, 2 );
+    CHECK( diff.find( "instance 3: different draw arguments" ) != std::string::npos );
+    CHECK( diff.find( "instance 2:" ) == std::string::npos );
+}
+
+TEST( DiffListsOnlyTheFirstDifferences )
+{
+    std::vector<IndirectDrawCommand> expected;
+    for (uint32_t i = 0; i < 20; i++)
+    {
+        expected.push_back( ExpectedCommand( i ) );
+    }
+
+    const std::string diff = DiffIndirectCommands( expected.data(), 20, nullptr, 0 );
+    CHECK( diff.find( "0 commands, 20 expected, 20 difference(s) (first ones listed)" ) != std::string::npos );
+    CHECK( diff.find( "instance 7: missing" ) != std::string::npos );
+    CHECK( diff.find( "instance 8: missing" ) == std::string::npos );
+}
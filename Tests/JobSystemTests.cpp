@@ -0,0 +1,364 @@
+#include "TestFramework.h"
+#include "JobSystem.h"
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // At least two workers, so that jobs are stolen even on a single-core machine.
+    uint32_t StressWorkerCount()
+    {
+        const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        return hardwareThreads > 3 ? hardwareThreads - 1 : 2;
+    }
+
+    // Keeps a worker busy until released, so that tests can control who runs what.
+    class BlockingJob
+    {
+    public:
+        BlockingJob() : m_started( false ), m_released( false ) {}
+
+        void Start( JobSystem& jobs, JobCounter& counter )
+        {
+            jobs.Run( [this]
+            {
+                m_started.store( true );
+                while (!m_released.load())
+                {
+                    std::this_thread::yield();
+                }
+            }, &counter );
+            while (!m_started.load())
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        void Release() { m_released.store( true ); }
+
+    private:
+        std::atomic<bool> m_started;
+        std::atomic<bool> m_released;
+    };
+}
+
+TEST( EveryJobRunsOnceBeforeWaitReturns )
+{
+    JobSystem jobs( StressWorkerCount() );
+    for (int round = 0; round < 20; round++)
+    {
+        const uint32_t Count = 10000;
+        std::unique_ptr<std::atomic<uint32_t>[]> runs( new std::atomic<uint32_t>[Count] );
+        for (uint32_t i = 0; i < Count; i++)
+        {
+            runs[i].store( 0 );
+        }
+
+        JobCounter counter;
+        for (uint32_t i = 0; i < Count; i++)
+        {
+            jobs.Run( [&runs, i] { runs[i].fetch_add( 1 ); }, &counter );
+        }
+        jobs.Wait( counter );
+        CHECK( counter.IsDone() );
+
+        uint32_t wrong = 0;
+        for (uint32_t i = 0; i < Count; i++)
+        {
+            wrong += runs[i].load() == 1 ? 0 : 1;
+        }
+        CHECK_EQ( wrong, 0u );
+    }
+}
+
+// Jobs queued by a worker go to its own deque, where the owner's pops race the other
+// workers' steals; a job lost or run twice by that race shows up in the counts.
+TEST( JobsSpawnedByWorkersRunOnceUnderStealing )
+{
+    JobSystem jobs( StressWorkerCount() );
+    static const uint32_t Spawners = 64;
+    static const uint32_t PerSpawner = 1000;
+    std::unique_ptr<std::atomic<uint32_t>[]> runs( new std::atomic<uint32_t>[Spawners * PerSpawner] );
+    for (uint32_t i = 0; i < Spawners * PerSpawner; i++)
+    {
+        runs[i].store( 0 );
+    }
+
+    JobCounter counter;
+    for (uint32_t spawner = 0; spawner < Spawners; spawner++)
+    {
+        jobs.Run( [&, spawner]
+        {
+            JobCounter children;
+            for (uint32_t i = 0; i < PerSpawner; i++)
+            {
+                jobs.Run( [&runs, spawner, i] { runs[spawner * PerSpawner + i].fetch_add( 1 ); }, &children );
+            }
+            jobs.Wait( children );
+        }, &counter );
+    }
+    jobs.Wait( counter );
+
+    uint32_t wrong = 0;
+    for (uint32_t i = 0; i < Spawners * PerSpawner; i++)
+    {
+        wrong += runs[i].load() == 1 ? 0 : 1;
+    }
+    CHECK_EQ( wrong, 0u );
+}
+
+TEST( NestedParallelForCoversEveryIndexOnce )
+{
+    JobSystem jobs( StressWorkerCount() );
+    const uint32_t Outer = 200;
+    const uint32_t Inner = 300;
+    for (int round = 0; round < 10; round++)
+    {
+        std::unique_ptr<std::atomic<uint32_t>[]> hits( new std::atomic<uint32_t>[Outer * Inner] );
+        for (uint32_t i = 0; i < Outer * Inner; i++)
+        {
+            hits[i].store( 0 );
+        }
+
+        jobs.ParallelFor( Outer, [&]( uint32_t begin, uint32_t end )
+        {
+            for (uint32_t outer = begin; outer < end; outer++)
+            {
+                jobs.ParallelFor( Inner, [&, outer]( uint32_t innerBegin, uint32_t innerEnd )
+                {
+                    for (uint32_t inner = innerBegin; inner < innerEnd; inner++)
+                    {
+                        hits[outer * Inner + inner].fetch_add( 1 );
+                    }
+                } );
+            }
+        } );
+
+        uint32_t wrong = 0;
+        for (uint32_t i = 0; i < Outer * Inner; i++)
+        {
+            wrong += hits[i].load() == 1 ? 0 : 1;
+        }
+        CHECK_EQ( wrong, 0u );
+    }
+}
+
+TEST( ParallelForOfNothingReturns )
+{
+    JobSystem jobs( 2 );
+    bool called = false;
+    jobs.ParallelFor( 0, [&]( uint32_t, uint32_t ) { called = true; } );
+    CHECK( !called );
+}
+
+TEST( WaitRethrowsTheFirstErrorOnce )
+{
+    JobSystem jobs( StressWorkerCount() );
+    JobCounter counter;
+    std::atomic<uint32_t> ran( 0 );
+    for (int i = 0; i < 100; i++)
+    {
+        jobs.Run( [&ran, i]
+        {
+            ran.fetch_add( 1 );
+            if (i % 10 == 0)
+            {
+                throw std::runtime_error( "job failed" );
+            }
+        }, &counter );
+    }
+    CHECK_THROWS( jobs.Wait( counter ) );
+    CHECK_EQ( ran.load(), 100u );
+
+    // The error was cleared: the counter can be reused.
+    jobs.Run( [&ran] { ran.fetch_add( 1 ); }, &counter );
+    jobs.Wait( counter );
+    CHECK_EQ( ran.load(), 101u );
+}
+
+TEST( RunAfterWaitsForItsDependency )
+{
+    JobSystem jobs( StressWorkerCount() );
+    for (int round = 0; round < 100; round++)
+    {
+        JobCounter first;
+        JobCounter second;
+        std::atomic<uint32_t> firstDone( 0 );
+        std::atomic<uint32_t> seenBySecond( 0 );
+        for (int i = 0; i < 16; i++)
+        {
+            jobs.Run( [&firstDone] { firstDone.fetch_add( 1 ); }, &first );
+        }
+        jobs.RunAfter( first, [&] { seenBySecond.store( firstDone.load() ); }, &second );
+        jobs.Wait( second );
+        CHECK_EQ( seenBySecond.load(), 16u );
+        jobs.Wait( first );
+    }
+}
+
+TEST( RunAfterAFailedDependencyIsSkipped )
+{
+    JobSystem jobs( 2 );
+    JobCounter first;
+    JobCounter second;
+    bool ran = false;
+    jobs.Run( [] { throw std::runtime_error( "dependency failed" ); }, &first );
+    jobs.RunAfter( first, [&ran] { ran = true; }, &second );
+    CHECK_THROWS( jobs.Wait( second ) );
+    CHECK( !ran );
+    CHECK_THROWS( jobs.Wait( first ) );
+
+    // Scheduled after the dependency already finished with its error cleared.
+    jobs.RunAfter( first, [&ran] { ran = true; }, &second );
+    jobs.Wait( second );
+    CHECK( ran );
+}
+
+TEST( DestructionRunsQueuedJobs )
+{
+    std::atomic<uint32_t> ran( 0 );
+    {
+        JobSystem jobs( StressWorkerCount() );
+        for (int i = 0; i < 1000; i++)
+        {
+            jobs.Run( [&ran] { ran.fetch_add( 1 ); } );
+            jobs.RunBackground( [&ran] { ran.fetch_add( 1 ); } );
+        }
+    }
+    CHECK_EQ( ran.load(), 2000u );
+}
+
+// A frame's ParallelFor() must not pick up a long background job (a shader compile)
+// while it waits for its own chunks: only an idle worker takes it.
+TEST( WaitLeavesUnrelatedBackgroundJobsToWorkers )
+{
+    JobSystem jobs( 1 );
+    JobCounter blocked;
+    BlockingJob blocker;
+    blocker.Start( jobs, blocked );
+
+    JobCounter background;
+    std::atomic<uint32_t> backgroundWorker( UINT32_MAX );
+    jobs.RunBackground( [&] { backgroundWorker.store( jobs.GetCurrentWorkerIndex() ); }, &background );
+
+    std::atomic<uint32_t> covered( 0 );
+    jobs.ParallelFor( 1000, [&covered]( uint32_t begin, uint32_t end ) { covered.fetch_add( end - begin ); } );
+    CHECK_EQ( covered.load(), 1000u );
+    CHECK( !background.IsDone() );
+
+    blocker.Release();
+    jobs.Wait( blocked );
+    jobs.Wait( background );
+    CHECK_EQ( backgroundWorker.load(), 1u );
+}
+
+// The same for ordinary jobs queued from outside the pool (startup tasks): a thread that
+// is not a worker only runs the jobs it waits for.
+TEST( WaitOutsideThePoolLeavesUnrelatedJobsToWorkers )
+{
+    JobSystem jobs( 1 );
+    JobCounter blocked;
+    BlockingJob blocker;
+    blocker.Start( jobs, blocked );
+
+    JobCounter unrelated;
+    std::atomic<uint32_t> unrelatedWorker( UINT32_MAX );
+    jobs.Run( [&] { unrelatedWorker.store( jobs.GetCurrentWorkerIndex() ); }, &unrelated );
+
+    std::atomic<uint32_t> covered( 0 );
+    jobs.ParallelFor( 1000, [&covered]( uint32_t begin, uint32_t end ) { covered.fetch_add( end - begin ); } );
+    CHECK_EQ( covered.load(), 1000u );
+    CHECK( !unrelated.IsDone() );
+
+    blocker.Release();
+    jobs.Wait( blocked );
+    jobs.Wait( unrelated );
+    CHECK_EQ( unrelatedWorker.load(), 1u );
+}
+
+// Waiting on a background job's own counter runs it, so it does not depend on a worker
+// becoming idle.
+TEST( WaitRunsItsOwnBackgroundJobs )
+{
+    JobSystem jobs( 1 );
+    JobCounter blocked;
+    BlockingJob blocker;
+    blocker.Start( jobs, blocked );
+
+    JobCounter unrelated;
+    JobCounter background;
+    std::atomic<uint32_t> unrelatedRan( 0 );
+    std::atomic<uint32_t> backgroundWorker( UINT32_MAX );
+    jobs.RunBackground( [&] { unrelatedRan.fetch_add( 1 ); }, &unrelated );
+    jobs.RunBackground( [&] { backgroundWorker.store( jobs.GetCurrentWorkerIndex() ); }, &background );
+    jobs.Wait( background );
+    CHECK_EQ( backgroundWorker.load(), 0u );
+    CHECK_EQ( unrelatedRan.load(), 0u );
+
+    blocker.Release();
+    jobs.Wait( blocked );
+    jobs.Wait( unrelated );
+    CHECK_EQ( unrelatedRan.load(), 1u );
+}
+
+// Regular jobs queued behind a background job still run first.
+TEST( BackgroundJobsRunAfterQueuedJobs )
+{
+    JobSystem jobs( 1 );
+    JobCounter blocked;
+    BlockingJob blocker;
+    blocker.Start( jobs, blocked );
+
+    std::vector<int> order;
+    JobCounter counter;
+    jobs.RunBackground( [&order] { order.push_back( 2 ); }, &counter );
+    jobs.Run( [&order] { order.push_back( 1 ); }, &counter );
+
+    // Left to the worker: this thread would take the regular job while the worker runs
+    // the background one.
+    blocker.Release();
+    while (!counter.IsDone())
+    {
+        std::this_thread::yield();
+    }
+    jobs.Wait( counter );
+    jobs.Wait( blocked );
+    REQUIRE( order.size() == 2 );
+    CHECK_EQ( order[0], 1 );
+    CHECK_EQ( order[1], 2 );
+}
+
+// Workers beyond the number of cores are left unpinned rather than sharing the caller's.
+TEST( PinningMoreWorkersThanCores )
+{
+    const uint32_t workerCount = std::thread::hardware_concurrency() * 2 + 2;
+    JobSystem jobs( workerCount, true );
+    CHECK_EQ( jobs.GetWorkerCount(), workerCount );
+
+    std::atomic<uint32_t> covered( 0 );
+    jobs.ParallelFor( 100000, [&covered]( uint32_t begin, uint32_t end ) { covered.fetch_add( end - begin ); } );
+    CHECK_EQ( covered.load(), 100000u );
+}
+
+TEST( WorkerIndices )
+{
+    JobSystem jobs( 3 );
+    CHECK_EQ( jobs.GetCurrentWorkerIndex(), 0u );
+
+    std::atomic<uint32_t> badIndex( 0 );
+    JobCounter counter;
+    for (int i = 0; i < 1000; i++)
+    {
+        jobs.Run( [&]
+        {
+            const uint32_t index = jobs.GetCurrentWorkerIndex();
+            badIndex.fetch_add( index > 3 ? 1 : 0 );
+        }, &counter );
+    }
+    jobs.Wait( counter );
+    CHECK_EQ( badIndex.load(), 0u );
+}
@@ -0,0 +1,460 @@
+#include "TestFramework.h"
+#include "OcclusionCulling.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // Clip space is screen space here: x and y in [-1, 1], depth z, w = 1.
+    const float Identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+
+    const uint16_t TriangleIndices[] = { 0, 1, 2 };
+    const uint16_t QuadIndices[] = { 0, 1, 2, 2, 1, 3 };
+
+    JobSystem& Jobs()
+    {
+        static JobSystem jobs( 3 );
+        return jobs;
+    }
+
+    float ClipX( const OcclusionBuffer& buffer, float pixelX )
+    {
+        return pixelX / buffer.GetWidth() * 2.0f - 1.0f;
+    }
+
+    float ClipY( const OcclusionBuffer& buffer, float pixelY )
+    {
+        return 1.0f - pixelY / buffer.GetHeight() * 2.0f;
+    }
+
+    // A triangle at a constant depth, with its corners given in pixels.
+    void AddTriangle( OcclusionBuffer& buffer, float x0, float y0, float x1, float y1, float x2, float y2, float depth )
+    {
+        const float positions[] =
+        {
+            ClipX( buffer, x0 ), ClipY( buffer, y0 ), depth,
+            ClipX( buffer, x1 ), ClipY( buffer, y1 ), depth,
+            ClipX( buffer, x2 ), ClipY( buffer, y2 ), depth
+        };
+        buffer.AddOccluder( Identity, positions, 3, TriangleIndices, 1 );
+    }
+
+    // An axis-aligned rectangle of pixels [minX, maxX) x [minY, maxY), as two triangles.
+    void AddRect( OcclusionBuffer& buffer, float minX, float minY, float maxX, float maxY, float depth )
+    {
+        const float positions[] =
+        {
+            ClipX( buffer, minX ), ClipY( buffer, minY ), depth,
+            ClipX( buffer, maxX ), ClipY( buffer, minY ), depth,
+            ClipX( buffer, minX ), ClipY( buffer, maxY ), depth,
+            ClipX( buffer, maxX ), ClipY( buffer, maxY ), depth
+        };
+        buffer.AddOccluder( Identity, positions, 4, QuadIndices, 2 );
+    }
+
+    // The depth buffer as text, one string per row: '.' for the far plane, otherwise the
+    // depth in tenths.
+    std::vector<std::string> Picture( const OcclusionBuffer& buffer )
+    {
+        std::vector<std::string> rows;
+        const float* pDepth = buffer.GetMinDepth( 0 );
+        for (uint32_t y = 0; y < buffer.GetHeight(); y++)
+        {
+            std::string row;
+            for (uint32_t x = 0; x < buffer.GetWidth(); x++)
+            {
+                const float depth = pDepth[y * buffer.GetWidth() + x];
+                row += depth == 1.0f ? '.' : static_cast<char>( '0' + static_cast<int>( std::lround( depth * 10.0f ) ) );
+            }
+            rows.push_back( row );
+        }
+        return rows;
+    }
+
+    void CheckPicture( const OcclusionBuffer& buffer, const std::vector<std::string>& expected )
+    {
+        const std::vector<std::string> actual = Picture( buffer );
+        REQUIRE( actual.size() == expected.size() );
+        for (size_t row = 0; row < actual.size(); row++)
+        {
+            CHECK_EQ( actual[row], expected[row] );
+        }
+    }
+
+    bool SameDepth( const OcclusionBuffer& a, const OcclusionBuffer& b )
+    {
+        for (uint32_t level = 0; level < a.GetLevelCount(); level++)
+        {
+            const size_t size = size_t( a.GetLevelWidth( level ) ) * a.GetLevelHeight( level );
+            if (!std::equal( a.GetMinDepth( level ), a.GetMinDepth( level ) + size, b.GetMinDepth( level ) )
+                || !std::equal( a.GetMaxDepth( level ), a.GetMaxDepth( level ) + size, b.GetMaxDepth( level ) ))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Looking down +z from the origin, 60 degrees vertically, for a 2:1 buffer; depth 0 at
+    // z = 0.1 and 1 at z = 100.
+    struct Camera
+    {
+        float viewProjection[4][4];
+
+        Camera()
+        {
+            const float nearZ = 0.1f;
+            const float farZ = 100.0f;
+            const float yScale = 1.0f / std::tan( 3.14159265f / 6.0f );
+            const float zScale = farZ / ( farZ - nearZ );
+            const float m[4][4] =
+            {
+                { yScale / 2.0f, 0.0f, 0.0f, 0.0f },
+                { 0.0f, yScale, 0.0f, 0.0f },
+                { 0.0f, 0.0f, zScale, 1.0f },
+                { 0.0f, 0.0f, -nearZ * zScale, 0.0f }
+            };
+            std::copy( &m[0][0], &m[0][0] + 16, &viewProjection[0][0] );
+        }
+    };
+
+    // A square wall facing the camera.
+    void AddWall( OcclusionBuffer& buffer, const Camera& camera, float x, float y, float z, float half )
+    {
+        const float positions[] = { x - half, y + half, z, x + half, y + half, z, x - half, y - half, z, x + half, y - half, z };
+        buffer.AddOccluder( camera.viewProjection, positions, 4, QuadIndices, 2 );
+    }
+}
+
+TEST( SizeMustBeWholeTiles )
+{
+    CHECK_THROWS( OcclusionBuffer( 0, 16 ) );
+    CHECK_THROWS( OcclusionBuffer( 48, 16 ) );
+    CHECK_THROWS( OcclusionBuffer( 32, 24 ) );
+}
+
+// Each level halves the one below, rounding up, down to a single texel.
+TEST( PyramidLevelSizes )
+{
+    const OcclusionBuffer buffer( 96, 16 );
+    const uint32_t widths[] = { 96, 48, 24, 12, 6, 3, 2, 1 };
+    const uint32_t heights[] = { 16, 8, 4, 2, 1, 1, 1, 1 };
+    REQUIRE( buffer.GetLevelCount() == 8 );
+    for (uint32_t level = 0; level < 8; level++)
+    {
+        CHECK_EQ( buffer.GetLevelWidth( level ), widths[level] );
+        CHECK_EQ( buffer.GetLevelHeight( level ), heights[level] );
+    }
+}
+
+TEST( ClearedBufferIsAtTheFarPlane )
+{
+    OcclusionBuffer buffer( 32, 16 );
+    buffer.RasterizeReference();
+    CheckPicture( buffer, std::vector<std::string>( 16, std::string( 32, '.' ) ) );
+    const uint32_t top = buffer.GetLevelCount() - 1;
+    CHECK_EQ( buffer.GetMinDepth( top )[0], 1.0f );
+    CHECK_EQ( buffer.GetMaxDepth( top )[0], 1.0f );
+}
+
+// A pixel is covered when its centre is: the rectangle [8, 24) x [4, 12) covers exactly
+// those pixels, and the diagonal the two triangles share leaves no gap.
+TEST( GoldenRectangle )
+{
+    OcclusionBuffer buffer( 32, 16 );
+    AddRect( buffer, 8.0f, 4.0f, 24.0f, 12.0f, 0.5f );
+    buffer.Rasterize( Jobs() );
+
+    std::vector<std::string> expected( 16, std::string( 32, '.' ) );
+    for (int y = 4; y < 12; y++)
+    {
+        expected[y].replace( 8, 16, 16, '5' );
+    }
+    CheckPicture( buffer, expected );
+}
+
+// Overlapping triangles at three depths: each pixel keeps the nearest. The 0.7 triangle
+// only shows where the 0.5 one does not cover it.
+TEST( GoldenOverlappingTriangles )
+{
+    const std::vector<std::string> expected =
+    {
+        "................................",
+        "................................",
+        "..555555555555555555555555555...",
+        "..5555555555555555555555555.....",
+        "..5555555555555555553555........",
+        "..55555555555555555533..........",
+        "..555555555555555555333.........",
+        "..555555555555555...3333........",
+        "..555555555555577777333337......",
+        "..555555555557777777333333......",
+        "..55555555..777777..3333333.....",
+        "..555555....77......33333333....",
+        "..5555..............333333333...",
+        "..5.................3333333333..",
+        "....................33333333333.",
+        "....................333333333333",
+    };
+
+    OcclusionBuffer simd( 32, 16 );
+    OcclusionBuffer reference( 32, 16 );
+    for (OcclusionBuffer* pBuffer : { &simd, &reference })
+    {
+        AddTriangle( *pBuffer, 2, 2, 30, 2, 2, 14, 0.5f );
+        AddTriangle( *pBuffer, 20, 4, 20, 16, 32, 16, 0.3f );   // Clockwise on screen.
+        AddTriangle( *pBuffer, 12, 8, 28, 8, 12, 12, 0.7f );
+    }
+    simd.Rasterize( Jobs() );
+    reference.RasterizeReference();
+    CheckPicture( simd, expected );
+    CheckPicture( reference, expected );
+}
+
+// Depth is interpolated linearly across the screen: 0.2 at the left edge to 0.6 at the
+// right, sampled at pixel centres.
+TEST( GoldenDepthGradient )
+{
+    OcclusionBuffer buffer( 64, 32 );
+    const float positions[] = { -1, 1, 0.2f, 1, 1, 0.6f, -1, -1, 0.2f, 1, -1, 0.6f };
+    buffer.AddOccluder( Identity, positions, 4, QuadIndices, 2 );
+    buffer.Rasterize( Jobs() );
+
+    const float* pDepth = buffer.GetMinDepth( 0 );
+    double worstError = 0.0;
+    for (uint32_t y = 0; y < 32; y++)
+    {
+        for (uint32_t x = 0; x < 64; x++)
+        {
+            const double expected = 0.2 + 0.4 * ( x + 0.5 ) / 64.0;
+            worstError = std::max( worstError, std::fabs( pDepth[y * 64 + x] - expected ) );
+        }
+    }
+    CHECK( worstError < 1e-6 );
+}
+
+// Each pyramid texel keeps the nearest and farthest depth below it.
+TEST( GoldenPyramid )
+{
+    OcclusionBuffer buffer( 64, 32 );
+    AddRect( buffer, 8.0f, 4.0f, 24.0f, 12.0f, 0.5f );
+    AddRect( buffer, 40.0f, 16.0f, 41.0f, 17.0f, 0.25f );  // A single pixel.
+    buffer.Rasterize( Jobs() );
+
+    // Level 1: 2x2 pixels per texel, aligned with the rectangle.
+    CHECK_EQ( buffer.GetMinDepth( 1 )[2 * 32 + 4], 0.5f );
+    CHECK_EQ( buffer.GetMaxDepth( 1 )[2 * 32 + 4], 0.5f );
+    CHECK_EQ( buffer.GetMinDepth( 1 )[2 * 32 + 3], 1.0f );
+    CHECK_EQ( buffer.GetMinDepth( 1 )[8 * 32 + 20], 0.25f );
+    CHECK_EQ( buffer.GetMaxDepth( 1 )[8 * 32 + 20], 1.0f );
+
+    // Level 2: 4x4 pixels per texel; the one at (2, 1) lies inside the rectangle.
+    CHECK_EQ( buffer.GetMinDepth( 2 )[1 * 16 + 2], 0.5f );
+    CHECK_EQ( buffer.GetMaxDepth( 2 )[1 * 16 + 2], 0.5f );
+
+    // Level 3: 8x8 pixels per texel; the one at (1, 0) is half covered.
+    CHECK_EQ( buffer.GetMinDepth( 3 )[0 * 8 + 1], 0.5f );
+    CHECK_EQ( buffer.GetMaxDepth( 3 )[0 * 8 + 1], 1.0f );
+
+    const uint32_t top = buffer.GetLevelCount() - 1;
+    CHECK_EQ( buffer.GetMinDepth( top )[0], 0.25f );
+    CHECK_EQ( buffer.GetMaxDepth( top )[0], 1.0f );
+}
+
+TEST( ClearDropsTheOccluders )
+{
+    OcclusionBuffer buffer( 32, 16 );
+    AddRect( buffer, 0.0f, 0.0f, 32.0f, 16.0f, 0.5f );
+    buffer.Rasterize( Jobs() );
+    CHECK_EQ( buffer.GetTriangleCount(), 2u );
+
+    buffer.Clear();
+    CHECK_EQ( buffer.GetTriangleCount(), 0u );
+    buffer.Rasterize( Jobs() );
+    CheckPicture( buffer, std::vector<std::string>( 16, std::string( 32, '.' ) ) );
+}
+
+// Occluder triangles with a corner in front of the near plane, or behind the camera, are
+// dropped; ones that cover no pixel centre are too.
+TEST( OccludersCrossingTheNearPlaneAreDropped )
+{
+    OcclusionBuffer buffer( 32, 16 );
+    const float crossing[] = { -1, 1, 0.5f, 1, 1, -0.1f, -1, -1, 0.5f };
+    buffer.AddOccluder( Identity, crossing, 3, TriangleIndices, 1 );
+    CHECK_EQ( buffer.GetTriangleCount(), 0u );
+
+    const Camera camera;
+    const float behind[] = { -1, 1, 5, 1, 1, -5, -1, -1, 5 };
+    buffer.AddOccluder( camera.viewProjection, behind, 3, TriangleIndices, 1 );
+    CHECK_EQ( buffer.GetTriangleCount(), 0u );
+
+    AddTriangle( buffer, 4.0f, 4.0f, 4.6f, 4.0f, 4.0f, 4.4f, 0.5f );
+    CHECK_EQ( buffer.GetTriangleCount(), 0u );
+}
+
+// The tiled SIMD rasterizer must match the per-pixel reference exactly, pyramid included.
+TEST( RasterizerMatchesTheReference )
+{
+    const Camera camera;
+    std::mt19937 random( 99 );
+    std::uniform_real_distribution<float> x( -30.0f, 30.0f );
+    std::uniform_real_distribution<float> y( -15.0f, 15.0f );
+    std::uniform_real_distribution<float> z( 5.0f, 60.0f );
+
+    OcclusionBuffer simd( 128, 64 );
+    OcclusionBuffer reference( 128, 64 );
+    for (int t = 0; t < 200; t++)
+    {
+        const float positions[] = { x( random ), y( random ), z( random ), x( random ), y( random ), z( random ), x( random ), y( random ), z( random ) };
+        simd.AddOccluder( camera.viewProjection, positions, 3, TriangleIndices, 1 );
+        reference.AddOccluder( camera.viewProjection, positions, 3, TriangleIndices, 1 );
+    }
+    simd.Rasterize( Jobs() );
+    reference.RasterizeReference();
+    CHECK( simd.GetTriangleCount() > 150 );
+    CHECK( SameDepth( simd, reference ) );
+}
+
+// Boxes behind a full-screen occluder are rejected at the coarsest level that holds them.
+TEST( BoxBehindAnOccluderIsCulled )
+{
+    OcclusionBuffer buffer( 64, 32 );
+    AddRect( buffer, 0.0f, 0.0f, 64.0f, 32.0f, 0.5f );
+    buffer.Rasterize( Jobs() );
+
+    CHECK( !buffer.IsBoxVisible( Identity, 0.0f, 0.0f, 0.8f, 0.2f, 0.2f, 0.1f ) );
+    CHECK( !buffer.IsBoxVisible( Identity, 0.0f, 0.0f, 0.8f, 0.9f, 0.9f, 0.1f ) );
+}
+
+TEST( BoxInFrontOfAnOccluderIsKept )
+{
+    OcclusionBuffer buffer( 64, 32 );
+    AddRect( buffer, 0.0f, 0.0f, 64.0f, 32.0f, 0.5f );
+    buffer.Rasterize( Jobs() );
+
+    CHECK( buffer.IsBoxVisible( Identity, 0.0f, 0.0f, 0.2f, 0.2f, 0.2f, 0.1f ) );
+
+    // Straddling the occluder's depth: its nearest point is in front.
+    CHECK( buffer.IsBoxVisible( Identity, 0.0f, 0.0f, 0.5f, 0.2f, 0.2f, 0.1f ) );
+
+    // Touching it from behind counts as visible.
+    CHECK( buffer.IsBoxVisible( Identity, 0.0f, 0.0f, 0.6f, 0.2f, 0.2f, 0.1f ) );
+}
+
+// The rectangle [8, 24) x [4, 12) at depth 0.5. A box behind it whose footprint is
+// pixels [9, 22] x [4, 11] starts at level 3, whose texels also cover uncovered pixels,
+// so the answer is unclear; one level finer its texels are all behind the rectangle.
+TEST( RefinementCullsABoxBehindASmallOccluder )
+{
+    OcclusionBuffer buffer( 64, 32 );
+    AddRect( buffer, 8.0f, 4.0f, 24.0f, 12.0f, 0.5f );
+    buffer.Rasterize( Jobs() );
+
+    // x from -0.7 to -0.3 is pixels 9.6 to 22.4; y from 0.7 to 0.3 is pixels 4.8 to 11.2.
+    CHECK( !buffer.IsBoxVisible( Identity, -0.5f, 0.5f, 0.8f, 0.2f, 0.2f, 0.1f ) );
+}
+
+// Refinement down to the pixels: a box reaching one pixel past the occluder is kept.
+TEST( RefinementKeepsABoxThatPeeksOut )
+{
+    OcclusionBuffer buffer( 64, 32 );
+    AddRect( buffer, 8.0f, 4.0f, 24.0f, 12.0f, 0.5f );
+    buffer.Rasterize( Jobs() );
+
+    // Right edge at pixel 24.5: the first uncovered column.
+    CHECK( buffer.IsBoxVisible( Identity, -0.45f, 0.5f, 0.8f, 0.2f, 0.2f, 0.1f ) );
+
+    // Right edge at pixel 23.5 stays behind the rectangle.
+    CHECK( !buffer.IsBoxVisible( Identity, -0.48125f, 0.5f, 0.8f, 0.2f, 0.2f, 0.1f ) );
+}
+
+TEST( BoxCrossingTheNearPlaneIsKept )
+{
+    OcclusionBuffer buffer( 64, 32 );
+    AddRect( buffer, 0.0f, 0.0f, 64.0f, 32.0f, 0.5f );
+    buffer.Rasterize( Jobs() );
+
+    // Depth from -0.1 to 0.9: part of it is in front of the near plane.
+    CHECK( buffer.IsBoxVisible( Identity, 0.0f, 0.0f, 0.4f, 0.2f, 0.2f, 0.5f ) );
+
+    // Under perspective, corners behind the camera (w <= 0) and corners between the
+    // camera and the near plane.
+    const Camera camera;
+    OcclusionBuffer perspective( 64, 32 );
+    AddWall( perspective, camera, 0.0f, 0.0f, 20.0f, 30.0f );
+    perspective.Rasterize( Jobs() );
+    CHECK( perspective.IsBoxVisible( camera.viewProjection, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f ) );
+    CHECK( perspective.IsBoxVisible( camera.viewProjection, 0.0f, 0.0f, 0.1f, 0.02f, 0.02f, 0.05f ) );
+    CHECK( !perspective.IsBoxVisible( camera.viewProjection, 0.0f, 0.0f, 40.0f, 1.0f, 1.0f, 1.0f ) );
+}
+
+// Off-screen boxes are left to frustum culling.
+TEST( BoxOffScreenIsKept )
+{
+    OcclusionBuffer buffer( 64, 32 );
+    AddRect( buffer, 0.0f, 0.0f, 64.0f, 32.0f, 0.5f );
+    buffer.Rasterize( Jobs() );
+    CHECK( buffer.IsBoxVisible( Identity, 3.0f, 0.0f, 0.8f, 0.2f, 0.2f, 0.1f ) );
+}
+
+TEST( PerspectiveWallHidesWhatIsBehindIt )
+{
+    const Camera camera;
+    OcclusionBuffer buffer( 64, 32 );
+    AddWall( buffer, camera, 0.0f, 0.0f, 20.0f, 8.0f );
+    buffer.Rasterize( Jobs() );
+
+    CHECK( !buffer.IsBoxVisible( camera.viewProjection, 0.0f, 0.0f, 40.0f, 1.0f, 1.0f, 1.0f ) );
+    CHECK( buffer.IsBoxVisible( camera.viewProjection, 0.0f, 0.0f, 10.0f, 1.0f, 1.0f, 1.0f ) );
+    CHECK( buffer.IsBoxVisible( camera.viewProjection, 40.0f, 0.0f, 40.0f, 1.0f, 1.0f, 1.0f ) );
+}
+
+// The parallel culls keep the candidates IsBoxVisible() keeps, in candidate order.
+TEST( ParallelCullsMatchIsBoxVisible )
+{
+    const Camera camera;
+    OcclusionBuffer buffer( 128, 64 );
+    AddWall( buffer, camera, -12.0f, 0.0f, 20.0f, 8.0f );
+    AddWall( buffer, camera, 4.0f, -3.0f, 25.0f, 9.0f );
+    buffer.Rasterize( Jobs() );
+
+    std::mt19937 random( 5 );
+    std::uniform_real_distribution<float> position( -25.0f, 25.0f );
+    std::uniform_real_distribution<float> depth( 30.0f, 90.0f );
+    std::uniform_real_distribution<float> size( 0.5f, 2.0f );
+    const uint32_t Count = 10000;
+    BoxBounds boxes;
+    SphereBounds spheres;
+    boxes.Resize( Count );
+    spheres.Resize( Count );
+    for (uint32_t i = 0; i < Count; i++)
+    {
+        const float x = position( random ), y = position( random ), z = depth( random ), r = size( random );
+        boxes.Set( i, x, y, z, r, r, r );
+        spheres.Set( i, x, y, z, r );
+    }
+
+    // Every other volume, so that indices and positions differ.
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < Count; i += 2)
+    {
+        candidates.push_back( i );
+        if (buffer.IsBoxVisible( camera.viewProjection, boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i], boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i] ))
+        {
+            expected.push_back( i );
+        }
+    }
+    CHECK( !expected.empty() && expected.size() < candidates.size() );
+
+    std::vector<uint32_t> visible;
+    buffer.CullBoxes( Jobs(), camera.viewProjection, boxes, candidates, visible );
+    CHECK( visible == expected );
+    buffer.CullSpheres( Jobs(), camera.viewProjection, spheres, candidates, visible );
+    CHECK( visible == expected );
+}
@@ -0,0 +1,213 @@
+#include "TestFramework.h"
+#include "DynamicResolution.h"
+
+#include <cmath>
+
+// With the default settings and a 16 ms budget, the dead band is 12.8 to 15.2 ms and
+// changes aim for 14 ms; scales move in steps of 1/32.
+namespace
+{
+    const double Step = 1.0 / 32.0;
+    const double Tolerance = 1e-9;
+
+    using Settings = ResolutionScaleController::Settings;
+
+    // Feeds count frames of gpuMs rendered at the current scale; returns the last result.
+    double AddFrames( ResolutionScaleController& controller, uint32_t count, double gpuMs )
+    {
+        double scale = controller.GetScale();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            scale = controller.AddFrame( gpuMs, controller.GetScale() );
+        }
+        return scale;
+    }
+
+    bool IsQuantized( double scale )
+    {
+        const double steps = scale / Step;
+        return std::fabs( steps - std::round( steps ) ) < 1e-6;
+    }
+}
+
+TEST( StartsAtTheLargestScale )
+{
+    const ResolutionScaleController controller( Settings{} );
+    CHECK_EQ( controller.GetScale(), 1.0 );
+}
+
+TEST( DeadBandLeavesTheScaleAlone )
+{
+    ResolutionScaleController controller( Settings{} );
+    CHECK_EQ( AddFrames( controller, 100, 14.0 ), 1.0 );
+    CHECK_EQ( AddFrames( controller, 100, 15.1 ), 1.0 );
+    CHECK_EQ( AddFrames( controller, 100, 12.9 ), 1.0 );
+}
+
+// Two slow frames in a row: down to sqrt( 14 / 20 ) = 0.837, quantized down to 26/32.
+TEST( DropsAfterTwoSlowFrames )
+{
+    ResolutionScaleController controller( Settings{} );
+    CHECK_EQ( controller.AddFrame( 20.0, 1.0 ), 1.0 );
+    CHECK_NEAR( controller.AddFrame( 20.0, 1.0 ), 26 * Step, Tolerance );
+}
+
+TEST( DeadBandFrameBreaksTheDownStreak )
+{
+    ResolutionScaleController controller( Settings{} );
+    controller.AddFrame( 20.0, 1.0 );
+    controller.AddFrame( 14.0, 1.0 );
+    CHECK_EQ( controller.AddFrame( 20.0, 1.0 ), 1.0 );
+    CHECK( controller.AddFrame( 20.0, 1.0 ) < 1.0 );
+}
+
+TEST( FastFrameBreaksTheDownStreak )
+{
+    ResolutionScaleController controller( Settings{} );
+    controller.AddFrame( 20.0, 1.0 );
+    controller.AddFrame( 10.0, 1.0 );
+    CHECK_EQ( controller.AddFrame( 20.0, 1.0 ), 1.0 );
+}
+
+// The slowest frame of the streak sets the target: sqrt( 14 / 24 ) = 0.764, i.e. 24/32.
+TEST( DropAimsAtTheSlowestFrameOfTheStreak )
+{
+    ResolutionScaleController controller( Settings{} );
+    controller.AddFrame( 24.0, 1.0 );
+    CHECK_NEAR( controller.AddFrame( 18.0, 1.0 ), 24 * Step, Tolerance );
+}
+
+// Aiming at a load above the threshold would keep the scale; it still drops one step.
+TEST( DropIsAtLeastOneStep )
+{
+    Settings settings;
+    settings.targetLoad = 1.0;
+    ResolutionScaleController controller( settings );
+    CHECK_NEAR( AddFrames( controller, 2, 15.5 ), 1.0 - Step, Tolerance );
+}
+
+TEST( RisesOnlyAfterThirtyFastFrames )
+{
+    ResolutionScaleController controller( Settings{} );
+    AddFrames( controller, 2, 24.0 );
+    REQUIRE( std::fabs( controller.GetScale() - 24 * Step ) < Tolerance );
+
+    // 0.75 * sqrt( 14 / 11 ) = 0.846, i.e. 27/32.
+    CHECK_NEAR( AddFrames( controller, 29, 11.0 ), 24 * Step, Tolerance );
+    CHECK_NEAR( controller.AddFrame( 11.0, controller.GetScale() ), 27 * Step, Tolerance );
+}
+
+TEST( DeadBandFrameBreaksTheUpStreak )
+{
+    ResolutionScaleController controller( Settings{} );
+    AddFrames( controller, 2, 24.0 );
+    AddFrames( controller, 29, 11.0 );
+    controller.AddFrame( 14.0, controller.GetScale() );
+    CHECK_NEAR( AddFrames( controller, 29, 11.0 ), 24 * Step, Tolerance );
+    CHECK_NEAR( AddFrames( controller, 1, 11.0 ), 27 * Step, Tolerance );
+}
+
+// 0.75 * sqrt( 14 / 6 ) would be 1.15; a single rise is limited to 0.125.
+TEST( RiseIsLimited )
+{
+    ResolutionScaleController controller( Settings{} );
+    AddFrames( controller, 2, 24.0 );
+    CHECK_NEAR( AddFrames( controller, 30, 6.0 ), 24 * Step + 0.125, Tolerance );
+}
+
+TEST( RiseStopsAtTheLargestScale )
+{
+    ResolutionScaleController controller( Settings{} );
+    AddFrames( controller, 2, 17.0 );
+    REQUIRE( controller.GetScale() < 1.0 );
+    CHECK_EQ( AddFrames( controller, 30, 1.0 ), 1.0 );
+}
+
+// With GPU time following the square of the scale, the controller settles inside the
+// dead band, on quantized scales only, and stays there.
+TEST( SettlesOnQuantizedScales )
+{
+    ResolutionScaleController controller( Settings{} );
+    bool allQuantized = true;
+    for (int frame = 0; frame < 500; frame++)
+    {
+        const double scale = controller.GetScale();
+        allQuantized = allQuantized && IsQuantized( controller.AddFrame( 25.0 * scale * scale, scale ) );
+    }
+    CHECK( allQuantized );
+
+    const double settled = controller.GetScale();
+    const double load = 25.0 * settled * settled / 16.0;
+    CHECK( load >= 0.80 && load <= 0.95 );
+    CHECK_EQ( AddFrames( controller, 100, 25.0 * settled * settled ), settled );
+}
+
+// --min-render-scale: however slow the frames, the scale stops at the minimum, which
+// need not be a whole number of steps.
+TEST( ClampsToTheMinimumScale )
+{
+    Settings settings;
+    settings.minScale = 0.6;
+    ResolutionScaleController controller( settings );
+    CHECK_NEAR( AddFrames( controller, 2, 64.0 ), 0.6, Tolerance );
+    CHECK_NEAR( AddFrames( controller, 100, 64.0 ), 0.6, Tolerance );
+
+    // And it still rises from there.
+    CHECK( AddFrames( controller, 30, 4.0 ) > 0.6 );
+}
+
+// GPU timings arrive frames late. Samples rendered at the old scale must not count
+// towards another drop, or one slow spell would be corrected twice.
+TEST( LateSamplesAtAnOldScaleAreIgnored )
+{
+    ResolutionScaleController controller( Settings{} );
+    AddFrames( controller, 2, 20.0 );
+    const double dropped = controller.GetScale();
+    REQUIRE( std::fabs( dropped - 26 * Step ) < Tolerance );
+
+    for (int i = 0; i < 5; i++)
+    {
+        CHECK_EQ( controller.AddFrame( 20.0, 1.0 ), dropped );
+    }
+
+    // The streak starts over at the new scale: 26/32 * sqrt( 14 / 20 ) = 0.680, i.e. 21/32.
+    CHECK_EQ( controller.AddFrame( 20.0, dropped ), dropped );
+    CHECK_NEAR( controller.AddFrame( 20.0, dropped ), 21 * Step, Tolerance );
+}
+
+TEST( LateFastSamplesDoNotRaiseTheScale )
+{
+    ResolutionScaleController controller( Settings{} );
+    AddFrames( controller, 2, 20.0 );
+    const double dropped = controller.GetScale();
+    for (int i = 0; i < 100; i++)
+    {
+        controller.AddFrame( 5.0, 1.0 );
+    }
+    CHECK_EQ( controller.GetScale(), dropped );
+}
+
+TEST( MissingTimingsAreIgnored )
+{
+    ResolutionScaleController controller( Settings{} );
+    controller.AddFrame( 20.0, 1.0 );
+    controller.AddFrame( 0.0, 1.0 );
+    CHECK( controller.AddFrame( 20.0, 1.0 ) < 1.0 );
+
+    Settings noBudget;
+    noBudget.budgetMs = 0.0;
+    ResolutionScaleController unbudgeted( noBudget );
+    CHECK_EQ( AddFrames( unbudgeted, 10, 100.0 ), 1.0 );
+}
+
+TEST( ResetReturnsToTheLargestScaleAndForgetsTheStreak )
+{
+    ResolutionScaleController controller( Settings{} );
+    AddFrames( controller, 2, 20.0 );
+    REQUIRE( controller.GetScale() < 1.0 );
+    controller.AddFrame( 20.0, controller.GetScale() );
+
+    controller.Reset();
+    CHECK_EQ( controller.GetScale(), 1.0 );
+    CHECK_EQ( controller.AddFrame( 20.0, 1.0 ), 1.0 );
+}
@@ -0,0 +1,150 @@
+#include "TestFramework.h"
+#include "SimulatedPresentQueue.h"
+
+#include <chrono>
+#include <thread>
+
+// The queue runs on the steady clock, so these only assert what holds however late the
+// test thread is scheduled: frames never show early, and admissions always balance.
+namespace
+{
+    // Waits until every presented frame has been shown.
+    void Drain( SimulatedPresentQueue& queue )
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 2 );
+        while (queue.GetQueuedFrameCount() != 0 && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        }
+        REQUIRE( queue.GetQueuedFrameCount() == 0 );
+    }
+
+    // Takes every admission on offer.
+    uint32_t CountAdmissions( SimulatedPresentQueue& queue )
+    {
+        uint32_t admissions = 0;
+        while (queue.WaitForFrame( 0 ))
+        {
+            admissions++;
+        }
+        return admissions;
+    }
+}
+
+TEST( AdmitsUpToTheFrameLatency )
+{
+    SimulatedPresentQueue queue( 60.0, 2 );
+    CHECK( queue.WaitForFrame( 0 ) );
+    CHECK( queue.WaitForFrame( 0 ) );
+    CHECK( !queue.WaitForFrame( 0 ) );
+    CHECK_EQ( queue.GetMaximumFrameLatency(), 2u );
+}
+
+TEST( WaitForFrameTimesOutWhileTheQueueIsFull )
+{
+    SimulatedPresentQueue queue( 60.0, 1 );
+    REQUIRE( queue.WaitForFrame( 0 ) );
+
+    const auto start = std::chrono::steady_clock::now();
+    CHECK( !queue.WaitForFrame( 20 ) );
+    CHECK( std::chrono::steady_clock::now() - start >= std::chrono::milliseconds( 20 ) );
+}
+
+TEST( PresentWithoutAnAdmissionThrows )
+{
+    SimulatedPresentQueue queue( 60.0, 1 );
+    CHECK_THROWS( queue.Present() );
+
+    REQUIRE( queue.WaitForFrame( 0 ) );
+    queue.Present();
+    CHECK_THROWS( queue.Present() );
+}
+
+TEST( ShownFrameGivesItsAdmissionBack )
+{
+    SimulatedPresentQueue queue( 200.0, 1 );
+    REQUIRE( queue.WaitForFrame( 0 ) );
+    const uint64_t presentVblank = queue.GetVblankCount();
+    queue.Present();
+
+    CHECK( queue.WaitForFrame( 1000 ) );
+    CHECK( queue.GetVblankCount() > presentVblank );
+    CHECK_EQ( queue.GetDisplayedFrameCount(), 1u );
+}
+
+// Flip model: frames presented back to back are shown on consecutive vblanks, not
+// together on the next one.
+TEST( ShowsOneFramePerVblank )
+{
+    SimulatedPresentQueue queue( 200.0, 3 );
+    const uint64_t firstVblank = queue.GetVblankCount();
+    for (int i = 0; i < 3; i++)
+    {
+        REQUIRE( queue.WaitForFrame( 0 ) );
+        queue.Present();
+    }
+
+    Drain( queue );
+    CHECK( queue.GetVblankCount() >= firstVblank + 3 );
+    CHECK_EQ( CountAdmissions( queue ), 3u );
+    CHECK_EQ( queue.GetDisplayedFrameCount(), 3u );
+}
+
+TEST( RaisingTheLatencyAdmitsAtOnce )
+{
+    SimulatedPresentQueue queue( 60.0, 1 );
+    REQUIRE( queue.WaitForFrame( 0 ) );
+    CHECK( !queue.WaitForFrame( 0 ) );
+
+    queue.SetMaximumFrameLatency( 2 );
+    CHECK( queue.WaitForFrame( 0 ) );
+    CHECK( !queue.WaitForFrame( 0 ) );
+}
+
+TEST( LoweringTheLatencyTakesEffectAsFramesDrain )
+{
+    SimulatedPresentQueue queue( 200.0, 3 );
+    for (int i = 0; i < 3; i++)
+    {
+        REQUIRE( queue.WaitForFrame( 0 ) );
+        queue.Present();
+    }
+
+    queue.SetMaximumFrameLatency( 1 );
+    CHECK_EQ( queue.GetMaximumFrameLatency(), 1u );
+    Drain( queue );
+    CHECK_EQ( CountAdmissions( queue ), 1u );
+}
+
+// The app's frame loop: a frame is only started, and presented, once admitted; frames
+// whose wait times out are skipped. However often that happens, no more frames are
+// queued than the latency allows, and once drained exactly that many are admitted again.
+TEST( SkippingTimedOutFramesKeepsAdmissionsBalanced )
+{
+    const uint32_t Latency = 2;
+    SimulatedPresentQueue queue( 500.0, Latency );
+    uint32_t presented = 0;
+    uint32_t skipped = 0;
+    uint32_t maxQueued = 0;
+    for (int i = 0; i < 200; i++)
+    {
+        // Alternate between polls, which mostly time out, and short waits.
+        if (!queue.WaitForFrame( i % 2 ))
+        {
+            skipped++;
+            continue;
+        }
+        queue.Present();
+        presented++;
+
+        const uint32_t queued = queue.GetQueuedFrameCount();
+        maxQueued = queued > maxQueued ? queued : maxQueued;
+    }
+    CHECK( presented > 0 );
+    CHECK( skipped > 0 );
+    CHECK( maxQueued <= Latency );
+
+    Drain( queue );
+    CHECK_EQ( CountAdmissions( queue ), Latency );
+    CHECK_EQ( queue.GetDisplayedFrameCount(), static_cast<uint64_t>( presented ) );
+}
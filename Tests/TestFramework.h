@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// A minimal test harness, so that the tests build anywhere without dependencies. TEST()
+// defines and registers a test; CHECK() and its variants record a failure and let the
+// test carry on, REQUIRE() ends the test. TestMain.cpp runs every registered test, or the
+// ones whose names contain the first command-line argument.
+namespace Test
+{
+    using Function = void (*)();
+
+    struct Case
+    {
+        const char* name;
+        Function function;
+    };
+
+    inline std::vector<Case>& Registry()
+    {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    inline int& FailureCount()
+    {
+        static int failures = 0;
+        return failures;
+    }
+
+    struct Registrar
+    {
+        Registrar( const char* name, Function function ) { Registry().push_back( { name, function } ); }
+    };
+
+    // Thrown by REQUIRE() to leave the test.
+    struct Abort
+    {
+    };
+
+    inline void Fail( const char* file, int line, const std::string& message )
+    {
+        printf( "%s(%d): %s\n", file, line, message.c_str() );
+        FailureCount()++;
+    }
+
+    template <typename T>
+    std::string Describe( const T& value )
+    {
+        std::ostringstream text;
+        text << value;
+        return text.str();
+    }
+
+    inline int RunAll( const char* filter )
+    {
+        int failedTests = 0;
+        for (const Case& test : Registry())
+        {
+            if (filter && std::string( test.name ).find( filter ) == std::string::npos)
+            {
+                continue;
+            }
+
+            const int failuresBefore = FailureCount();
+            try
+            {
+                test.function();
+            }
+            catch (const Abort&)
+            {
+            }
+            catch (const std::exception& e)
+            {
+                Fail( __FILE__, __LINE__, std::string( "unexpected exception: " ) + e.what() );
+            }
+
+            const bool passed = FailureCount() == failuresBefore;
+            printf( "[%s] %s\n", passed ? " ok " : "FAIL", test.name );
+            failedTests += passed ? 0 : 1;
+        }
+
+        printf( "%d test(s) failed\n", failedTests );
+        return failedTests == 0 ? 0 : 1;
+    }
+}
+
+#define TEST( name ) \
+    static void name(); \
+    static const Test::Registrar name##Registrar( #name, name ); \
+    static void name()
+
+#define CHECK( condition ) \
+    do { if (!( condition )) Test::Fail( __FILE__, __LINE__, "CHECK( " #condition " ) failed" ); } while (0)
+
+#define REQUIRE( condition ) \
+    do { if (!( condition )) { Test::Fail( __FILE__, __LINE__, "REQUIRE( " #condition " ) failed" ); throw Test::Abort(); } } while (0)
+
+#define CHECK_EQ( actual, expected ) \
+    do \
+    { \
+        const auto& actualValue = ( actual ); \
+        const auto& expectedValue = ( expected ); \
+        if (!( actualValue == expectedValue )) \
+        { \
+            Test::Fail( __FILE__, __LINE__, "CHECK_EQ( " #actual ", " #expected " ): " + Test::Describe( actualValue ) + " != " + Test::Describe( expectedValue ) ); \
+        } \
+    } while (0)
+
+#define CHECK_NEAR( actual, expected, tolerance ) \
+    do \
+    { \
+        const double actualValue = ( actual ); \
+        const double expectedValue = ( expected ); \
+        if (!( std::fabs( actualValue - expectedValue ) <= ( tolerance ) )) \
+        { \
+            Test::Fail( __FILE__, __LINE__, "CHECK_NEAR( " #actual ", " #expected " ): " + Test::Describe( actualValue ) + " != " + Test::Describe( expectedValue ) ); \
+        } \
+    } while (0)
+
+#define CHECK_THROWS( expression ) \
+    do \
+    { \
+        bool threw = false; \
+        try { ( void )( expression ); } catch (...) { threw = true; } \
+        if (!threw) Test::Fail( __FILE__, __LINE__, "CHECK_THROWS( " #expression " ): nothing was thrown" ); \
+    } while (0)
@@ -0,0 +1,6 @@
+#include "TestFramework.h"
+
+int main( int argc, char** argv )
+{
+    return Test::RunAll( argc > 1 ? argv[1] : nullptr );
+}
@@ -0,0 +1,357 @@
+#include "TestFramework.h"
+#include "TransformHierarchy.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    using NodeId = TransformHierarchy::NodeId;
+    const NodeId NoParent = TransformHierarchy::NoParent;
+
+    JobSystem& Jobs()
+    {
+        static JobSystem jobs( 3 );
+        return jobs;
+    }
+
+    // The same hierarchy kept the obvious way: parents and locals by node id, and world
+    // matrices evaluated recursively from the root on every query.
+    struct NaiveHierarchy
+    {
+        std::vector<NodeId> parents;
+        std::vector<XMFLOAT4X4A> locals;
+
+        NodeId Add( TransformHierarchy& hierarchy, NodeId parent, FXMMATRIX local )
+        {
+            parents.push_back( parent );
+            locals.emplace_back();
+            XMStoreFloat4x4A( &locals.back(), local );
+            return hierarchy.AddNode( parent, local );
+        }
+
+        void SetLocal( TransformHierarchy& hierarchy, NodeId node, FXMMATRIX local )
+        {
+            XMStoreFloat4x4A( &locals[node], local );
+            hierarchy.SetLocal( node, local );
+        }
+
+        void SetParent( TransformHierarchy& hierarchy, NodeId node, NodeId parent )
+        {
+            parents[node] = parent;
+            hierarchy.SetParent( node, parent );
+        }
+
+        XMMATRIX World( NodeId node ) const
+        {
+            const XMMATRIX local = XMLoadFloat4x4A( &locals[node] );
+            return parents[node] == NoParent ? local : XMMatrixMultiply( local, World( parents[node] ) );
+        }
+
+        bool IsInSubtree( NodeId node, NodeId root ) const
+        {
+            for (NodeId ancestor = node; ancestor != NoParent; ancestor = parents[ancestor])
+            {
+                if (ancestor == root)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Nodes whose world matrix depends on one of the changed ones.
+        uint32_t CountAffected( const std::vector<NodeId>& changed ) const
+        {
+            uint32_t affected = 0;
+            for (NodeId node = 0; node < parents.size(); node++)
+            {
+                affected += std::any_of( changed.begin(), changed.end(), [&]( NodeId root ) { return IsInSubtree( node, root ); } ) ? 1 : 0;
+            }
+            return affected;
+        }
+
+        uint32_t CountLevels() const
+        {
+            uint32_t levels = 0;
+            for (NodeId node = 0; node < parents.size(); node++)
+            {
+                uint32_t depth = 1;
+                for (NodeId ancestor = parents[node]; ancestor != NoParent; ancestor = parents[ancestor])
+                {
+                    depth++;
+                }
+                levels = std::max( levels, depth );
+            }
+            return levels;
+        }
+    };
+
+    float MaxDifference( FXMMATRIX a, CXMMATRIX b )
+    {
+        XMFLOAT4X4A x;
+        XMFLOAT4X4A y;
+        XMStoreFloat4x4A( &x, a );
+        XMStoreFloat4x4A( &y, b );
+        float difference = 0.0f;
+        for (int row = 0; row < 4; row++)
+        {
+            for (int column = 0; column < 4; column++)
+            {
+                difference = std::max( difference, std::fabs( x.m[row][column] - y.m[row][column] ) );
+            }
+        }
+        return difference;
+    }
+
+    // Every world matrix against the recursive evaluation.
+    bool WorldsMatch( const TransformHierarchy& hierarchy, const NaiveHierarchy& naive )
+    {
+        for (NodeId node = 0; node < naive.parents.size(); node++)
+        {
+            if (MaxDifference( hierarchy.GetWorld( node ), naive.World( node ) ) > 1e-4f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    XMMATRIX Local( float angle, float x, float y, float z )
+    {
+        return XMMatrixMultiply( XMMatrixRotationY( angle ), XMMatrixTranslation( x, y, z ) );
+    }
+
+    XMMATRIX RandomLocal( std::mt19937& random )
+    {
+        std::uniform_real_distribution<float> angle( -XM_PI, XM_PI );
+        std::uniform_real_distribution<float> offset( -1.0f, 1.0f );
+        return Local( angle( random ), offset( random ), offset( random ), offset( random ) );
+    }
+
+    // A few roots with random children, each added under any node that already exists, so
+    // depths vary and ids are not in depth order.
+    void BuildRandom( TransformHierarchy& hierarchy, NaiveHierarchy& naive, uint32_t count, std::mt19937& random )
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const NodeId parent = i < 4 ? NoParent : static_cast<NodeId>( random() % i );
+            naive.Add( hierarchy, parent, RandomLocal( random ) );
+        }
+    }
+}
+
+// Two roots, a chain of three under the first and a child of the second added last, so
+// the depth sort has to move it ahead of the deeper nodes.
+TEST( WorldIsLocalTimesParentWorld )
+{
+    TransformHierarchy hierarchy;
+    NaiveHierarchy naive;
+    naive.Add( hierarchy, NoParent, Local( 0.5f, 1.0f, 0.0f, 0.0f ) );
+    naive.Add( hierarchy, NoParent, Local( -1.0f, 0.0f, 2.0f, 0.0f ) );
+    naive.Add( hierarchy, 0, Local( 0.25f, 0.0f, 0.0f, 3.0f ) );
+    naive.Add( hierarchy, 2, Local( 1.0f, 1.0f, 1.0f, 1.0f ) );
+    naive.Add( hierarchy, 3, Local( 0.0f, -2.0f, 0.0f, 0.0f ) );
+    naive.Add( hierarchy, 1, Local( 2.0f, 0.0f, 0.0f, -1.0f ) );
+
+    CHECK_EQ( hierarchy.Update( Jobs() ), 6u );
+    CHECK_EQ( hierarchy.GetLevelCount(), 4u );
+    CHECK( WorldsMatch( hierarchy, naive ) );
+
+    // World of node 3 by hand: its local, then node 2's, then node 0's.
+    const XMMATRIX expected = XMMatrixMultiply( XMMatrixMultiply( Local( 1.0f, 1.0f, 1.0f, 1.0f ), Local( 0.25f, 0.0f, 0.0f, 3.0f ) ), Local( 0.5f, 1.0f, 0.0f, 0.0f ) );
+    CHECK( MaxDifference( hierarchy.GetWorld( 3 ), expected ) < 1e-5f );
+}
+
+TEST( NothingChangedUpdatesNothing )
+{
+    TransformHierarchy hierarchy;
+    NaiveHierarchy naive;
+    std::mt19937 random( 1 );
+    BuildRandom( hierarchy, naive, 100, random );
+
+    CHECK_EQ( hierarchy.Update( Jobs() ), 100u );
+    CHECK_EQ( hierarchy.Update( Jobs() ), 0u );
+    CHECK( WorldsMatch( hierarchy, naive ) );
+}
+
+TEST( EmptyHierarchyUpdates )
+{
+    TransformHierarchy hierarchy;
+    CHECK_EQ( hierarchy.Update( Jobs() ), 0u );
+    CHECK_EQ( hierarchy.GetLevelCount(), 0u );
+}
+
+// Changing a node recomputes it and everything below it, and nothing else.
+TEST( PartialChangeUpdatesOnlyTheSubtrees )
+{
+    TransformHierarchy hierarchy;
+    NaiveHierarchy naive;
+    std::mt19937 random( 2 );
+    BuildRandom( hierarchy, naive, 500, random );
+    hierarchy.Update( Jobs() );
+
+    for (int round = 0; round < 10; round++)
+    {
+        std::vector<NodeId> changed;
+        for (int i = 0; i < 5; i++)
+        {
+            changed.push_back( static_cast<NodeId>( random() % 500 ) );
+            naive.SetLocal( hierarchy, changed.back(), RandomLocal( random ) );
+        }
+        CHECK_EQ( hierarchy.Update( Jobs() ), naive.CountAffected( changed ) );
+        CHECK( WorldsMatch( hierarchy, naive ) );
+    }
+}
+
+// A node and one of its descendants both changed: the descendant is computed once, from
+// its ancestor's new world matrix.
+TEST( ChangeUnderAChangedAncestor )
+{
+    TransformHierarchy hierarchy;
+    NaiveHierarchy naive;
+    const NodeId root = naive.Add( hierarchy, NoParent, Local( 0.0f, 0.0f, 0.0f, 0.0f ) );
+    const NodeId middle = naive.Add( hierarchy, root, Local( 0.5f, 1.0f, 0.0f, 0.0f ) );
+    const NodeId leaf = naive.Add( hierarchy, middle, Local( 0.5f, 1.0f, 0.0f, 0.0f ) );
+    naive.Add( hierarchy, root, Local( 0.0f, 0.0f, 1.0f, 0.0f ) );
+    hierarchy.Update( Jobs() );
+
+    naive.SetLocal( hierarchy, leaf, Local( 1.0f, 0.0f, 0.0f, 2.0f ) );
+    naive.SetLocal( hierarchy, middle, Local( -0.5f, 3.0f, 0.0f, 0.0f ) );
+    CHECK_EQ( hierarchy.Update( Jobs() ), 2u );
+    CHECK( WorldsMatch( hierarchy, naive ) );
+}
+
+// Nodes added after an update are sorted into their levels; the ids handed out before
+// still name the same nodes.
+TEST( AddingNodesKeepsIdsValid )
+{
+    TransformHierarchy hierarchy;
+    NaiveHierarchy naive;
+    std::mt19937 random( 3 );
+    BuildRandom( hierarchy, naive, 50, random );
+    hierarchy.Update( Jobs() );
+
+    const NodeId deep = naive.Add( hierarchy, 49, RandomLocal( random ) );
+    naive.Add( hierarchy, deep, RandomLocal( random ) );
+    naive.Add( hierarchy, NoParent, RandomLocal( random ) );
+    CHECK_EQ( hierarchy.Update( Jobs() ), 3u );
+    CHECK_EQ( hierarchy.GetLevelCount(), naive.CountLevels() );
+    CHECK( WorldsMatch( hierarchy, naive ) );
+    for (NodeId node = 0; node < naive.parents.size(); node++)
+    {
+        CHECK( MaxDifference( hierarchy.GetLocal( node ), XMLoadFloat4x4A( &naive.locals[node] ) ) == 0.0f );
+    }
+}
+
+TEST( AddNodeRejectsAMissingParent )
+{
+    TransformHierarchy hierarchy;
+    CHECK_THROWS( hierarchy.AddNode( 0, XMMatrixIdentity() ) );
+    hierarchy.AddNode( NoParent, XMMatrixIdentity() );
+    CHECK_THROWS( hierarchy.AddNode( 1, XMMatrixIdentity() ) );
+}
+
+// Moving a subtree under a node with a higher id, to the root level, and making a root a
+// child: the moved subtrees are recomputed and depths follow.
+TEST( ReparentingMovesTheSubtree )
+{
+    TransformHierarchy hierarchy;
+    NaiveHierarchy naive;
+    const NodeId a = naive.Add( hierarchy, NoParent, Local( 0.5f, 1.0f, 0.0f, 0.0f ) );
+    const NodeId b = naive.Add( hierarchy, a, Local( 0.5f, 0.0f, 1.0f, 0.0f ) );
+    const NodeId c = naive.Add( hierarchy, b, Local( 0.5f, 0.0f, 0.0f, 1.0f ) );
+    const NodeId d = naive.Add( hierarchy, NoParent, Local( -1.0f, 5.0f, 0.0f, 0.0f ) );
+    const NodeId e = naive.Add( hierarchy, d, Local( 1.0f, 0.0f, 2.0f, 0.0f ) );
+    const NodeId f = naive.Add( hierarchy, e, Local( 0.0f, 0.0f, 0.0f, 3.0f ) );
+    hierarchy.Update( Jobs() );
+    CHECK_EQ( hierarchy.GetLevelCount(), 3u );
+
+    // b (with c) under f: depths 3 and 4.
+    naive.SetParent( hierarchy, b, f );
+    CHECK_EQ( hierarchy.Update( Jobs() ), 2u );
+    CHECK_EQ( hierarchy.GetLevelCount(), 5u );
+    CHECK( WorldsMatch( hierarchy, naive ) );
+
+    // e (with f, b and c) becomes a root.
+    naive.SetParent( hierarchy, e, NoParent );
+    CHECK_EQ( hierarchy.Update( Jobs() ), 4u );
+    CHECK_EQ( hierarchy.GetLevelCount(), 4u );
+    CHECK( WorldsMatch( hierarchy, naive ) );
+
+    // The root a goes under c, at the bottom of e's subtree.
+    naive.SetParent( hierarchy, a, c );
+    CHECK_EQ( hierarchy.Update( Jobs() ), 1u );
+    CHECK_EQ( hierarchy.GetLevelCount(), 5u );
+    CHECK( WorldsMatch( hierarchy, naive ) );
+}
+
+TEST( ReparentingRejectsCycles )
+{
+    TransformHierarchy hierarchy;
+    const NodeId root = hierarchy.AddNode( NoParent, XMMatrixIdentity() );
+    const NodeId child = hierarchy.AddNode( root, XMMatrixIdentity() );
+    const NodeId grandchild = hierarchy.AddNode( child, XMMatrixIdentity() );
+
+    CHECK_THROWS( hierarchy.SetParent( root, root ) );
+    CHECK_THROWS( hierarchy.SetParent( root, grandchild ) );
+    CHECK_THROWS( hierarchy.SetParent( child, grandchild ) );
+    CHECK_THROWS( hierarchy.SetParent( 7, root ) );
+    CHECK_THROWS( hierarchy.SetParent( child, 7 ) );
+
+    // Moving within the subtree's own ancestors is fine.
+    hierarchy.SetParent( grandchild, root );
+    CHECK_EQ( hierarchy.Update( Jobs() ), 3u );
+    CHECK_EQ( hierarchy.GetLevelCount(), 2u );
+}
+
+// Levels wide enough to be split across the workers, with changes and moves between
+// updates: the parallel update must agree with the recursive evaluation every time.
+TEST( ParallelUpdateMatchesRecursiveEvaluation )
+{
+    const uint32_t Count = 30000;
+    TransformHierarchy hierarchy;
+    NaiveHierarchy naive;
+    hierarchy.Reserve( Count );
+
+    // Sixteen roots and four children per node, breadth first: several levels wider
+    // than one job's share.
+    std::mt19937 random( 4 );
+    for (uint32_t i = 0; i < Count; i++)
+    {
+        naive.Add( hierarchy, i < 16 ? NoParent : ( i - 16 ) / 4, RandomLocal( random ) );
+    }
+    CHECK_EQ( hierarchy.Update( Jobs() ), Count );
+    CHECK( WorldsMatch( hierarchy, naive ) );
+
+    for (int round = 0; round < 5; round++)
+    {
+        std::vector<NodeId> changed;
+        for (int i = 0; i < 50; i++)
+        {
+            changed.push_back( static_cast<NodeId>( random() % Count ) );
+            naive.SetLocal( hierarchy, changed.back(), RandomLocal( random ) );
+        }
+
+        // Moves that keep the hierarchy acyclic: under a node outside the moved subtree.
+        for (int i = 0; i < 10; i++)
+        {
+            const NodeId node = static_cast<NodeId>( 16 + random() % ( Count - 16 ) );
+            const NodeId parent = static_cast<NodeId>( random() % Count );
+            if (!naive.IsInSubtree( parent, node ))
+            {
+                changed.push_back( node );
+                naive.SetParent( hierarchy, node, parent );
+            }
+        }
+
+        CHECK_EQ( hierarchy.Update( Jobs() ), naive.CountAffected( changed ) );
+        CHECK_EQ( hierarchy.GetLevelCount(), naive.CountLevels() );
+        CHECK( WorldsMatch( hierarchy, naive ) );
+    }
+}